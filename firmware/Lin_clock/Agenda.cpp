@@ -0,0 +1,373 @@
+/* Agenda
+ * ======
+ * The alarms and chimes are described by a list of rules (the "agenda" setting), separated by a ';':
+ *   alarm 1-5 6:45 alarm*6       on monday to friday at 6:45, ring the alarm bell 6 times
+ *   chime * *:00 hours           every day on the whole hour, the melody and a chime for every hour
+ *   chime * *:15,30,45 quarter   every day, every quarter
+ *   chime 0,6 8-22:30 magical    on saturday and sunday at every half hour from 8:30 to 22:30
+ *   quiet * 23:00-7:00           no chimes (the alarms still sound) from 23:00 until 7:00
+ * The days are 0 (sunday) to 6, the hours 0 to 23 and the minutes 0 to 59, a * means all of them. A list may contain
+ * values and ranges, separated by a comma. The sounds are: melody, hour, quarter, magical, alarm (these are the
+ * samples, an optional *n plays it n times) and hours. An alarm rings the alarm bell 6 times when no sound is given,
+ * a chime plays the quarter.
+ *
+ * The rules are parsed only once. The next moment of every alarm and chime rule is kept in a queue that is sorted
+ * on time, so normally the only thing that needs to be done is to compare the time with the first entry of the queue.
+ * Only the rule that fired is moved to its next moment. When the time jumps (the first sync, a change of timezone
+ * or daylight saving time) the queue is rebuilt.
+*/
+
+#include <Arduino.h>
+#include "Agenda.h"
+#include "Audio.h"
+#include "Eventlog.h"
+
+/*--------------------------------------------*/
+typedef struct
+{
+  unsigned char kind;     /*one of Agenda_kinds*/
+  unsigned char days;     /*bit 0 is sunday*/
+  unsigned long hours;    /*bit 0 is 0:00-0:59*/
+  uint64_t minutes;       /*bit 0 is the whole hour*/
+  unsigned int from;      /*quiet: the first minute of the day (0-1439) that is quiet...*/
+  unsigned int until;     /*...up to this minute, the period may pass midnight*/
+  unsigned char sound;    /*one of Audio_samples or AGENDA_HOURS*/
+  unsigned char count;
+} agenda_ruleTYPE;
+
+static const char * const kind_names[] = {"alarm", "chime", "quiet"};
+static const char * const sound_names[AUDIO_SAMPLES] = {"melody", "hour", "quarter", "magical", "alarm"};  /*in the order of Audio_samples*/
+
+static agenda_ruleTYPE rules[AGENDA_RULES];
+static unsigned char rule_count = 0;
+static bool agenda_valid = true;
+static unsigned long next[AGENDA_RULES];    /*the next moment (local time) of every rule*/
+static unsigned char queue[AGENDA_RULES];   /*the alarm and chime rules, the first one is due first*/
+static unsigned char queue_count = 0;
+static unsigned long last_local = 0;        /*the time of the previous call, 0 when the queue must be (re)built*/
+
+/*------------------------------------------------------------------------------------------*/
+const char* agenda_rule(const char *p, agenda_ruleTYPE *rule);
+const char* agenda_word(const char *p, const char * const *names, unsigned char count, unsigned char *index);
+const char* agenda_list(const char *p, unsigned char max, uint64_t *mask);
+const char* agenda_time(const char *p, unsigned int *minute);
+unsigned long agenda_next(const agenda_ruleTYPE *rule, unsigned long after);
+bool agenda_quiet(unsigned long local);
+void agenda_build(unsigned long local);
+void agenda_insert(unsigned char r);
+/*------------------------------------------------------------------------------------------*/
+
+/*parse the rules, a rule that can't be parsed is ignored (the others are used), the queue is rebuilt at the next call of Agenda_due()*/
+void Agenda_init(const char *text)
+{
+  const char *p = text;
+  const char *q;
+
+  rule_count = 0;
+  agenda_valid = true;
+  while((p != NULL) && (*p != 0))
+  {
+    while((*p == ' ') || (*p == ';')) {p++;}
+    if(*p == 0)
+    {
+      break;
+    }
+
+    q = (rule_count < AGENDA_RULES) ? agenda_rule(p, &rules[rule_count]) : NULL;
+    if(q == NULL)
+    {
+      Serial.print(F("Invalid agenda rule: "));
+      Serial.println(p);
+      agenda_valid = false;
+      q = strchr(p, ';');                       /*skip to the next rule*/
+    }
+    else
+    {
+      rule_count++;
+    }
+    p = q;
+  }
+
+  queue_count = 0;
+  last_local = 0;       /*force the queue to be built at the first call of Agenda_due()*/
+}
+
+/*true when an event is due at this local time (seconds since 1970), the event is removed from the queue*/
+bool Agenda_due(unsigned long local, agenda_eventTYPE *event)
+{
+  unsigned char r;
+  unsigned long late;
+
+  if((last_local == 0) || (local < last_local) || ((local - last_local) > AGENDA_LATE))  /*the time has jumped*/
+  {
+    agenda_build(local);
+  }
+  last_local = local;
+
+  if((queue_count == 0) || (next[queue[0]] > local))  /*nothing to do, this is the normal case*/
+  {
+    return(false);
+  }
+
+  r = queue[0];
+  late = local - next[r];
+  memmove(&queue[0], &queue[1], queue_count - 1);
+  queue_count--;
+  next[r] = agenda_next(&rules[r], local);
+  agenda_insert(r);
+
+  if((late > AGENDA_LATE) || ((rules[r].kind == AGENDA_CHIME) && (agenda_quiet(local) == true)))
+  {
+    Eventlog_add(EVENT_AGENDA, r, 0);
+    return(false);
+  }
+  Eventlog_add(EVENT_AGENDA, r, 1);
+  event->kind = rules[r].kind;
+  event->sound = rules[r].sound;
+  event->count = rules[r].count;
+  return(true);
+}
+
+/*false when one of the rules could not be parsed (it is ignored)*/
+bool Agenda_valid(void)
+{
+  return(agenda_valid);
+}
+
+/*................................................................*/
+
+/*parse a single rule, returns a pointer to the character after it (a ';' or the end of the text), or NULL when it is not valid*/
+const char* agenda_rule(const char *p, agenda_ruleTYPE *rule)
+{
+  uint64_t mask;
+  unsigned long value;
+  char *end;
+
+  p = agenda_word(p, kind_names, sizeof(kind_names) / sizeof(kind_names[0]), &rule->kind);
+  if(p != NULL)  {p = agenda_list(p, 6, &mask);  rule->days = mask;}
+  if(p == NULL)
+  {
+    return(NULL);
+  }
+
+  if(rule->kind == AGENDA_QUIET)
+  {
+    p = agenda_time(p, &rule->from);
+    if((p != NULL) && (*p == '-'))  {p = agenda_time(p + 1, &rule->until);} else {p = NULL;}
+  }
+  else
+  {
+    p = agenda_list(p, 23, &mask);
+    rule->hours = mask;
+    if((p != NULL) && (*p == ':'))  {p = agenda_list(p + 1, 59, &rule->minutes);} else {p = NULL;}
+
+    rule->sound = (rule->kind == AGENDA_ALARM) ? AUDIO_ALARM : AUDIO_QUARTER;
+    rule->count = (rule->kind == AGENDA_ALARM) ? 6 : 1;
+    while((p != NULL) && (*p == ' ')) {p++;}
+    if((p != NULL) && (strncmp(p, "hours", 5) == 0) && ((p[5] == ' ') || (p[5] == ';') || (p[5] == 0)))
+    {
+      rule->sound = AGENDA_HOURS;
+      p = p + 5;
+    }
+    else if((p != NULL) && (*p != ';') && (*p != 0))
+    {
+      p = agenda_word(p, sound_names, AUDIO_SAMPLES, &rule->sound);
+      if((p != NULL) && (*p == '*'))
+      {
+        value = strtoul(p + 1, &end, 10);
+        p = ((end == (p + 1)) || (value == 0) || (value > 99)) ? NULL : end;
+        rule->count = value;
+      }
+    }
+  }
+
+  while((p != NULL) && (*p == ' ')) {p++;}
+  if((p != NULL) && (*p != ';') && (*p != 0))  /*something we don't understand*/
+  {
+    return(NULL);
+  }
+  return(p);
+}
+
+/*one of the names (followed by a space, ';', '*' or the end), the spaces after it are skipped*/
+const char* agenda_word(const char *p, const char * const *names, unsigned char count, unsigned char *index)
+{
+  unsigned char i;
+  size_t len;
+
+  for(i=0; i<count; i++)
+  {
+    len = strlen(names[i]);
+    if((strncmp(p, names[i], len) == 0) && ((p[len] == ' ') || (p[len] == ';') || (p[len] == '*') || (p[len] == 0)))
+    {
+      *index = i;
+      p = p + len;
+      while(*p == ' ') {p++;}
+      return(p);
+    }
+  }
+  return(NULL);
+}
+
+/*a '*' or a list of values and ranges (like "1-5" or "15,30,45"), from 0 up to max, the spaces after it are skipped*/
+const char* agenda_list(const char *p, unsigned char max, uint64_t *mask)
+{
+  unsigned long first;
+  unsigned long last;
+  char *end;
+
+  *mask = 0;
+  if(*p == '*')
+  {
+    *mask = (max == 63) ? ~0ULL : ((1ULL << (max + 1)) - 1);
+    p++;
+  }
+  else
+  {
+    while(true)
+    {
+      first = strtoul(p, &end, 10);
+      if(end == p)
+      {
+        return(NULL);
+      }
+      p = end;
+      last = first;
+      if(*p == '-')
+      {
+        last = strtoul(p + 1, &end, 10);
+        if(end == (p + 1))
+        {
+          return(NULL);
+        }
+        p = end;
+      }
+      if((first > last) || (last > max))
+      {
+        return(NULL);
+      }
+      for(; first<=last; first++)
+      {
+        *mask = *mask | (1ULL << first);
+      }
+      if(*p != ',')
+      {
+        break;
+      }
+      p++;
+    }
+  }
+  while(*p == ' ') {p++;}
+  return(p);
+}
+
+/*a time of the day (like "7:00" or "23:30") in minutes since 0:00, the spaces after it are skipped*/
+const char* agenda_time(const char *p, unsigned int *minute)
+{
+  unsigned long hours;
+  unsigned long minutes;
+  char *end;
+
+  hours = strtoul(p, &end, 10);
+  if((end == p) || (*end != ':') || (hours > 23))
+  {
+    return(NULL);
+  }
+  p = end + 1;
+  minutes = strtoul(p, &end, 10);
+  if((end == p) || (minutes > 59))
+  {
+    return(NULL);
+  }
+  *minute = (hours * 60) + minutes;
+  p = end;
+  while(*p == ' ') {p++;}
+  return(p);
+}
+
+/*the first moment (local time, a whole minute) after the given moment at which the rule applies*/
+unsigned long agenda_next(const agenda_ruleTYPE *rule, unsigned long after)
+{
+  unsigned long t = ((after / 60) + 1) * 60;
+  unsigned int tries;
+
+  for(tries=0; tries<2000; tries++)   /*at most 8 days of skipped days and hours, and the minutes of the last hour*/
+  {
+    if((rule->days & (1 << (((t / 86400) + 4) % 7))) == 0)   /*1-1-1970 was a thursday*/
+    {
+      t = ((t / 86400) + 1) * 86400;
+    }
+    else if((rule->hours & (1UL << ((t / 3600) % 24))) == 0)
+    {
+      t = ((t / 3600) + 1) * 3600;
+    }
+    else if((rule->minutes & (1ULL << ((t / 60) % 60))) == 0)
+    {
+      t = t + 60;
+    }
+    else
+    {
+      return(t);
+    }
+  }
+  return(0xFFFFFFFF);                 /*never (no days, hours or minutes)*/
+}
+
+/*true when this moment (local time) is in one of the quiet periods*/
+bool agenda_quiet(unsigned long local)
+{
+  unsigned int minute = (local / 60) % 1440;
+  unsigned char today = ((local / 86400) + 4) % 7;
+  unsigned char yesterday = (today + 6) % 7;
+  unsigned char r;
+
+  for(r=0; r<rule_count; r++)
+  {
+    if(rules[r].kind != AGENDA_QUIET)
+    {
+      continue;
+    }
+    if(rules[r].from <= rules[r].until)
+    {
+      if((rules[r].days & (1 << today)) && (minute >= rules[r].from) && (minute < rules[r].until))
+      {
+        return(true);
+      }
+    }
+    else if(((rules[r].days & (1 << today)) && (minute >= rules[r].from)) || ((rules[r].days & (1 << yesterday)) && (minute < rules[r].until)))
+    {
+      return(true);                   /*the period passes midnight, the part after midnight belongs to the day before*/
+    }
+  }
+  return(false);
+}
+
+/*put the next moment of every alarm and chime rule in the queue, the events at this very moment are not included*/
+void agenda_build(unsigned long local)
+{
+  unsigned char r;
+
+  queue_count = 0;
+  for(r=0; r<rule_count; r++)
+  {
+    if(rules[r].kind != AGENDA_QUIET)
+    {
+      next[r] = agenda_next(&rules[r], local);
+      agenda_insert(r);
+    }
+  }
+}
+
+/*put a rule in the queue, behind the rules that are due earlier (or at the same moment)*/
+void agenda_insert(unsigned char r)
+{
+  unsigned char i = queue_count;
+
+  while((i > 0) && (next[queue[i - 1]] > next[r]))
+  {
+    queue[i] = queue[i - 1];
+    i--;
+  }
+  queue[i] = r;
+  queue_count++;
+}
@@ -0,0 +1,26 @@
+#ifndef __AGENDA_H
+#define __AGENDA_H
+
+/*------------------------------------------*/
+
+#define AGENDA_RULES    12      /*the number of rules that can be used*/
+#define AGENDA_LATE     90      /*an event that is more than this number of seconds late is skipped (the time has jumped)*/
+#define AGENDA_HOURS    0xFF    /*the sound of an event: the melody followed by a chime for every hour (see Audio_hour())*/
+
+enum Agenda_kinds {AGENDA_ALARM,  /*sounds, also during the quiet hours*/
+                   AGENDA_CHIME,  /*sounds, but not during the quiet hours*/
+                   AGENDA_QUIET   /*a period in which the chimes are silent*/
+                  };
+
+typedef struct
+{
+  unsigned char kind;     /*AGENDA_ALARM or AGENDA_CHIME*/
+  unsigned char sound;    /*one of Audio_samples or AGENDA_HOURS*/
+  unsigned char count;    /*the number of times the sound is played*/
+} agenda_eventTYPE;
+
+void Agenda_init(const char *rules);  /*parse the rules (like "alarm 1-5 7:00 alarm*6; chime * *:00 hours; quiet * 23:00-7:00"), the queue is rebuilt*/
+bool Agenda_due(unsigned long local, agenda_eventTYPE *event);  /*true when an event is due at this local time (seconds since 1970), call this regularly*/
+bool Agenda_valid(void);              /*false when one of the rules could not be parsed (it is ignored)*/
+
+#endif
@@ -0,0 +1,317 @@
+/* Audio playback
+ * ==============
+ * Plays the samples from the SPIFFS without blocking the rest of the sketch. The requests are placed in a queue and
+ * Audio_loop() feeds the output a little bit every time it is called, so the motor keeps moving and the webserver
+ * keeps responding while the clock chimes.
+ *
+ * The generator, the file sources and the output are created only once, creating and deleting them for every sample
+ * would fragment the heap. The short chime (which is repeated up to 12 times every hour) is kept in RAM when it is
+ * small enough, otherwise it is read from the SPIFFS like all other samples.
+ *
+ * The samples are converted by tools/audio_convert.py (the originals are in the audio folder of the sketch), which
+ * also writes the manifest (audio.json) holding the duration and size of every sample. This way we know how long a
+ * job is going to take and whether a sample fits in RAM, without opening the files.
+*/
+
+#include <Arduino.h>
+#include <FS.h>
+#include <ArduinoJson.h>
+#include "Audio.h"
+#include "Metrics.h"
+
+#include "AudioFileSourceSPIFFS.h"  /*this sketch requires the library "ESP8266Audio-master.zip" to be installed ( https://github.com/earlephilhower/ESP8266Audio )*/
+#include "AudioFileSourcePROGMEM.h" /*used to play the sample that is cached in RAM*/
+#include "AudioGeneratorWAV.h"
+#include "AudioOutputI2SNoDAC.h"    /*the cheap method of making sound*/
+//#include <AudioOutputI2S.h>       /*the sophisticated way of making sound*/
+
+/*--------------------------------------------*/
+#define AUDIO_MANIFEST    "/audio.json"
+#define AUDIO_OVERRUN     2000    /*a sample that plays this much (ms) longer than the manifest says is stopped*/
+#define AUDIO_HEAP_RESERVE 16384  /*the cache may not bring the free heap below this (in bytes)*/
+
+enum Audio_states {AUDIO_IDLE, AUDIO_PAUSE, AUDIO_PLAYING};
+
+/*the files that belong to the samples, in the same order as Audio_samples*/
+static const char * const sample_files[AUDIO_SAMPLES] = {"/clock_melody.wav",
+                                                         "/clock_chime_short.wav",
+                                                         "/clock_chime_quarter.wav",
+                                                         "/clock_chime_magical.wav",
+                                                         "/clock_alarm.wav"
+                                                        };
+
+typedef struct
+{
+  unsigned char sample;   /*the sample to play*/
+  unsigned char count;    /*the number of times it still has to be played*/
+  unsigned int pause;     /*silence (in ms) before every repetition*/
+} Audio_jobTYPE;
+
+static Audio_jobTYPE queue[AUDIO_QUEUE_SIZE];
+static unsigned char queue_head = 0;        /*the job that is playing (or the next one)*/
+static unsigned char queue_count = 0;       /*the number of jobs in the queue*/
+static unsigned char audio_state = AUDIO_IDLE;
+static unsigned long pause_millis = 0;
+static unsigned char led_pin = 0;
+
+static AudioGeneratorWAV *wav = NULL;
+static AudioFileSourceSPIFFS *file = NULL;
+static AudioFileSourcePROGMEM *mem = NULL;
+static AudioOutputI2SNoDAC *out = NULL;
+//static AudioOutputI2S *out = NULL;
+
+static unsigned int sample_ms[AUDIO_SAMPLES];     /*duration according to the manifest, 0 when unknown*/
+static unsigned long sample_bytes[AUDIO_SAMPLES]; /*file size according to the manifest, 0 when unknown*/
+static unsigned long start_millis = 0;            /*when the current sample started playing*/
+
+static uint8_t *cache = NULL;               /*the short chime in RAM*/
+static uint32_t cache_size = 0;
+
+/*------------------------------------------------------------------------------------------*/
+bool audio_start(unsigned char sample);
+void audio_cache(unsigned char sample);
+void audio_manifest(void);
+/*------------------------------------------------------------------------------------------*/
+
+/*ATTENTION:, don't call this before WebConfig_init() as it WILL crash the ESP (has something to do with declaring of the "out" object (don't ask me why, but it works better this way)*/
+void Audio_init(unsigned char led)
+{
+  led_pin = led;
+  out = new AudioOutputI2SNoDAC();  /*this initialisation is required for all audio playback code, the objects live forever, so the heap is not fragmented by playing samples*/
+  wav = new AudioGeneratorWAV();
+  file = new AudioFileSourceSPIFFS();
+  mem = new AudioFileSourcePROGMEM();
+  audio_manifest();
+  audio_cache(AUDIO_HOUR);          /*the sample that is repeated most often*/
+}
+
+/*play a sample count times, with a silence of pause ms before every repetition, returns false when the queue is full*/
+bool Audio_queue(unsigned char sample, unsigned char count, unsigned int pause)
+{
+  unsigned char i;
+
+  if((queue_count >= AUDIO_QUEUE_SIZE) || (sample >= AUDIO_SAMPLES) || (count == 0))
+  {
+    return(false);
+  }
+
+  i = (queue_head + queue_count) % AUDIO_QUEUE_SIZE;
+  queue[i].sample = sample;
+  queue[i].count = count;
+  queue[i].pause = pause;
+  queue_count++;
+  return(true);
+}
+
+/*chime on the whole hour: the melody, a small pause (othwerwise the first hour chime will be not noticed) and then sound the number of hours*/
+void Audio_hour(unsigned char hours)
+{
+  Audio_queue(AUDIO_MELODY, 1, 0);
+  if(hours > 0)
+  {
+    Audio_queue(AUDIO_HOUR, 1, 2000);
+    if(hours > 1)
+    {
+      Audio_queue(AUDIO_HOUR, hours - 1, 0);
+    }
+  }
+}
+
+/*the duration of a sample in ms (0 when it is not in the manifest)*/
+unsigned int Audio_duration(unsigned char sample)
+{
+  if(sample >= AUDIO_SAMPLES)
+  {
+    return(0);
+  }
+  return(sample_ms[sample]);
+}
+
+/*an estimate of the time (in ms) it takes to play everything in the queue*/
+unsigned long Audio_remaining(void)
+{
+  unsigned long ms = 0;
+  unsigned char i;
+  unsigned char j;
+
+  for(i=0; i<queue_count; i++)
+  {
+    j = (queue_head + i) % AUDIO_QUEUE_SIZE;
+    ms = ms + ((unsigned long)queue[j].count * (queue[j].pause + sample_ms[queue[j].sample]));
+  }
+
+  if((audio_state == AUDIO_PLAYING) && (queue_count > 0))  /*the pause and part of the current sample are already over*/
+  {
+    ms = ms - queue[queue_head].pause - min((unsigned long)sample_ms[queue[queue_head].sample], millis() - start_millis);
+  }
+  return(ms);
+}
+
+/*true as long as there is something playing or waiting to be played*/
+bool Audio_busy(void)
+{
+  return((queue_count > 0) || (audio_state != AUDIO_IDLE));
+}
+
+/*keep the audio going, call this as often as possible (every call a small part of the sample is sent to the output)*/
+void Audio_loop(void)
+{
+  unsigned long start_micros = micros();
+
+  switch(audio_state)
+  {
+    case AUDIO_IDLE:
+    {
+      if(queue_count > 0)
+      {
+        pause_millis = millis();
+        audio_state = AUDIO_PAUSE;
+      }
+      return;     /*nothing to measure*/
+    }
+
+    case AUDIO_PAUSE:
+    {
+      if((millis() - pause_millis) >= queue[queue_head].pause)
+      {
+        start_millis = millis();
+        if(audio_start(queue[queue_head].sample) == true)
+        {
+          audio_state = AUDIO_PLAYING;
+        }
+        else
+        {
+          Serial.print(F("Could not play "));
+          Serial.println(sample_files[queue[queue_head].sample]);
+          queue[queue_head].count = 1;  /*skip this job*/
+          audio_state = AUDIO_PLAYING;  /*the generator isn't running, so the job is finished immediately*/
+        }
+      }
+      break;
+    }
+
+    case AUDIO_PLAYING:
+    {
+      if(wav->isRunning())
+      {
+        if (!wav->loop()) wav->stop();  /*stopping also closes the file*/
+        else if((sample_ms[queue[queue_head].sample] > 0) && ((millis() - start_millis) > (sample_ms[queue[queue_head].sample] + AUDIO_OVERRUN)))
+        {
+          Serial.println(F("Sample takes too long, stopped"));  /*the file doesn't match the manifest (or is damaged)*/
+          wav->stop();
+        }
+      }
+      else
+      {
+        /*led output is also a pin that is used by the I2S port, therefore we must restore it back to IO when done playing the sample*/
+        pinMode(led_pin, OUTPUT);         /*indicator LED*/
+        digitalWrite(led_pin, LOW);       /*should be off*/
+
+        queue[queue_head].count--;
+        if(queue[queue_head].count == 0)  /*this job is done, continue with the next*/
+        {
+          queue_head = (queue_head + 1) % AUDIO_QUEUE_SIZE;
+          queue_count--;
+        }
+        pause_millis = millis();
+        audio_state = (queue_count > 0) ? AUDIO_PAUSE : AUDIO_IDLE;
+      }
+      break;
+    }
+
+    default:
+    {
+      audio_state = AUDIO_IDLE;
+      break;
+    }
+  }
+
+  Metrics_record(METRIC_AUDIO, micros() - start_micros);
+}
+
+/*................................................................*/
+
+/*start playing a sample, from RAM when it is cached, otherwise from the SPIFFS*/
+bool audio_start(unsigned char sample)
+{
+  if((sample == AUDIO_HOUR) && (cache != NULL))
+  {
+    mem->open(cache, cache_size);
+    return(wav->begin(mem, out));
+  }
+
+  if(file->open(sample_files[sample]) == false)
+  {
+    return(false);
+  }
+  return(wav->begin(file, out));
+}
+
+/*load a sample into RAM, but only when it is small enough and there is enough memory left for the rest of the sketch*/
+void audio_cache(unsigned char sample)
+{
+  File f;
+
+  if((sample_bytes[sample] == 0) || (sample_bytes[sample] > AUDIO_CACHE_MAX) || (ESP.getFreeHeap() < (AUDIO_HEAP_RESERVE + sample_bytes[sample])))
+  {
+    return;   /*not in the manifest or too large, no need to open the file*/
+  }
+
+  f = SPIFFS.open(sample_files[sample], "r");
+  if(!f)
+  {
+    return;
+  }
+
+  if((f.size() == sample_bytes[sample]) && (f.size() > 0))  /*the file must match the manifest*/
+  {
+    cache = (uint8_t *)malloc(f.size());
+    if(cache != NULL)
+    {
+      cache_size = f.read(cache, f.size());
+      Serial.print(F("Cached in RAM: "));
+      Serial.println(sample_files[sample]);
+    }
+  }
+  f.close();
+}
+
+/*read the duration and size of the samples from the manifest*/
+void audio_manifest(void)
+{
+  unsigned char i;
+
+  File f = SPIFFS.open(AUDIO_MANIFEST, "r");
+  if(!f)
+  {
+    Serial.println(F("No audio manifest"));
+    return;
+  }
+
+  size_t size = f.size();
+  if(size > 512)
+  {
+    Serial.println(F("Audio manifest too large"));
+    f.close();
+    return;
+  }
+
+  std::unique_ptr<char[]> buf(new char[size + 1]);  /*Allocate a buffer to store contents of the file.*/
+  f.readBytes(buf.get(), size);
+  buf[size] = 0;
+  f.close();
+
+  StaticJsonBuffer<800> jsonBuffer;
+  JsonObject& json = jsonBuffer.parseObject(buf.get());
+  if (!json.success())
+  {
+    Serial.println(F("Failed to parse audio manifest"));
+    return;
+  }
+
+  for(i=0; i<AUDIO_SAMPLES; i++)
+  {
+    sample_ms[i] = json["samples"][sample_files[i]]["ms"];
+    sample_bytes[i] = json["samples"][sample_files[i]]["bytes"];
+  }
+}
@@ -0,0 +1,26 @@
+#ifndef __AUDIO_H
+#define __AUDIO_H
+
+/*------------------------------------------*/
+
+#define AUDIO_QUEUE_SIZE  8       /*the number of jobs that can be waiting to be played*/
+#define AUDIO_CACHE_MAX   24576   /*the short chime is kept in RAM when it is not larger than this (in bytes)*/
+
+/*the available samples*/
+enum Audio_samples {AUDIO_MELODY,     /*the hourly melody before the actual chiming starts*/
+                    AUDIO_HOUR,       /*the chime indicating the hours*/
+                    AUDIO_QUARTER,    /*every 15 minutes*/
+                    AUDIO_MAGICAL,    /*a magical sound (for booting or to indicate ready)*/
+                    AUDIO_ALARM,      /*a old fashioned alarmclock-bell-ringing-sound*/
+                    AUDIO_SAMPLES
+                   };
+
+void Audio_init(unsigned char led);     /*do this after WebConfig_init(), led is the pin that must be restored after playback (it is shared with the I2S port)*/
+bool Audio_queue(unsigned char sample, unsigned char count, unsigned int pause);  /*play a sample count times, with a silence of pause ms before every repetition*/
+void Audio_hour(unsigned char hours);   /*the melody followed by the chime for every hour, as a single job*/
+unsigned int Audio_duration(unsigned char sample);  /*the duration of a sample in ms, according to the manifest*/
+unsigned long Audio_remaining(void);    /*an estimate of the time (in ms) it takes to play everything in the queue*/
+void Audio_loop(void);                  /*keep the audio going, call this as often as possible*/
+bool Audio_busy(void);                  /*true as long as there is something playing or waiting to be played*/
+
+#endif
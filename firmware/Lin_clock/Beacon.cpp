@@ -0,0 +1,272 @@
+/* Beacon
+ * ======
+ * With dozens of clocks on one site, every clock asking the timeservers itself multiplies the traffic and still
+ * leaves the clocks a little apart. Instead, one clock (the master, or a computer running tools/time_beacon.py)
+ * gets the time from the timeservers and sends a small time beacon to a multicast group every few seconds.
+ * The other clocks (the followers) simply listen, no name lookups and no requests are required.
+ *
+ * Anyone on the LAN could send beacons, so they are signed with SipHash-2-4 using a shared key. A copied beacon
+ * can't be sent again later, because the time in a beacon must always be later than in the previous one. That time
+ * is kept in the RTC memory, so this also holds after a warm reset (after power-on it is gone, like the time itself).
+ *
+ * A beacon looks like this (numbers are big endian):
+ *   "LCB" (3 bytes), version (1 byte), flags (1 byte), reserved (3 bytes), sequence number (4 bytes),
+ *   UTC time in us since 1970 (8 bytes), SipHash-2-4 of the previous 20 bytes (8 bytes, little endian)
+*/
+
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include "Beacon.h"
+#include "NTP.h"
+#include "Network.h"
+
+/*--------------------------------------------*/
+#define BEACON_VERSION    1
+#define BEACON_SIGNED     20      /*the number of bytes that are signed*/
+#define BEACON_SYNCED     0x01    /*flag: the time of the master is synced to a timeserver*/
+#define BEACON_RTC_MAGIC  0x4C434201UL
+
+/*the time of the last beacon in the RTC memory, the copy tells whether it is valid (after power-on it is random)*/
+typedef struct
+{
+  uint32_t magic;
+  uint32_t reserved;
+  uint64_t last_time;
+  uint64_t inverted;        /*~last_time*/
+} beacon_rtcTYPE;
+
+static const char * const mode_names[] = {"off", "master", "follower"};
+
+static unsigned char beacon_mode = BEACON_OFF;
+static uint8_t beacon_key[BEACON_KEY_SIZE];
+static unsigned long sequence = 0;
+static unsigned long beacon_millis = 0;       /*the last beacon that was sent or accepted*/
+static unsigned long long last_time = 0;      /*the time in the last beacon that was accepted*/
+static unsigned long sent = 0;
+static unsigned long accepted = 0;
+static unsigned long rejected = 0;
+static long last_offset = 0;                  /*the difference (in us) between the last beacon and our clock*/
+static bool following = false;                /*false when the master has disappeared and the timeservers are used*/
+static bool joined = false;                   /*we are a member of the multicast group (this is lost with the connection)*/
+static uint8_t packet[BEACON_SIZE];
+static char text[BEACON_TEXT_SIZE];
+static WiFiUDP beacon_udp;
+
+/*------------------------------------------------------------------------------------------*/
+uint64_t beacon_siphash(const uint8_t *key, const uint8_t *data, size_t len);
+void beacon_send(void);
+void beacon_receive(void);
+void beacon_rtc_write(void);
+/*------------------------------------------------------------------------------------------*/
+
+/*mode is "off", "master" or "follower", the key is a shared secret of at most 16 characters*/
+void Beacon_init(const char *mode, const char *key)
+{
+  beacon_rtcTYPE rtc;
+  unsigned char i;
+
+  ESP.rtcUserMemoryRead(BEACON_RTC_OFFSET, (uint32_t *)&rtc, sizeof(rtc));
+  if((rtc.magic == BEACON_RTC_MAGIC) && (rtc.inverted == ~rtc.last_time))
+  {
+    last_time = rtc.last_time;    /*a warm reset, the beacons from before it are still old*/
+  }
+
+  beacon_mode = BEACON_OFF;
+  for(i=BEACON_OFF; i<=BEACON_FOLLOWER; i++)
+  {
+    if(strcmp(mode, mode_names[i]) == 0)
+    {
+      beacon_mode = i;
+    }
+  }
+
+  memset(beacon_key, 0, sizeof(beacon_key));
+  memcpy(beacon_key, key, strnlen(key, sizeof(beacon_key)));   /*no terminating 0 required, the rest stays 0*/
+  if((beacon_mode != BEACON_OFF) && (key[0] == 0))
+  {
+    Serial.println(F("Beacon: no key, anyone on the LAN can set the time"));
+  }
+
+  if(beacon_mode == BEACON_FOLLOWER)
+  {
+    NTP_follow(true);
+    following = true;
+  }
+  Serial.print(F("Beacon: "));
+  Serial.println(mode_names[beacon_mode]);
+}
+
+/*send or receive the beacons, call this regularly (a follower uses the arrival time, so often)*/
+void Beacon_process(void)
+{
+  if(Network_connected() == false)
+  {
+    joined = false;
+  }
+  else if(beacon_mode == BEACON_MASTER)
+  {
+    if((NTP_struct.synced == true) && ((millis() - beacon_millis) >= BEACON_INTERVAL))
+    {
+      beacon_send();
+      beacon_millis = millis();
+    }
+  }
+  else if(beacon_mode == BEACON_FOLLOWER)
+  {
+    if(joined == false)                       /*the group can only be joined once we have an address*/
+    {
+      beacon_udp.beginMulticast(WiFi.localIP(), IPAddress(BEACON_GROUP), BEACON_PORT);
+      joined = true;
+      beacon_millis = millis();               /*give the master some time (again) before the timeservers are used*/
+    }
+    beacon_receive();
+    if((following == true) && ((millis() - beacon_millis) > BEACON_TIMEOUT))
+    {
+      Serial.println(F("Beacon: master lost, using the timeservers"));
+      NTP_follow(false);
+      following = false;
+    }
+  }
+}
+
+unsigned char Beacon_mode(void)
+{
+  return(beacon_mode);
+}
+
+/*the statistics of the beacons as text*/
+const char* Beacon_text(void)
+{
+  snprintf(text, sizeof(text), "mode %s\nfollowing %u\nsent %lu\naccepted %lu\nrejected %lu\nlast_offset_us %ld\nlast_ms_ago %lu\n",
+           mode_names[beacon_mode], following, sent, accepted, rejected, last_offset, millis() - beacon_millis);
+  return(text);
+}
+
+/*................................................................*/
+
+/*send our time to the multicast group*/
+void beacon_send(void)
+{
+  unsigned long long now_us;
+  uint64_t tag;
+  unsigned char i;
+
+  sequence++;
+  packet[0] = 'L'; packet[1] = 'C'; packet[2] = 'B'; packet[3] = BEACON_VERSION;
+  packet[4] = BEACON_SYNCED; packet[5] = 0; packet[6] = 0; packet[7] = 0;
+  for(i=0; i<4; i++)  {packet[8 + i] = sequence >> (24 - (8 * i));}
+  now_us = NTP_now();                         /*as late as possible*/
+  for(i=0; i<8; i++)  {packet[12 + i] = now_us >> (56 - (8 * i));}
+  tag = beacon_siphash(beacon_key, packet, BEACON_SIGNED);
+  for(i=0; i<8; i++)  {packet[BEACON_SIGNED + i] = tag >> (8 * i);}
+
+  beacon_udp.beginPacketMulticast(IPAddress(BEACON_GROUP), BEACON_PORT, WiFi.localIP());
+  beacon_udp.write(packet, BEACON_SIZE);
+  beacon_udp.endPacket();
+  sent++;
+}
+
+/*check the beacons that have arrived, the valid ones are used to set our clock*/
+void beacon_receive(void)
+{
+  unsigned long long time_us;
+  uint64_t tag;
+  unsigned char i;
+
+  while(beacon_udp.parsePacket() > 0)
+  {
+    time_us = 0;
+    tag = 0;
+    if((beacon_udp.read(packet, BEACON_SIZE) != BEACON_SIZE) || (packet[0] != 'L') || (packet[1] != 'C') || (packet[2] != 'B') || (packet[3] != BEACON_VERSION))
+    {
+      rejected++;
+      continue;
+    }
+
+    for(i=0; i<8; i++)  {tag |= (uint64_t)packet[BEACON_SIGNED + i] << (8 * i);}
+    for(i=0; i<8; i++)  {time_us = (time_us << 8) | packet[12 + i];}
+    if((tag != beacon_siphash(beacon_key, packet, BEACON_SIGNED)) || (time_us <= last_time) || ((packet[4] & BEACON_SYNCED) == 0))
+    {
+      rejected++;                             /*wrong key, an old (copied) beacon or the master doesn't know the time itself*/
+      continue;
+    }
+
+    last_time = time_us;
+    beacon_rtc_write();
+    last_offset = (long)((long long)(time_us - NTP_now()));
+    NTP_beacon(time_us);
+    accepted++;
+    beacon_millis = millis();
+    if(following == false)
+    {
+      Serial.println(F("Beacon: master found"));
+      NTP_follow(true);
+      following = true;
+    }
+  }
+}
+
+/*keep the time of the last beacon during a reset*/
+void beacon_rtc_write(void)
+{
+  beacon_rtcTYPE rtc;
+
+  rtc.magic = BEACON_RTC_MAGIC;
+  rtc.reserved = 0;
+  rtc.last_time = last_time;
+  rtc.inverted = ~last_time;
+  ESP.rtcUserMemoryWrite(BEACON_RTC_OFFSET, (uint32_t *)&rtc, sizeof(rtc));
+}
+
+/*SipHash-2-4, a fast keyed hash for short messages (https://131002.net/siphash/)*/
+#define ROTL(x, b)  (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+#define SIPROUND    do {v0 += v1; v1 = ROTL(v1, 13); v1 ^= v0; v0 = ROTL(v0, 32); \
+                        v2 += v3; v3 = ROTL(v3, 16); v3 ^= v2;                    \
+                        v0 += v3; v3 = ROTL(v3, 21); v3 ^= v0;                    \
+                        v2 += v1; v1 = ROTL(v1, 17); v1 ^= v2; v2 = ROTL(v2, 32);} while(0)
+
+uint64_t beacon_siphash(const uint8_t *key, const uint8_t *data, size_t len)
+{
+  uint64_t k0 = 0;
+  uint64_t k1 = 0;
+  uint64_t m;
+  uint64_t b = (uint64_t)len << 56;
+  uint64_t v0, v1, v2, v3;
+  size_t i;
+  unsigned char j;
+
+  for(j=0; j<8; j++)
+  {
+    k0 |= (uint64_t)key[j] << (8 * j);
+    k1 |= (uint64_t)key[8 + j] << (8 * j);
+  }
+  v0 = k0 ^ 0x736f6d6570736575ULL;
+  v1 = k1 ^ 0x646f72616e646f6dULL;
+  v2 = k0 ^ 0x6c7967656e657261ULL;
+  v3 = k1 ^ 0x7465646279746573ULL;
+
+  for(i=0; (i + 8) <= len; i += 8)            /*all complete 8 byte words*/
+  {
+    m = 0;
+    for(j=0; j<8; j++)  {m |= (uint64_t)data[i + j] << (8 * j);}
+    v3 ^= m;
+    SIPROUND;
+    SIPROUND;
+    v0 ^= m;
+  }
+  for(j=0; (i + j) < len; j++)                /*the remaining bytes and the length*/
+  {
+    b |= (uint64_t)data[i + j] << (8 * j);
+  }
+
+  v3 ^= b;
+  SIPROUND;
+  SIPROUND;
+  v0 ^= b;
+  v2 ^= 0xff;
+  SIPROUND;
+  SIPROUND;
+  SIPROUND;
+  SIPROUND;
+  return(v0 ^ v1 ^ v2 ^ v3);
+}
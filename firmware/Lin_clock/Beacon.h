@@ -0,0 +1,26 @@
+#ifndef __BEACON_H
+#define __BEACON_H
+
+/*------------------------------------------*/
+
+#define BEACON_GROUP      239, 255, 42, 99  /*the multicast group (administratively scoped, so it stays on the LAN)*/
+#define BEACON_PORT       4242
+#define BEACON_INTERVAL   8000    /*the master sends a beacon every ... ms*/
+#define BEACON_TIMEOUT    60000   /*a follower uses the timeservers itself when it hasn't received a beacon for ... ms*/
+#define BEACON_SIZE       28      /*the size of a beacon in bytes, see Beacon.cpp*/
+#define BEACON_KEY_SIZE   16      /*the size of the SipHash key*/
+#define BEACON_TEXT_SIZE  256     /*the size of the beacon report*/
+#define BEACON_RTC_OFFSET 96      /*where the time of the last beacon is kept in the RTC memory (in blocks of 4 bytes), after the part of the journal*/
+
+/*the role of this clock*/
+enum Beacon_modes {BEACON_OFF,
+                   BEACON_MASTER,     /*gets the time from the timeservers and sends beacons*/
+                   BEACON_FOLLOWER    /*gets the time from the beacons*/
+                  };
+
+void Beacon_init(const char *mode, const char *key);  /*mode is "off", "master" or "follower", the key is a shared secret of at most 16 characters*/
+void Beacon_process(void);                            /*send or receive the beacons, call this regularly (a follower uses the arrival time, so often)*/
+unsigned char Beacon_mode(void);
+const char* Beacon_text(void);                        /*the statistics of the beacons as text*/
+
+#endif
@@ -0,0 +1,166 @@
+/* Calibration
+ * ===========
+ * Measures the number of steps per minute of this particular clock. The indicator is homed, then it moves down
+ * over the insulator in the middle of the sensor bar. The stepper interrupt stores the positions where it starts and
+ * ends, the center of the insulator is at a known distance from the home sensor edge. Using the center makes the
+ * measurement independent of the width of the insulator and of the hysteresis of the sensor.
+ *
+ * The alarm blocks of the user give the same signal as the insulator, so only the edges within CALIBRATION_WINDOW
+ * of the expected center are used. When there are more than two, an alarm block is too close to 6:00 and the
+ * calibration fails (the user has to move it towards the end of the scale).
+*/
+
+#include <Arduino.h>
+#include "Calibration.h"
+#include "Homing.h"
+#include "Stepper.h"
+#include "Scale.h"
+
+/*--------------------------------------------*/
+enum Calibration_states {CALIBRATION_IDLE,
+                         CALIBRATION_HOMING,
+                         CALIBRATION_MEASURE,
+                         CALIBRATION_STOP
+                        };
+
+static unsigned char calibration_state = CALIBRATION_IDLE;
+static bool requested = false;
+static uint32_t block_mask = 0;           /*the pin of the updown sensor (as bit), it is high over the insulator and the alarm blocks*/
+static unsigned char edges = 0;           /*the number of edges within the window that have been found*/
+static unsigned long block_start = 0;
+static unsigned long block_end = 0;
+static unsigned long ratio = 0;
+
+/*------------------------------------------------------------------------------------------*/
+
+/*calibrate as soon as the clock has time for it*/
+void Calibration_request(void)
+{
+  requested = true;
+}
+
+/*true when calibration was requested (the request is cleared)*/
+bool Calibration_requested(void)
+{
+  bool result = requested;
+
+  requested = false;
+  return(result);
+}
+
+/*home, then measure the distance to the insulator, range is the maximum distance to find the home sensor*/
+void Calibration_start(unsigned char home_pin, unsigned char block_pin, unsigned long range)
+{
+  block_mask = 1UL << block_pin;
+  edges = 0;
+  Homing_start(home_pin, CALIBRATION_ORIGIN, range);
+  calibration_state = CALIBRATION_HOMING;
+}
+
+/*call as often as possible until it returns CALIBRATION_DONE or CALIBRATION_FAILED*/
+unsigned char Calibration_process(void)
+{
+  stepper_edgeTYPE edge;
+  unsigned char result;
+
+  switch(calibration_state)
+  {
+    case CALIBRATION_HOMING:
+    {
+      result = Homing_process();
+      if(result == HOMING_DONE)
+      {
+        while(Stepper_edge(&edge) == true) {}   /*forget the changes that were seen while homing*/
+        Stepper_moveto(CALIBRATION_ORIGIN - Scale_position(CALIBRATION_DISTANCE / 2) - Scale_position(CALIBRATION_WINDOW), STEPPER_PROFILE);
+        calibration_state = CALIBRATION_MEASURE;
+      }
+      else if(result == HOMING_FAILED)
+      {
+        calibration_state = CALIBRATION_IDLE;
+        return(CALIBRATION_FAILED);
+      }
+      break;
+    }
+
+    case CALIBRATION_MEASURE:
+    {
+      while(Stepper_edge(&edge) == true)
+      {
+        if(((edge.changed & block_mask) == 0) || (edge.position > (CALIBRATION_ORIGIN - Scale_position(CALIBRATION_DISTANCE / 2) + Scale_position(CALIBRATION_WINDOW))))
+        {
+          continue;   /*another sensor, or an alarm block between the home sensor and the window*/
+        }
+        if(edges == 0)
+        {
+          block_start = edge.position;
+          if((edge.level & block_mask) == 0)    /*the window starts halfway a block*/
+          {
+            edges = 2;
+          }
+        }
+        else if(edges == 1)
+        {
+          block_end = edge.position;
+        }
+        edges++;
+      }
+
+      if(Stepper_busy() == false)               /*went through the whole window*/
+      {
+        if(edges == 2)
+        {
+          calibration_state = CALIBRATION_STOP;
+          break;
+        }
+        calibration_state = CALIBRATION_IDLE;
+        if(edges == 0)
+        {
+          Serial.println(F("Calibration: insulator not found"));
+        }
+        else
+        {
+          Serial.println(F("Calibration: an alarm block is too close to 6:00, move the alarm blocks towards the ends of the scale"));
+        }
+        return(CALIBRATION_FAILED);
+      }
+      break;
+    }
+
+    case CALIBRATION_STOP:
+    {
+      if(Stepper_busy() == true)                /*wait for the motor to come to a standstill*/
+      {
+        break;
+      }
+
+      calibration_state = CALIBRATION_IDLE;
+      ratio = (unsigned long)(((uint64_t)(CALIBRATION_ORIGIN - (block_end + ((block_start - block_end) / 2))) << 17) / CALIBRATION_DISTANCE);
+      Serial.print(F("Calibration: insulator from "));
+      Serial.print(CALIBRATION_ORIGIN - block_start);
+      Serial.print(F(" to "));
+      Serial.print(CALIBRATION_ORIGIN - block_end);
+      Serial.print(F(" steps from home, "));
+      Serial.print((float)ratio / 65536.0, 3);
+      Serial.println(F(" steps per minute"));
+      if(Scale_valid(ratio) == false)
+      {
+        Serial.println(F("Calibration: unrealistic result"));
+        return(CALIBRATION_FAILED);
+      }
+      return(CALIBRATION_DONE);
+    }
+
+    case CALIBRATION_IDLE:
+    default:
+    {
+      return(CALIBRATION_FAILED);  /*not started*/
+    }
+  }
+  return(CALIBRATION_BUSY);
+}
+
+/*the measured number of steps per minute (16.16 fixed point)*/
+unsigned long Calibration_ratio(void)
+{
+  return(ratio);
+}
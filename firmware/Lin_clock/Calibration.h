@@ -0,0 +1,22 @@
+#ifndef __CALIBRATION_H
+#define __CALIBRATION_H
+
+/*------------------------------------------*/
+
+#define CALIBRATION_ORIGIN    0x10000000UL  /*the position counter at the home sensor edge during calibration*/
+#define CALIBRATION_DISTANCE  835           /*the distance in half minutes (0.5mm) between the home sensor edge (at 12:57) and the center of the insulator (between 17:59 and 6:00)*/
+#define CALIBRATION_WINDOW    25            /*the insulator must be within this number of minutes of where it is expected (the ratio may be 5% off), the alarm blocks must be further away*/
+
+/*the result of Calibration_process()*/
+enum Calibration_results {CALIBRATION_BUSY,
+                          CALIBRATION_DONE,
+                          CALIBRATION_FAILED
+                         };
+
+void Calibration_request(void);               /*calibrate as soon as the clock has time for it*/
+bool Calibration_requested(void);             /*true when calibration was requested (the request is cleared)*/
+void Calibration_start(unsigned char home_pin, unsigned char block_pin, unsigned long range);  /*home, then measure the distance to the insulator*/
+unsigned char Calibration_process(void);      /*call as often as possible until it returns CALIBRATION_DONE or CALIBRATION_FAILED*/
+unsigned long Calibration_ratio(void);        /*the measured number of steps per minute (16.16 fixed point)*/
+
+#endif
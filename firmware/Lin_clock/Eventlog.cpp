@@ -0,0 +1,126 @@
+/* Eventlog
+ * ========
+ * Printing text at 115200 baud takes about 87us per character, and Serial.print() waits when the (small) buffer of
+ * the UART is full. The statemachines therefore don't print what they do, they store a small binary event in a ring
+ * in RAM instead (a code, two numbers and the time). The events are printed later, when the serial port has room
+ * for them (so printing never waits), and the last EVENTLOG_SIZE events can be read from the /events page, which
+ * keeps far more history than anybody watching the serial port would remember.
+ *
+ * The /events page is binary (numbers are little endian), tools/event_log.py turns it into text:
+ *   "LCEV" (4 bytes), version (1 byte), record size (1 byte), number of records (2 bytes),
+ *   number of events since boot (4 bytes), millis() at the moment of the dump (4 bytes),
+ *   followed by the records, oldest first: millis() (4 bytes), code (2 bytes), a (2 bytes), b (4 bytes, signed)
+*/
+
+#include <Arduino.h>
+#include "Eventlog.h"
+
+/*--------------------------------------------*/
+typedef struct
+{
+  uint32_t ms;
+  uint16_t code;
+  uint16_t a;
+  int32_t b;
+} eventlog_recordTYPE;
+
+typedef struct
+{
+  char magic[4];
+  uint8_t version;
+  uint8_t record_size;
+  uint16_t count;
+  uint32_t total;
+  uint32_t now_ms;
+} eventlog_headerTYPE;
+
+static const char * const event_names[EVENT_CODES] = {"NONE",
+                                                      "BOOT",
+                                                      "STATE",
+                                                      "MOVE",
+                                                      "ARRIVED",
+                                                      "NTP_REQUEST",
+                                                      "NTP_REPLY",
+                                                      "NTP_SYNC",
+                                                      "NTP_TIMEOUT",
+                                                      "NTP_INVALID",
+                                                      "NTP_DNS_FAIL",
+                                                      "HTTP",
+                                                      "SETTING",
+                                                      "NETWORK",
+                                                      "CORRECTION",
+                                                      "ERROR",
+                                                      "AGENDA"
+                                                     };
+
+static_assert((EVENTLOG_SIZE & (EVENTLOG_SIZE - 1)) == 0, "EVENTLOG_SIZE must be a power of 2");
+
+static eventlog_recordTYPE ring[EVENTLOG_SIZE];
+static uint32_t total = 0;        /*the number of events since boot, the next event goes to ring[total % EVENTLOG_SIZE]*/
+static uint32_t printed = 0;      /*the number of events that have been printed*/
+
+/*------------------------------------------------------------------------------------------*/
+
+/*store an event, this costs next to nothing*/
+void Eventlog_add(unsigned char code, uint16_t a, long b)
+{
+  eventlog_recordTYPE *r = &ring[total & (EVENTLOG_SIZE - 1)];
+
+  r->ms = millis();
+  r->code = code;
+  r->a = a;
+  r->b = b;
+  total++;
+}
+
+/*print the events that haven't been printed yet, but only as much as fits in the serial buffer (so this never waits)*/
+void Eventlog_drain(void)
+{
+  char line[EVENTLOG_LINE];
+  eventlog_recordTYPE *r;
+  int len;
+
+  if((total - printed) > EVENTLOG_SIZE)   /*nobody could keep up, the oldest ones have been overwritten*/
+  {
+    printed = total - EVENTLOG_SIZE;
+  }
+
+  while((printed != total) && (Serial.availableForWrite() >= EVENTLOG_LINE))
+  {
+    r = &ring[printed & (EVENTLOG_SIZE - 1)];
+    len = snprintf(line, sizeof(line), "ev %lu %s %u %ld\r\n", (unsigned long)r->ms, (r->code < EVENT_CODES) ? event_names[r->code] : "?", r->a, (long)r->b);
+    Serial.write((const uint8_t *)line, (len < (int)sizeof(line)) ? len : (sizeof(line) - 1));
+    printed++;
+  }
+}
+
+/*the size (in bytes) of the dump below*/
+size_t Eventlog_size(void)
+{
+  uint32_t count = (total < EVENTLOG_SIZE) ? total : EVENTLOG_SIZE;
+
+  return(sizeof(eventlog_headerTYPE) + (count * sizeof(eventlog_recordTYPE)));
+}
+
+/*the events in binary, oldest first, write() is called for every part (the header and one or two pieces of the ring)*/
+void Eventlog_dump(void (*write)(const void *data, size_t len))
+{
+  eventlog_headerTYPE header = {{'L', 'C', 'E', 'V'}, EVENTLOG_VERSION, sizeof(eventlog_recordTYPE), 0, total, (uint32_t)millis()};
+  uint32_t first;
+  uint32_t start;
+
+  header.count = (total < EVENTLOG_SIZE) ? total : EVENTLOG_SIZE;
+  first = total - header.count;
+  start = first & (EVENTLOG_SIZE - 1);
+
+  write(&header, sizeof(header));
+  if((start + header.count) > EVENTLOG_SIZE)    /*the ring wraps around*/
+  {
+    write(&ring[start], (EVENTLOG_SIZE - start) * sizeof(eventlog_recordTYPE));
+    write(&ring[0], (start + header.count - EVENTLOG_SIZE) * sizeof(eventlog_recordTYPE));
+  }
+  else if(header.count > 0)
+  {
+    write(&ring[start], header.count * sizeof(eventlog_recordTYPE));
+  }
+}
@@ -0,0 +1,36 @@
+#ifndef __EVENTLOG_H
+#define __EVENTLOG_H
+
+/*------------------------------------------*/
+
+#define EVENTLOG_SIZE     256     /*the number of events that are kept (a power of 2), older ones are overwritten*/
+#define EVENTLOG_LINE     48      /*an event is only printed when the serial port has room for a line of this length*/
+#define EVENTLOG_VERSION  1       /*of the /events dump, see tools/event_log.py*/
+
+/*the events, keep tools/event_log.py in line with this list (new events are added at the end)*/
+enum Eventlog_codes {EVENT_NONE,
+                     EVENT_BOOT,          /*a: the reset reason*/
+                     EVENT_STATE,         /*a: the new state of the clock statemachine, b: the previous state*/
+                     EVENT_MOVE,          /*a: the time the indicator moves to (in minutes since 0:00), b: the number of steps (negative is down)*/
+                     EVENT_ARRIVED,       /*a: the time the move took (in ms, at most 65535), b: the position*/
+                     EVENT_NTP_REQUEST,   /*a: the number of servers that were asked*/
+                     EVENT_NTP_REPLY,     /*a: the server, b: the round trip delay in ms*/
+                     EVENT_NTP_SYNC,      /*a: the delay in ms, b: the offset in ms*/
+                     EVENT_NTP_TIMEOUT,   /*a: the number of retries left*/
+                     EVENT_NTP_INVALID,   /*a: 0 = not a valid reply, 1 = a reply to no request of ours*/
+                     EVENT_NTP_DNS_FAIL,  /*a: the server*/
+                     EVENT_HTTP,          /*a: the HTTP status code, b: the first 4 characters of the URI (after the /)*/
+                     EVENT_SETTING,       /*a: the setting (index in the settings table), b: 1 when it is stored in the journal*/
+                     EVENT_NETWORK,       /*a: 1 = connected, 0 = lost, b: our IP address*/
+                     EVENT_CORRECTION,    /*a: the pin of the sensor, b: the number of steps the position was off*/
+                     EVENT_ERROR,         /*a: the error code*/
+                     EVENT_AGENDA,        /*a: the rule (see Agenda.cpp), b: 1 = it sounds, 0 = skipped (quiet or too late)*/
+                     EVENT_CODES
+                    };
+
+void Eventlog_add(unsigned char code, uint16_t a, long b);  /*store an event, this costs next to nothing*/
+void Eventlog_drain(void);                                  /*print the events that haven't been printed yet, but only as much as fits in the serial buffer*/
+size_t Eventlog_size(void);                                 /*the size (in bytes) of the dump below*/
+void Eventlog_dump(void (*write)(const void *data, size_t len));  /*the events in binary, oldest first (use tools/event_log.py to read them)*/
+
+#endif
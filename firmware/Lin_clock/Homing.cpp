@@ -0,0 +1,180 @@
+/* Homing
+ * ======
+ * Finds the home sensor in three phases. First the indicator moves up at the cruise speed of the step mode (using
+ * the acceleration profile, see Stepper.h) until the sensor becomes active, the motor needs some steps to decelerate so it stops beyond the
+ * sensor edge. Then it moves back until the sensor releases, plus a small distance. Finally it approaches the
+ * sensor again at a very low speed, this way the edge is always found from the same side, at the same speed.
+ * When the indicator is already at the sensor, the first phase is skipped.
+ *
+ * The time every phase takes is printed and the total is shown in the status message (host/test/sim_day.cpp
+ * checks it), so homing can be compared between firmware versions.
+*/
+
+#include <Arduino.h>
+#include "Homing.h"
+#include "Stepper.h"
+
+/*--------------------------------------------*/
+enum Homing_states {HOMING_IDLE,
+                    HOMING_COARSE,
+                    HOMING_RELEASE_SETUP,
+                    HOMING_RELEASE,
+                    HOMING_BACKOFF_WAIT,
+                    HOMING_FINE,
+                    HOMING_SETTLE
+                   };
+
+static unsigned char homing_state = HOMING_IDLE;
+static unsigned char sensor_pin = 0;
+static unsigned long home_position = 0;   /*the position of the sensor edge on the scale*/
+static unsigned long edge = 0;            /*the position counter at the moment the sensor edge was found*/
+static unsigned long start_millis = 0;
+static unsigned long phase_millis = 0;    /*the start of the current phase*/
+static unsigned long duration = 0;
+
+/*------------------------------------------------------------------------------------------*/
+void homing_phase(const __FlashStringHelper *name);
+/*------------------------------------------------------------------------------------------*/
+
+/*start homing to the edge of the (active low) sensor on pin, that edge is at edge_position*/
+/*range is the maximum distance the indicator may travel before the sensor must have been found*/
+void Homing_start(unsigned char pin, unsigned long edge_position, unsigned long range)
+{
+  sensor_pin = pin;
+  home_position = edge_position;
+  start_millis = millis();
+  phase_millis = start_millis;
+
+  Stepper_setposition(HOMING_START);            /*the position is unknown, so we start counting from here*/
+  if(digitalRead(sensor_pin) == false)          /*already at the sensor, no need to search for it*/
+  {
+    homing_state = HOMING_RELEASE_SETUP;
+  }
+  else
+  {
+    Stepper_moveto(HOMING_START + range, STEPPER_PROFILE);
+    homing_state = HOMING_COARSE;
+  }
+}
+
+/*call as often as possible until it returns HOMING_DONE or HOMING_FAILED*/
+unsigned char Homing_process(void)
+{
+  switch(homing_state)
+  {
+    case HOMING_COARSE:   /*up at the cruise speed, until the sensor becomes active*/
+    {
+      if(digitalRead(sensor_pin) == false)
+      {
+        Stepper_stop();                         /*decelerates, so we will end up beyond the edge*/
+        homing_phase(F("coarse"));
+        homing_state = HOMING_RELEASE_SETUP;
+      }
+      else if(Stepper_busy() == false)          /*the entire distance has been travelled without finding the sensor*/
+      {
+        Serial.println(F("Homing: sensor not found"));
+        homing_state = HOMING_IDLE;
+        return(HOMING_FAILED);
+      }
+      break;
+    }
+
+    case HOMING_RELEASE_SETUP:
+    {
+      if(Stepper_busy() == false)               /*wait for the motor to come to a standstill*/
+      {
+        Stepper_move(HOMING_RELEASE_MAX, DOWN, STEPPER_INTERVAL_SLOW);
+        homing_state = HOMING_RELEASE;
+      }
+      break;
+    }
+
+    case HOMING_RELEASE:  /*down, until the sensor releases*/
+    {
+      if(digitalRead(sensor_pin) == true)
+      {
+        Stepper_moveto(current_position - HOMING_BACKOFF, STEPPER_INTERVAL_SLOW);  /*redirects the running move*/
+        homing_state = HOMING_BACKOFF_WAIT;
+      }
+      else if(Stepper_busy() == false)
+      {
+        Serial.println(F("Homing: sensor does not release"));
+        homing_state = HOMING_IDLE;
+        return(HOMING_FAILED);
+      }
+      break;
+    }
+
+    case HOMING_BACKOFF_WAIT:
+    {
+      if(Stepper_busy() == false)
+      {
+        homing_phase(F("back off"));
+        Stepper_move(2 * HOMING_BACKOFF, UP, HOMING_INTERVAL_FINE);
+        homing_state = HOMING_FINE;
+      }
+      break;
+    }
+
+    case HOMING_FINE:     /*up at a very low speed, until the sensor becomes active*/
+    {
+      if(digitalRead(sensor_pin) == false)
+      {
+        edge = current_position;
+        Stepper_stop();
+        homing_state = HOMING_SETTLE;
+      }
+      else if(Stepper_busy() == false)          /*it was there a moment ago*/
+      {
+        Serial.println(F("Homing: edge not found"));
+        homing_state = HOMING_IDLE;
+        return(HOMING_FAILED);
+      }
+      break;
+    }
+
+    case HOMING_SETTLE:
+    {
+      if(Stepper_busy() == false)
+      {
+        homing_phase(F("fine"));
+        Stepper_setposition(home_position + (current_position - edge)); /*the motor may have done a step after the edge was found*/
+        duration = millis() - start_millis;
+        Serial.print(F("Homing: total "));
+        Serial.print(duration);
+        Serial.println(F(" ms"));
+        homing_state = HOMING_IDLE;
+        return(HOMING_DONE);
+      }
+      break;
+    }
+
+    case HOMING_IDLE:
+    default:
+    {
+      return(HOMING_FAILED);  /*not started*/
+    }
+  }
+  return(HOMING_BUSY);
+}
+
+/*the time (in ms) the last homing took*/
+unsigned long Homing_duration(void)
+{
+  return(duration);
+}
+
+/*................................................................*/
+
+/*print the time the phase that has just been completed took*/
+void homing_phase(const __FlashStringHelper *name)
+{
+  unsigned long now = millis();
+
+  Serial.print(F("Homing: "));
+  Serial.print(name);
+  Serial.print(F(" "));
+  Serial.print(now - phase_millis);
+  Serial.println(F(" ms"));
+  phase_millis = now;
+}
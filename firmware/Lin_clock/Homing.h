@@ -0,0 +1,21 @@
+#ifndef __HOMING_H
+#define __HOMING_H
+
+/*------------------------------------------*/
+
+#define HOMING_START          0x10000000UL  /*the position counter during homing, far away from 0 so it can count in both directions*/
+#define HOMING_BACKOFF        2048          /*after the coarse approach, move this far (in half-steps) beyond the point where the sensor releases*/
+#define HOMING_RELEASE_MAX    40000         /*when the sensor is still active after moving back this far, it is stuck*/
+#define HOMING_INTERVAL_FINE  2000          /*time between two half-steps in us during the fine approach, slow so the edge is found precisely*/
+
+/*the result of Homing_process()*/
+enum Homing_results {HOMING_BUSY,
+                     HOMING_DONE,
+                     HOMING_FAILED
+                    };
+
+void Homing_start(unsigned char pin, unsigned long edge_position, unsigned long range); /*start homing to the edge of the (active low) sensor on pin, that edge is at edge_position*/
+unsigned char Homing_process(void);                                   /*call as often as possible until it returns HOMING_DONE or HOMING_FAILED*/
+unsigned long Homing_duration(void);                                  /*the time (in ms) the last homing took*/
+
+#endif
@@ -0,0 +1,345 @@
+/* Journal
+ * =======
+ * Keeps the changed settings in the SPIFFS, so they survive a reset. Rewriting a file for every change would wear
+ * out the flash (and a reset halfway would destroy it), therefore records are only added to the end of the journal.
+ * Every record has a CRC, a damaged record at the end (the power went down while writing) is detected at boot and
+ * ignored.
+ *
+ * When the journal becomes too large, it is compacted: the last record of every setting is written to a new file,
+ * which replaces the old one when it is complete. The SPIFFS itself spreads the writes over the flash (wear levelling).
+ *
+ * A record looks like this:
+ *   type (1 byte), id (1 byte), len (1 byte), JOURNAL_MAGIC (1 byte), data (len bytes), CRC32 (4 bytes)
+ *
+ * The position of the indicator changes every minute, which is far too often for the flash. It is only used after
+ * a warm reset (after power-on the indicator may have been moved by hand), so it is kept in the RTC memory of the
+ * ESP, which keeps its contents during every reset except power-on. The sensor edges that were learned (see
+ * Sensorbar.cpp) are kept there as well, so the position can be checked after the reset. A CRC tells whether the
+ * contents are valid (after power-on they are random).
+*/
+
+#include <Arduino.h>
+#include <FS.h>
+#include "Journal.h"
+
+/*--------------------------------------------*/
+#define JOURNAL_MAGIC     0xA5    /*helps to recognise the start of a record*/
+#define JOURNAL_RTC_MAGIC 0x4C4A0001UL  /*the RTC memory holds a position (and this layout)*/
+
+enum Journal_types {JOURNAL_POSITION = 1,   /*no longer written (the position is in the RTC memory), skipped when read*/
+                    JOURNAL_MOVING,         /*no longer written*/
+                    JOURNAL_SETTING         /*a setting has changed, id is the setting, data is its new value*/
+                   };
+
+typedef struct
+{
+  uint8_t type;
+  uint8_t id;
+  uint8_t len;
+  uint8_t magic;
+} journal_headerTYPE;
+
+/*the state in the RTC memory, the size must be a multiple of 4 bytes*/
+typedef struct
+{
+  uint32_t magic;
+  uint32_t position;
+  uint8_t position_valid;
+  uint8_t edges_len;
+  uint16_t reserved;
+  uint8_t edges[JOURNAL_EDGES_MAX];
+  uint32_t crc;             /*of everything above*/
+} journal_rtcTYPE;
+
+static unsigned long journal_size = 0;        /*the size of the valid part of the journal*/
+static bool journal_damaged = false;          /*there is rubbish after the last valid record*/
+static journal_rtcTYPE rtc;                   /*a copy of the RTC memory*/
+static uint16_t setting_offset[JOURNAL_IDS];  /*where the last record of every setting starts (0xFFFF when there is none)*/
+
+/*------------------------------------------------------------------------------------------*/
+uint32_t journal_crc(uint32_t crc, const uint8_t *data, size_t len);
+bool journal_read(File &f, journal_headerTYPE *header, uint8_t *data);
+bool journal_write(File &f, uint8_t type, uint8_t id, const void *data, uint8_t len);
+bool journal_append(uint8_t type, uint8_t id, const void *data, uint8_t len);
+bool journal_compact(void);
+void journal_rtc_write(void);
+/*------------------------------------------------------------------------------------------*/
+
+/*do SPIFFS.begin() before calling Journal_init(), reads the journal and repairs it when the last record is damaged*/
+void Journal_init(void)
+{
+  journal_headerTYPE header;
+  uint8_t data[JOURNAL_DATA_MAX];
+  unsigned char i;
+  File f;
+
+  for(i=0; i<JOURNAL_IDS; i++)
+  {
+    setting_offset[i] = 0xFFFF;
+  }
+
+  ESP.rtcUserMemoryRead(JOURNAL_RTC_OFFSET, (uint32_t *)&rtc, sizeof(rtc));
+  if((rtc.magic != JOURNAL_RTC_MAGIC) || (rtc.crc != journal_crc(0, (const uint8_t *)&rtc, offsetof(journal_rtcTYPE, crc))) || (rtc.edges_len > JOURNAL_EDGES_MAX))
+  {
+    memset(&rtc, 0, sizeof(rtc));   /*power-on (or another firmware)*/
+    journal_rtc_write();
+  }
+
+  if(SPIFFS.exists(JOURNAL_TEMPNAME))   /*the power went down while compacting*/
+  {
+    if(SPIFFS.exists(JOURNAL_FILENAME))
+    {
+      SPIFFS.remove(JOURNAL_TEMPNAME);  /*the new file may be incomplete, the old one is still there*/
+    }
+    else
+    {
+      SPIFFS.rename(JOURNAL_TEMPNAME, JOURNAL_FILENAME);  /*the new file was complete, only the rename didn't happen*/
+    }
+  }
+
+  f = SPIFFS.open(JOURNAL_FILENAME, "r");
+  if(!f)
+  {
+    Serial.println(F("No journal"));
+    return;
+  }
+
+  journal_size = 0;
+  while(journal_read(f, &header, data) == true)
+  {
+    if((header.type == JOURNAL_SETTING) && (header.id < JOURNAL_IDS))
+    {
+      setting_offset[header.id] = journal_size;
+    }
+    journal_size = f.position();
+  }
+
+  journal_damaged = (journal_size != f.size());
+  f.close();
+
+  Serial.print(F("Journal: "));
+  Serial.print(journal_size);
+  Serial.println(journal_damaged ? F(" bytes, damaged end ignored") : F(" bytes"));
+  if(journal_damaged == true)
+  {
+    journal_compact();  /*new records must not be added after the rubbish*/
+  }
+}
+
+/*apply all stored setting changes in the order they were made*/
+void Journal_replay(void (*apply)(unsigned char id, const void *data, unsigned char len))
+{
+  journal_headerTYPE header;
+  uint8_t data[JOURNAL_DATA_MAX];
+
+  File f = SPIFFS.open(JOURNAL_FILENAME, "r");
+  if(!f)
+  {
+    return;
+  }
+
+  while((f.position() < journal_size) && (journal_read(f, &header, data) == true))
+  {
+    if(header.type == JOURNAL_SETTING)
+    {
+      apply(header.id, data, header.len);
+    }
+  }
+  f.close();
+}
+
+/*store a setting change*/
+bool Journal_setting(unsigned char id, const void *data, unsigned char len)
+{
+  if((id >= JOURNAL_IDS) || (len > JOURNAL_DATA_MAX))
+  {
+    return(false);
+  }
+  return(journal_append(JOURNAL_SETTING, id, data, len));
+}
+
+/*the motor is about to move, the stored position is no longer valid*/
+void Journal_moving(void)
+{
+  if(rtc.position_valid != 0)   /*only one write is required, no matter how many moves follow*/
+  {
+    rtc.position_valid = 0;
+    journal_rtc_write();
+  }
+}
+
+/*the motor has stopped at this position*/
+void Journal_stopped(unsigned long pos)
+{
+  if((rtc.position_valid == 0) || (pos != rtc.position))
+  {
+    rtc.position = pos;
+    rtc.position_valid = 1;
+    journal_rtc_write();
+  }
+}
+
+/*true when the last known position is valid (a warm reset while the motor wasn't moving)*/
+bool Journal_position(unsigned long *pos)
+{
+  *pos = rtc.position;
+  return(rtc.position_valid != 0);
+}
+
+/*keep the learned sensor edges (see Sensorbar.cpp) until the next warm reset*/
+void Journal_edges(const void *data, unsigned char len)
+{
+  if(len > JOURNAL_EDGES_MAX)
+  {
+    len = 0;
+  }
+  memcpy(rtc.edges, data, len);
+  rtc.edges_len = len;
+  journal_rtc_write();
+}
+
+/*the learned sensor edges from before the reset, returns the length (0 when there are none)*/
+unsigned char Journal_edges_read(void *data, unsigned char size)
+{
+  if(rtc.edges_len > size)
+  {
+    return(0);
+  }
+  memcpy(data, rtc.edges, rtc.edges_len);
+  return(rtc.edges_len);
+}
+
+/*................................................................*/
+
+/*the standard CRC32 (as used by zip), bitwise, because the records are small*/
+uint32_t journal_crc(uint32_t crc, const uint8_t *data, size_t len)
+{
+  unsigned char b;
+
+  crc = ~crc;
+  while(len--)
+  {
+    crc ^= *data++;
+    for(b=0; b<8; b++)
+    {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return(~crc);
+}
+
+/*read the next record, returns false when there is no (valid) record*/
+bool journal_read(File &f, journal_headerTYPE *header, uint8_t *data)
+{
+  uint32_t crc;
+
+  if(f.read((uint8_t *)header, sizeof(journal_headerTYPE)) != sizeof(journal_headerTYPE))  {return(false);}
+  if((header->magic != JOURNAL_MAGIC) || (header->len > JOURNAL_DATA_MAX))                 {return(false);}
+  if(f.read(data, header->len) != header->len)                                             {return(false);}
+  if(f.read((uint8_t *)&crc, sizeof(crc)) != sizeof(crc))                                  {return(false);}
+  return(crc == journal_crc(journal_crc(0, (const uint8_t *)header, sizeof(journal_headerTYPE)), data, header->len));
+}
+
+/*write a single record*/
+bool journal_write(File &f, uint8_t type, uint8_t id, const void *data, uint8_t len)
+{
+  journal_headerTYPE header = {type, id, len, JOURNAL_MAGIC};
+  uint32_t crc = journal_crc(journal_crc(0, (const uint8_t *)&header, sizeof(header)), (const uint8_t *)data, len);
+
+  if(f.write((const uint8_t *)&header, sizeof(header)) != sizeof(header))  {return(false);}
+  if((len > 0) && (f.write((const uint8_t *)data, len) != len))             {return(false);}
+  return(f.write((const uint8_t *)&crc, sizeof(crc)) == sizeof(crc));
+}
+
+/*add a record to the end of the journal, compact it first when it has become too large*/
+bool journal_append(uint8_t type, uint8_t id, const void *data, uint8_t len)
+{
+  bool ok;
+
+  if((journal_damaged == true) || ((journal_size + sizeof(journal_headerTYPE) + len + sizeof(uint32_t)) > JOURNAL_SIZE_MAX))
+  {
+    if((journal_compact() == false) && (journal_damaged == true))
+    {
+      return(false);  /*a record after the rubbish would never be read*/
+    }
+  }
+
+  File f = SPIFFS.open(JOURNAL_FILENAME, "a");
+  if(!f)
+  {
+    Serial.println(F("Failed to open journal"));
+    return(false);
+  }
+
+  if((type == JOURNAL_SETTING) && (id < JOURNAL_IDS))
+  {
+    setting_offset[id] = journal_size;
+  }
+  ok = journal_write(f, type, id, data, len);
+  journal_size = f.position();
+  f.close();
+  return(ok);
+}
+
+/*write the last record of every setting to a new journal, which then replaces the old one*/
+bool journal_compact(void)
+{
+  journal_headerTYPE header;
+  uint8_t data[JOURNAL_DATA_MAX];
+  uint16_t offset[JOURNAL_IDS];
+  unsigned long size = journal_size;
+  unsigned char i;
+  bool ok = true;
+  File src;
+  File dst;
+
+  Serial.println(F("Compacting journal"));
+  dst = SPIFFS.open(JOURNAL_TEMPNAME, "w");
+  if(!dst)
+  {
+    return(false);
+  }
+
+  src = SPIFFS.open(JOURNAL_FILENAME, "r");
+  for(i=0; i<JOURNAL_IDS; i++)
+  {
+    offset[i] = setting_offset[i];
+    setting_offset[i] = 0xFFFF;
+    if((offset[i] != 0xFFFF) && src && (src.seek(offset[i], SeekSet) == true) && (journal_read(src, &header, data) == true))
+    {
+      setting_offset[i] = dst.position();
+      ok = ok && journal_write(dst, JOURNAL_SETTING, i, data, header.len);
+    }
+  }
+  if(src)
+  {
+    src.close();
+  }
+
+  journal_size = dst.position();
+  dst.close();
+
+  if(ok == false)   /*keep using the old journal (the SPIFFS is probably full)*/
+  {
+    SPIFFS.remove(JOURNAL_TEMPNAME);
+    for(i=0; i<JOURNAL_IDS; i++)
+    {
+      setting_offset[i] = offset[i];
+    }
+    journal_size = size;
+    return(false);
+  }
+
+  SPIFFS.remove(JOURNAL_FILENAME);                    /*from here on, a reset is handled by Journal_init()*/
+  SPIFFS.rename(JOURNAL_TEMPNAME, JOURNAL_FILENAME);
+  journal_damaged = false;
+  return(true);
+}
+
+/*the RTC memory is not flash, it can be written as often as required*/
+void journal_rtc_write(void)
+{
+  rtc.magic = JOURNAL_RTC_MAGIC;
+  rtc.crc = journal_crc(0, (const uint8_t *)&rtc, offsetof(journal_rtcTYPE, crc));
+  ESP.rtcUserMemoryWrite(JOURNAL_RTC_OFFSET, (uint32_t *)&rtc, sizeof(rtc));
+}
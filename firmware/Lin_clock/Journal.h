@@ -0,0 +1,23 @@
+#ifndef __JOURNAL_H
+#define __JOURNAL_H
+
+/*------------------------------------------*/
+
+#define JOURNAL_FILENAME  "/journal.bin"  /*the journal, records are only added to the end*/
+#define JOURNAL_TEMPNAME  "/journal.tmp"  /*used while compacting, renamed to the journal when complete*/
+#define JOURNAL_SIZE_MAX  4096            /*when the journal grows beyond this size (in bytes) it is compacted*/
+#define JOURNAL_IDS       16              /*the number of different settings that can be stored*/
+#define JOURNAL_DATA_MAX  128             /*the largest setting (in bytes)*/
+#define JOURNAL_RTC_OFFSET  32            /*where the position is kept in the RTC memory (in blocks of 4 bytes), the first 128 bytes are used by the OTA update, it takes 34 blocks (see BEACON_RTC_OFFSET)*/
+#define JOURNAL_EDGES_MAX   120           /*the room for the learned sensor edges in the RTC memory (in bytes)*/
+
+void Journal_init(void);                  /*do SPIFFS.begin() before calling Journal_init(), reads the journal and repairs it when the last record is damaged*/
+void Journal_replay(void (*apply)(unsigned char id, const void *data, unsigned char len));  /*apply all stored setting changes in the order they were made*/
+bool Journal_setting(unsigned char id, const void *data, unsigned char len);  /*store a setting change*/
+void Journal_moving(void);                /*the motor is about to move, the stored position is no longer valid*/
+void Journal_stopped(unsigned long position);  /*the motor has stopped at this position*/
+bool Journal_position(unsigned long *position);  /*true when the last known position is valid (a warm reset while the motor wasn't moving)*/
+void Journal_edges(const void *data, unsigned char len);   /*keep the learned sensor edges (see Sensorbar.cpp) until the next warm reset*/
+unsigned char Journal_edges_read(void *data, unsigned char size);  /*the learned sensor edges from before the reset, returns the length (0 when there are none)*/
+
+#endif
@@ -19,11 +19,22 @@
 #include <FS.h>               /*lib. required for audio playback (which uses spiffs)*/
 #include "WebConfig.h"        /*the webserver to which the user can connect to configure the Cassiopei*/
 #include "NTP.h"              /*Network Time Protocol (required to get time and date from a timeserver somewhere on the web*/
-
-#include "AudioFileSourceSPIFFS.h"  /*this sketch requires the library "ESP8266Audio-master.zip" to be installed ( https://github.com/earlephilhower/ESP8266Audio )*/
-#include "AudioGeneratorWAV.h"
-#include "AudioOutputI2SNoDAC.h"  /*the cheap method of making sound*/
-//#include <AudioOutputI2S.h>       /*the sophisticated way of making sound*/
+#include "Stepper.h"          /*interrupt driven stepper motor engine, the motor moves while the rest of the code keeps running*/
+#include "Metrics.h"          /*measure how long things take (see the /metrics page of the webserver)*/
+#include "TZ.h"               /*timezone and daylight saving time rules*/
+#include "Journal.h"          /*the settings are kept in the SPIFFS and the position in the RTC memory, so we don't have to home after a reset*/
+#include "Status.h"           /*the status message that is shown on the webpage*/
+#include "Audio.h"            /*non blocking sample playback, the chimes play while the motor moves and the webserver keeps running*/
+#include "Homing.h"           /*find the home sensor, fast at first and then slowly for a precise edge*/
+#include "Sensorbar.h"        /*correct the position when steps are lost, using the sensor edges that are crossed*/
+#include "Scale.h"            /*converts minutes on the scale to steps, using the calibrated number of steps per minute*/
+#include "Calibration.h"      /*measures the number of steps per minute of this clock*/
+#include "Scheduler.h"        /*runs the tasks below when they are due, the CPU idles in between*/
+#include "Power.h"            /*WiFi modem sleep and light sleep between the minutes*/
+#include "Beacon.h"           /*one clock gets the time from the timeservers, the others get it from that clock*/
+#include "Network.h"          /*connects to the network in the background, reconnects when the connection is lost*/
+#include "Eventlog.h"         /*what happened, kept in RAM and printed when the serial port has time for it (see the /events page)*/
+#include "Agenda.h"           /*the alarm and chime rules, in a queue sorted on the moment they are due*/
 
 /*Note to myself: if strange things happen when loading from SPIFFS, make sure that SPIFFS is still OK, by reloading it*/
 
@@ -31,8 +42,6 @@
 /*           IO-pin definitions             */
 /*------------------------------------------*/
 
-//#define DEBUG_MODE  /*uncomment for debugging only (it disables all motor movements)*/
-
 #define BAUDRATE          115200
 #define TXD               1
 #define RXD               3
@@ -43,62 +52,100 @@
 #define SENSORBAR_UPDOWN  4   /*connected to the sensor bar for when the stepper is moving downwards*/
 #define SENSORBAR_HOME    5   /*connected to the sensor bar for when the stepper is moving upwards*/
 
-#define COIL_A            13  /*connected to orange wire of 28BYJ-48*/
-#define COIL_B            14  /*connected to pink wire of 28BYJ-48*/
-#define COIL_C            12  /*connected to yellow wire of 28BYJ-48*/
-#define COIL_D            16  /*connected to blue wire of 28BYJ-48*/
+/*the coils of the stepper motor are connected to pins 13, 14, 12 and 16, see Stepper.h*/
 
 #define LED               15  /*connected to speaker output*/
 
 /*------------------------------------------*/
-#define DOWN              0   /*direction definition for stepper motor*/
-#define UP                1   /*direction definition for stepper motor*/
-
-//#define STEPS_PER_REV     4096  /*the number of steps for a full rotation of the motor-shaft, we use M6, so a rev. is exactly 1 mm, the scale is 1mm/min, therefore 4096 steps=1min*/
-#define STEPS_PER_REV     4076  /*the stepper isn't really 1:64 but 1:63.68395*/
+/*we use M6, so a rev. is exactly 1 mm, the scale is 1mm/min, the number of steps per minute is measured by the calibration (see Scale.h)*/
 /*for more 28BYJ-48 stepper info: https://grahamwideman.wikispaces.com/Motors-+28BYJ-48+Stepper+motor+notes */
 
-#define HOME_POSITION     (11 * STEPS_PER_REV * 60) + (59 * STEPS_PER_REV) /*the number of steps away from 0:00*/
+#define HOME_MINUTES      ((11 * 60) + 59)            /*the point 11:59 on the scale, in minutes (mm) away from 0:00*/
+#define HOME_POSITION     Scale_position(HOME_MINUTES) /*the number of steps away from 0:00*/
+#define SENSOR_POSITION   Scale_position(HOME_MINUTES + 58) /*the home sensor is 58 minutes past the point 11:59 on the scale*/
+#define INSULATOR_MS      (((HOME_MINUTES + 58) * 60000UL) - (CALIBRATION_DISTANCE * 30000UL)) /*the center of the insulator between the two halves of the sensor bar (in ms on the scale)*/
+#define REFERENCE_RANGE   (5UL * 60000UL)             /*the fixed sensor edges are within this distance (in ms on the scale) of the home sensor edge and the center of the insulator*/
+#define HOMING_DISTANCE   Scale_position(15 * 60)     /*scale is 14 hours, so if we haven't found anything after a distance of 15hours, then there is a serious problem*/
 #define ALARM_THRESSHOLD  4     /*this is the halve of the width of the trigger block size in mm (or minutes)*/
+#define PROFILE_MIN_STEPS Scale_position(2) /*moves shorter than this are done at the gentle speed, longer moves use the acceleration profile*/
+#define SMOOTH_BATCH      16    /*in smooth mode, the indicator moves when it is this many steps behind (about 1/4 s), so the coils are off most of the time*/
+#define SMOOTH_HOLD       20    /*in smooth mode, the coils stay on this long (in ms) after a move, so the rotor settles before it is released*/
+
+/*the intervals (in us) of the tasks, see Scheduler.cpp*/
+#define TASK_CLOCK_MOVING   1000    /*the sensors must be watched closely while the motor moves (homing)*/
+#define TASK_CLOCK_IDLE     20000   /*waiting for the next minute, keeping the NTP time up to date*/
+#define TASK_AUDIO_PLAYING  1000    /*the output must be fed continuously*/
+#define TASK_AUDIO_IDLE     20000   /*the delay before a queued sample starts*/
+#define TASK_NETWORK        100000
+#define TASK_HTTP           5000
+#define TASK_SENSORBAR      20000   /*the stepper interrupt stores the edges, so this can be slow*/
+#define TASK_HEAP           10000
+#define TASK_POWER          100000
+#define TASK_EVENTLOG       50000   /*the serial port sends about 11 characters per ms*/
+#define TASK_BEACON         10000   /*a follower uses the moment a beacon arrives, so this must be short*/
 
 /*----------------------------------------------------------------------------*/
 /*the possible clock related functions*/
 enum Clock_states      {CLOCK_IDLE,
-                        CLOCK_HOME_TO_SENSOR_SETUP,
-                        CLOCK_HOME_TO_SENSOR,
-                        CLOCK_MOVE_TO_1159_SETUP,
-                        CLOCK_MOVE_TO_1159,
-                        CLOCK_OPERATE_SETUP,
+                        CLOCK_RESUME,
+                        CLOCK_RESUME_CHECK,
+                        CLOCK_HOMING_SETUP,
+                        CLOCK_HOMING,
                         CLOCK_OPERATE,
                         CLOCK_OPERATE_2,
                         CLOCK_OPERATE_3,
                         CLOCK_OPERATE_4,
+                        CLOCK_SMOOTH,
                         CLOCK_ALARM_SETUP,
                         CLOCK_ALARM,
+                        CLOCK_CALIBRATE_SETUP,
+                        CLOCK_CALIBRATE,
                         CLOCK_NTP_ERROR,
                         CLOCK_ERROR
                        }; 
 
-/*----------------------------------------------------------------------------*/
-unsigned long current_position = 0; /*use for stepper motor absolute position*/
+/*the names of the states above, these are used in the metrics report*/
+const char * const Clock_state_names[] = {"CLOCK_IDLE",
+                                          "CLOCK_RESUME",
+                                          "CLOCK_RESUME_CHECK",
+                                          "CLOCK_HOMING_SETUP",
+                                          "CLOCK_HOMING",
+                                          "CLOCK_OPERATE",
+                                          "CLOCK_OPERATE_2",
+                                          "CLOCK_OPERATE_3",
+                                          "CLOCK_OPERATE_4",
+                                          "CLOCK_SMOOTH",
+                                          "CLOCK_ALARM_SETUP",
+                                          "CLOCK_ALARM",
+                                          "CLOCK_CALIBRATE_SETUP",
+                                          "CLOCK_CALIBRATE",
+                                          "CLOCK_NTP_ERROR",
+                                          "CLOCK_ERROR"
+                                         };
 
 /*----------------------------------------------------------------------------*/
 
 void Clock_statemachine(void);
-void MoveStepper(unsigned long steps, unsigned char dir, unsigned char spd);
+void Task_clock(void);
+void Task_audio(void);
+void Task_network(void);
+void Task_http(void);
+void Task_sensorbar(void);
+void Task_heap(void);
+void Task_power(void);
+void Task_beacon(void);
+void Task_eventlog(void);
 void Motor_Off(void);
-void Play_Chime_Melody(void);
-void Play_Chime_Hour(void);
-void Play_Chime_Quarter(void);
-void Play_Chime_Magical(void);
-void Play_Alarm(void);
+void Motor_Moveto(unsigned long target, unsigned int interval);
+unsigned long Clock_position(bool smooth);
+bool Led_blink(unsigned char count);
+bool Clock_insulator(void);
 
 /*----------------------------------------------------------------------------*/
 
-AudioGeneratorWAV *wav;
-AudioFileSourceSPIFFS *file;
-AudioOutputI2SNoDAC *out;
-//AudioOutputI2S *out;
+bool position_known = false;  /*true when the position counter matches the scale (the clock has been homed or resumed)*/
+unsigned char task_clock = 0;
+unsigned char task_audio = 0;
 
 /*============================================================================*/
 
@@ -108,14 +155,10 @@ void setup()
 
   pinMode(SENSORBAR_UPDOWN, INPUT);
   pinMode(SENSORBAR_HOME, INPUT);
-  pinMode(COIL_A, OUTPUT);      /*signal to stepper coildriver*/
-  digitalWrite(COIL_A, LOW);    /*signal to stepper coildriver*/
-  pinMode(COIL_B, OUTPUT);      /*signal to stepper coildriver*/
-  digitalWrite(COIL_B, LOW);    /*signal to stepper coildriver*/
-  pinMode(COIL_C, OUTPUT);      /*signal to stepper coildriver*/
-  digitalWrite(COIL_C, LOW);    /*signal to stepper coildriver*/
-  pinMode(COIL_D, OUTPUT);      /*signal to stepper coildriver*/
-  digitalWrite(COIL_D, LOW);    /*signal to stepper coildriver*/
+  Stepper_init();               /*all coils off, the motor is driven by a timer interrupt from now on*/
+  Sensorbar_init((1 << SENSORBAR_UPDOWN) | (1 << SENSORBAR_HOME));  /*the stepper interrupt watches the sensors while moving*/
+  Sensorbar_reference(1 << SENSORBAR_HOME, (HOME_MINUTES + 58) * 60000UL, REFERENCE_RANGE);  /*the position is only checked at the parts that can't be moved, not at the alarm blocks*/
+  Sensorbar_reference(1 << SENSORBAR_UPDOWN, INSULATOR_MS, REFERENCE_RANGE);
   pinMode(LED, OUTPUT);         /*indicator LED*/
   digitalWrite(LED, LOW);       /*indicator lights off*/ 
 
@@ -123,6 +166,7 @@ void setup()
   Serial.println();
   Serial.println(F("\r\n--== Linear clock ==--"));
   Serial.println(F("Firmware version:" __DATE__ ));
+  Eventlog_add(EVENT_BOOT, ESP.getResetInfoPtr()->reason, 0);
   
   #ifdef DEBUG_MODE        /*alaert the programmer we arein debugging mode*/
   Serial.println(F("ATTENTION: debugging mode, all movement disabled"));
@@ -133,21 +177,38 @@ void setup()
   //Serial.print(F("Free heap size =")); /*show available RAM*/
   //Serial.println(ESP.getFreeHeap()); /*show available RAM*/
 
+  Metrics_init(Clock_state_names, sizeof(Clock_state_names) / sizeof(Clock_state_names[0]));
+
   Serial.println(F("Mounting FS...")); /*required for webserver, settings and sample playback*/
   if (SPIFFS.begin() == false)
   {
     Serial.println(F("Failed to mount file system"));
     ESP.restart();  /*force reset on failure*/
   } 
+  Journal_init();               /*the last known position and the settings that were changed since the config file was written*/
   
-  digitalWrite(LED, HIGH);      /*indicator lights on, they will turn off when connected to a network*/   
-  WebConfig_init();             /*get the configuration from the config.json file as stored in the SPIFFS filesystem, when connected to the network start the webserver*/
-  Webserver_process();    
-  digitalWrite(LED, LOW);       /*indicator lights off, we are connected to a network*/ 
+  WebConfig_init();             /*get the configuration from the config.json file as stored in the SPIFFS filesystem and start the webserver, the network is connected in the background (Task_network)*/
+
+  Stepper_cruise(cfg.cruise);   /*the speed of long moves, when it was measured on this clock*/
+  Stepper_mode(cfg.stepmode);   /*half-steps, full steps or wave-drive*/
 
   /*ATTENTION:, don't play samples before calling WebConfig_init() as it WILL crash the ESP (has something to do with declaring of the "out" object (don't ask me why, but it works better this way)*/
-  out = new AudioOutputI2SNoDAC();  /*this initialisation is required for all audio playback code, initialze the object here because it is not good (and not needed) to do this in the playback routine*/  
-  Play_Chime_Magical();             /*indicate that we've powered up and that we are connected to the specified network*/  
+  Beacon_init(cfg.beacon, cfg.beacon_key);  /*the multicast group is joined once the network is there*/
+  Audio_init(LED);                  /*this initialisation is required for all audio playback code*/
+  Audio_queue(AUDIO_MAGICAL, 1, 0); /*indicate that we've powered up*/  
+
+  task_clock = Scheduler_add(Task_clock, TASK_CLOCK_IDLE);  /*do what needs to be done to make this clock a clock*/
+  task_audio = Scheduler_add(Task_audio, TASK_AUDIO_PLAYING);
+  Scheduler_add(Task_network, TASK_NETWORK);                /*connect (and reconnect) to the network, while the clock homes and runs*/
+  Scheduler_add(Task_http, TASK_HTTP);                      /*handle webserver and therefore stay as responsive as is practically possible*/
+  Scheduler_add(Task_sensorbar, TASK_SENSORBAR);            /*check the position at the sensor edges that were crossed*/
+  Scheduler_add(Task_heap, TASK_HEAP);
+  Scheduler_add(Task_power, TASK_POWER);
+  Scheduler_add(Task_eventlog, TASK_EVENTLOG);
+  if(Beacon_mode() != BEACON_OFF)
+  {
+    Scheduler_add(Task_beacon, TASK_BEACON);
+  }
 }
 
 
@@ -155,154 +216,198 @@ void loop()
 {  
   while(1)
   {
-    yield();                      /*pet the watchdog*/
-    Webserver_process();          /*handle webserver and therefore stay as responsive as is practically possible*/    
-    yield();                      /*pet the darn beast again... just to make sure it stays drowsy*/
-    Clock_statemachine();         /*do what needs to be done to make this clock a clock*/
+    Scheduler_run();              /*the scheduler yields after every pass (or sleeps when there is nothing to do), this pets the watchdog*/
   }   
 }
 
 /*==================================================================*/
 
+/*the clock statemachine, it is run often while the motor moves and at a slow pace while waiting*/
+void Task_clock(void)
+{
+  Clock_statemachine();
+  Scheduler_interval(task_clock, (Stepper_busy() == true) ? TASK_CLOCK_MOVING : TASK_CLOCK_IDLE);
+}
+
+/*keep the sound going*/
+void Task_audio(void)
+{
+  if(Audio_busy() == true)
+  {
+    Power_wake();   /*the output must be fed, so the CPU can't sleep*/
+  }
+  Audio_loop();
+  Scheduler_interval(task_audio, (Audio_busy() == true) ? TASK_AUDIO_PLAYING : TASK_AUDIO_IDLE);
+}
+
+void Task_network(void)
+{
+  Network_process();
+}
+
+void Task_http(void)
+{
+  Webserver_process();
+}
+
+void Task_sensorbar(void)
+{
+  Sensorbar_process();
+}
+
+void Task_heap(void)
+{
+  Metrics_heap();
+}
+
+void Task_power(void)
+{
+  Power_process(cfg.power);
+}
+
+void Task_beacon(void)
+{
+  Beacon_process();
+}
+
+void Task_eventlog(void)
+{
+  Eventlog_drain();
+}
+
+/*==================================================================*/
+
 /*======================================================================================================================*/
 /*                                        Statemachine for all Clock related functions                                  */
 /*======================================================================================================================*/
 void Clock_statemachine(void)
 {
   static unsigned char Clock_state = CLOCK_IDLE;
-  static long timeout = 0;  
   static unsigned char error_code = 0;
   static unsigned char lp = 0;
   static unsigned long new_position = 0;
   static unsigned long steps = 0;
-  static unsigned char dir = UP;
   static unsigned char prev_hour = 0;
   static unsigned char prev_minute = 0;
   static unsigned char alarm_cnt = 0;
-  static long value = 0;
+  static unsigned long move_micros = 0;
+  static unsigned long smooth_millis = 0;
+  static agenda_eventTYPE event = {AGENDA_ALARM, AUDIO_ALARM, 6};  /*the mechanical alarm (the trigger block) uses the defaults*/
+  char text[12];
+  unsigned char state = Clock_state;  /*the state we are going to execute, required for the metrics*/
+  unsigned long state_micros = micros();
   
   switch(Clock_state)
   {
-    case CLOCK_HOME_TO_SENSOR_SETUP:
+    case CLOCK_HOMING_SETUP:
     {
       Serial.println(F("Starting homing procedure"));  /*home the runner to hit the limit-switch*/
-      cfg.status_msg = "Homing indicator...";       /*update the status message*/
-      timeout = 15 * STEPS_PER_REV * 60;            /*scale is 14 hours, so if we haven't found anything after a distance of 15hours, then there is a serious problem and we should abort*/
-      Clock_state = CLOCK_HOME_TO_SENSOR;
+      Status_set(STATUS_HOMING, 0);                 /*update the status message*/
+      position_known = false;
+      Sensorbar_learn(false);                       /*the learned edges are useless now*/
+      Journal_moving();
+      Power_wake();
+      Homing_start(SENSORBAR_HOME, SENSOR_POSITION, HOMING_DISTANCE);
+      Clock_state = CLOCK_HOMING;
       break;
     }
     
-    case CLOCK_HOME_TO_SENSOR:
+    case CLOCK_HOMING:
     {
-      if(timeout > 256)
+      NTP_statemachine();                             /*get the time while homing, so we can go there directly*/
+#ifndef DEBUG_MODE        /*for debugging purposes, it can be usefull to disable movement*/    
+      lp = Homing_process();
+      if(lp == HOMING_DONE)
       {
-        timeout = timeout - 256;
+        Audio_queue(AUDIO_QUARTER, 1, 0);
+        Status_set(STATUS_HOME_FOUND, Homing_duration()); /*update the status message*/        
+        position_known = true;
+        Sensorbar_learn(true);                        /*the position is exact now, learn the sensor edges that are crossed from here on*/
+        Sensorbar_known(1 << SENSORBAR_HOME, 0, UP, SENSOR_POSITION); /*the edge that was just found, used to check the position after a warm reset*/
+        prev_hour = 0xFF;                             /*move to the current time, even when it is 0:00*/
+        Clock_state = CLOCK_OPERATE;
       }
-      else
+      else if(lp == HOMING_FAILED)
       {
         Serial.println(F("timeout exceeded, service required"));      
         Serial.println(F("limit sensor could not be detected"));
-        Play_Alarm();     /*could not home the runner*/
+        Motor_Off();
+        Audio_queue(AUDIO_ALARM, 1, 0); /*could not home the runner*/
         error_code = 3;
+        Eventlog_add(EVENT_ERROR, error_code, 0);
         Clock_state = CLOCK_ERROR;
-        break;
       }
-
-#ifndef DEBUG_MODE        /*for debugging purposes, it can be usefull to disable movement*/    
-      MoveStepper(256, UP, 1);  /*move stepper 0.0625mm up before checking the sensor again*/    
-
-      if(digitalRead(SENSORBAR_HOME) == false)        /*home the runner to hit the limit-switch (sensor signal goes low when home reached)*/
-      {
-        cfg.status_msg = "Home sensor detected";       /*update the status message*/        
-        Clock_state = CLOCK_MOVE_TO_1159_SETUP;        
-      }      
 #else
-      Clock_state = CLOCK_MOVE_TO_1159_SETUP;        
+      Stepper_setposition(SENSOR_POSITION);
+      position_known = true;
+      Clock_state = CLOCK_OPERATE;        
 #endif      
 
       break;
     }
 
-    case CLOCK_MOVE_TO_1159_SETUP:
+    case CLOCK_OPERATE:
     {
-      Play_Chime_Quarter();
-      Serial.println(F("home reached, moving to 11:59"));
-      cfg.status_msg = "Moving to 11:59";       /*update the status message*/        
-      new_position = 58*STEPS_PER_REV;  /*move the stepper to the point 11:59 on the scale*/
-      Clock_state = CLOCK_MOVE_TO_1159;
-      break;
-    }
-                       
-    case CLOCK_MOVE_TO_1159:
-    {          
-      cfg.status_msg = "Moving indicator, ";            /*update the status message*/              
-      cfg.status_msg += new_position;                   /*traveling the entire distance in one command would take too long*/
-      cfg.status_msg += " steps";                       /*therefore we split up the move action in smaller steps. This requires*/
-                               
-      if(new_position > 256)                            /*much more code but it will have the benefit of a fully responsive web interface*/
+      NTP_offset(TZ_offset(NTP_struct.epoch)); /*normally this is just a compare with the next DST transition, the table is rebuilt when the user changes the settings*/
+      
+      NTP_statemachine();           /*get and/or update the time*/  
+
+      if((NTP_struct.synced == false) && (Network_connected() == false))
       {
-        new_position = new_position - 256;              /*decrement by the number of done steps*/
-        MoveStepper(256, DOWN, 1); 
+        Status_set(STATUS_CONNECTING, 0);         /*the time follows as soon as the network is there*/
       }
       else
       {
-        MoveStepper(new_position, DOWN, 1);             /*the last piece of the new_position movement*/
-        current_position = HOME_POSITION;               /*the system is homed, therefore (re)set the position counter*/          
-        Clock_state = CLOCK_OPERATE_SETUP;          
+        Status_set(STATUS_TIME, NTP_struct.synced);  /*update the status message, the text is only made when the webpage asks for it*/
       }
-      break;
-    }
-
-    case CLOCK_OPERATE_SETUP:
-    {
-      NTP_init(cfg.ntp);  /*initialize NTP functionality (in order to get time and date from a timeserver)*/
-      Clock_state = CLOCK_OPERATE;
-      break;
-    }
-
-    case CLOCK_OPERATE:
-    {
-      value = 60*60 * cfg.offset;   /*because the offset (timezone) and dst setting can be changed by the user at any time, it is best that we calculate and parse this value every time*/
-      if (cfg.dst == true)          /*normally this would not be important, but in this case we want the user settings to take effect immediately*/
+      
+      if(Calibration_requested() == true)   /*the motor stands still, so this is a good moment*/
       {
-        value = value + (60*60);    /*when DST is enabled, add another hour to the offset value*/
+        Clock_state = CLOCK_CALIBRATE_SETUP;
       }
-      NTP_offset(value);            /*parse the value to the NTP routines*/
-      
-      NTP_statemachine();           /*get and/or update the time*/  
-
-      cfg.status_msg = "Local time = ";      /*update the status message*/
-      cfg.status_msg+= NTP_struct.year;    
-      cfg.status_msg+= "-";
-      cfg.status_msg+= NTP_struct.month;
-      cfg.status_msg+= "-";
-      cfg.status_msg+= NTP_struct.day;
-      cfg.status_msg+= " ";
-      cfg.status_msg+= NTP_struct.hour;
-      cfg.status_msg+= ":";
-      if(NTP_struct.minute < 10)  {cfg.status_msg+= "0";} /*check if we must add an additionl 0 to maintain the 2 digit representation*/
-      cfg.status_msg+= NTP_struct.minute;
-      cfg.status_msg+= ":";    
-      if(NTP_struct.second < 10)  {cfg.status_msg+= "0";} /*check if we must add an additionl 0 to maintain the 2 digit representation*/
-      cfg.status_msg+= NTP_struct.second;      
-      
-      if(NTP_struct.synced == true)     
+      else if(NTP_struct.synced == true)          /*also while the network is lost, the time is kept by our own clock*/
       {
-        cfg.status_msg+= " (synced)";
         if((NTP_struct.hour != prev_hour) || (NTP_struct.minute != prev_minute))  /*only update the clock when the time has changed*/
         {
           Clock_state = CLOCK_OPERATE_2;
         }
+        else if(Agenda_due(NTP_struct.epoch + TZ_offset(NTP_struct.epoch), &event) == true)  /*a single compare, unless something is due*/
+        {
+          if((event.kind == AGENDA_ALARM) && (cfg.alarm == true))
+          {
+            Clock_state = CLOCK_ALARM_SETUP;
+          }
+          else if((event.kind == AGENDA_CHIME) && (cfg.chime == true))  /*the chimes are played in the background*/
+          {
+            Status_set(STATUS_CHIME, 0);            /*update the status message*/
+            if(event.sound == AGENDA_HOURS)
+            {
+              lp = NTP_struct.hour;
+              if(lp > 12)    /*reduce the number of chimes to 12... technically 11*/
+              {
+                lp = lp - 12;
+              }
+              Audio_hour(lp);
+            }
+            else
+            {
+              Audio_queue(event.sound, event.count, 0);
+            }
+          }
+        }
+        else if(cfg.smooth == true)               /*follow the seconds as well*/
+        {
+          Clock_state = CLOCK_SMOOTH;
+        }
       }
-      else                              
+      else if((Network_connected() == true) && (NTP_failed() == true))  /*the timeservers can't be reached (not just: haven't answered yet)*/
       {
-        cfg.status_msg+= " (NTP err.)";
         Clock_state = CLOCK_NTP_ERROR;       
       }
 
 #ifdef DEBUG_MODE        /*for debugging purposes, it can be usefull to disable movement*/    
       Serial.print(F("Status msg: "));
-      Serial.println(cfg.status_msg);
+      Serial.println(Status_text());
       delay(1000);  /*slow down the stream of printf messages...*/
 #endif      
 
@@ -320,56 +425,40 @@ void Clock_statemachine(void)
       prev_hour = NTP_struct.hour;
       prev_minute = NTP_struct.minute;
   
-      /*calculate how many steps since 0:00 we must do to reach the new time*/   
-      if(NTP_struct.hour < 12)  
+      new_position = Clock_position(cfg.smooth);        /*in smooth mode, this is only the last bit of the minute (or the first move after boot)*/
+      
+      if(new_position < current_position)
       {
-        new_position = (NTP_struct.hour * STEPS_PER_REV * 60) + (NTP_struct.minute * STEPS_PER_REV);                        /*this is the number of steps from 0:00 (on the right side of the scale)*/
+        steps = current_position - new_position;
+        Eventlog_add(EVENT_MOVE, (NTP_struct.hour * 60) + NTP_struct.minute, -(long)steps);
       }
-      else                      
+      else
       {
-        new_position = HOME_POSITION - ((STEPS_PER_REV * (NTP_struct.hour-12) * 60) + (STEPS_PER_REV * NTP_struct.minute)); /*this is the number of steps from 0:00 (on the right side of the scale)*/
+        steps = new_position - current_position;
+        Eventlog_add(EVENT_MOVE, (NTP_struct.hour * 60) + NTP_struct.minute, steps);
       }
-      
-      Serial.print(F("current:"));
-      Serial.print(current_position);
-      Serial.print(F(", requested:"));
-      Serial.println(new_position); /*move the steppermotor to the calculated position*/      
 
-      if(new_position < current_position)
+      Status_set(STATUS_MOVING, steps);                 /*update the status message*/              
+      if(steps > PROFILE_MIN_STEPS)                     /*the motor moves on its own, the webserver stays fully responsive*/
       {
-        steps = current_position - new_position;
-        dir = DOWN;
-        Serial.print(F("down "));
-        Serial.print(steps);
-        Serial.println(F(" steps")); 
+        Motor_Moveto(new_position, STEPPER_PROFILE);    /*a large correction (after boot or a change of timezone), accelerate to save time*/
       }
       else
       {
-        steps = new_position - current_position;
-        dir = UP;        
-        Serial.print(F("up "));
-        Serial.print(steps);
-        Serial.println(F(" steps"));    
+        Motor_Moveto(new_position, STEPPER_INTERVAL_SLOW);    /*the regular minute tick, keep it gentle and quiet*/
       }
-      
+      move_micros = micros();
       Clock_state = CLOCK_OPERATE_3;
       break; 
     }
 
     case CLOCK_OPERATE_3:
     { 
-      cfg.status_msg = "Moving indicator, ";              /*update the status message*/              
-      cfg.status_msg += steps; 
-      cfg.status_msg += " steps";
-      Serial.println(cfg.status_msg);
-      if(steps > 256)                                   /*much more code but it will have the benefit of a fully responsive web interface*/
-      {
-        steps = steps - 256;                            /*decrement by the number of done steps*/
-        MoveStepper(256, dir, 1);
-      }
-      else
+      NTP_statemachine();                               /*keep the time up to date while the motor is running*/
+      if(Stepper_busy() == false)
       {
-        MoveStepper(steps, dir, 1);                     /*the last piece of the new_position movement*/
+        Metrics_record(METRIC_MOVE, micros() - move_micros);
+        Eventlog_add(EVENT_ARRIVED, ((micros() - move_micros) > 65535000UL) ? 0xFFFF : ((micros() - move_micros) / 1000), current_position);
         Motor_Off();                                    /*shut down the motors to save energy*/                                            
         Clock_state = CLOCK_OPERATE_4;          
       }     
@@ -378,45 +467,8 @@ void Clock_statemachine(void)
 
     case CLOCK_OPERATE_4:
     { 
-      /*chime on the whole hour and sound the number of hours*/
-      if(cfg.chime == true)
-      {
-        if(NTP_struct.minute == 0)
-        {
-          cfg.status_msg = "Playing hourly chime";              /*update the status message*/                       
-          Play_Chime_Melody();
-          lp=20;
-          while(lp>0)   /*small delay othwerwise the first hour chime will be not noticed*/
-          { 
-            yield();                      /*pet the watchdog*/
-            Webserver_process();          /*handle webserver and therefore stay as responsive as is practically possible*/    
-            delay(100);
-            lp--;            
-          }
-          
-          
-          lp = NTP_struct.hour;
-          if(lp > 12)    /*reduce the number of chimes to 12... technically 11*/
-          {
-            lp = lp - 12;
-          }
-          
-          while(lp>0)
-          { 
-            yield();                      /*pet the watchdog*/
-            Webserver_process();          /*handle webserver and therefore stay as responsive as is practically possible*/    
-            Play_Chime_Hour();
-            lp--;            
-          }
-        }
-      
-        /*chime every 15 minutes*/
-        if((NTP_struct.minute == 15) || (NTP_struct.minute == 30) || (NTP_struct.minute == 45))
-        {
-          Play_Chime_Quarter();
-        }
-      }
-
+      /*the chimes and the alarms of the agenda are done in CLOCK_OPERATE, this is the alarm of the trigger block*/
+      Clock_state = CLOCK_OPERATE;
       if(cfg.alarm == true)
       {
         if(digitalRead(SENSORBAR_UPDOWN) == true)
@@ -430,250 +482,277 @@ void Clock_statemachine(void)
         
         if(alarm_cnt == ALARM_THRESSHOLD)
         {            
-          if(((NTP_struct.minute >= 57) || (NTP_struct.minute <= 3)) && ((NTP_struct.hour == 6) || (NTP_struct.hour == 18)))
+          if(Clock_insulator() == false)     /*around 6:00 the sensor sees the insulator, that is not a trigger block*/
           {
+            event.sound = AUDIO_ALARM;
+            event.count = 6;
             Clock_state = CLOCK_ALARM_SETUP;  
           }
         }
       }
+      break;
+    }
+
+    case CLOCK_SMOOTH:  /*the indicator follows the time in small moves of a few steps, the trigger block is still checked at the minute ticks*/
+    {
+      if(Stepper_busy() == true)
+      {
+        smooth_millis = millis();
+      }
+      else
+      {
+        new_position = Clock_position(true);
+        if((new_position >= (current_position + SMOOTH_BATCH)) || ((new_position + SMOOTH_BATCH) <= current_position))
+        {
+          Motor_Moveto(new_position, STEPPER_INTERVAL_SLOW);  /*the journal is only written at the minute ticks, Journal_moving() writes once*/
+          smooth_millis = millis();
+        }
+        else if((millis() - smooth_millis) >= SMOOTH_HOLD)
+        {
+          Stepper_release();        /*the gear holds the indicator, the position is stored at the next minute tick*/
+        }
+      }
       Clock_state = CLOCK_OPERATE;
       break;
     }
     
     case CLOCK_ALARM_SETUP:
     {
-      cfg.status_msg = "Alarm event";   /*update the status message*/      
-      lp = 5; /*the number of times the alarm sound should be played*/
+      Status_set(STATUS_ALARM, 0);      /*update the status message*/      
+      if(event.sound == AGENDA_HOURS)
+      {
+        Audio_hour((NTP_struct.hour > 12) ? (NTP_struct.hour - 12) : NTP_struct.hour);
+      }
+      else
+      {
+        Audio_queue(event.sound, event.count, 500); /*the number of times the alarm sound should be played, with a small pause in between*/
+      }
       Clock_state = CLOCK_ALARM;      
       break;
     }   
 
     case CLOCK_ALARM:
     {      
-      Play_Alarm();
-      delay(500);
-      if(lp-- == 0)
+      if(Audio_busy() == false)
       {  
         Clock_state = CLOCK_OPERATE;
       }
       break;
     }   
 
+    case CLOCK_CALIBRATE_SETUP:
+    {
+      Serial.println(F("Starting calibration"));
+      Status_set(STATUS_CALIBRATING, 0);            /*update the status message*/
+      position_known = false;
+      Sensorbar_learn(false);                       /*the learned edges are useless now*/
+      Journal_moving();
+      Power_wake();
+      Calibration_start(SENSORBAR_HOME, SENSORBAR_UPDOWN, HOMING_DISTANCE);
+      Clock_state = CLOCK_CALIBRATE;
+      break;
+    }
+
+    case CLOCK_CALIBRATE:
+    {
+      NTP_statemachine();                           /*keep the time up to date while the motor is running*/
+      lp = Calibration_process();
+      if(lp == CALIBRATION_DONE)
+      {
+        snprintf(text, sizeof(text), "%lu", Calibration_ratio());
+        Config_set("steps", text);                  /*use the new value from now on, also after a reset*/
+        Scale_init(Calibration_ratio());
+        Stepper_setposition(SENSOR_POSITION - (CALIBRATION_ORIGIN - current_position)); /*the position relative to the home sensor edge is known*/
+        Audio_queue(AUDIO_QUARTER, 1, 0);
+        position_known = true;
+        Sensorbar_learn(true);
+        Sensorbar_known(1 << SENSORBAR_HOME, 0, UP, SENSOR_POSITION);
+        prev_hour = 0xFF;                           /*move to the current time*/
+        Clock_state = CLOCK_OPERATE;
+      }
+      else if(lp == CALIBRATION_FAILED)
+      {
+        Motor_Off();
+        Audio_queue(AUDIO_ALARM, 1, 0);
+        Clock_state = CLOCK_HOMING_SETUP;           /*the position is unknown, home with the old value*/
+      }
+      break;
+    }
+
     case CLOCK_NTP_ERROR:
     {
-      Serial.println(F("NTP time unavailable"));
-      cfg.status_msg = "Error: #4";   /*update the status message*/
-      for(lp=4; lp>0; lp--)
+      Status_set(STATUS_ERROR, 4);    /*update the status message, the event log shows the state change*/
+      NTP_statemachine();             /*the retries go on in the background*/
+      if(Audio_busy() == true)        /*the LED shares its pin with the sound*/
       {
-        digitalWrite(LED, HIGH);  /*light the indicator LED, there is a problem*/                
-        delay(500);
-        digitalWrite(LED, LOW);  /*light the indicator LED, there is a problem*/                
-        delay(500);
+        break;
+      }
+      if((Led_blink(4) == true) || (NTP_struct.synced == true))
+      {
+        digitalWrite(LED, LOW);
+        Clock_state = CLOCK_OPERATE;
       }
-      digitalWrite(LED, LOW);
-      delay(3000);    
-      Clock_state = CLOCK_OPERATE;      
       break;
     }   
        
     case CLOCK_ERROR:
     {
-      /*blink the LED to indicate an error situation*/
-      cfg.status_msg = "Error: #";      /*update the status message*/
-      cfg.status_msg += error_code;     /*update the status message*/
-      for(lp=error_code; lp>0; lp--)
+      if(Audio_busy() == true)  /*let the alarm finish first, the LED shares its pin with the sound*/
       {
-        digitalWrite(LED, HIGH);  /*light the indicator LED, there is a problem*/                
-        delay(500);
-        digitalWrite(LED, LOW);  /*light the indicator LED, there is a problem*/                
-        delay(500);
+        break;
       }
-      digitalWrite(LED, LOW);
-      delay(3000);    
+      /*blink the LED to indicate an error situation*/
+      Status_set(STATUS_ERROR, error_code); /*update the status message*/
+      Led_blink(error_code);
       break;
     }   
  
+    case CLOCK_RESUME:
+    {
+      NTP_init(cfg.ntp);  /*initialize NTP functionality (in order to get time and date from a timeserver)*/
+
+      /*after a reset (not after power-on, the indicator may have been moved by hand), continue from the position in the journal*/
+      if((ESP.getResetInfoPtr()->reason != REASON_DEFAULT_RST) && (Journal_position(&new_position) == true) && (new_position <= HOME_POSITION))
+      {
+        if(digitalRead(SENSORBAR_HOME) == false)  /*the indicator is at the home sensor, so it can't be on the scale, the journal is wrong*/
+        {
+          Serial.println(F("Home sensor active, the stored position is wrong"));
+        }
+        else if(Sensorbar_resume(new_position) == true) /*the position is checked at the nearest known sensor edge*/
+        {
+          Serial.print(F("Resuming at position "));
+          Serial.println(new_position);
+          Status_set(STATUS_RESUMING, 0);
+          Journal_moving();
+          Power_wake();
+          Clock_state = CLOCK_RESUME_CHECK;
+          break;
+        }
+        else
+        {
+          Serial.println(F("No sensor edge to check the stored position"));
+        }
+      }
+      Clock_state = CLOCK_HOMING_SETUP;
+      break;
+    }
+
+    case CLOCK_RESUME_CHECK:
+    {
+      NTP_statemachine();                           /*get the time while checking, so we can go there directly*/
+      lp = Sensorbar_resume_process();
+      if(lp == SENSORBAR_CONFIRMED)                 /*the check goes on at every crossing from now on*/
+      {
+        Serial.println(F("Sensor edge found, the stored position is right"));
+        position_known = true;
+        prev_hour = 0xFF;                           /*move to the current time, even when it is 0:00*/
+        Clock_state = CLOCK_OPERATE;
+      }
+      else if(lp == SENSORBAR_FAILED)
+      {
+        Serial.println(F("Sensor edge not found, the stored position is wrong"));
+        Clock_state = CLOCK_HOMING_SETUP;
+      }
+      break;
+    }
+
     case CLOCK_IDLE:
     default:
     {
-      Clock_state = CLOCK_HOME_TO_SENSOR_SETUP;
+      Clock_state = CLOCK_RESUME;
       break;
     }
   }
+
+  Metrics_state(state, micros() - state_micros);
+  if((Clock_state != state) && ((Clock_state < CLOCK_OPERATE) || (Clock_state > CLOCK_SMOOTH) || (state < CLOCK_OPERATE) || (state > CLOCK_SMOOTH)))
+  {
+    Eventlog_add(EVENT_STATE, Clock_state, state);  /*the minute ticks (CLOCK_OPERATE...CLOCK_SMOOTH) have their own events*/
+  }
 }
 
 /*======================================================================================================================*/
 /*                                                     other subroutines                                                */
 /*======================================================================================================================*/
-/*play the hourly melody before the actual chiming starts*/
-void Play_Chime_Melody(void)
-{ 
-  yield();
-  file = new AudioFileSourceSPIFFS("/clock_melody.wav"); 
-  wav = new AudioGeneratorWAV();
-  wav->begin(file, out);
-  while(wav->isRunning())
+/*................................................................*/
+
+/*turn the motor coils off to reduce power consumption, the motor stands still so the position is stored in the journal*/
+void Motor_Off(void)
+{
+  Stepper_release();
+  if(position_known == true)
   {
-    yield();
-    if (!wav->loop()) wav->stop();
+    Journal_stopped(current_position);
   }
-  delete file;  /*when done so time to clean up*/
-  delete wav;  
-  /*led output is also a pin that is used by the I2S port, therefore we must restore it back to IO when done playing the sample*/
-  pinMode(LED, OUTPUT);         /*indicator LED*/
-  digitalWrite(LED, LOW);       /*should be off*/
 }
 
-/*play the chime (indicating the hours) as many times as required, the last chime will be the sample with the extra long duration*/
-void Play_Chime_Hour(void)
+/*start a move, from now on the position in the journal is no longer valid (the power may go down while moving)*/
+void Motor_Moveto(unsigned long target, unsigned int interval)
 {
-  yield();
-  file = new AudioFileSourceSPIFFS("/clock_chime_short.wav");     
-  wav = new AudioGeneratorWAV();
-  wav->begin(file, out);
-  while(wav->isRunning())
-  {
-    yield();    
-    if (!wav->loop()) wav->stop();
-  } 
-  delete file;  /*when done so time to clean up*/
-  delete wav;  
-  /*led output is also a pin that is used by the I2S port, therefore we must restore it back to IO when done playing the sample*/
-  pinMode(LED, OUTPUT);         /*indicator LED*/
-  digitalWrite(LED, LOW);       /*should be off*/ 
+  Journal_moving();
+  Power_wake();     /*the stepper interrupt needs a CPU that is awake*/
+  Stepper_moveto(target, interval);
 }
 
-/*play the hourly melody before the actual chiming starts*/
-void Play_Chime_Quarter(void)
-{ 
-  yield();
-  file = new AudioFileSourceSPIFFS("/clock_chime_quarter.wav"); 
-  wav = new AudioGeneratorWAV();
-  wav->begin(file, out);
-  while(wav->isRunning())
+/*true from 5:57 to 6:03 and from 17:57 to 18:03, the indicator is then at the insulator which the updown sensor sees as well*/
+bool Clock_insulator(void)
+{
+  if((NTP_struct.minute >= 57) && ((NTP_struct.hour == 5) || (NTP_struct.hour == 17)))
   {
-    yield();    
-    if (!wav->loop()) wav->stop();
+    return(true);
   }
-  delete file;  /*when done so time to clean up*/
-  delete wav;  
-  /*led output is also a pin that is used by the I2S port, therefore we must restore it back to IO when done playing the sample*/
-  pinMode(LED, OUTPUT);         /*indicator LED*/
-  digitalWrite(LED, LOW);       /*should be off*/   
-}
-
-/*play a magical sound (for booting or to indicate ready)*/
-void Play_Chime_Magical(void)
-{ 
-  yield();
-  file = new AudioFileSourceSPIFFS("/clock_chime_magical.wav"); 
-  wav = new AudioGeneratorWAV();
-  wav->begin(file, out);
-  while(wav->isRunning())
+  if((NTP_struct.minute <= 3) && ((NTP_struct.hour == 6) || (NTP_struct.hour == 18)))
   {
-    yield();    
-    if (!wav->loop()) wav->stop();
+    return(true);
   }
-  delete file;  /*when done so time to clean up*/
-  delete wav;  
-  /*led output is also a pin that is used by the I2S port, therefore we must restore it back to IO when done playing the sample*/
-  pinMode(LED, OUTPUT);         /*indicator LED*/
-  digitalWrite(LED, LOW);       /*should be off*/   
+  return(false);
 }
 
-/*play a old fashioned alarmclock-bell-ringing-sound*/
-void Play_Alarm(void)
-{ 
-  yield();
-  file = new AudioFileSourceSPIFFS("/clock_alarm.wav"); 
-  wav = new AudioGeneratorWAV();
-  wav->begin(file, out);
-  while(wav->isRunning())
+/*blink the LED count times followed by a pause without blocking (the webserver and the sound keep going), call this*/
+/*regularly, returns true when the sequence is complete (the next call starts a new one)*/
+bool Led_blink(unsigned char count)
+{
+  static unsigned long start_millis = 0;
+  static unsigned long call_millis = 0;
+  static bool blinking = false;
+  unsigned long elapsed;
+
+  if((blinking == false) || ((millis() - call_millis) > 1000UL))   /*a sequence that was left halfway is started again*/
   {
-    yield();    
-    if (!wav->loop()) wav->stop();
+    start_millis = millis();
+    blinking = true;
   }
-  delete file;  /*when done so time to clean up*/
-  delete wav;  
-  /*led output is also a pin that is used by the I2S port, therefore we must restore it back to IO when done playing the sample*/
-  pinMode(LED, OUTPUT);         /*indicator LED*/
-  digitalWrite(LED, LOW);       /*should be off*/   
+  call_millis = millis();
+  elapsed = millis() - start_millis;
+  if(elapsed >= ((count * 1000UL) + 3000UL))
+  {
+    digitalWrite(LED, LOW);
+    blinking = false;
+    return(true);
+  }
+  digitalWrite(LED, ((elapsed < (count * 1000UL)) && ((elapsed % 1000UL) < 500UL)) ? HIGH : LOW);   /*500ms on, 500ms off, then 3s off*/
+  return(false);
 }
-/*................................................................*/
 
-/*drive the stepper motor that moves the roller, use the "half-step" coil driving pattern*/
-void MoveStepper(unsigned long steps, unsigned char dir, unsigned char spd)
+/*the position of the indicator for the current time, to the minute or (smooth) to the ms*/
+/*before noon the indicator moves up from 0:00, after noon it comes down again (12:00 and 11:59 share the same point)*/
+unsigned long Clock_position(bool smooth)
 {
-  static unsigned char state = 0;
-  unsigned long lp;
+  unsigned long ms = ((NTP_struct.hour * 60UL) + NTP_struct.minute) * 60000UL;
 
-  uint8_t Ca; /*state of coil A*/
-  uint8_t Cb; /*state of coil B*/
-  uint8_t Cc; /*state of coil C*/
-  uint8_t Cd; /*state of coil D*/
-
-#ifdef DEBUG_MODE        /*for debugging purposes, it can be usefull to disable movement*/    
-  if(dir == UP) {current_position = current_position + steps;}
-  else          {current_position = current_position - steps;}
-  return; /*exit immediately*/
-#endif
-   
-  for(lp=steps;lp>0;lp--) /*number of sequences*/
+  if(smooth == true)
   {
-    if(dir == UP)
-    {      
-      state++;
-      current_position++; /*adjust position counter*/
-      if(state>7)
-      {
-        state = 0;
-      }
-    }
-    else
-    {
-      current_position--; /*adjust position counter*/      
-      if(state>0)
-      {
-        state--;
-      }
-      else
-      {
-        state = 7;
-      }
-    }
-
-    //Serial.print(F("state="));
-    //Serial.println(state);
-
-    switch(state)
-    {
-      case 0: {Ca=LOW ; Cb=LOW ; Cc=HIGH; Cd=LOW ; break;} /*2*/
-      case 1: {Ca=LOW ; Cb=HIGH; Cc=HIGH; Cd=LOW ; break;} /*6*/
-      case 2: {Ca=LOW ; Cb=HIGH; Cc=LOW ; Cd=LOW ; break;} /*4*/
-      case 3: {Ca=LOW;  Cb=HIGH; Cc=LOW ; Cd=HIGH; break;} /*5*/
-      case 4: {Ca=LOW ; Cb=LOW ; Cc=LOW ; Cd=HIGH; break;} /*1*/
-      case 5: {Ca=HIGH; Cb=LOW ; Cc=LOW ; Cd=HIGH; break;} /*9*/
-      case 6: {Ca=HIGH; Cb=LOW ; Cc=LOW ; Cd=LOW ; break;} /*8*/
-      case 7: {Ca=HIGH; Cb=LOW ; Cc=HIGH; Cd=LOW ; break;} /*10*/
-      default:{Ca=LOW ; Cb=LOW ; Cc=LOW ; Cd=LOW ; break;} /*all coils off*/   
-    }
+    ms = ms + (NTP_struct.second * 1000UL) + NTP_struct.millisecond;
+  }
 
-    /*send the stepper motor coil signals to the driver*/
-    digitalWrite(COIL_A, Ca);
-    digitalWrite(COIL_B, Cb);
-    digitalWrite(COIL_C, Cc);
-    digitalWrite(COIL_D, Cd);
-    
-    delay(spd);
-  }   
+  if(NTP_struct.hour < 12)
+  {
+    ms = min(ms, HOME_MINUTES * 60000UL);                           /*the last minute before noon waits at 11:59*/
+  }
+  else
+  {
+    ms = (ms > ((HOME_MINUTES + 720) * 60000UL)) ? 0 : (((HOME_MINUTES + 720) * 60000UL) - ms); /*the last minute before midnight waits at 0:00*/
+  }
+  return(Scale_position_ms(ms));
 }
 
-/*turn the motor coils off to reduce power consumption*/
-void Motor_Off(void)
-{
-  digitalWrite(COIL_A, LOW);
-  digitalWrite(COIL_B, LOW);
-  digitalWrite(COIL_C, LOW);
-  digitalWrite(COIL_D, LOW);  
-}
-
@@ -0,0 +1,182 @@
+/* Metrics
+ * =======
+ * Keeps track of how long things take, so we can find out what keeps the webserver from responding.
+ * Every measurement is stored in a histogram with a fixed number of buckets (the duration in us is
+ * rounded up to the next power of 2), so no matter how long the clock runs, the memory use never grows.
+ * The report is available as plain text on the /metrics page of the webserver.
+*/
+
+#include <Arduino.h>
+#include "Metrics.h"
+
+/*--------------------------------------------*/
+#define METRICS_TEXT_SIZE   2048  /*size of the buffer that holds the report*/
+#define HEAP_FRAG_INTERVAL  1000  /*heap fragmentation is expensive to determine, so only do it every ... ms*/
+
+typedef struct
+{
+  unsigned long count;                    /*number of measurements*/
+  unsigned long min;                      /*shortest measured duration in us*/
+  unsigned long max;                      /*longest measured duration in us*/
+  unsigned long long sum;                 /*total of all durations in us, required for the average*/
+  unsigned long bucket[METRIC_BUCKETS];   /*the histogram*/
+} histogramTYPE;
+
+static histogramTYPE metric[METRIC_COUNT];
+static histogramTYPE state_metric[METRIC_STATES];
+static const char * const metric_names[METRIC_COUNT] = {"loop", "http", "move", "audio"};
+static const char * const *state_names = NULL;
+static unsigned char state_count = 0;
+
+static unsigned long heap_min = 0xFFFFFFFF;
+static unsigned long heap_max = 0;
+static unsigned char heap_frag = 0;
+static unsigned char heap_frag_max = 0;
+static unsigned long heap_frag_millis = 0;
+
+static unsigned long idle_last = 0;       /*the idle ratio (in 0.1%) of the last measurement*/
+static unsigned long long idle_sum = 0;   /*the idle time (in ms) since boot*/
+static unsigned long long idle_total = 0; /*the time (in ms) that was measured since boot*/
+
+static char text[METRICS_TEXT_SIZE];
+
+/*------------------------------------------------------------------------------------------*/
+void histogram_add(histogramTYPE *h, unsigned long duration);
+size_t histogram_print(char *buf, size_t size, const char *name, const histogramTYPE *h);
+/*------------------------------------------------------------------------------------------*/
+
+/*the names are used to make the report readable, the array must remain valid (so use a const array)*/
+void Metrics_init(const char * const *names, unsigned char count)
+{
+  state_names = names;
+  state_count = count;
+  if(state_count > METRIC_STATES)
+  {
+    state_count = METRIC_STATES;
+  }
+}
+
+/*add a measurement (in us)*/
+void Metrics_record(unsigned char id, unsigned long duration)
+{
+  if(id < METRIC_COUNT)
+  {
+    histogram_add(&metric[id], duration);
+  }
+}
+
+/*add a measurement (in us) of a state of the clock statemachine*/
+void Metrics_state(unsigned char state, unsigned long duration)
+{
+  if(state < METRIC_STATES)
+  {
+    histogram_add(&state_metric[state], duration);
+  }
+}
+
+/*sample the heap statistics*/
+void Metrics_heap(void)
+{
+  unsigned long heap = ESP.getFreeHeap();
+
+  if(heap < heap_min) {heap_min = heap;}
+  if(heap > heap_max) {heap_max = heap;}
+
+  if((millis() - heap_frag_millis) > HEAP_FRAG_INTERVAL)
+  {
+    heap_frag_millis = millis();
+    heap_frag = ESP.getHeapFragmentation();   /*in percent, 0 means that all free memory is in one block*/
+    if(heap_frag > heap_frag_max) {heap_frag_max = heap_frag;}
+  }
+}
+
+/*the CPU was idle for idle ms out of total ms*/
+void Metrics_idle(unsigned long idle, unsigned long total)
+{
+  if(total > 0)
+  {
+    idle_last = (idle * 1000) / total;
+    idle_sum = idle_sum + idle;
+    idle_total = idle_total + total;
+  }
+}
+
+/*a compact text report of all measurements, one line per item*/
+/*the histogram is a comma separated list of counts, the first bucket is up to 1us, the next up to 2us, then 4us, etc.*/
+const char* Metrics_text(void)
+{
+  size_t len = 0;
+  unsigned char i;
+
+  len += snprintf(text + len, sizeof(text) - len, "uptime_ms %lu\n", millis());
+  len += snprintf(text + len, sizeof(text) - len, "heap_free %lu\nheap_min %lu\nheap_max %lu\n", (unsigned long)ESP.getFreeHeap(), heap_min, heap_max);
+  len += snprintf(text + len, sizeof(text) - len, "heap_frag %u\nheap_frag_max %u\n", heap_frag, heap_frag_max);
+  len += snprintf(text + len, sizeof(text) - len, "idle_permille %lu\nidle_permille_total %lu\n", idle_last,
+                  (idle_total > 0) ? (unsigned long)((idle_sum * 1000) / idle_total) : 0UL);
+
+  for(i=0; i<METRIC_COUNT; i++)
+  {
+    len += histogram_print(text + len, sizeof(text) - len, metric_names[i], &metric[i]);
+  }
+
+  for(i=0; i<state_count; i++)
+  {
+    if(state_metric[i].count > 0)   /*states that were never visited are not worth mentioning*/
+    {
+      len += histogram_print(text + len, sizeof(text) - len, state_names[i], &state_metric[i]);
+    }
+  }
+  return(text);
+}
+
+/*................................................................*/
+
+/*add a duration to the histogram*/
+void histogram_add(histogramTYPE *h, unsigned long duration)
+{
+  unsigned char b = 0;
+
+  if(duration > 0)
+  {
+    b = 32 - __builtin_clz(duration);   /*the number of bits required to represent the duration*/
+  }
+  if(b >= METRIC_BUCKETS)
+  {
+    b = METRIC_BUCKETS - 1;
+  }
+
+  h->bucket[b]++;
+  if((h->count == 0) || (duration < h->min)) {h->min = duration;}
+  if(duration > h->max)                      {h->max = duration;}
+  h->sum = h->sum + duration;
+  h->count++;
+}
+
+/*print a single line of the report, returns the number of characters added*/
+size_t histogram_print(char *buf, size_t size, const char *name, const histogramTYPE *h)
+{
+  size_t len = 0;
+  unsigned char b;
+  unsigned long avg = 0;
+
+  if(size < 2)  /*no more room in the buffer*/
+  {
+    return(0);
+  }
+
+  if(h->count > 0)
+  {
+    avg = (unsigned long)(h->sum / h->count);
+  }
+  len += snprintf(buf + len, size - len, "%s count=%lu min=%lu avg=%lu max=%lu hist=", name, h->count, h->min, avg, h->max);
+  for(b=0; (b<METRIC_BUCKETS) && (len < size); b++)
+  {
+    len += snprintf(buf + len, size - len, (b < (METRIC_BUCKETS - 1)) ? "%lu," : "%lu\n", h->bucket[b]);
+  }
+
+  if(len >= size)   /*the text did not fit, snprintf has truncated it*/
+  {
+    len = size - 1;
+  }
+  return(len);
+}
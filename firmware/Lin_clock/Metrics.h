@@ -0,0 +1,24 @@
+#ifndef __METRICS_H
+#define __METRICS_H
+
+/*------------------------------------------*/
+
+#define METRIC_BUCKETS    20  /*bucket n counts durations from 2^(n-1) up to 2^n us, the last bucket counts everything above 0.25s*/
+#define METRIC_STATES     16  /*the maximum number of states of the clock statemachine that can be measured*/
+
+/*the things that are measured (the states of the clock statemachine are measured separately)*/
+enum Metric_ids {METRIC_LOOP,       /*time the tasks that were due took (a single pass of the scheduler)*/
+                 METRIC_HTTP,       /*time spent in server.handleClient()*/
+                 METRIC_MOVE,       /*time the motor needs to complete a move*/
+                 METRIC_AUDIO,      /*time spent feeding the audio output (per call of Audio_loop)*/
+                 METRIC_COUNT
+                };
+
+void Metrics_init(const char * const *state_names, unsigned char state_count);  /*the names are used to make the report readable*/
+void Metrics_record(unsigned char id, unsigned long duration);       /*add a measurement (in us)*/
+void Metrics_state(unsigned char state, unsigned long duration);     /*add a measurement (in us) of a state of the clock statemachine*/
+void Metrics_heap(void);                                              /*sample the heap statistics*/
+void Metrics_idle(unsigned long idle, unsigned long total);           /*the CPU was idle for idle ms out of total ms*/
+const char* Metrics_text(void);                                       /*a compact text report of all measurements*/
+
+#endif
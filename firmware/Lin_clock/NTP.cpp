@@ -13,24 +13,91 @@
 
 #include <ESP8266WiFi.h>
 #include <WiFiUdp.h>
+#include <FS.h>
 #include "NTP.h"
+#include "Network.h"
+#include "Eventlog.h"
+
+extern "C" {
+#include "lwip/init.h"    /*required for LWIP_VERSION_MAJOR*/
+#include "lwip/dns.h"     /*the asynchronous resolver of lwIP, WiFi.hostByName() would block the entire sketch while waiting*/
+}
+
+/* The time is kept by a disciplined clock: the time base is advanced using millis(), corrected for the measured
+ * drift of the crystal of the ESP8266. Every sync uses all four timestamps of the NTP exchange:
+ *   T1 = time the request left (our clock), T2 = time the server received it (server clock)
+ *   T3 = time the server replied (server clock), T4 = time the reply arrived (our clock)
+ *   offset = ((T2-T1) + (T3-T4)) / 2     delay = (T4-T1) - (T3-T2)
+ * Small offsets are slewed in (the clock runs slightly faster or slower until the offset is gone), large offsets
+ * are stepped. The remaining offset after each poll interval tells us how much the crystal drifts, this drift is
+ * corrected continuously and stored in SPIFFS so that it is known immediately after a reboot. When the clock is
+ * stable, the time between syncs is increased, so the server is asked far less often.
+ *
+ * Multiple servers can be specified (separated by a comma or a space). All servers are asked at the same time and the
+ * reply with the shortest round trip delay is used (as that one has the smallest uncertainty). Names are resolved
+ * in the background and the addresses are remembered for a while, so nothing in here ever waits for the network.
+ *
+ * A clock can also follow the time beacons of a master clock on the LAN (see Beacon.cpp), then the timeservers
+ * are not asked at all. The time in a beacon is used just like the offset of a server reply (the delay on the LAN
+ * is ignored), but only once per NTP_POLL_MIN, so the drift of the crystal is still measured.
+*/
 
 /*--------------------------------------------*/
-enum NTP_states {NTP_INITIALIZE, NTP_REQUEST, NTP_WAITFORPACKET, NTP_CLOCK};  /*state of the TAP file handling statemachine*/
+enum NTP_states {NTP_INITIALIZE, NTP_RESOLVE_SETUP, NTP_RESOLVE, NTP_REQUEST, NTP_WAITFORPACKET, NTP_CLOCK};  /*state of the TAP file handling statemachine*/
+enum NTP_dns_states {NTP_DNS_NONE, NTP_DNS_PENDING, NTP_DNS_OK, NTP_DNS_FAIL};  /*state of the name lookup of a single server*/
+
+#define NTP_MAX_SERVERS   3           /*the number of servers that can be specified*/
+#define NTP_NAME_SIZE     32          /*the maximum length of a servername*/
+#define NTP_DNS_TTL       3600000UL   /*a resolved address is used for ... ms, after that it is looked up again (pools rotate their addresses)*/
+#define NTP_TIMEOUT       5000UL      /*time in ms to wait for the name lookup and for the replies*/
+
+#define NTP_POLL_MIN      64          /*shortest time between syncs in seconds*/
+#define NTP_POLL_MAX      65536       /*longest time between syncs in seconds (approx. 18 hours)*/
+#define NTP_POLL_RETRY    256         /*when the server could not be reached, try again after ... seconds*/
+#define NTP_STEP_LIMIT    1000000LL   /*offsets larger than this (in us) are stepped instead of slewed*/
+#define NTP_STABLE_LIMIT  50000LL     /*when the offset is smaller than this (in us), the poll interval may be increased*/
+#define NTP_UNSTABLE_LIMIT 200000LL   /*when the offset is larger than this (in us), the poll interval must be decreased*/
+#define NTP_SLEW_DIVIDER  100         /*slew at most 1% (10ms per second)*/
+#define NTP_DRIFT_MAX     500000L     /*the crystal of the ESP8266 will never be worse then 500ppm*/
+#define NTP_DRIFT_SAVE    1000L       /*only store the drift when it has changed more than 1ppm*/
+#define NTP_REBASE        10000UL     /*move the time base forward every ... ms*/
 
-char ntpServerName[32];   /*valid server names are "time.nist.gov" or  "time4.google.com" but there are many many others*/
+/*everything we need to know about a single timeserver*/
+typedef struct
+{
+  char name[NTP_NAME_SIZE];           /*valid server names are "time.nist.gov" or  "time4.google.com" but there are many many others*/
+  IPAddress ip;                       /*the resolved address (Don't hardwire the IP address or we won't get the benefits of the pool)*/
+  volatile unsigned char dns;         /*state of the name lookup, this is changed by the callback of the resolver*/
+  unsigned long resolved_millis;      /*the moment the address was resolved*/
+  unsigned long long request_us;      /*T1, the moment our request was sent (on our clock)*/
+  byte request_stamp[8];              /*T1 as it was sent to the server, the server must return exactly the same value*/
+  bool requested;                     /*true when a request has been sent to this server*/
+  bool replied;                       /*true when this server has replied to the request*/
+} NTP_serverTYPE;
+
+NTP_serverTYPE servers[NTP_MAX_SERVERS];
+unsigned char server_count = 0;
 long offset = 0;          /*use value = 3600 (1*60*60) for UTC+1, use value -3600 (-1*60*60) for UTC-1 etc.*/
 
 const int NTP_PACKET_SIZE = 48;     /*NTP time stamp is in the first 48 bytes of the message*/
 unsigned int localPort = 2390;      /*local port to listen for UDP packets*/
-IPAddress timeServerIP; /*time.nist.gov NTP server address (Don't hardwire the IP address or we won't get the benefits of the pool)*/
+const unsigned long seventyYears = 2208988800UL;  /*Unix time starts on Jan 1 1970. In seconds, that's 2208988800*/
 
-/*required for breaking down time*/
-#define LEAP_YEAR(Y)     ((Y>0) && !(Y%4) && ((Y%100) || !(Y%400)))       /*leap year calulator expects time in years AC*/
-static  const uint8_t monthDays[]={31,28,31,30,31,30,31,31,30,31,30,31};  /*API starts months from 1, this array starts from 0*/
-unsigned char months, days_in_month;
-unsigned long days;
-/*------*/
+/*the disciplined clock*/
+unsigned long long base_us = 0;     /*UTC time in us since 1970 at the moment millis() was base_millis*/
+unsigned long base_millis = 0;
+long drift_ppb = 0;                 /*the measured drift of our crystal in parts per billion (positive when our clock is too slow)*/
+long drift_saved = 0;               /*the drift value as it is stored in SPIFFS*/
+long long slew_us = 0;              /*the part of the offset that still has to be applied to the time base*/
+unsigned long poll = NTP_POLL_MIN;  /*the current time between syncs in seconds*/
+unsigned long long last_sync_us = 0;/*the moment of the last successful sync (on our clock)*/
+bool best_valid = false;            /*true when at least one valid reply has been received*/
+long long best_offset = 0;          /*the offset of the reply with the shortest delay*/
+long long best_delay = 0;           /*the shortest delay of all replies*/
+unsigned long long best_request_us = 0;  /*T1 of the reply with the shortest delay*/
+bool follow = false;                /*true when the time comes from the beacons of a master clock*/
+bool new_source = false;            /*true when the time comes from elsewhere since the last sync (the difference between the sources is not drift)*/
+bool failed = false;                /*true when all retries were used without getting the time*/
 
 byte packetBuffer[ NTP_PACKET_SIZE]; //buffer to hold incoming and outgoing packets
 WiFiUDP udp;   /*A UDP instance to let us send and receive packets over UDP*/
@@ -38,16 +105,53 @@ WiFiUDP udp;   /*A UDP instance to let us send and receive packets over UDP*/
 NTP_structTYPE NTP_struct;  /*structure holding all the settings and variables that should be available to all callers who includes this .h file*/
 
 /*------------------------------------------------------------------------------------------*/
-unsigned long sendNTPpacket(IPAddress& address);
+void sendNTPpacket(unsigned char index);
 void breaktime(unsigned long timeInput);
+unsigned long long clock_now_us(void);
+void clock_rebase(void);
+bool clock_measure(unsigned long long t4);
+void clock_sync(void);
+void clock_adapt(long long offset_us, unsigned long long request_us);
+void dns_start(unsigned char index);
+unsigned long long ntp_to_us(const byte *buf);
+void us_to_ntp(unsigned long long us, byte *buf);
+void drift_load(void);
+void drift_save(void);
 /*------------------------------------------------------------------------------------------*/
 
-/*initialize the NTP function*/
-void NTP_init(String ntpserv)
+/*initialize the NTP function, ntpserv holds one or more servernames, separated by a comma or a space*/
+void NTP_init(const char *ntpserv)
 {  
-  int ntpserv_len = ntpserv.length() + 1;             /*Length (with one extra character for the null terminator)*/
-  char char_array[ntpserv_len];                       /*Prepare the character array (the buffer)*/
-  ntpserv.toCharArray(ntpServerName, ntpserv_len);    /*Copy it over*/
+  const char *p = ntpserv;
+  unsigned char len = 0;
+
+  server_count = 0;
+  for(len=0; len<NTP_MAX_SERVERS; len++)
+  {
+    memset(servers[len].name, 0, sizeof(servers[len].name));
+    servers[len].dns = NTP_DNS_NONE;
+    servers[len].requested = false;
+    servers[len].replied = false;
+  }
+  len = 0;
+  while((*p != 0) && (server_count < NTP_MAX_SERVERS))
+  {
+    if((*p == ',') || (*p == ' '))                    /*end of a name*/
+    {
+      if(len > 0) {server_count++; len = 0;}
+    }
+    else if(len < (NTP_NAME_SIZE - 1))                /*names that are too long are truncated*/
+    {
+      servers[server_count].name[len++] = *p;
+    }
+    p++;
+  }
+  if((len > 0) && (server_count < NTP_MAX_SERVERS))   /*the last name in the list*/
+  {
+    server_count++;
+  }
+
+  drift_load();                                       /*the drift of the crystal is known from previous runs*/
 }
 
 /*method for parsing the offset, which could be made of a timezone value and DST*/
@@ -62,107 +166,148 @@ void NTP_statemachine(void)
 {
   static unsigned char retry_count = 0;
   static unsigned char NTP_state = NTP_INITIALIZE;
-  static unsigned long current_millis = 0;
-  static unsigned long last_millis = 0;
-  static unsigned long remainder = 0;
-  static int sync_countdown = 0;  
-  static int sec_passed;
+  static unsigned long request_millis = 0;
+  static unsigned long resolve_millis = 0;
+  static unsigned long sync_millis = 0;
+  static unsigned long sync_countdown = 0;  /*time between syncs in seconds*/
+  unsigned long long now_us;
+  unsigned long long t4;
+  unsigned char i;
+  unsigned char pending;
 
   switch(NTP_state)
   {   
     case NTP_INITIALIZE: /*initialize the NTP*/
     {
       NTP_struct.synced = false;
+      failed = false;
       Serial.println(F("Starting UDP"));
       udp.begin(localPort);
       Serial.print(F("Local port: "));
       Serial.println(udp.localPort());
+      base_millis = millis();
       retry_count = 3;    /*allow ... retries in getting time from the NTP server*/
-      NTP_state = NTP_REQUEST;      
+      NTP_state = NTP_RESOLVE_SETUP;      
+      if(follow == true)
+      {
+        sync_countdown = 0;                       /*ask the timeservers directly when the master disappears*/
+        NTP_state = NTP_CLOCK;
+      }
       break;      
     }    
+
+    case NTP_RESOLVE_SETUP:  /*look up the addresses of the servers that we don't know (anymore)*/
+    {
+      if(Network_connected() == false)        /*wait for the network, the retries would be wasted*/
+      {
+        break;
+      }
+      for(i=0; i<server_count; i++)
+      {
+        if((servers[i].dns != NTP_DNS_OK) || ((millis() - servers[i].resolved_millis) > NTP_DNS_TTL))
+        {
+          if(servers[i].dns != NTP_DNS_PENDING)   /*a lookup that is still busy (from a previous attempt) is not restarted*/
+          {
+            dns_start(i);
+          }
+        }
+      }
+      resolve_millis = millis();
+      NTP_state = NTP_RESOLVE;
+      break;
+    }
+
+    case NTP_RESOLVE:  /*wait for the resolver to finish, this happens in the background*/
+    {
+      pending = 0;
+      for(i=0; i<server_count; i++)
+      {
+        if(servers[i].dns == NTP_DNS_PENDING) {pending++;}
+      }
+      if((pending == 0) || ((millis() - resolve_millis) > NTP_TIMEOUT))
+      {
+        NTP_state = NTP_REQUEST;                    /*continue with the servers we have an address for*/
+      }
+      break;
+    }
        
     case NTP_REQUEST:
     {
-      Serial.println(F("Requesting NTP packet..."));      
-      last_millis = millis();                       /*get the time since reset (in ms)*/
-      remainder = 0;      
-      WiFi.hostByName(ntpServerName, timeServerIP); /*get a random server from the pool*/
-      sendNTPpacket(timeServerIP);                  /*send an NTP packet to a time server*/
+      while(udp.parsePacket()) {udp.flush();}       /*throw away late replies to previous requests*/
+      request_millis = millis();                    /*get the time since reset (in ms)*/
+      best_valid = false;
+      pending = 0;
+      for(i=0; i<server_count; i++)
+      {
+        servers[i].requested = false;
+        servers[i].replied = false;
+        if(servers[i].dns == NTP_DNS_OK)
+        {
+          sendNTPpacket(i);                         /*send an NTP packet to a time server*/
+          pending++;
+        }
+      }
+      Eventlog_add(EVENT_NTP_REQUEST, pending, 0);
       NTP_state = NTP_WAITFORPACKET;      
       break;      
     }    
 
     case NTP_WAITFORPACKET:
     {
-      if (udp.parsePacket())                                  /*when we receive a packet we process it immediately*/
+      if (udp.parsePacket() >= NTP_PACKET_SIZE)               /*when we receive a packet we process it immediately*/
       {      
-        unsigned long highWord;
-        unsigned long lowWord;
-        unsigned long secsSince1900;
-        const unsigned long seventyYears = 2208988800UL; // - 15UL;      /*Unix time starts on Jan 1 1970. In seconds, that's 2208988800*/ 
-        /*day 1 : compensate 12 seconds ?!?!?!*/
-        /*day 2 : compensate 15 seconds ?!?!?!*/
-        /*day 3 : compensate 17 seconds ?!?!?!*/
+        t4 = clock_now_us();                                  /*T4, the moment the reply arrived*/
         udp.read(packetBuffer, NTP_PACKET_SIZE);              /*read the packet into the buffer*/
-        highWord = word(packetBuffer[40], packetBuffer[41]);  /*the timestamp starts at byte 40 of the received packet and is four bytes (or two words) long. First, extract the two words*/   
-        lowWord = word(packetBuffer[42], packetBuffer[43]);   /**/
-        secsSince1900 = highWord << 16 | lowWord;             /*combine the four bytes (two words) into a long integer (this is NTP time (seconds since Jan 1 1900))*/   
-        NTP_struct.epoch = secsSince1900 - seventyYears;      /*subtract seventy years in order to convert the NTP time since 1900 into everyday time*/
-        breaktime(NTP_struct.epoch);                          /*convert time in a more readable format*/     
-        NTP_struct.synced = true;                             /*time is now synced to the time of the timeserver, so we raise the flag to indicate that the time and date are available*/
-        NTP_state = NTP_CLOCK;                                /*in the next state we maintain the current time by updating it using the internal clock of the ESP8266*/
+        clock_measure(t4);                                    /*process the four timestamps, remember the best reply*/
       }            
-      else
+
+      pending = 0;
+      for(i=0; i<server_count; i++)
       {
-        current_millis = millis();      
-        if((current_millis - last_millis) > 5000)             /*when the timeserver does not respond in ...ms we may assume that our request could not be handled*/
-        {                                                     /*and we must do another request*/
-          Serial.print(F("Timeout exceeded, "));
-          retry_count--;
-          if(retry_count > 0)
-          {
-             Serial.println(F("request new packet"));              
-             NTP_state = NTP_REQUEST;                         /*timeout exceeded, do a new request*/            
-          }
-          else
-          {
-            Serial.println(F("retry failed"));            
-            NTP_state = NTP_CLOCK;                           /*stop requesting, try again later, use internal time for now*/
-          }
+        if((servers[i].requested == true) && (servers[i].replied == false)) {pending++;}
+      }
+
+      if((best_valid == true) && ((pending == 0) || ((millis() - request_millis) > NTP_TIMEOUT)))  /*all servers replied (or the others are too late)*/
+      {
+        clock_sync();                                         /*correct our clock using the best reply*/
+        NTP_struct.synced = true;                             /*time is now synced to the time of the timeserver, so we raise the flag to indicate that the time and date are available*/
+        failed = false;
+        sync_countdown = poll;                                /*the next sync, the poll interval depends on how stable our clock is*/
+        sync_millis = millis();
+        NTP_state = NTP_CLOCK;                                /*in the next state we maintain the current time by updating it using the internal clock of the ESP8266*/
+      }
+      else if((millis() - request_millis) > NTP_TIMEOUT)      /*when the timeserver does not respond in ...ms we may assume that our request could not be handled*/
+      {                                                       /*and we must do another request*/
+        retry_count--;
+        Eventlog_add(EVENT_NTP_TIMEOUT, retry_count, 0);
+        if(retry_count > 0)
+        {
+           NTP_state = NTP_RESOLVE_SETUP;                     /*timeout exceeded, do a new request (and look up the servers that failed)*/
+        }
+        else
+        {
+          failed = true;
+          sync_countdown = NTP_POLL_RETRY;                    /*stop requesting, try again later, use internal time for now*/
+          if(sync_countdown > poll) {sync_countdown = poll;}
+          sync_millis = millis();
+          NTP_state = NTP_CLOCK;
         }
       }
-      sync_countdown = 3600;  /*sync every ... seconds*/
       break;      
     }    
     
     case NTP_CLOCK:  /*using the onboard clock/timer we can maintain the time without having to poll the timeserver too many times*/
     { 
-      current_millis = millis();
-      if(current_millis > last_millis)                        /*check for overflow, if so then ignore the situation and accept the inaccuracy it causes, it will be compensated when the NTP time is requested*/
-      {
-        sec_passed = (int)(current_millis - last_millis)/1000;
-        NTP_struct.epoch = NTP_struct.epoch + (unsigned long)sec_passed;
-        remainder = (current_millis - last_millis)%1000;      /*calculate the error (the part less then a second)*/
-        last_millis = current_millis - remainder;             /*the part (less then a second) that could not be used, will be remembered and used the next time we calculate time*/        
-        breaktime((NTP_struct.epoch + offset)); /*add the offset to the UTC time and then convert it into a more readable format*/
-      }
-      else
+      if((millis() - base_millis) >= NTP_REBASE)
       {
-        sec_passed = 0;
-        last_millis = millis();
-        remainder = 0;
+        clock_rebase();                                       /*apply drift correction and slew to the time base*/
       }
 
       /*check if it is time to sync with the NTP server again*/
-      if(sync_countdown-sec_passed <= 0)
+      if((follow == false) && (Network_connected() == true) && ((millis() - sync_millis) / 1000 >= sync_countdown))  /*without the network, we keep running on our own clock*/
       {
         retry_count = 3;    /*allow ... retries in getting time from the NTP server*/
-        NTP_state = NTP_REQUEST;                         /*timeout exceeded, do a new request*/                    
-      }
-      else
-      {  
-        NTP_state = NTP_CLOCK;      
+        NTP_state = NTP_RESOLVE_SETUP;                   /*timeout exceeded, do a new request*/                    
       }
       break;      
     }    
@@ -172,59 +317,339 @@ void NTP_statemachine(void)
       NTP_state = NTP_INITIALIZE;     
       break;
     }
+  }
 
-    //NTP_print_time();                                   /*Print complete time information*/
+  /*the time and date are always available (although they are only correct once synced)*/
+  now_us = clock_now_us();
+  NTP_struct.epoch = (unsigned long)(now_us / 1000000ULL);
+  NTP_struct.millisecond = (unsigned int)((now_us / 1000ULL) % 1000ULL);
+  breaktime((NTP_struct.epoch + offset)); /*add the offset to the UTC time and then convert it into a more readable format*/
+}
+
+/*UTC in us since 1970, according to our disciplined clock*/
+unsigned long long NTP_now(void)
+{
+  return(clock_now_us());
+}
+
+/*true: don't ask the timeservers, the time comes from the beacons of a master clock*/
+void NTP_follow(bool enable)
+{
+  if(enable != follow)
+  {
+    new_source = true;
   }
+  follow = enable;
 }
 
-/*convert seconds since 1970 into a more user readable format*/
-void breaktime(unsigned long timeInput)
+/*the time (UTC in us since 1970) in a beacon that has just arrived*/
+void NTP_beacon(unsigned long long time_us)
 {
-  //Serial.print(F("timeInput=");
-  //Serial.println(timeInput);
-  NTP_struct.second = timeInput % 60;
-  timeInput /= 60; /*and from here time is in minutes*/
-  NTP_struct.minute = timeInput % 60;
-  timeInput /= 60; /*and from here time is in hours*/
-  NTP_struct.hour = timeInput % 24;
-  timeInput /= 24; /*/*and from here time is in days*/
-  NTP_struct.weekday = ((timeInput + 4) % 7) + 1;  /*Sunday is day 1*/
-      
-  NTP_struct.year = 1970;   /*year is offset from 1970*/
-  days = 0;
-  while((unsigned)(days += (LEAP_YEAR(NTP_struct.year) ? 366 : 365)) <= timeInput)
+  unsigned long long now_us = clock_now_us();
+  long long beacon_offset = (long long)(time_us - now_us);
+
+  if((NTP_struct.synced == true) && ((now_us - last_sync_us) < (NTP_POLL_MIN * 1000000ULL)) && (beacon_offset < NTP_STEP_LIMIT) && (beacon_offset > -NTP_STEP_LIMIT))
   {
-    NTP_struct.year++;
+    return;   /*the drift can only be measured over a longer period*/
   }
-  
-  days -= LEAP_YEAR(NTP_struct.year) ? 366 : 365;
-  timeInput  -= days; /*now it is days in this year, starting at 0*/
-  
-  days=0;
-  months=0;
-  days_in_month=0;
-  for (months=0; months<12; months++)
+
+  best_offset = beacon_offset;
+  best_delay = 0;
+  best_request_us = now_us;
+  clock_sync();
+  NTP_struct.synced = true;
+  failed = false;
+}
+
+/*true when the timeservers didn't answer any of the retries (and the time hasn't come from elsewhere since)*/
+bool NTP_failed(void)
+{
+  return(failed);
+}
+
+/*................................................................*/
+
+/*the current UTC time in us since 1970 according to our disciplined clock*/
+unsigned long long clock_now_us(void)
+{
+  unsigned long elapsed = millis() - base_millis;   /*this is always a small value, because the time base is moved forward regularly*/
+  long long correction;
+
+  correction = ((long long)elapsed * drift_ppb) / 1000000LL;  /*elapsed is in ms and the drift in ppb, so the result is in us*/
+  return(base_us + ((unsigned long long)elapsed * 1000ULL) + correction);
+}
+
+/*move the time base forward to now, this is where the drift correction and the slew are applied*/
+void clock_rebase(void)
+{
+  unsigned long now = millis();
+  unsigned long elapsed = now - base_millis;
+  long long step;
+
+  base_us = base_us + ((unsigned long long)elapsed * 1000ULL) + (((long long)elapsed * drift_ppb) / 1000000LL);
+  base_millis = now;
+
+  step = ((long long)elapsed * 1000LL) / NTP_SLEW_DIVIDER;  /*the maximum correction allowed in this period*/
+  if(slew_us > step)          {base_us += step;   slew_us -= step;}
+  else if(slew_us < -step)    {base_us -= step;   slew_us += step;}
+  else                        {base_us += slew_us; slew_us = 0;}
+}
+
+/*process the reply of the server (which is in packetBuffer), returns false when the packet is not a valid reply*/
+/*the reply with the shortest round trip delay is remembered, it is used to discipline our clock*/
+bool clock_measure(unsigned long long t4)
+{
+  unsigned long long t1, t2, t3;
+  long long clock_offset;
+  long long round_trip;
+  unsigned char i;
+
+  if(((packetBuffer[0] & 0x07) != 4) || (packetBuffer[1] == 0))   /*must be a server reply (mode 4) and not a "kiss of death" (stratum 0)*/
   {
-    if (months==1)
-    { /*0=january, 1=february, etc.*/
-      if (LEAP_YEAR(NTP_struct.year)) {days_in_month=29;}
-      else                            {days_in_month=28;}
+    Eventlog_add(EVENT_NTP_INVALID, 0, 0);
+    return(false);
+  }
+
+  for(i=0; i<server_count; i++) /*the server copies our transmit timestamp into the originate timestamp, this tells us which server replied*/
+  {
+    if((servers[i].requested == true) && (servers[i].replied == false) && (memcmp(&packetBuffer[24], servers[i].request_stamp, sizeof(servers[i].request_stamp)) == 0))
+    {
+      break;
     }
-    else
+  }
+  if(i >= server_count)
+  {
+    Eventlog_add(EVENT_NTP_INVALID, 1, 0);
+    return(false);
+  }
+  servers[i].replied = true;
+
+  t1 = servers[i].request_us;
+  t2 = ntp_to_us(&packetBuffer[32]);                        /*receive timestamp of the server*/
+  t3 = ntp_to_us(&packetBuffer[40]);                        /*transmit timestamp of the server*/
+
+  clock_offset = (((long long)(t2 - t1)) + ((long long)(t3 - t4))) / 2;
+  round_trip = ((long long)(t4 - t1)) - ((long long)(t3 - t2));
+  if(round_trip < 0) {round_trip = 0;}
+
+  Eventlog_add(EVENT_NTP_REPLY, i, (long)(round_trip / 1000LL));
+
+  if((best_valid == false) || (round_trip < best_delay))
+  {
+    best_valid = true;
+    best_offset = clock_offset;
+    best_delay = round_trip;
+    best_request_us = t1;
+  }
+  return(true);
+}
+
+/*discipline our clock using the best reply*/
+void clock_sync(void)
+{
+  NTP_struct.offset_ms = (long)(best_offset / 1000LL);
+  NTP_struct.delay_ms = (unsigned long)(best_delay / 1000LL);
+
+  if((NTP_struct.synced == false) || (best_offset > NTP_STEP_LIMIT) || (best_offset < -NTP_STEP_LIMIT))
+  {
+    slew_us = 0;
+    clock_rebase();
+    base_us = base_us + best_offset;                        /*way off (or the very first sync), simply set the clock*/
+    poll = NTP_POLL_MIN;                                    /*we must learn the drift again*/
+  }
+  else
+  {
+    clock_adapt(best_offset, best_request_us);
+  }
+  last_sync_us = clock_now_us();
+  new_source = false;
+
+  Eventlog_add(EVENT_NTP_SYNC, (NTP_struct.delay_ms > 0xFFFF) ? 0xFFFF : NTP_struct.delay_ms, NTP_struct.offset_ms);
+}
+
+/*a small offset has been measured, use it to improve the drift estimate and the poll interval and slew the remaining offset*/
+void clock_adapt(long long offset_us, unsigned long long request_us)
+{
+  long long interval_ms = (long long)((request_us - last_sync_us) / 1000ULL);   /*time since the previous sync*/
+  long long residual_us = offset_us - slew_us;   /*the part of the offset that was not known at the previous sync, this is caused by drift*/
+  long long residual_ppb;
+
+  if((interval_ms >= (NTP_POLL_MIN * 1000LL)) && (new_source == false))
+  {
+    residual_ppb = (residual_us * 1000000LL) / interval_ms;
+    drift_ppb = drift_ppb + (long)(residual_ppb / 2);   /*don't take the full step, a single measurement could be disturbed by network delay*/
+    if(drift_ppb > NTP_DRIFT_MAX)  {drift_ppb = NTP_DRIFT_MAX;}
+    if(drift_ppb < -NTP_DRIFT_MAX) {drift_ppb = -NTP_DRIFT_MAX;}
+    drift_save();
+  }
+
+  if((offset_us < NTP_STABLE_LIMIT) && (offset_us > -NTP_STABLE_LIMIT))
+  {
+    if(poll < NTP_POLL_MAX) {poll = poll * 2;}           /*stable, we can wait longer before asking again*/
+  }
+  else if((offset_us > NTP_UNSTABLE_LIMIT) || (offset_us < -NTP_UNSTABLE_LIMIT))
+  {
+    if(poll > NTP_POLL_MIN) {poll = poll / 2;}           /*unstable, ask more often*/
+  }
+
+  slew_us = offset_us;                                   /*this replaces the part of the previous offset that wasn't applied yet*/
+}
+
+/*the resolver has finished, this is called by lwIP*/
+#if LWIP_VERSION_MAJOR == 1
+void dns_found(const char *name, ip_addr_t *ipaddr, void *callback_arg)
+#else
+void dns_found(const char *name, const ip_addr_t *ipaddr, void *callback_arg)
+#endif
+{
+  NTP_serverTYPE *server = (NTP_serverTYPE *)callback_arg;
+
+  (void)name;                               /*the server is known from callback_arg*/
+  if(ipaddr != NULL)
+  {
+    server->ip = IPAddress(ipaddr);
+    server->resolved_millis = millis();
+    server->dns = NTP_DNS_OK;
+  }
+  else
+  {
+    server->dns = NTP_DNS_FAIL;
+  }
+}
+
+/*start looking up the address of a server, this never waits, the result is reported by dns_found()*/
+void dns_start(unsigned char index)
+{
+  ip_addr_t addr;
+  err_t err;
+
+  servers[index].dns = NTP_DNS_PENDING;
+  err = dns_gethostbyname(servers[index].name, &addr, dns_found, &servers[index]);
+  if(err == ERR_OK)                         /*the name was an IP address or it is known by the resolver already*/
+  {
+    dns_found(servers[index].name, &addr, &servers[index]);
+  }
+  else if(err != ERR_INPROGRESS)
+  {
+    Eventlog_add(EVENT_NTP_DNS_FAIL, index, 0);
+    servers[index].dns = NTP_DNS_FAIL;
+  }
+}
+
+/*convert a 64-bit NTP timestamp (seconds since 1900 and a fraction) into us since 1970*/
+unsigned long long ntp_to_us(const byte *buf)
+{
+  unsigned long long sec;
+  unsigned long long frac;
+
+  sec = ((unsigned long)buf[0] << 24) | ((unsigned long)buf[1] << 16) | ((unsigned long)buf[2] << 8) | buf[3];
+  frac = ((unsigned long)buf[4] << 24) | ((unsigned long)buf[5] << 16) | ((unsigned long)buf[6] << 8) | buf[7];
+  if(sec < seventyYears)
+  {
+    sec = sec + 0x100000000ULL;   /*NTP era 1 (from the year 2036)*/
+  }
+  return(((sec - seventyYears) * 1000000ULL) + ((frac * 1000000ULL) >> 32));
+}
+
+/*convert us since 1970 into a 64-bit NTP timestamp*/
+void us_to_ntp(unsigned long long us, byte *buf)
+{
+  unsigned long sec = (unsigned long)((us / 1000000ULL) + seventyYears);  /*wraps around in 2036, just like NTP itself*/
+  unsigned long frac = (unsigned long)(((us % 1000000ULL) << 32) / 1000000ULL);
+
+  buf[0] = sec >> 24;  buf[1] = sec >> 16;  buf[2] = sec >> 8;  buf[3] = sec;
+  buf[4] = frac >> 24; buf[5] = frac >> 16; buf[6] = frac >> 8; buf[7] = frac;
+}
+
+/*read the drift of the crystal as measured during previous runs*/
+void drift_load(void)
+{
+  File driftFile = SPIFFS.open(NTP_DRIFTFILENAME, "r");
+  if(driftFile)
+  {
+    drift_ppb = driftFile.parseInt();
+    driftFile.close();
+    if(drift_ppb > NTP_DRIFT_MAX)  {drift_ppb = NTP_DRIFT_MAX;}
+    if(drift_ppb < -NTP_DRIFT_MAX) {drift_ppb = -NTP_DRIFT_MAX;}
+    drift_saved = drift_ppb;
+    Serial.print(F("Crystal drift: "));
+    Serial.print(drift_ppb);
+    Serial.println(F("ppb"));
+  }
+}
+
+/*store the drift of the crystal, but only when it has changed significantly (to spare the flash)*/
+void drift_save(void)
+{
+  if(((drift_ppb - drift_saved) > NTP_DRIFT_SAVE) || ((drift_saved - drift_ppb) > NTP_DRIFT_SAVE))
+  {
+    File driftFile = SPIFFS.open(NTP_DRIFTFILENAME, "w");
+    if(driftFile)
     {
-      days_in_month = monthDays[months];
+      driftFile.println(drift_ppb);
+      driftFile.close();
+      drift_saved = drift_ppb;
     }
-    
-    if (timeInput >= days_in_month)   {timeInput -= days_in_month;}
-    else                              {break;}
   }
-  NTP_struct.month = months + 1;      /*add one, so now 1=january, 2=february, etc.*/
-  NTP_struct.day = timeInput + 1;     /*day of month*/
+}
+
+/*convert seconds since 1970 into a more user readable format*/
+/*this is called on every pass of the main loop, so most of the time only the seconds have changed (or nothing at all)*/
+/*in that case we only update what has changed. The date is calculated in constant time, using the "civil from days"*/
+/*algorithm of Howard Hinnant (http://howardhinnant.github.io/date_algorithms.html), which works in eras of 400 years*/
+/*starting on March 1st (this way the leap day is the last day of the year)*/
+void breaktime(unsigned long timeInput)
+{
+  static bool prev_valid = false;               /*false until the first call, every value of prev_time is a possible time*/
+  static unsigned long prev_time = 0;           /*the time of the previous call*/
+  static unsigned long prev_days = 0;           /*the day of the previous call*/
+  unsigned long days;
+  unsigned long secs;
+  unsigned long z, era, doe, yoe, doy, mp;
+
+  if((prev_valid == true) && (timeInput == prev_time))  /*nothing has changed*/
+  {
+    return;
+  }
+
+  if((prev_valid == true) && (timeInput == (prev_time + 1)) && (timeInput != 0) && (NTP_struct.second < 59))  /*only the seconds have changed (0 follows 0xFFFFFFFF in 2106)*/
+  {
+    NTP_struct.second++;
+    prev_time = timeInput;
+    return;
+  }
+  prev_time = timeInput;
+
+  days = timeInput / 86400;
+  secs = timeInput % 86400;
+  NTP_struct.hour = secs / 3600;
+  secs = secs % 3600;
+  NTP_struct.minute = secs / 60;
+  NTP_struct.second = secs % 60;
+
+  if((prev_valid == true) && (days == prev_days))  /*still the same day, so the date is still valid*/
+  {
+    return;
+  }
+  prev_valid = true;
+  prev_days = days;
+
+  NTP_struct.weekday = ((days + 4) % 7) + 1;    /*Sunday is day 1*/
+
+  z = days + 719468;                            /*days since 0000-03-01*/
+  era = z / 146097;                             /*the era of 400 years*/
+  doe = z - (era * 146097);                     /*day of era [0, 146096]*/
+  yoe = (doe - (doe / 1460) + (doe / 36524) - (doe / 146096)) / 365;   /*year of era [0, 399]*/
+  doy = doe - ((365 * yoe) + (yoe / 4) - (yoe / 100));                 /*day of year (starting at March 1st) [0, 365]*/
+  mp = ((5 * doy) + 2) / 153;                   /*month (starting at March) [0, 11]*/
+  NTP_struct.day = doy - (((153 * mp) + 2) / 5) + 1;                   /*day of month*/
+  NTP_struct.month = (mp < 10) ? (mp + 3) : (mp - 9);                  /*1=january, 2=february, etc.*/
+  NTP_struct.year = (yoe + (era * 400)) + ((NTP_struct.month <= 2) ? 1 : 0);
 }
 
 
-/*Send an NTP request to the time server at the given address*/
-unsigned long sendNTPpacket(IPAddress& address)
+/*Send an NTP request to the time server with the given index*/
+void sendNTPpacket(unsigned char index)
 {
   //Serial.println(F("sending NTP packet...");
   memset(packetBuffer, 0, NTP_PACKET_SIZE);       /*set all bytes in the buffer to 0*/
@@ -238,9 +663,14 @@ unsigned long sendNTPpacket(IPAddress& address)
   packetBuffer[13]= 0x4E;
   packetBuffer[14]= 49;
   packetBuffer[15]= 52;
+  servers[index].request_us = clock_now_us();  /*T1, the server copies this into the originate timestamp of its reply*/
+  us_to_ntp(servers[index].request_us, &packetBuffer[40]);
+  packetBuffer[47] = index;                   /*the lowest bits of the fraction are far below our resolution, use them to make the timestamp unique for every server*/
+  memcpy(servers[index].request_stamp, &packetBuffer[40], sizeof(servers[index].request_stamp));
+  servers[index].requested = true;
 
   /*all NTP fields have been given values, now you can send a packet requesting a timestamp*/
-  udp.beginPacket(address, 123);              /*NTP requests are to port 123*/
+  udp.beginPacket(servers[index].ip, 123);    /*NTP requests are to port 123*/
   udp.write(packetBuffer, NTP_PACKET_SIZE);
   udp.endPacket();
 }
@@ -263,4 +693,4 @@ void NTP_print_time(void)
   Serial.print(F(" it is now day "));
   Serial.println(NTP_struct.weekday);  
 }
-
+
@@ -3,10 +3,16 @@
 
 /*------------------------------------------*/
 
-void NTP_init(String ntpserv);
+#define NTP_DRIFTFILENAME "/ntp_drift.txt"  /*the drift (in ppb) is stored in this file*/
+
+void NTP_init(const char *ntpserv);  /*a list of one or more servers, separated by a comma or space*/
 void NTP_offset(long value);
 void NTP_statemachine(void);
 void NTP_print_time(void);
+unsigned long long NTP_now(void);              /*UTC in us since 1970, according to our disciplined clock*/
+void NTP_follow(bool enable);                  /*true: don't ask the timeservers, the time comes from the beacons of a master clock*/
+void NTP_beacon(unsigned long long time_us);   /*the time (UTC in us since 1970) in a beacon that has just arrived*/
+bool NTP_failed(void);                         /*true when the timeservers didn't answer any of the retries*/
 
 /*a simple struct to hold all settings*/
 typedef struct
@@ -20,9 +26,12 @@ typedef struct
   unsigned char minute;
   unsigned char second;
   unsigned char weekday;  /*weekday, ranges from 1 to 7, where 1=sunday*/
+  unsigned int  millisecond;  /*the part of the current second that has passed, ranges from 0 to 999*/
+  long          offset_ms;    /*the offset that was measured during the last sync*/
+  unsigned long delay_ms;     /*the round trip delay that was measured during the last sync*/
 } NTP_structTYPE;
 
 extern NTP_structTYPE NTP_struct;   /*structure holding all the settings and variables that should be available to all callers who includes this .h file*/
 
 #endif
-
+
@@ -0,0 +1,329 @@
+/* Network
+ * =======
+ * Connects to the network in the background, so the clock can home and move while the WiFi is coming up. A scan
+ * for all networks takes a few seconds, therefore the access point (BSSID and channel) we were connected to is kept
+ * in the SPIFFS, the next connection goes to that access point directly. After a reset or a short loss of the
+ * connection, the address we got from the DHCP server is used again as well (the DHCP server is asked to confirm
+ * it once we are connected). Only when the cached access point doesn't answer, the networks are scanned.
+ *
+ * When the network can't be found (or the key is rejected), an access point is created, so that the user can connect
+ * using his/her phone/tablet and fill in the correct settings. The network is tried again when these settings change,
+ * and every few minutes (the network may just have been down). When the connection is lost, we reconnect.
+*/
+
+#include <ESP8266WiFi.h>
+#include <FS.h>
+#include "Network.h"
+#include "WebConfig.h"
+#include "Status.h"
+#include "Eventlog.h"
+
+/*--------------------------------------------*/
+#define NETWORK_MAGIC     0x4C43574E    /*"NWCL", recognises a valid cache file*/
+
+enum Network_states {NETWORK_IDLE,
+                     NETWORK_START,
+                     NETWORK_FAST,
+                     NETWORK_SCAN_SETUP,
+                     NETWORK_SCAN,
+                     NETWORK_CONNECT,
+                     NETWORK_CONNECTED,
+                     NETWORK_AP_SETUP,
+                     NETWORK_AP
+                    };
+
+typedef struct
+{
+  uint32_t magic;
+  char ssid[33];          /*the cache is only used for this network*/
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint32_t ip;            /*the address we got from the DHCP server*/
+  uint32_t gateway;
+  uint32_t mask;
+  uint32_t dns;
+} network_cacheTYPE;
+
+static unsigned char network_state = NETWORK_IDLE;
+static network_cacheTYPE cache;
+static bool cache_valid = false;
+static bool lease_valid = false;        /*the cached address may be used without asking the DHCP server*/
+static bool lease_used = false;         /*the current connection uses the cached address*/
+static unsigned long lease_millis = 0;  /*the moment the DHCP server gave (or confirmed) the address*/
+static unsigned long state_millis = 0;
+static char prev_ssid[sizeof(cfg.ssid)];  /*to keep track of a changing SSID*/
+static char prev_key[sizeof(cfg.key)];    /*to keep track of a changing KEY*/
+
+/*------------------------------------------------------------------------------------------*/
+void network_cache_load(void);
+void network_cache_save(void);
+void network_connected(void);
+/*------------------------------------------------------------------------------------------*/
+
+/*do SPIFFS.begin() and Config_load() first, starts connecting in the background*/
+void Network_init(void)
+{
+  WiFi.disconnect();                /*only required when the ESP is reset, this is not required when the ESP is power-on*/
+  WiFi.persistent(false);           /*Do not memorise new wifi connections*/
+  WiFi.setAutoReconnect(false);     /*reconnecting is done by the statemachine below*/
+  WiFi.mode(WIFI_STA);              /*connect to an existing WiFi network (the ESP8266 will be used as a STATION)*/
+  WiFi.hostname(WIFIHOSTNAME);      /*the name of this device. This name is shown in the list of connected devices in your router*/
+
+  network_cache_load();
+  lease_valid = cache_valid && (ESP.getResetInfoPtr()->reason != REASON_DEFAULT_RST);  /*after power-on, the DHCP server may have forgotten us*/
+  network_state = NETWORK_START;
+}
+
+/*the connection statemachine, call this regularly*/
+void Network_process(void)
+{
+  unsigned char i;
+  int n;
+  int best;
+
+  switch(network_state)
+  {
+    case NETWORK_START:
+    {
+      strcpy(prev_ssid, cfg.ssid);
+      strcpy(prev_key, cfg.key);
+      if((cache_valid == true) && (strcmp(cache.ssid, cfg.ssid) == 0))
+      {
+        Serial.print(F("Connecting to the cached access point, channel "));
+        Serial.println(cache.channel);
+        lease_used = lease_valid && ((millis() - lease_millis) < NETWORK_LEASE_TIME);
+        if(lease_used == true)
+        {
+          WiFi.config(IPAddress(cache.ip), IPAddress(cache.gateway), IPAddress(cache.mask), IPAddress(cache.dns));  /*no need to wait for the DHCP server*/
+        }
+        WiFi.begin(cfg.ssid, cfg.key, cache.channel, cache.bssid);
+        state_millis = millis();
+        network_state = NETWORK_FAST;
+      }
+      else
+      {
+        network_state = NETWORK_SCAN_SETUP;
+      }
+      break;
+    }
+
+    case NETWORK_FAST:
+    {
+      if(WiFi.status() == WL_CONNECTED)
+      {
+        network_connected();
+      }
+      else if((millis() - state_millis) > NETWORK_FAST_TIMEOUT)
+      {
+        Serial.println(F("Cached access point not found"));
+        WiFi.disconnect();
+        if(lease_used == true)
+        {
+          WiFi.config(IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0));  /*back to DHCP*/
+          lease_used = false;
+        }
+        lease_valid = false;
+        network_state = NETWORK_SCAN_SETUP;
+      }
+      break;
+    }
+
+    case NETWORK_SCAN_SETUP:
+    {
+      Serial.println(F("scanning for networks"));
+      WiFi.scanNetworks(true);          /*asynchronous, the results are collected below*/
+      network_state = NETWORK_SCAN;
+      break;
+    }
+
+    case NETWORK_SCAN:
+    {
+      n = WiFi.scanComplete();
+      if(n == WIFI_SCAN_RUNNING)
+      {
+        break;
+      }
+
+      best = -1;
+      for(i=0; (n > 0) && (i < n); i++)   /*show all the found networks, and pick the strongest access point of our network*/
+      {
+        Serial.print(WiFi.SSID(i));
+        Serial.print(F(" ("));
+        Serial.print(WiFi.RSSI(i));
+        Serial.print(F(" dB)"));
+        Serial.println((WiFi.encryptionType(i) == ENC_TYPE_NONE)?" ":"*");
+        if((WiFi.SSID(i) == cfg.ssid) && ((best < 0) || (WiFi.RSSI(i) > WiFi.RSSI(best))))
+        {
+          best = i;
+        }
+      }
+
+      Serial.print(F("Searching for:"));
+      Serial.print(cfg.ssid);
+      if(best >= 0)
+      {
+        Serial.println(F(",found"));
+        Serial.println(F("Connecting..."));
+        WiFi.begin(cfg.ssid, cfg.key, WiFi.channel(best), WiFi.BSSID(best));
+        state_millis = millis();
+        network_state = NETWORK_CONNECT;
+      }
+      else
+      {
+        Serial.println(F(",not found"));
+        network_state = NETWORK_AP_SETUP;
+      }
+      WiFi.scanDelete();
+      break;
+    }
+
+    case NETWORK_CONNECT:
+    {
+      if(WiFi.status() == WL_CONNECTED)
+      {
+        network_connected();
+      }
+      else if((millis() - state_millis) > NETWORK_TIMEOUT)
+      {
+        Serial.println(F("Failed to connect, check key value"));
+        Status_set(STATUS_KEY_REJECTED, 0);      /*update the status message*/
+        WiFi.disconnect();
+        network_state = NETWORK_AP_SETUP;
+      }
+      break;
+    }
+
+    case NETWORK_CONNECTED:
+    {
+      if(WiFi.status() != WL_CONNECTED)
+      {
+        Serial.println(F("Network lost, reconnecting"));
+        Eventlog_add(EVENT_NETWORK, 0, 0);
+        network_state = NETWORK_START;        /*the clock keeps running on its own clock in the meantime*/
+      }
+      break;
+    }
+
+    case NETWORK_AP_SETUP:
+    {
+      if(WiFi.getMode() != WIFI_AP_STA)
+      {
+        IPAddress Ip(192, 168, 1, 1);
+        IPAddress NMask(255, 255, 255, 0);
+        WiFi.softAPConfig(Ip, Ip, NMask);
+        WiFi.mode(WIFI_AP_STA);   /*could not connect to network, so we set up our own network as a means to do allows for configuration*/
+        Serial.println(WiFi.softAPIP());
+      }
+      state_millis = millis();
+      network_state = NETWORK_AP;
+      break;
+    }
+
+    case NETWORK_AP:  /*the webserver keeps running, hoping that the user will modify the settings here so we can continue*/
+    {
+      if((strcmp(prev_ssid, cfg.ssid) != 0) || (strcmp(prev_key, cfg.key) != 0)) /*check if SSID and/or KEY settings have changed, if so then repeat the cycle, perhaps settings are correct now*/
+      {
+        Serial.println(F("Settings have changed, try again"));
+        network_state = NETWORK_START;
+      }
+      else if((millis() - state_millis) > NETWORK_RETRY)
+      {
+        network_state = NETWORK_SCAN_SETUP;
+      }
+      break;
+    }
+
+    case NETWORK_IDLE:
+    default:
+    {
+      break;
+    }
+  }
+}
+
+/*true when we are connected to the network (and have an address)*/
+bool Network_connected(void)
+{
+  return(network_state == NETWORK_CONNECTED);
+}
+
+/*................................................................*/
+
+/*read the access point and address of the last connection*/
+void network_cache_load(void)
+{
+  File f = SPIFFS.open(NETWORK_CACHEFILE, "r");
+
+  cache_valid = false;
+  if(!f)
+  {
+    return;
+  }
+  if((f.read((uint8_t *)&cache, sizeof(cache)) == sizeof(cache)) && (cache.magic == NETWORK_MAGIC))
+  {
+    cache.ssid[sizeof(cache.ssid) - 1] = 0;
+    cache_valid = true;
+  }
+  f.close();
+}
+
+/*store the access point and address of this connection, the file is only written when something has changed*/
+void network_cache_save(void)
+{
+  network_cacheTYPE now;
+  File f;
+
+  memset(&now, 0, sizeof(now));
+  now.magic = NETWORK_MAGIC;
+  strlcpy(now.ssid, cfg.ssid, sizeof(now.ssid));     /*always terminated, the rest stays 0 so the compare below works*/
+  memcpy(now.bssid, WiFi.BSSID(), sizeof(now.bssid));
+  now.channel = WiFi.channel();
+  now.ip = WiFi.localIP();
+  now.gateway = WiFi.gatewayIP();
+  now.mask = WiFi.subnetMask();
+  now.dns = WiFi.dnsIP();
+
+  if((cache_valid == true) && (memcmp(&now, &cache, sizeof(now)) == 0))
+  {
+    return;                         /*spare the flash*/
+  }
+  cache = now;
+  cache_valid = true;
+  f = SPIFFS.open(NETWORK_CACHEFILE, "w");
+  if(f)
+  {
+    f.write((const uint8_t *)&cache, sizeof(cache));
+    f.close();
+  }
+}
+
+/*the connection has just been made*/
+void network_connected(void)
+{
+  Serial.print(F("Network: "));    /*everything went fine*/
+  Serial.print(WiFi.SSID());
+  Serial.print(F(", IP: "));
+  Serial.println(WiFi.localIP());
+  Serial.print(F("You may also go to: "));
+  Serial.print(WIFIHOSTNAME);
+  Serial.println(F("/"));
+
+  if(WiFi.getMode() != WIFI_STA)    /*the access point for the configuration is no longer needed*/
+  {
+    WiFi.softAPdisconnect();
+    WiFi.mode(WIFI_STA);
+  }
+  if(lease_used == true)
+  {
+    WiFi.config(IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0));  /*let the DHCP server confirm (or change) the address in the background*/
+    lease_used = false;
+  }
+  else
+  {
+    network_cache_save();           /*the address came from the DHCP server*/
+  }
+  lease_valid = true;
+  lease_millis = millis();
+  Eventlog_add(EVENT_NETWORK, 1, (uint32_t)WiFi.localIP());
+  network_state = NETWORK_CONNECTED;
+}
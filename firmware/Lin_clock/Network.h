@@ -0,0 +1,16 @@
+#ifndef __NETWORK_H
+#define __NETWORK_H
+
+/*------------------------------------------*/
+
+#define NETWORK_CACHEFILE     "/wifi.bin" /*the access point (BSSID and channel) and the address we got the last time*/
+#define NETWORK_FAST_TIMEOUT  8000        /*when the cached access point doesn't answer within ... ms, scan for the network*/
+#define NETWORK_TIMEOUT       30000       /*when the connection isn't made within ... ms, the key is probably wrong*/
+#define NETWORK_RETRY         300000      /*while the access point for the configuration is active, try the network again every ... ms*/
+#define NETWORK_LEASE_TIME    3600000     /*the cached address is only used when we got it less than ... ms ago (or before a reset)*/
+
+void Network_init(void);        /*do SPIFFS.begin() and Config_load() first, starts connecting in the background*/
+void Network_process(void);     /*the connection statemachine, call this regularly*/
+bool Network_connected(void);   /*true when we are connected to the network (and have an address)*/
+
+#endif
@@ -0,0 +1,141 @@
+/* Power
+ * =====
+ * The clock only has real work to do once a minute, so most of the time the WiFi and the CPU could sleep:
+ *   POWER_MODEM  the radio is turned off between the beacons of the access point, the CPU keeps running (this is the
+ *                default of the SDK). Used while the motor moves or a sample plays (the stepper interrupt and the audio
+ *                output must keep going), while connecting (and when the access point for the configuration is
+ *                active) and for a while after a browser has made a request
+ *   POWER_LIGHT  the CPU sleeps as well (when the scheduler idles) and only every few beacons are listened to, it wakes
+ *                for the timers and the incoming packets, so the webpages still work (but respond slower). It is only
+ *                used after the motor and the audio have been quiet for a while, changing the sleep mode costs time
+ *                (and makes the WiFi reconfigure itself), so it must not happen at every small move
+ *
+ * The time spent in every state is counted and multiplied by the estimated current, so the saving can be seen
+ * on the /power page. The estimates can be replaced by measured values in Power.h.
+*/
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include "Power.h"
+#include "Stepper.h"
+#include "Audio.h"
+#include "Network.h"
+
+/*--------------------------------------------*/
+static const char * const state_names[POWER_STATES] = {"modem", "light"};
+static const unsigned int state_currents[POWER_STATES] = {POWER_CURRENT_MODEM, POWER_CURRENT_LIGHT};
+
+static unsigned char power_state = POWER_MODEM;
+static unsigned long activity_millis = 0;   /*the last request of a browser*/
+static unsigned long busy_millis = 0;       /*the last time the motor or the audio was busy*/
+static unsigned long update_millis = 0;     /*the last time the statistics were updated*/
+static unsigned long long state_time[POWER_STATES];  /*in ms*/
+static unsigned long long motor_time = 0;   /*in ms*/
+static unsigned long long audio_time = 0;   /*in ms*/
+static char text[POWER_TEXT_SIZE];
+
+/*------------------------------------------------------------------------------------------*/
+void power_set(unsigned char state);
+void power_count(void);
+/*------------------------------------------------------------------------------------------*/
+
+/*choose the power state, call this regularly. When enable is false, light sleep is never used*/
+void Power_process(bool enable)
+{
+  power_count();
+
+  if((Stepper_busy() == true) || (Audio_busy() == true))
+  {
+    busy_millis = millis();
+  }
+  if((enable == false) || (Network_connected() == false) || ((millis() - busy_millis) < POWER_SETTLE) || ((millis() - activity_millis) < POWER_AWAKE_TIME))
+  {
+    power_set(POWER_MODEM);
+  }
+  else
+  {
+    power_set(POWER_LIGHT);
+  }
+}
+
+/*the motor or the audio is about to start, the CPU must keep running*/
+void Power_wake(void)
+{
+  busy_millis = millis();
+  if(power_state == POWER_LIGHT)
+  {
+    power_count();
+    power_set(POWER_MODEM);
+  }
+}
+
+/*a browser is using the webpages, don't use light sleep for a while*/
+void Power_activity(void)
+{
+  activity_millis = millis();
+}
+
+/*the time spent in every state and the estimated current*/
+const char* Power_text(void)
+{
+  unsigned long long total = 0;
+  unsigned long long charge = 0;    /*in 0.1mA*ms*/
+  unsigned long long saved;         /*in 0.1mA*/
+  size_t len = 0;
+  unsigned char i;
+
+  power_count();
+  len += snprintf(text + len, sizeof(text) - len, "state %s\n", state_names[power_state]);
+  for(i=0; i<POWER_STATES; i++)
+  {
+    len += snprintf(text + len, sizeof(text) - len, "%s_s %lu\n%s_ma %u.%u\n", state_names[i], (unsigned long)(state_time[i] / 1000),
+                    state_names[i], state_currents[i] / 10, state_currents[i] % 10);
+    total = total + state_time[i];
+    charge = charge + (state_time[i] * state_currents[i]);
+  }
+  charge = charge + (motor_time * POWER_CURRENT_MOTOR) + (audio_time * POWER_CURRENT_AUDIO);
+  len += snprintf(text + len, sizeof(text) - len, "motor_s %lu\naudio_s %lu\n", (unsigned long)(motor_time / 1000), (unsigned long)(audio_time / 1000));
+  if(total > 0)
+  {
+    len += snprintf(text + len, sizeof(text) - len, "average_ma %lu.%lu\n", (unsigned long)(charge / total / 10), (unsigned long)((charge / total) % 10));
+    saved = (state_time[POWER_LIGHT] * (POWER_CURRENT_MODEM - POWER_CURRENT_LIGHT)) / total;    /*compared to modem sleep all the time*/
+    snprintf(text + len, sizeof(text) - len, "saved_ma %lu.%lu\n", (unsigned long)(saved / 10), (unsigned long)(saved % 10));
+  }
+  return(text);
+}
+
+/*................................................................*/
+
+/*change the sleep mode of the WiFi*/
+void power_set(unsigned char state)
+{
+  if(state == power_state)
+  {
+    return;
+  }
+
+  switch(state)
+  {
+    case POWER_MODEM: {WiFi.setSleepMode(WIFI_MODEM_SLEEP);                        break;}
+    case POWER_LIGHT: {WiFi.setSleepMode(WIFI_LIGHT_SLEEP, POWER_LISTEN_INTERVAL); break;}
+  }
+  power_state = state;
+}
+
+/*add the time since the previous update to the statistics*/
+void power_count(void)
+{
+  unsigned long now = millis();
+  unsigned long elapsed = now - update_millis;
+
+  update_millis = now;
+  state_time[power_state] = state_time[power_state] + elapsed;
+  if(Stepper_busy() == true)
+  {
+    motor_time = motor_time + elapsed;
+  }
+  if(Audio_busy() == true)
+  {
+    audio_time = audio_time + elapsed;
+  }
+}
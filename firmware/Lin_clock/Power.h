@@ -0,0 +1,28 @@
+#ifndef __POWER_H
+#define __POWER_H
+
+/*------------------------------------------*/
+
+#define POWER_AWAKE_TIME      60000   /*after a request from a browser, light sleep is not used for ... ms, so the webpages respond quickly*/
+#define POWER_SETTLE          2000    /*light sleep is only used when the motor and the audio have been quiet for ... ms (in smooth mode the motor moves every 1/4 s, so it isn't used at all)*/
+#define POWER_LISTEN_INTERVAL 3       /*in light sleep, only every ... DTIM beacon is listened to*/
+#define POWER_TEXT_SIZE       384     /*the size of the power report*/
+
+/*estimated current (in 0.1mA) of the ESP in every power state, from the datasheet, measure your own clock for better numbers*/
+#define POWER_CURRENT_MODEM   150     /*the radio is off between the beacons, the CPU runs*/
+#define POWER_CURRENT_LIGHT   9       /*the radio and the CPU sleep between the beacons*/
+#define POWER_CURRENT_MOTOR   2000    /*extra, while the coils of the motor are powered*/
+#define POWER_CURRENT_AUDIO   300     /*extra, while a sample is playing*/
+
+/*the power states, from the highest to the lowest power*/
+enum Power_states {POWER_MODEM,
+                   POWER_LIGHT,
+                   POWER_STATES
+                  };
+
+void Power_process(bool enable);  /*choose the power state, call this regularly. When enable is false, light sleep is never used*/
+void Power_wake(void);            /*the motor or the audio is about to start, the CPU must keep running*/
+void Power_activity(void);        /*a browser is using the webpages, don't use light sleep for a while*/
+const char* Power_text(void);     /*the time spent in every state and the estimated current*/
+
+#endif
@@ -0,0 +1,51 @@
+/* Scale
+ * =====
+ * Converts a point on the scale (in minutes from 0:00, the scale is 1mm/min) to a position of the stepper.
+ * Every gearbox and every threaded rod is slightly different, so the number of steps per minute is a setting
+ * (which can be measured, see Calibration.cpp). It is a 16.16 fixed point number, so it is precise enough for
+ * the full scale and the conversion only needs integer math. Every position is calculated from 0:00, this way
+ * the rounding errors don't add up.
+*/
+
+#include <Arduino.h>
+#include "Scale.h"
+
+/*--------------------------------------------*/
+static unsigned long ratio_used = SCALE_DEFAULT;
+
+/*------------------------------------------------------------------------------------------*/
+
+/*use this number of steps per minute (16.16 fixed point), the default is used when it is unrealistic*/
+void Scale_init(unsigned long ratio)
+{
+  if(Scale_valid(ratio) == false)
+  {
+    Serial.println(F("Unrealistic number of steps per minute, using the default"));
+    ratio = SCALE_DEFAULT;
+  }
+  ratio_used = ratio;
+}
+
+/*the number of steps per minute (16.16 fixed point) that is used*/
+unsigned long Scale_ratio(void)
+{
+  return(ratio_used);
+}
+
+/*true when the ratio is realistic*/
+bool Scale_valid(unsigned long ratio)
+{
+  return((ratio >= (SCALE_DEFAULT - (SCALE_DEFAULT / SCALE_TOLERANCE))) && (ratio <= (SCALE_DEFAULT + (SCALE_DEFAULT / SCALE_TOLERANCE))));
+}
+
+/*the position (in steps) of the point that is this number of minutes away from 0:00, rounded to the nearest step*/
+unsigned long Scale_position(unsigned long minutes)
+{
+  return((unsigned long)((((uint64_t)minutes * ratio_used) + 0x8000) >> 16));
+}
+
+/*the position (in steps) of the point that is this number of ms away from 0:00*/
+unsigned long Scale_position_ms(unsigned long ms)
+{
+  return((unsigned long)((((uint64_t)ms * ratio_used) + (60000ULL << 15)) / (60000ULL << 16)));
+}
@@ -0,0 +1,15 @@
+#ifndef __SCALE_H
+#define __SCALE_H
+
+/*------------------------------------------*/
+
+#define SCALE_DEFAULT     (4076UL << 16)  /*steps per minute (16.16 fixed point), the stepper isn't really 1:64 but 1:63.68395*/
+#define SCALE_TOLERANCE   20              /*a ratio that differs more than 1/SCALE_TOLERANCE (5%) from the default must be a mistake*/
+
+void Scale_init(unsigned long ratio);               /*use this number of steps per minute (16.16 fixed point), the default is used when it is unrealistic*/
+unsigned long Scale_ratio(void);                     /*the number of steps per minute (16.16 fixed point) that is used*/
+bool Scale_valid(unsigned long ratio);              /*true when the ratio is realistic*/
+unsigned long Scale_position(unsigned long minutes); /*the position (in steps) of the point that is this number of minutes away from 0:00*/
+unsigned long Scale_position_ms(unsigned long ms);   /*the same, for a time in ms (used by the smooth mode)*/
+
+#endif
@@ -0,0 +1,119 @@
+/* Scheduler
+ * =========
+ * A very small cooperative scheduler. Every task is a function that does a little bit of work and returns
+ * (just like the statemachines), it is called again when its interval has passed. When no task is due, the
+ * CPU idles until the next one is: for longer waits delay() is used, which lets the WiFi stack do its work and
+ * allows the ESP to sleep. After a pass that did run tasks yield() is called, so the SDK (and the watchdog) get
+ * their turn even when a task is due all the time. The time spent idling is reported on the /metrics page, so we
+ * can see how much of the CPU is really needed.
+*/
+
+#include <Arduino.h>
+#include "Scheduler.h"
+#include "Metrics.h"
+
+/*--------------------------------------------*/
+typedef struct
+{
+  void (*function)(void);
+  unsigned long interval;   /*in us*/
+  unsigned long next;       /*the value of micros() at which the task is due*/
+} taskTYPE;
+
+static taskTYPE tasks[SCHEDULER_TASKS];
+static unsigned char task_count = 0;
+static unsigned long window_start = 0;    /*millis() at the start of the measurement window*/
+static unsigned long window_idle = 0;     /*the idle time (in us) in the current window*/
+
+/*------------------------------------------------------------------------------------------*/
+
+/*run the task every interval us, returns the id of the task*/
+unsigned char Scheduler_add(void (*task)(void), unsigned long interval)
+{
+  if(task_count >= SCHEDULER_TASKS)
+  {
+    Serial.println(F("Too many tasks"));
+    return(0xFF);
+  }
+  tasks[task_count].function = task;
+  tasks[task_count].interval = interval;
+  tasks[task_count].next = micros();
+  return(task_count++);
+}
+
+/*change the interval (in us) of a task, a shorter interval is used directly*/
+void Scheduler_interval(unsigned char id, unsigned long interval)
+{
+  unsigned long next;
+
+  if(id < task_count)
+  {
+    tasks[id].interval = interval;
+    next = micros() + interval;
+    if((long)(tasks[id].next - next) > 0)
+    {
+      tasks[id].next = next;
+    }
+  }
+}
+
+/*run the task as soon as possible*/
+void Scheduler_wake(unsigned char id)
+{
+  if(id < task_count)
+  {
+    tasks[id].next = micros();
+  }
+}
+
+/*run the tasks that are due, when nothing is due the CPU idles until the next one is, every pass yields to the SDK*/
+void Scheduler_run(void)
+{
+  unsigned long now = micros();
+  unsigned long start = now;
+  long wait = SCHEDULER_WINDOW * 1000L;
+  long due;
+  bool busy = false;
+  unsigned char i;
+
+  for(i=0; i<task_count; i++)
+  {
+    due = (long)(tasks[i].next - now);
+    if(due <= 0)
+    {
+      tasks[i].next = now + tasks[i].interval;
+      tasks[i].function();
+      now = micros();
+      busy = true;
+    }
+    else if(due < wait)
+    {
+      wait = due;
+    }
+  }
+
+  if(busy == true)
+  {
+    Metrics_record(METRIC_LOOP, now - start);   /*the time the tasks took*/
+    yield();                                    /*the tasks may be due on every pass (while the motor runs), the SDK and the watchdog still need their turn*/
+  }
+  else
+  {
+    if(wait >= 1000)
+    {
+      delay(wait / 1000);   /*the SDK may sleep in the meantime*/
+    }
+    else
+    {
+      yield();
+    }
+    window_idle = window_idle + (micros() - now);
+  }
+
+  if((millis() - window_start) >= SCHEDULER_WINDOW)
+  {
+    Metrics_idle(window_idle / 1000, millis() - window_start);
+    window_start = millis();
+    window_idle = 0;
+  }
+}
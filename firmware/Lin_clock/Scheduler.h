@@ -0,0 +1,14 @@
+#ifndef __SCHEDULER_H
+#define __SCHEDULER_H
+
+/*------------------------------------------*/
+
+#define SCHEDULER_TASKS   12      /*the maximum number of tasks*/
+#define SCHEDULER_WINDOW  10000   /*the idle ratio is reported every ... ms*/
+
+unsigned char Scheduler_add(void (*task)(void), unsigned long interval); /*run the task every interval us, returns the id of the task*/
+void Scheduler_interval(unsigned char id, unsigned long interval);       /*change the interval (in us) of a task*/
+void Scheduler_wake(unsigned char id);                                   /*run the task as soon as possible*/
+void Scheduler_run(void);                                                /*run the tasks that are due, when nothing is due the CPU idles until the next one is, every pass yields*/
+
+#endif
@@ -0,0 +1,456 @@
+/* Sensorbar
+ * =========
+ * When the motor stalls or skips steps, the position counter no longer matches the indicator. Instead of homing
+ * again (which takes many minutes), the crossings of the sensor edges are used as calibration points. Right after
+ * homing the position is trusted, so the position of the edges that are crossed from then on is learned. When the
+ * same edge (same sensor, same level, same direction) is crossed again, the difference between the position counter
+ * and the learned position is the error.
+ *
+ * Only the edges of parts that never move are used (the home sensor edge and the insulator in the middle of the
+ * bar, see Sensorbar_reference()), the alarm blocks may be moved by the user at any time. An error is only corrected
+ * when SENSORBAR_CONFIRM crossings agree about it, and a sensor that changes several times within SENSORBAR_BOUNCE
+ * half-steps is bouncing, such a crossing is not used at all.
+ *
+ * The learned edges are kept in the RTC memory (see Journal.cpp), after a warm reset the motor makes a short move to
+ * the nearest of them. When that edge is where it should be, the clock resumes from the stored position, otherwise it
+ * is homed again.
+*/
+
+#include <Arduino.h>
+#include "Sensorbar.h"
+#include "Stepper.h"
+#include "Eventlog.h"
+#include "Journal.h"
+#include "Scale.h"
+
+/*--------------------------------------------*/
+typedef struct
+{
+  uint16_t pin;             /*the pin (as bit)*/
+  uint16_t level;           /*the new level of that pin*/
+  unsigned char dir;        /*the direction of the motor when it was crossed*/
+  unsigned long position;   /*the learned position*/
+  unsigned long crossings;  /*the number of times it was crossed since it was learned*/
+  long error;               /*the error at the last crossing*/
+} sensorbar_edgeTYPE;
+
+/*a part of the scale where the edges of a sensor are fixed, with the last edge that was seen there*/
+typedef struct
+{
+  uint16_t pin;             /*the pin (as bit)*/
+  unsigned long ms;         /*the center, in ms from 0:00 on the scale (so it follows the ratio)*/
+  unsigned long range_ms;
+  bool pending;             /*an edge is waiting to see whether the contact bounces*/
+  bool bounced;             /*it did*/
+  uint16_t level;
+  unsigned char dir;
+  unsigned long position;
+} sensorbar_referenceTYPE;
+
+/*a learned edge as it is kept in the RTC memory*/
+typedef struct
+{
+  uint16_t pin;
+  uint16_t level;
+  uint8_t dir;
+  uint8_t reserved;
+  uint16_t reserved2;
+  uint32_t position;
+} sensorbar_storedTYPE;
+
+static sensorbar_edgeTYPE learned[SENSORBAR_EDGES];
+static unsigned char learned_count = 0;
+static bool learning = false;
+static sensorbar_referenceTYPE references[SENSORBAR_REFERENCES];
+static unsigned char reference_count = 0;
+static long agreed_error = 0;             /*the error that the last crossings agree about*/
+static unsigned char agreed = 0;          /*the number of crossings that agree about it*/
+static unsigned long corrections = 0;     /*the number of times the position was corrected*/
+static unsigned long corrected = 0;       /*the total number of half-steps that were corrected*/
+static long largest = 0;                  /*the largest error that was seen*/
+static signed char resume_edge = -1;      /*the edge that is checked after a warm reset (-1: none)*/
+static bool resume_approach = false;      /*first going to the other side of that edge*/
+static unsigned long resume_target = 0;   /*the end of the move that crosses it*/
+static char text[SENSORBAR_TEXT_SIZE];
+
+/*------------------------------------------------------------------------------------------*/
+sensorbar_referenceTYPE* sensorbar_reference(uint16_t pin, unsigned long position);
+void sensorbar_edge(uint16_t pin, uint16_t level, unsigned char dir, unsigned long position);
+void sensorbar_check(uint16_t pin, uint16_t level, unsigned char dir, unsigned long position);
+void sensorbar_add(uint16_t pin, uint16_t level, unsigned char dir, unsigned long position);
+void sensorbar_store(void);
+/*------------------------------------------------------------------------------------------*/
+
+/*the sensor pins (as bits) whose edges are used to check the position*/
+void Sensorbar_init(uint32_t mask)
+{
+  Stepper_sensors(mask);
+}
+
+/*only the edges of this pin that are within range_ms of this point on the scale (in ms from 0:00) are used*/
+void Sensorbar_reference(uint16_t pin, unsigned long ms, unsigned long range_ms)
+{
+  unsigned char i;
+
+  for(i=0; (i<reference_count) && (references[i].pin != pin); i++) {}
+  if(i == SENSORBAR_REFERENCES)
+  {
+    return;
+  }
+  references[i].pin = pin;
+  references[i].ms = ms;
+  references[i].range_ms = range_ms;
+  references[i].pending = false;
+  if(i == reference_count)
+  {
+    reference_count++;
+  }
+}
+
+/*true: the position is trusted (just homed), unknown edges are learned. false: forget everything (call this before homing)*/
+void Sensorbar_learn(bool enable)
+{
+  stepper_edgeTYPE edge;
+
+  unsigned char i;
+
+  while(Stepper_edge(&edge) == true) {}   /*these were seen before the position became (un)trusted*/
+  for(i=0; i<reference_count; i++)
+  {
+    references[i].pending = false;
+  }
+  learning = enable;
+  learned_count = 0;
+  agreed = 0;
+  resume_edge = -1;
+  sensorbar_store();
+}
+
+/*an edge whose position is known without crossing it (the home edge after homing)*/
+void Sensorbar_known(uint16_t pin, uint16_t level, unsigned char dir, unsigned long position)
+{
+  sensorbar_add(pin, level, dir, position);
+}
+
+/*check the position at every edge that was crossed, call this regularly*/
+void Sensorbar_process(void)
+{
+  stepper_edgeTYPE edge;
+  uint16_t pin;
+  unsigned char i;
+  unsigned long position;
+
+  if(learning == false)    /*leave them, calibration may need them*/
+  {
+    return;
+  }
+
+  while(Stepper_edge(&edge) == true)
+  {
+    for(pin=1; pin!=0; pin=pin<<1)    /*several sensors may have changed at the same step*/
+    {
+      if(edge.changed & pin)
+      {
+        sensorbar_edge(pin, edge.level & pin, edge.dir, edge.position);
+      }
+    }
+  }
+
+  position = current_position;
+  for(i=0; i<reference_count; i++)    /*the motor has gone far enough past the last edge to know it didn't bounce*/
+  {
+    if((references[i].pending == true) && (abs((long)(position - references[i].position)) > SENSORBAR_BOUNCE))
+    {
+      references[i].pending = false;
+      if(references[i].bounced == false)
+      {
+        sensorbar_check(references[i].pin, references[i].level, references[i].dir, references[i].position);
+      }
+    }
+  }
+}
+
+/*after a warm reset: start a short move to the nearest edge that was learned before the reset, false when there is none*/
+/*the edge must be crossed in the direction it was learned in (the rod has some play), so when the position is on the*/
+/*wrong side of it (or too close to be sure), the motor first goes to the other side*/
+bool Sensorbar_resume(unsigned long position)
+{
+  sensorbar_storedTYPE stored[SENSORBAR_EDGES];
+  stepper_edgeTYPE edge;
+  unsigned char len;
+  unsigned char i;
+  unsigned long before;     /*where the crossing starts*/
+  unsigned long after;      /*where it ends*/
+  unsigned long distance;
+  unsigned long nearest = 0xFFFFFFFF;
+  bool approach;
+
+  while(Stepper_edge(&edge) == true) {}
+  learning = false;
+  learned_count = 0;
+  resume_edge = -1;
+
+  len = Journal_edges_read(stored, sizeof(stored));
+  for(i=0; i<(len / sizeof(sensorbar_storedTYPE)); i++)
+  {
+    if(sensorbar_reference(stored[i].pin, stored[i].position) == NULL)
+    {
+      continue;   /*learned by an older firmware*/
+    }
+    learned[learned_count].pin = stored[i].pin;
+    learned[learned_count].level = stored[i].level;
+    learned[learned_count].dir = stored[i].dir;
+    learned[learned_count].position = stored[i].position;
+    learned[learned_count].crossings = 0;
+    learned[learned_count].error = 0;
+    learned_count++;
+
+    if(stored[i].position < SENSORBAR_WINDOW)
+    {
+      continue;
+    }
+    before = (stored[i].dir == UP) ? stored[i].position - SENSORBAR_WINDOW : stored[i].position + SENSORBAR_WINDOW;
+    after = (stored[i].dir == UP) ? stored[i].position + SENSORBAR_WINDOW : stored[i].position - SENSORBAR_WINDOW;
+    approach = (stored[i].dir == UP) ? (position > before) : (position < before);
+    if(approach == false)
+    {
+      distance = (stored[i].dir == UP) ? after - position : position - after;
+    }
+    else
+    {
+      distance = ((position > before) ? position - before : before - position) + (2 * SENSORBAR_WINDOW);
+    }
+    if(distance < nearest)
+    {
+      nearest = distance;
+      resume_edge = learned_count - 1;
+      resume_approach = approach;
+      resume_target = after;
+    }
+  }
+
+  if(resume_edge < 0)
+  {
+    return(false);
+  }
+  Stepper_setposition(position);
+  if(resume_approach == true)
+  {
+    Stepper_moveto((learned[resume_edge].dir == UP) ? learned[resume_edge].position - SENSORBAR_WINDOW : learned[resume_edge].position + SENSORBAR_WINDOW, STEPPER_PROFILE);
+  }
+  else
+  {
+    Stepper_moveto(resume_target, STEPPER_PROFILE);
+  }
+  return(true);
+}
+
+/*call this until the edge is found (SENSORBAR_CONFIRMED) or not (SENSORBAR_FAILED)*/
+unsigned char Sensorbar_resume_process(void)
+{
+  sensorbar_edgeTYPE *expected;
+  stepper_edgeTYPE edge;
+  long error;
+
+  if(resume_edge < 0)
+  {
+    return(SENSORBAR_FAILED);
+  }
+  expected = &learned[resume_edge];
+
+  if(resume_approach == true)   /*on the way to the other side of the edge, what is crossed now doesn't count*/
+  {
+    while(Stepper_edge(&edge) == true) {}
+    if(Stepper_busy() == false)
+    {
+      resume_approach = false;
+      Stepper_moveto(resume_target, STEPPER_PROFILE);
+    }
+    return(SENSORBAR_BUSY);
+  }
+
+  while(Stepper_edge(&edge) == true)
+  {
+    if(((edge.changed & expected->pin) == 0) || ((edge.level & expected->pin) != expected->level) || (edge.dir != expected->dir))
+    {
+      continue;   /*another sensor (or the other side of the same one)*/
+    }
+    error = (long)(edge.position - expected->position);
+    if((error > SENSORBAR_WINDOW) || (error < -SENSORBAR_WINDOW))
+    {
+      continue;
+    }
+
+    Stepper_stop();
+    expected->crossings++;
+    expected->error = error;
+    if((error > SENSORBAR_TOLERANCE) || (error < -SENSORBAR_TOLERANCE))
+    {
+      Stepper_correct(-error);
+      corrections++;
+      corrected = corrected + abs(error);
+      Eventlog_add(EVENT_CORRECTION, expected->pin, -error);
+    }
+    resume_edge = -1;
+    learning = true;    /*the position can be trusted again, keep checking it (with the edges that were learned before)*/
+    return(SENSORBAR_CONFIRMED);
+  }
+
+  if(Stepper_busy() == true)
+  {
+    return(SENSORBAR_BUSY);
+  }
+  resume_edge = -1;
+  return(SENSORBAR_FAILED);   /*went past the place where it should have been*/
+}
+
+/*the learned edges and the corrections as text*/
+const char* Sensorbar_text(void)
+{
+  unsigned char i;
+  unsigned int len;
+
+  len = snprintf(text, sizeof(text), "corrections %lu\ncorrected %lu\nlargest %ld\nagreed %u,%ld\n", corrections, corrected, largest, agreed, agreed_error);
+  for(i=0; (i<learned_count) && (len < sizeof(text)); i++)
+  {
+    len += snprintf(text + len, sizeof(text) - len, "edge pin=%04x,level=%u,dir=%s,position=%lu,crossings=%lu,error=%ld\n",
+                    learned[i].pin, (learned[i].level != 0) ? 1 : 0, (learned[i].dir == UP) ? "up" : "down",
+                    learned[i].position, learned[i].crossings, learned[i].error);
+  }
+  return(text);
+}
+
+/*................................................................*/
+
+/*the reference of this pin when the position is within it, NULL otherwise*/
+sensorbar_referenceTYPE* sensorbar_reference(uint16_t pin, unsigned long position)
+{
+  unsigned char i;
+  unsigned long ms;
+
+  for(i=0; i<reference_count; i++)
+  {
+    if(references[i].pin != pin)
+    {
+      continue;
+    }
+    ms = (references[i].ms > references[i].range_ms) ? references[i].ms - references[i].range_ms : 0;
+    if((position >= Scale_position_ms(ms)) && (position <= Scale_position_ms(references[i].ms + references[i].range_ms)))
+    {
+      return(&references[i]);
+    }
+  }
+  return(NULL);
+}
+
+/*a sensor has changed, it is held until the motor has moved far enough to be sure the contact doesn't bounce*/
+void sensorbar_edge(uint16_t pin, uint16_t level, unsigned char dir, unsigned long position)
+{
+  sensorbar_referenceTYPE *reference = sensorbar_reference(pin, position);
+
+  if(reference == NULL)
+  {
+    return;   /*an alarm block (or another part that can be moved)*/
+  }
+  if((reference->pending == true) && (abs((long)(position - reference->position)) <= SENSORBAR_BOUNCE))
+  {
+    reference->bounced = true;    /*this one and the one before are useless*/
+  }
+  else
+  {
+    if((reference->pending == true) && (reference->bounced == false))
+    {
+      sensorbar_check(pin, reference->level, reference->dir, reference->position);
+    }
+    reference->bounced = false;
+  }
+  reference->pending = true;
+  reference->level = level;
+  reference->dir = dir;
+  reference->position = position;
+}
+
+/*compare a single edge with the learned ones, correct the position (when the last crossings agree) or learn the edge*/
+void sensorbar_check(uint16_t pin, uint16_t level, unsigned char dir, unsigned long position)
+{
+  unsigned char i;
+  long error;
+
+  for(i=0; i<learned_count; i++)
+  {
+    if((learned[i].pin != pin) || (learned[i].level != level) || (learned[i].dir != dir))
+    {
+      continue;
+    }
+
+    error = (long)(position - learned[i].position);
+    if((error > SENSORBAR_WINDOW) || (error < -SENSORBAR_WINDOW))
+    {
+      return;     /*a reference has a single edge like this, but this is more than a stall costs, only homing can tell*/
+    }
+
+    learned[i].crossings++;
+    learned[i].error = error;
+    if(abs(error) > abs(largest))
+    {
+      largest = error;
+    }
+    if((error <= SENSORBAR_TOLERANCE) && (error >= -SENSORBAR_TOLERANCE))
+    {
+      agreed = 0;             /*right, whatever was seen before*/
+    }
+    else if((agreed > 0) && (abs(error - agreed_error) <= SENSORBAR_TOLERANCE))
+    {
+      agreed++;
+    }
+    else
+    {
+      agreed = 1;             /*a new error, it may be a glitch*/
+    }
+    agreed_error = error;
+    if(agreed >= SENSORBAR_CONFIRM)
+    {
+      Stepper_correct(-error);
+      corrections++;
+      corrected = corrected + abs(error);
+      Eventlog_add(EVENT_CORRECTION, pin, -error);
+      agreed = 0;
+    }
+    return;
+  }
+
+  sensorbar_add(pin, level, dir, position);   /*a new edge*/
+}
+
+/*learn a new edge*/
+void sensorbar_add(uint16_t pin, uint16_t level, unsigned char dir, unsigned long position)
+{
+  if(learned_count < SENSORBAR_EDGES)
+  {
+    learned[learned_count].pin = pin;
+    learned[learned_count].level = level;
+    learned[learned_count].dir = dir;
+    learned[learned_count].position = position;
+    learned[learned_count].crossings = 0;
+    learned[learned_count].error = 0;
+    learned_count++;
+    sensorbar_store();
+  }
+}
+
+/*keep the learned edges in the RTC memory, so they can be used after a warm reset (this is rare, so it may be slow)*/
+void sensorbar_store(void)
+{
+  sensorbar_storedTYPE stored[SENSORBAR_EDGES];
+  unsigned char i;
+
+  memset(stored, 0, sizeof(stored));
+  for(i=0; i<learned_count; i++)
+  {
+    stored[i].pin = learned[i].pin;
+    stored[i].level = learned[i].level;
+    stored[i].dir = learned[i].dir;
+    stored[i].position = learned[i].position;
+  }
+  Journal_edges(stored, learned_count * sizeof(sensorbar_storedTYPE));
+}
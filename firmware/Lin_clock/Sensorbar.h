@@ -0,0 +1,28 @@
+#ifndef __SENSORBAR_H
+#define __SENSORBAR_H
+
+/*------------------------------------------*/
+
+#define SENSORBAR_EDGES       8     /*the number of sensor edges that can be learned*/
+#define SENSORBAR_REFERENCES  2     /*the number of fixed references (one per sensor)*/
+#define SENSORBAR_WINDOW      256   /*a sensor change within this number of half-steps from a learned edge is that edge (a few times the steps a stall costs)*/
+#define SENSORBAR_TOLERANCE   16    /*smaller errors (in half-steps) are not corrected, the sensors aren't that precise*/
+#define SENSORBAR_CONFIRM     3     /*the number of crossings that must agree about the error before it is corrected*/
+#define SENSORBAR_BOUNCE      64    /*sensor changes closer together than this number of half-steps are contact bounce, they are ignored*/
+#define SENSORBAR_TEXT_SIZE   512   /*the size of the statistics report*/
+
+enum Sensorbar_resume_results {SENSORBAR_BUSY,        /*still moving towards the edge*/
+                               SENSORBAR_CONFIRMED,   /*the edge was found, the position is right (or has been corrected)*/
+                               SENSORBAR_FAILED       /*the edge was not found, the position is wrong*/
+                              };
+
+void Sensorbar_init(uint32_t mask);   /*the sensor pins (as bits) whose edges are used to check the position*/
+void Sensorbar_reference(uint16_t pin, unsigned long ms, unsigned long range_ms);  /*only the edges of this pin that are within range_ms of this point on the scale (in ms from 0:00) are used*/
+void Sensorbar_learn(bool enable);    /*true: the position is trusted (just homed), unknown edges are learned. false: forget everything*/
+void Sensorbar_known(uint16_t pin, uint16_t level, unsigned char dir, unsigned long position);  /*an edge whose position is known without crossing it (the home edge after homing)*/
+void Sensorbar_process(void);         /*check the position at every edge that was crossed, call this regularly*/
+bool Sensorbar_resume(unsigned long position);  /*after a warm reset: start a short move to the nearest edge that was learned before the reset, false when there is none*/
+unsigned char Sensorbar_resume_process(void);   /*call this until the edge is found (SENSORBAR_CONFIRMED) or not (SENSORBAR_FAILED)*/
+const char* Sensorbar_text(void);     /*the learned edges and the corrections as text*/
+
+#endif
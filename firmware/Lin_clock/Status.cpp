@@ -0,0 +1,75 @@
+/* Status
+ * ======
+ * The status message that is shown on the webpage. The statemachine only stores a code and a value, the text
+ * is made from that when it is requested (by the webserver), so there is no work (and no heap use) when nobody
+ * is watching.
+*/
+
+#include <Arduino.h>
+#include "Status.h"
+#include "NTP.h"
+
+/*--------------------------------------------*/
+static const char * const status_texts[STATUS_CODES] = {"n.a.",
+                                                        "Key is rejected",
+                                                        "Homing indicator...",
+                                                        "Home sensor detected (%ld ms)",
+                                                        "Local time = ",
+                                                        "Moving indicator, %ld steps",
+                                                        "Playing chime",
+                                                        "Alarm event",
+                                                        "Error: #%ld",
+                                                        "Calibrating...",
+                                                        "Connecting to the network...",
+                                                        "Checking the position..."
+                                                       };
+
+static unsigned char status_code = STATUS_NONE;
+static long status_value = 0;
+static unsigned long status_version = 0;
+static unsigned char status_minute = 0;     /*the minute that is part of the time message*/
+static char text[STATUS_TEXT_SIZE];
+
+/*------------------------------------------------------------------------------------------*/
+
+/*cheap, the text is only made when somebody wants to see it*/
+void Status_set(unsigned char code, long value)
+{
+  if((code != status_code) || (value != status_value))
+  {
+    status_code = code;
+    status_value = value;
+    status_version++;
+  }
+}
+
+/*changes every time the status (or the displayed minute) changes, so the webserver knows when to send an update*/
+unsigned long Status_version(void)
+{
+  if((status_code == STATUS_TIME) && (NTP_struct.minute != status_minute))
+  {
+    status_minute = NTP_struct.minute;
+    status_version++;
+  }
+  return(status_version);
+}
+
+/*the status as readable text*/
+const char* Status_text(void)
+{
+  if(status_code >= STATUS_CODES)
+  {
+    status_code = STATUS_NONE;
+  }
+
+  if(status_code == STATUS_TIME)
+  {
+    snprintf(text, sizeof(text), "%s%u-%u-%u %u:%02u %s", status_texts[STATUS_TIME], NTP_struct.year, NTP_struct.month, NTP_struct.day,
+             NTP_struct.hour, NTP_struct.minute, (status_value != 0) ? "(synced)" : "(NTP err.)");
+  }
+  else
+  {
+    snprintf(text, sizeof(text), status_texts[status_code], status_value);
+  }
+  return(text);
+}
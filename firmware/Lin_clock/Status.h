@@ -0,0 +1,28 @@
+#ifndef __STATUS_H
+#define __STATUS_H
+
+/*------------------------------------------*/
+
+#define STATUS_TEXT_SIZE  64    /*the longest status message (including the terminating 0)*/
+
+/*the messages that can be shown on the webpage*/
+enum Status_codes {STATUS_NONE,
+                   STATUS_KEY_REJECTED,
+                   STATUS_HOMING,
+                   STATUS_HOME_FOUND,   /*value: the time homing took (in ms)*/
+                   STATUS_TIME,         /*value: the synced flag*/
+                   STATUS_MOVING,       /*value: the number of steps*/
+                   STATUS_CHIME,        /*any chime of the agenda (hourly, quarter or custom)*/
+                   STATUS_ALARM,
+                   STATUS_ERROR,        /*value: the error code*/
+                   STATUS_CALIBRATING,
+                   STATUS_CONNECTING,
+                   STATUS_RESUMING,
+                   STATUS_CODES
+                  };
+
+void Status_set(unsigned char code, long value);  /*cheap, the text is only made when somebody wants to see it*/
+unsigned long Status_version(void);               /*changes every time the status (or the displayed minute) changes*/
+const char* Status_text(void);                    /*the status as readable text*/
+
+#endif
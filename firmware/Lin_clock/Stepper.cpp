@@ -0,0 +1,433 @@
+/* Stepper motor engine
+ * ====================
+ * Drives the 28BYJ-48 from the timer1 interrupt, so that the main loop is never blocked by motor movements.
+ * The caller only specifies where the motor should go (and how fast), the interrupt routine takes care of the
+ * individual steps and keeps track of the absolute position. This way the webserver and the NTP routines keep
+ * running while the indicator travels over the scale (which could take many minutes).
+ *
+ * timer1 runs at 80MHz/16 = 5MHz, so 5 ticks is 1us
+ *
+ * Long moves can use a trapezoidal speed profile. The speed after n steps of constant acceleration a is
+ * v = sqrt(v0^2 + 2*a*n), the term a*n (the "ramp energy") is accumulated by the interrupt every step and is used
+ * as index in a table of step intervals, which is calculated once at startup. When decelerating the same table is
+ * used, but then indexed by the remaining steps multiplied by the deceleration. This way the interrupt routine
+ * only needs additions, a shift and a table lookup.
+ *
+ * The interrupt also samples the sensor bar after every step. When a sensor changes (and the new level stays
+ * the same for a few steps, the contacts may bounce) the position at which it changed is stored, this is far more
+ * precise than polling the sensors from the main loop, which may be busy with the webserver for a while.
+ *
+ * The coils are switched by writing the GPIO registers directly (digitalWrite() is slow and would switch them one
+ * after the other). The set bits of every step are calculated by the compiler. GPIO0..15 are switched together with
+ * GPOC/GPOS, GPIO16 has its own register (GP16O). In the full-step modes (see Stepper.h) every timer tick moves two
+ * half-steps, which takes half the interrupts for the same speed. The sensors are then sampled every full step.
+*/
+
+#include <Arduino.h>
+#include "Stepper.h"
+
+/*--------------------------------------------*/
+#define TIMER_TICKS_PER_US  5   /*timer1 is clocked at 80MHz/16*/
+#define RAMP_TABLE_SIZE     256 /*number of entries in the table of step intervals*/
+
+#define COIL_BIT(pin)       (1UL << (pin))   /*the bit of a GPIO, GPIO16 (which has its own register) is bit 16*/
+
+/*the GPIO bits of the coils that are on in a pattern, bit 3=coil A, bit 2=coil B, bit 1=coil C, bit 0=coil D*/
+static constexpr uint32_t coil_bits(uint8_t pattern)
+{
+  return(((pattern & 0b1000) ? COIL_BIT(COIL_A) : 0) |
+         ((pattern & 0b0100) ? COIL_BIT(COIL_B) : 0) |
+         ((pattern & 0b0010) ? COIL_BIT(COIL_C) : 0) |
+         ((pattern & 0b0001) ? COIL_BIT(COIL_D) : 0));
+}
+
+static_assert((COIL_A <= 16) && (COIL_B <= 16) && (COIL_C <= 16) && (COIL_D <= 16), "the coils must be on GPIO0..16");
+static constexpr uint32_t coil_mask = coil_bits(0b1111);                  /*all coils*/
+static constexpr bool coil_gpio16 = ((coil_mask & COIL_BIT(16)) != 0);    /*a coil is on GPIO16*/
+
+/*the "half-step" coil driving pattern, the even entries have a single coil on (wave-drive), the odd entries two coils (full-step)*/
+static const uint32_t step_table[8] = {coil_bits(0b0010),   /*2*/
+                                       coil_bits(0b0110),   /*6*/
+                                       coil_bits(0b0100),   /*4*/
+                                       coil_bits(0b0101),   /*5*/
+                                       coil_bits(0b0001),   /*1*/
+                                       coil_bits(0b1001),   /*9*/
+                                       coil_bits(0b1000),   /*8*/
+                                       coil_bits(0b1010)};  /*10*/
+
+static const char * const mode_names[] = {"half", "full", "wave"};
+
+volatile unsigned long current_position = 0;         /*use for stepper motor absolute position*/
+static volatile unsigned long target_position = 0;   /*the position the interrupt routine is working towards*/
+static volatile bool running = false;                /*true when the timer is enabled and the motor is moving*/
+static volatile unsigned char coil_state = 0;        /*index in the half-step pattern*/
+static unsigned char step_mode = STEPPER_HALF;
+static unsigned int cruise_setting = 0;              /*the cruise interval (in us) that was set, 0 when the step mode decides*/
+static volatile unsigned char next_step = 1;         /*the number of half-steps the next timer tick makes*/
+static volatile unsigned long step_ticks = 0;        /*the time between two half-steps (in timer ticks) when not using the profile*/
+
+static uint16_t ramp_table[RAMP_TABLE_SIZE];         /*step interval (in timer ticks) as a function of the ramp energy*/
+static unsigned char ramp_shift = 0;                 /*ramp energy >> ramp_shift gives the index in the ramp table*/
+static unsigned long ramp_max = 0;                   /*the ramp energy at which cruise speed is reached*/
+static unsigned long decel_steps = 0;                /*the number of steps required to decelerate from cruise speed*/
+static volatile bool profile = false;                /*true when the current move uses the acceleration profile*/
+static volatile unsigned long ramp = 0;              /*accumulated ramp energy of the acceleration*/
+static volatile unsigned long ramp_used = 0;         /*the ramp energy that was used for the last step (so this represents the current speed)*/
+
+static uint32_t sensor_mask = 0;                     /*the GPIO pins (as bits) that are sampled after every step*/
+static volatile uint32_t sensor_level = 0;           /*the (debounced) level of the sensors*/
+static volatile uint32_t pending_level = 0;          /*a new level that has not been stable long enough yet*/
+static volatile unsigned long pending_position = 0;  /*the position at which the pending level appeared*/
+static volatile unsigned char pending_count = 0;
+static stepper_edgeTYPE edge_buffer[STEPPER_EDGES];  /*the sensor changes that have not been collected yet*/
+static volatile unsigned char edge_head = 0;         /*written by the interrupt*/
+static volatile unsigned char edge_tail = 0;         /*written by Stepper_edge()*/
+
+/*------------------------------------------------------------------------------------------*/
+void ICACHE_RAM_ATTR Stepper_isr(void);
+void ICACHE_RAM_ATTR Stepper_coils(uint32_t bits);
+void ICACHE_RAM_ATTR Stepper_sample(unsigned char dir);
+unsigned char ICACHE_RAM_ATTR Stepper_next(unsigned long remaining);
+void Stepper_ramp_init(unsigned int cruise_interval);
+/*------------------------------------------------------------------------------------------*/
+
+/*setup the coil pins and the timer that drives the motor*/
+void Stepper_init(void)
+{
+  pinMode(COIL_A, OUTPUT);      /*signal to stepper coildriver*/
+  pinMode(COIL_B, OUTPUT);      /*signal to stepper coildriver*/
+  pinMode(COIL_C, OUTPUT);      /*signal to stepper coildriver*/
+  pinMode(COIL_D, OUTPUT);      /*signal to stepper coildriver*/
+  Stepper_coils(0);             /*all coils off*/
+  Stepper_ramp_init(STEPPER_CRUISE_INTERVAL);
+
+  timer1_isr_init();
+  timer1_attachInterrupt(Stepper_isr);
+}
+
+/*start moving to an absolute position, this routine returns immediately, use Stepper_busy() to check if the target has been reached*/
+/*the interval is the time between two half-steps in us, or STEPPER_PROFILE to accelerate and decelerate using the profile*/
+/*a profile move should not be redirected in the opposite direction while it is running*/
+void Stepper_moveto(unsigned long target, unsigned int interval)
+{
+#ifdef DEBUG_MODE        /*for debugging purposes, it can be usefull to disable movement*/
+  current_position = target;
+  target_position = target;
+  return; /*exit immediately*/
+#endif
+
+  if(interval == STEPPER_PROFILE)
+  {
+    if((running == false) || (profile == false))
+    {
+      ramp = 0;                       /*start the ramp from the start speed*/
+      ramp_used = 0;
+    }
+    profile = true;
+    interval = STEPPER_INTERVAL_SLOW; /*the first step is done at start speed*/
+  }
+  else
+  {
+    profile = false;
+  }
+
+  step_ticks = interval * TIMER_TICKS_PER_US;
+  target_position = target;
+  if((running == false) && (target_position != current_position))
+  {
+    running = true;
+    next_step = Stepper_next(Stepper_remaining());
+    timer1_enable(TIM_DIV16, TIM_EDGE, TIM_LOOP);
+    timer1_write(step_ticks * next_step);
+  }
+  else if(profile == false)
+  {
+    timer1_write(step_ticks * next_step);         /*(re)load the timer, when already running this changes the speed of the current movement*/
+  }
+}
+
+/*start moving relative to the current position*/
+void Stepper_move(unsigned long steps, unsigned char dir, unsigned int interval)
+{
+  if(dir == UP) {Stepper_moveto(target_position + steps, interval);}
+  else          {Stepper_moveto(target_position - steps, interval);}
+}
+
+/*abort the current movement, the motor stops at the next timer tick*/
+/*during a profile move, the target is moved to the point where the motor can come to a standstill without losing steps*/
+void Stepper_stop(void)
+{
+  unsigned long cur = current_position;
+  unsigned long brake = 0;
+
+  if(profile == true)
+  {
+    brake = ramp_used / STEPPER_DECELERATION;   /*steps required to get back to start speed*/
+    if(target_position > cur) {target_position = cur + brake;}
+    else                      {target_position = cur - brake;}
+  }
+  else
+  {
+    target_position = cur;
+  }
+}
+
+/*the position counter is off by delta steps (it was checked against a sensor), the current move still ends at the intended place*/
+void Stepper_correct(long delta)
+{
+  noInterrupts();
+  current_position = current_position + delta;
+  interrupts();
+}
+
+/*sample these pins (as bits, for example (1 << 4)) after every step, the sensors are active low*/
+void Stepper_sensors(uint32_t mask)
+{
+  noInterrupts();
+  sensor_mask = mask;
+  sensor_level = GPI & mask;
+  pending_level = sensor_level;
+  edge_tail = edge_head;
+  interrupts();
+}
+
+/*get the next sensor change that was seen while moving, false when there is none*/
+bool Stepper_edge(stepper_edgeTYPE *edge)
+{
+  unsigned char tail = edge_tail;
+
+  if(tail == edge_head)
+  {
+    return(false);
+  }
+  *edge = edge_buffer[tail];
+  edge_tail = (tail + 1) % STEPPER_EDGES;
+  return(true);
+}
+
+/*true as long as the motor has not reached its target*/
+bool Stepper_busy(void)
+{
+  return(running);
+}
+
+/*the number of steps still to go*/
+unsigned long Stepper_remaining(void)
+{
+  unsigned long cur = current_position;
+  unsigned long tar = target_position;
+
+  if(tar > cur) {return(tar - cur);}
+  else          {return(cur - tar);}
+}
+
+/*(re)define the current position, this is only allowed when the motor is not moving (for example after homing)*/
+void Stepper_setposition(unsigned long position)
+{
+  if(running == false)
+  {
+    current_position = position;
+    target_position = position;
+  }
+}
+
+/*"half", "full" or "wave" (see Stepper.h), only used when the motor is not moving*/
+void Stepper_mode(const char *name)
+{
+  unsigned char i;
+  const unsigned int cruise[] = {STEPPER_CRUISE_INTERVAL, STEPPER_CRUISE_FULL, STEPPER_CRUISE_WAVE};
+
+  if(running == true)
+  {
+    return;
+  }
+  for(i=STEPPER_HALF; i<=STEPPER_WAVE; i++)
+  {
+    if(strcmp(name, mode_names[i]) == 0)
+    {
+      step_mode = i;
+    }
+  }
+  Stepper_ramp_init((cruise_setting != 0) ? cruise_setting : cruise[step_mode]);  /*the other mode may run faster (or slower)*/
+  Serial.print(F("Stepper: "));
+  Serial.print(mode_names[step_mode]);
+  Serial.print(F(", cruise "));
+  Serial.print((cruise_setting != 0) ? cruise_setting : cruise[step_mode]);
+  Serial.println(F("us"));
+}
+
+/*the cruise interval (in us per half-step) of long moves, 0 = the default of the step mode, used from the next Stepper_mode()*/
+/*the value is kept between STEPPER_CRUISE_MIN and the gentle speed*/
+void Stepper_cruise(unsigned int interval)
+{
+  if(interval == 0)
+  {
+    cruise_setting = 0;
+  }
+  else if(interval < STEPPER_CRUISE_MIN)
+  {
+    cruise_setting = STEPPER_CRUISE_MIN;
+  }
+  else if(interval > STEPPER_INTERVAL_SLOW)
+  {
+    cruise_setting = STEPPER_INTERVAL_SLOW;
+  }
+  else
+  {
+    cruise_setting = interval;
+  }
+}
+
+/*turn the motor coils off to reduce power consumption*/
+void Stepper_release(void)
+{
+  if(running == false)
+  {
+    Stepper_coils(0);
+  }
+}
+
+/*................................................................*/
+
+/*the timer interrupt, every tick the motor does a half-step (or a full step, which is two of them) towards the target*/
+void ICACHE_RAM_ATTR Stepper_isr(void)
+{
+  unsigned char step = next_step;
+  unsigned long remaining;
+
+  if(current_position == target_position)
+  {
+    timer1_disable();   /*we have arrived, nothing more to do until the next move request*/
+    running = false;
+    return;
+  }
+
+  if(target_position > current_position)
+  {
+    if(target_position - current_position < step) {step = 1;}   /*the target has been moved*/
+    current_position = current_position + step;                  /*adjust position counter*/
+    coil_state = (coil_state + step) & 0x07;
+    Stepper_coils(step_table[coil_state]);
+    Stepper_sample(UP);
+  }
+  else
+  {
+    if(current_position - target_position < step) {step = 1;}
+    current_position = current_position - step;                  /*adjust position counter*/
+    coil_state = (coil_state - step) & 0x07;
+    Stepper_coils(step_table[coil_state]);
+    Stepper_sample(DOWN);
+  }
+
+  if(target_position > current_position)  {remaining = target_position - current_position;}
+  else                                    {remaining = current_position - target_position;}
+  next_step = Stepper_next(remaining);
+
+  if(profile == false)
+  {
+    timer1_write(step_ticks * next_step);
+  }
+  else
+  {
+    unsigned long energy = ramp;                  /*the speed we are allowed to reach when accelerating*/
+
+    if(remaining < decel_steps)                   /*close to the target, limit the speed so we can still stop in time*/
+    {
+      if(remaining * STEPPER_DECELERATION < energy)
+      {
+        energy = remaining * STEPPER_DECELERATION;
+      }
+    }
+
+    ramp_used = energy;
+    energy = energy >> ramp_shift;
+    if(energy >= RAMP_TABLE_SIZE)                 /*the ramp may overshoot the end of the table by less than one acceleration step*/
+    {
+      energy = RAMP_TABLE_SIZE - 1;
+    }
+    timer1_write(ramp_table[energy] * next_step);
+
+    if(ramp < ramp_max)
+    {
+      ramp = ramp + (STEPPER_ACCELERATION * step);  /*the ramp is counted in half-steps*/
+    }
+  }
+}
+
+/*the number of half-steps of the next tick, a full step is only made when the coils are at the right pattern for the mode*/
+/*(otherwise a half-step gets them there) and when it doesn't go past the target*/
+unsigned char ICACHE_RAM_ATTR Stepper_next(unsigned long remaining)
+{
+  if((step_mode == STEPPER_FULL) && ((coil_state & 1) == 1) && (remaining >= 2)) {return(2);}
+  if((step_mode == STEPPER_WAVE) && ((coil_state & 1) == 0) && (remaining >= 2)) {return(2);}
+  return(1);
+}
+
+/*calculate the table of step intervals for the acceleration profile*/
+void Stepper_ramp_init(unsigned int cruise_interval)
+{
+  unsigned int i;
+  float v_start = 1000000.0 / STEPPER_INTERVAL_SLOW;      /*in half-steps per second*/
+  float v_cruise = 1000000.0 / cruise_interval;           /*in half-steps per second*/
+  float v;
+
+  ramp_max = (unsigned long)(((v_cruise * v_cruise) - (v_start * v_start)) / 2);   /*v^2 = v0^2 + 2*energy*/
+  ramp_shift = 0;
+  while((ramp_max >> ramp_shift) >= (RAMP_TABLE_SIZE - 1))
+  {
+    ramp_shift++;
+  }
+  decel_steps = (ramp_max / STEPPER_DECELERATION) + 1;
+
+  for(i=0; i<RAMP_TABLE_SIZE; i++)
+  {
+    v = sqrt((v_start * v_start) + (2.0 * (float)((unsigned long)i << ramp_shift)));
+    if(v > v_cruise)
+    {
+      v = v_cruise;
+    }
+    ramp_table[i] = (uint16_t)((1000000.0 * TIMER_TICKS_PER_US) / v);
+  }
+}
+
+/*check the sensors, a change is stored when the new level has been stable for STEPPER_DEBOUNCE steps*/
+void ICACHE_RAM_ATTR Stepper_sample(unsigned char dir)
+{
+  uint32_t level = GPI & sensor_mask;
+  unsigned char next;
+
+  if(level == sensor_level)
+  {
+    pending_level = level;                    /*it was a glitch (or there is no change at all)*/
+  }
+  else if(level != pending_level)
+  {
+    pending_level = level;                    /*something changed, remember where*/
+    pending_position = current_position;
+    pending_count = 0;
+  }
+  else if(++pending_count >= STEPPER_DEBOUNCE)
+  {
+    next = (edge_head + 1) % STEPPER_EDGES;
+    if(next != edge_tail)                     /*when nobody collects the changes, the newest ones are lost*/
+    {
+      edge_buffer[edge_head].position = pending_position;
+      edge_buffer[edge_head].changed = level ^ sensor_level;
+      edge_buffer[edge_head].level = level;
+      edge_buffer[edge_head].dir = dir;
+      edge_head = next;
+    }
+    sensor_level = level;
+  }
+}
+
+/*send the stepper motor coil signals to the driver, bits comes from coil_bits()*/
+void ICACHE_RAM_ATTR Stepper_coils(uint32_t bits)
+{
+  GPOC = coil_mask & ~bits & 0xFFFF;    /*only the coils change, the other outputs are left alone*/
+  GPOS = bits & 0xFFFF;
+  if(coil_gpio16 == true)               /*decided by the compiler*/
+  {
+    GP16O = (bits >> 16) & 1;
+  }
+}
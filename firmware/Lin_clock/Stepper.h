@@ -0,0 +1,67 @@
+#ifndef __STEPPER_H
+#define __STEPPER_H
+
+/*------------------------------------------*/
+
+//#define DEBUG_MODE  /*uncomment for debugging only (it disables all motor movements)*/
+
+#define COIL_A            13  /*connected to orange wire of 28BYJ-48*/
+#define COIL_B            14  /*connected to pink wire of 28BYJ-48*/
+#define COIL_C            12  /*connected to yellow wire of 28BYJ-48*/
+#define COIL_D            16  /*connected to blue wire of 28BYJ-48*/
+
+#define DOWN              0   /*direction definition for stepper motor*/
+#define UP                1   /*direction definition for stepper motor*/
+
+#define STEPPER_INTERVAL_SLOW   1000  /*time between two half-steps in us, this is the gentle speed the clock has always been using (1ms per half-step)*/
+#define STEPPER_PROFILE         0     /*use this as interval to make a long move using the acceleration profile below*/
+
+/*acceleration profile (trapezoid) for long moves, like homing and large time corrections*/
+/*the motor starts at STEPPER_INTERVAL_SLOW (which it can always do from standstill), accelerates to the cruise speed*/
+/*and decelerates back to the start speed just before arriving at the target. In half-step and wave mode the cruise*/
+/*speed is the speed the clock has always been using. In full-step mode two coils are always on, a 28BYJ-48 on 5V is*/
+/*commonly run at 1000 full steps per second with a ramp like this one, that is twice the gentle speed. How much the*/
+/*motor, the rod and the supply of a clock really allow can be set with the "cruise" setting (Stepper_cruise()), see*/
+/*host/test/stepper_profile.cpp for what a value does, the clock silently runs off when steps are lost*/
+#define STEPPER_CRUISE_INTERVAL STEPPER_INTERVAL_SLOW   /*time between two half-steps in us at full speed*/
+#define STEPPER_CRUISE_FULL     500   /*the same, in full-step mode (two coils are always on, so there is more torque)*/
+#define STEPPER_CRUISE_WAVE     STEPPER_INTERVAL_SLOW   /*the same, in wave-drive mode (a single coil is on, so there is less torque)*/
+#define STEPPER_CRUISE_MIN      250   /*the shortest cruise interval the setting accepts*/
+#define STEPPER_ACCELERATION    3000  /*in half-steps per second per second*/
+#define STEPPER_DECELERATION    3000  /*in half-steps per second per second*/
+
+/*the way the coils are driven, the position is always counted in half-steps, in the full-step modes every step is two of them*/
+enum Stepper_modes {STEPPER_HALF,   /*one and two coils on in turn, the smallest steps*/
+                    STEPPER_FULL,   /*two coils on (two-phase), the most torque and the highest speed*/
+                    STEPPER_WAVE    /*a single coil on, the least power*/
+                   };
+
+#define STEPPER_EDGES           8     /*the number of sensor changes that can be stored until they are collected*/
+#define STEPPER_DEBOUNCE        4     /*a sensor must have its new level for this number of half-steps before the change counts*/
+
+/*a change of a sensor, seen by the interrupt while moving*/
+typedef struct
+{
+  unsigned long position;   /*the position at which the sensor changed*/
+  uint16_t changed;         /*the pins (as bits) that changed*/
+  uint16_t level;           /*the new level of all sampled pins*/
+  unsigned char dir;        /*the direction of the motor (UP or DOWN)*/
+} stepper_edgeTYPE;
+
+void Stepper_init(void);                                                      /*setup the coil pins and the timer that drives the motor*/
+void Stepper_moveto(unsigned long target, unsigned int interval);            /*start moving to an absolute position, this routine returns immediately (use STEPPER_PROFILE as interval for long moves)*/
+void Stepper_move(unsigned long steps, unsigned char dir, unsigned int interval); /*start moving relative to the current position, this routine returns immediately*/
+void Stepper_stop(void);                                                      /*abort the current movement (when accelerated, the motor decelerates before it stops)*/
+bool Stepper_busy(void);                                                      /*true as long as the motor has not reached its target*/
+unsigned long Stepper_remaining(void);                                       /*the number of steps still to go*/
+void Stepper_setposition(unsigned long position);                            /*(re)define the current position (only when the motor is not moving)*/
+void Stepper_mode(const char *name);                                         /*"half", "full" or "wave", only used when the motor is not moving*/
+void Stepper_cruise(unsigned int interval);                                  /*the cruise interval (us per half-step) of long moves, 0 = the default of the step mode*/
+void Stepper_release(void);                                                   /*turn the coils off to reduce power consumption*/
+void Stepper_correct(long delta);                                            /*the position counter is off by delta steps, the current move still ends at the intended place*/
+void Stepper_sensors(uint32_t mask);                                         /*sample these pins (as bits) after every step*/
+bool Stepper_edge(stepper_edgeTYPE *edge);                                   /*get the next sensor change that was seen while moving, false when there is none*/
+
+extern volatile unsigned long current_position;   /*stepper motor absolute position, this value is maintained by the stepper interrupt*/
+
+#endif
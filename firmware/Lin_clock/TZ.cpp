@@ -0,0 +1,364 @@
+/* Timezone and daylight saving time
+ * =================================
+ * The local time is derived from UTC using a POSIX TZ rule, for example:
+ *   CET-1CEST,M3.5.0,M10.5.0/3     (central Europe)
+ *   EST5EDT,M3.2.0,M11.1.0         (US east coast)
+ *   AEST-10AEDT,M10.1.0,M4.1.0/3   (Sydney, DST during the southern summer)
+ * Mm.w.d means: month m, week w (5 is the last week), day d (0 is sunday), the optional /time is the local time of the
+ * transition (default 2:00). Jn (day 1..365, february 29 is never counted) and n (day 0..365) are also supported.
+ * Note that the sign of the offset is inverted in POSIX: CET-1 means UTC+1.
+ *
+ * The rule is parsed only once, into a table of the UTC moments at which the offset changes. Normally the only thing
+ * that needs to be done is to compare the time with the next transition, so there is no need to flip a DST switch
+ * twice a year and the clock does not spend any time on this in the main loop.
+*/
+
+#include <Arduino.h>
+#include "TZ.h"
+
+/*--------------------------------------------*/
+#define TZ_DEFAULT_TIME   (2L * 3600L)  /*transitions happen at 2:00 local time, unless specified otherwise*/
+
+typedef struct
+{
+  char type;              /*'M' for Mm.w.d, 'J' for Jn and 'D' for n*/
+  unsigned char month;    /*1-12*/
+  unsigned char week;     /*1-5, 5 is the last week of the month*/
+  unsigned char wday;     /*0-6, 0 is sunday*/
+  unsigned int day;       /*the day for the J and D format*/
+  long time;              /*local time of the transition in seconds*/
+} TZ_ruleTYPE;
+
+typedef struct
+{
+  unsigned long when;     /*UTC moment of the transition*/
+  long offset;            /*the offset (in seconds) that applies from this moment on*/
+} TZ_transitionTYPE;
+
+static bool tz_valid = false;             /*true when a rule has been parsed*/
+static long std_offset = 0;               /*offset of standard time in seconds (east of UTC is positive)*/
+static long dst_offset = 0;               /*offset of daylight saving time in seconds*/
+static bool has_dst = false;              /*false for zones without daylight saving time*/
+static TZ_ruleTYPE dst_start;
+static TZ_ruleTYPE dst_end;
+
+static TZ_transitionTYPE table[TZ_MAX_TRANSITIONS];
+static unsigned char table_count = 0;
+static unsigned long valid_from = 0;      /*the current offset is valid from this moment...*/
+static unsigned long valid_until = 0;     /*...up to this moment (the next transition)*/
+static long current_offset = 0;
+
+/*------------------------------------------------------------------------------------------*/
+const char* tz_name(const char *p);
+const char* tz_number(const char *p, long *value);
+const char* tz_time(const char *p, long *seconds);
+const char* tz_rule(const char *p, TZ_ruleTYPE *rule);
+unsigned long days_from_civil(unsigned int y, unsigned char m, unsigned char d);
+unsigned int year_from_days(unsigned long days);
+long rule_day(const TZ_ruleTYPE *rule, unsigned int year);
+void tz_add(long long when, long offset);
+void tz_build(unsigned long utc);
+/*------------------------------------------------------------------------------------------*/
+
+/*parse the POSIX TZ rule, when it is empty (or invalid) the fixed offset (in hours) and DST setting are used*/
+void TZ_init(const char *rule, float offset, bool dst)
+{
+  const char *p = rule;
+  long value;
+
+  tz_valid = false;
+  has_dst = false;
+  std_offset = (long)(offset * 3600);     /*the fixed offset, from the settings*/
+  if(dst == true)
+  {
+    std_offset = std_offset + 3600;       /*when DST is enabled, add another hour to the offset value*/
+  }
+
+  if((p != NULL) && (*p != 0))
+  {
+    p = tz_name(p);                                 /*name of standard time (like "CET")*/
+    if(p != NULL) {p = tz_time(p, &value);}         /*offset of standard time*/
+    if(p != NULL)
+    {
+      std_offset = -value;                          /*POSIX counts west of UTC as positive*/
+      tz_valid = true;
+      if(*p != 0)                                   /*there is daylight saving time*/
+      {
+        p = tz_name(p);                             /*name of daylight saving time (like "CEST")*/
+        dst_offset = std_offset + 3600;             /*by default DST is one hour ahead*/
+        if((p != NULL) && (*p != ',') && (*p != 0))
+        {
+          p = tz_time(p, &value);
+          dst_offset = -value;
+        }
+        if((p != NULL) && (*p == 0))                /*no rules specified, use the rules of the US*/
+        {
+          p = ",M3.2.0,M11.1.0";
+        }
+        if((p != NULL) && (*p == ','))  {p = tz_rule(p + 1, &dst_start);} else {p = NULL;}
+        if((p != NULL) && (*p == ','))  {p = tz_rule(p + 1, &dst_end);}   else {p = NULL;}
+        has_dst = (p != NULL);
+      }
+      if(p == NULL)
+      {
+        tz_valid = false;
+      }
+    }
+
+    if(tz_valid == false)
+    {
+      Serial.print(F("Invalid timezone rule: "));
+      Serial.println(rule);
+      std_offset = (long)(offset * 3600);
+      if(dst == true) {std_offset = std_offset + 3600;}
+      has_dst = false;
+    }
+  }
+
+  table_count = 0;
+  valid_from = 0;
+  valid_until = 0;      /*force the table to be built at the first call of TZ_offset()*/
+  current_offset = std_offset;
+}
+
+/*the offset in seconds that must be added to UTC to get the local time*/
+long TZ_offset(unsigned long utc)
+{
+  unsigned char i;
+
+  if((utc >= valid_until) || (utc < valid_from))    /*a transition has passed (or the clock has been set), look up the new offset*/
+  {
+    if(has_dst == false)
+    {
+      valid_from = 0;
+      valid_until = 0xFFFFFFFF;
+      current_offset = std_offset;
+      return(current_offset);
+    }
+
+    if((table_count == 0) || (utc < table[0].when) || (utc >= table[table_count - 1].when))
+    {
+      tz_build(utc);                                /*the table does not cover this moment*/
+      if(table_count == 0)                          /*only possible for moments near the limits of our clock (1970 or 2106)*/
+      {
+        valid_from = utc;
+        valid_until = utc + 1;
+        current_offset = std_offset;
+        return(current_offset);
+      }
+    }
+
+    for(i=1; i<table_count; i++)
+    {
+      if(utc < table[i].when)
+      {
+        break;
+      }
+    }
+    current_offset = table[i - 1].offset;
+    valid_from = table[i - 1].when;
+    valid_until = (i < table_count) ? table[i].when : 0xFFFFFFFF;
+  }
+  return(current_offset);
+}
+
+/*false when the rule could not be parsed (the fixed offset is used instead)*/
+bool TZ_valid(void)
+{
+  return(tz_valid);
+}
+
+/*................................................................*/
+
+/*build the table of transitions for the year before, during and after the given moment*/
+void tz_build(unsigned long utc)
+{
+  unsigned int year = year_from_days(utc / 86400);
+  unsigned int y;
+  unsigned char i, j;
+  TZ_transitionTYPE t;
+
+  table_count = 0;
+  for(y=year-1; y<=year+1; y++)
+  {
+    tz_add(((long long)rule_day(&dst_start, y) * 86400LL) + dst_start.time - std_offset, dst_offset);  /*the start is specified in standard time*/
+    tz_add(((long long)rule_day(&dst_end, y) * 86400LL) + dst_end.time - dst_offset, std_offset);      /*the end is specified in daylight saving time*/
+  }
+
+  for(i=1; i<table_count; i++)  /*sort the transitions (on the southern hemisphere DST ends before it starts)*/
+  {
+    for(j=i; (j>0) && (table[j].when < table[j-1].when); j--)
+    {
+      t = table[j];
+      table[j] = table[j-1];
+      table[j-1] = t;
+    }
+  }
+}
+
+/*add a transition to the table, transitions outside the range of our clock are ignored*/
+void tz_add(long long when, long offset)
+{
+  if((when >= 0) && (when <= 0xFFFFFFFFLL) && (table_count < TZ_MAX_TRANSITIONS))
+  {
+    table[table_count].when = (unsigned long)when;
+    table[table_count].offset = offset;
+    table_count++;
+  }
+}
+
+/*the day (since 1970) on which the rule applies in the given year*/
+long rule_day(const TZ_ruleTYPE *rule, unsigned int year)
+{
+  static const unsigned char mdays[] = {31,28,31,30,31,30,31,31,30,31,30,31};
+  unsigned long first = days_from_civil(year, 1, 1);
+  unsigned long days;
+  unsigned char wday;
+  unsigned char last;
+  unsigned char day;
+  bool leap = ((year % 4) == 0) && (((year % 100) != 0) || ((year % 400) == 0));
+
+  if(rule->type == 'J')                   /*Jn: 1..365, february 29 is never counted*/
+  {
+    days = first + rule->day - 1;
+    if(leap && (rule->day >= 60)) {days++;}
+    return(days);
+  }
+  if(rule->type == 'D')                   /*n: 0..365, counting february 29*/
+  {
+    return(first + rule->day);
+  }
+
+  days = days_from_civil(year, rule->month, 1);   /*Mm.w.d*/
+  wday = (days + 4) % 7;                          /*weekday of the first day of the month, 1970-01-01 was a thursday*/
+  day = 1 + ((rule->wday + 7 - wday) % 7) + ((rule->week - 1) * 7);
+  last = mdays[rule->month - 1] + (((rule->month == 2) && leap) ? 1 : 0);
+  while(day > last)                               /*week 5 means the last week of the month*/
+  {
+    day = day - 7;
+  }
+  return(days + day - 1);
+}
+
+/*days since 1970-01-01 of the given date (Howard Hinnant's "days from civil" algorithm)*/
+unsigned long days_from_civil(unsigned int y, unsigned char m, unsigned char d)
+{
+  unsigned long era, yoe, doy, doe;
+
+  if(m <= 2) {y--;}
+  era = y / 400;
+  yoe = y - (era * 400);
+  doy = ((153 * ((m > 2) ? (m - 3) : (m + 9))) + 2) / 5 + d - 1;
+  doe = (yoe * 365) + (yoe / 4) - (yoe / 100) + doy;
+  return((era * 146097) + doe - 719468);
+}
+
+/*the year the given day (since 1970) is in*/
+unsigned int year_from_days(unsigned long days)
+{
+  unsigned long z = days + 719468;
+  unsigned long era = z / 146097;
+  unsigned long doe = z - (era * 146097);
+  unsigned long yoe = (doe - (doe / 1460) + (doe / 36524) - (doe / 146096)) / 365;
+  unsigned long doy = doe - ((365 * yoe) + (yoe / 4) - (yoe / 100));
+  unsigned long mp = ((5 * doy) + 2) / 153;
+
+  return((yoe + (era * 400)) + ((mp >= 10) ? 1 : 0));
+}
+
+/*skip the name of a zone, this is either alphabetic ("CET") or quoted ("<+03>"), returns NULL when invalid*/
+const char* tz_name(const char *p)
+{
+  const char *start = p;
+
+  if(*p == '<')
+  {
+    while((*p != 0) && (*p != '>')) {p++;}
+    return((*p == '>') ? (p + 1) : NULL);
+  }
+  while(((*p >= 'a') && (*p <= 'z')) || ((*p >= 'A') && (*p <= 'Z'))) {p++;}
+  return(((p - start) >= 3) ? p : NULL);   /*POSIX requires at least 3 characters*/
+}
+
+/*read a decimal number, returns NULL when there are no digits*/
+const char* tz_number(const char *p, long *value)
+{
+  const char *start = p;
+
+  *value = 0;
+  while((*p >= '0') && (*p <= '9'))
+  {
+    *value = (*value * 10) + (*p - '0');
+    p++;
+  }
+  return((p != start) ? p : NULL);
+}
+
+/*read a time [+|-]hh[:mm[:ss]] and convert it to seconds, returns NULL when invalid*/
+const char* tz_time(const char *p, long *seconds)
+{
+  long sign = 1;
+  long value;
+
+  if(*p == '+')       {p++;}
+  else if(*p == '-')  {p++; sign = -1;}
+
+  p = tz_number(p, &value);
+  if(p == NULL) {return(NULL);}
+  *seconds = value * 3600;
+  if(*p == ':')
+  {
+    p = tz_number(p + 1, &value);
+    if(p == NULL) {return(NULL);}
+    *seconds += value * 60;
+    if(*p == ':')
+    {
+      p = tz_number(p + 1, &value);
+      if(p == NULL) {return(NULL);}
+      *seconds += value;
+    }
+  }
+  *seconds = *seconds * sign;
+  return(p);
+}
+
+/*read a transition rule (Mm.w.d, Jn or n, optionally followed by /time), returns NULL when invalid*/
+const char* tz_rule(const char *p, TZ_ruleTYPE *rule)
+{
+  long value;
+
+  rule->time = TZ_DEFAULT_TIME;
+  if(*p == 'M')
+  {
+    rule->type = 'M';
+    p = tz_number(p + 1, &value);
+    if((p == NULL) || (value < 1) || (value > 12) || (*p != '.')) {return(NULL);}
+    rule->month = value;
+    p = tz_number(p + 1, &value);
+    if((p == NULL) || (value < 1) || (value > 5) || (*p != '.')) {return(NULL);}
+    rule->week = value;
+    p = tz_number(p + 1, &value);
+    if((p == NULL) || (value > 6)) {return(NULL);}
+    rule->wday = value;
+  }
+  else if(*p == 'J')
+  {
+    rule->type = 'J';
+    p = tz_number(p + 1, &value);
+    if((p == NULL) || (value < 1) || (value > 365)) {return(NULL);}
+    rule->day = value;
+  }
+  else
+  {
+    rule->type = 'D';
+    p = tz_number(p, &value);
+    if((p == NULL) || (value > 365)) {return(NULL);}
+    rule->day = value;
+  }
+
+  if(*p == '/')
+  {
+    p = tz_time(p + 1, &rule->time);
+  }
+  return(p);
+}
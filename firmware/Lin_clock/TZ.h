@@ -0,0 +1,12 @@
+#ifndef __TZ_H
+#define __TZ_H
+
+/*------------------------------------------*/
+
+#define TZ_MAX_TRANSITIONS  6   /*the transitions of three consecutive years are kept in the table*/
+
+void TZ_init(const char *rule, float offset, bool dst);  /*parse the POSIX TZ rule (like "CET-1CEST,M3.5.0,M10.5.0/3"), when empty the fixed offset (in hours) and DST setting are used*/
+long TZ_offset(unsigned long utc);                       /*the offset in seconds that must be added to UTC to get the local time*/
+bool TZ_valid(void);                                     /*false when the rule could not be parsed (the fixed offset is used instead)*/
+
+#endif
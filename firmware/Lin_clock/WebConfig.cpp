@@ -2,6 +2,19 @@
 #include <ArduinoJson.h>  /*this can be installed using the arduino library manager, it is in the list, but not installed by default*/
 #include <FS.h>
 #include "WebConfig.h"
+#include "Metrics.h"
+#include "TZ.h"
+#include "Status.h"
+#include "Journal.h"
+#include "Sensorbar.h"
+#include "Scale.h"
+#include "Calibration.h"
+#include "Power.h"
+#include "Beacon.h"
+#include "Network.h"
+#include "Eventlog.h"
+#include "Agenda.h"
+#include "NTP.h"
 #include <ESP8266WiFi.h>
 #include <ESP8266WebServer.h>
 
@@ -9,6 +22,105 @@
 
 ESP8266WebServer server(80);
 
+/*the type of a setting, this determines how it is read from the form and the configuration file*/
+enum Setting_types {SETTING_TEXT,       /*a char array, copied as is*/
+                    SETTING_TRIMMED,    /*a char array, leading and trailing spaces are removed*/
+                    SETTING_FLOAT,
+                    SETTING_ULONG,
+                    SETTING_BOOL        /*"on" in the form, true/false in the configuration file*/
+                   };
+
+#define SETTING_SECRET  0x01    /*flag: never sent to the browser, an empty value from the form leaves it unchanged*/
+#define HEADER_ETAG     0       /*If-None-Match is the first of the collected request headers (see Webserver_init)*/
+
+/*describes a member of config_structTYPE, the same name is used in the form and in the configuration file*/
+/*the position in the table is used as id in the journal, so new settings must be added at the end*/
+typedef struct
+{
+  const char *name;
+  unsigned char type;
+  unsigned char size;       /*the size of the member (in bytes)*/
+  unsigned short offset;    /*the position of the member in config_structTYPE*/
+  unsigned char flags;
+} settingTYPE;
+
+#define SETTING(member, type)   {#member, type, sizeof(((config_structTYPE *)0)->member), offsetof(config_structTYPE, member), 0}
+#define SECRET(member, type)    {#member, type, sizeof(((config_structTYPE *)0)->member), offsetof(config_structTYPE, member), SETTING_SECRET}
+
+static const settingTYPE settings[] = {SETTING(ssid,   SETTING_TEXT),
+                                       SECRET(key,     SETTING_TEXT),
+                                       SETTING(ntp,    SETTING_TRIMMED),
+                                       SETTING(offset, SETTING_FLOAT),
+                                       SETTING(dst,    SETTING_BOOL),
+                                       SETTING(tz,     SETTING_TRIMMED),
+                                       SETTING(alarm,  SETTING_BOOL),
+                                       SETTING(chime,  SETTING_BOOL),
+                                       SETTING(steps,  SETTING_ULONG),
+                                       SETTING(power,  SETTING_BOOL),
+                                       SETTING(beacon, SETTING_TRIMMED),
+                                       SECRET(beacon_key, SETTING_TEXT),
+                                       SETTING(stepmode, SETTING_TRIMMED),
+                                       SETTING(smooth, SETTING_BOOL),
+                                       SETTING(agenda, SETTING_TRIMMED),
+                                       SETTING(cruise, SETTING_ULONG)
+                                      };
+#define SETTINGS_COUNT  (sizeof(settings) / sizeof(settings[0]))
+
+/*the file types the webserver knows, the extension determines what is sent to the browser*/
+/*the webserver only takes Strings, these are made once (before setup()) so no request has to build them*/
+static const struct
+{
+  const char *ext;
+  String type;
+} content_types[] = {{".htm",  "text/html"},
+                     {".html", "text/html"},
+                     {".css",  "text/css"},
+                     {".js",   "application/javascript"},
+                     {".json", "application/json"},
+                     {".png",  "image/png"},
+                     {".gif",  "image/gif"},
+                     {".jpg",  "image/jpeg"},
+                     {".ico",  "image/x-icon"},
+                     {".xml",  "text/xml"},
+                     {".pdf",  "application/x-pdf"},
+                     {".zip",  "application/x-zip"},
+                     {".gz",   "application/x-gzip"}
+                    };
+static const String type_plain = "text/plain";
+static const String type_download = "application/octet-stream";
+
+/*the response headers, for the same reason*/
+static const String header_etag = "ETag";
+static const String header_cache = "Cache-Control";
+static const String cache_always = "no-cache";
+static const String cache_keep = WEB_MAX_AGE;
+
+/*the files of the firmware itself, these are never sent (the configuration holds the network key, it is sent by config_send)*/
+static const char * const internal_files[] = {CONFIGFILENAME,
+                                              JOURNAL_FILENAME,
+                                              JOURNAL_TEMPNAME,
+                                              NETWORK_CACHEFILE,
+                                              NTP_DRIFTFILENAME
+                                             };
+
+static char config_text[CONFIG_SIZE_MAX + 1];   /*the configuration file is read into this buffer, the JSON parser works on it directly*/
+static char message[256];                       /*the "file not found" response*/
+
+/*a web file as listed in the manifest*/
+typedef struct
+{
+  char path[32];    /*the name as requested by the browser*/
+  String etag;      /*the hash of the contents (between quotes), a String because that is what the webserver sends*/
+  bool gz;          /*stored as path.gz*/
+} web_assetTYPE;
+
+static web_assetTYPE web_assets[WEB_ASSETS_MAX];  /*filled at boot, so we don't have to search the SPIFFS for every request*/
+static unsigned char web_asset_count = 0;
+
+static WiFiClient stream_clients[STREAM_CLIENTS];   /*the browsers that receive the status stream*/
+static unsigned long stream_version = 0;            /*the version of the status that was sent last*/
+static unsigned long stream_millis = 0;             /*when something was sent last*/
+
 /*--------------------------------------------------------------*/
 config_structTYPE cfg;  /*structure holding all the settings and variables that should be available to all callers who includes this .h file*/
 /*--------------------------------------------------------------*/
@@ -17,134 +129,53 @@ config_structTYPE cfg;  /*structure holding all the settings and variables that
 bool Config_load(void);                   /*load settings from JSON configuration file*/
 bool Config_save(void);                   /*save settings to JSON configuration file*/
 void Webserver_init(void);                /*init webserver routines*/
+void Webassets_load(void);                /*read the list of web files*/
+web_assetTYPE* Webassets_find(const char *path);
 
-void settings_send(unsigned char var);
+const settingTYPE* setting_find(const char *name);
+void setting_set(const settingTYPE *setting, const char *value);
+bool setting_store(const settingTYPE *setting, const char *value);
+void setting_print(const settingTYPE *setting);
+void setting_replay(unsigned char id, const void *data, unsigned char len);
+void config_fill(JsonObject& json, bool secrets);
+void config_send(void);
 
 void returnOK(void);
-void returnFail(String msg);
-String getContentType(String filename);
-bool handleFileRead(String path);
+void returnFail(const char *msg);
+const String& getContentType(const char *filename);
+bool handleFileRead(const char *uri);
 void handleNotFound(void);
 void redirect_to_mainmenu(void);
+void handleStatusStream(void);
+void Statusstream_process(void);
+void handleEvents(void);
+void events_write(const void *data, size_t len);
+long uri_tag(const char *uri);
 
 /*================================================================/*
 
 /*do SPIFFS.begin() before calling WebConfig_init();*/
-/*this routine will open the SPIFFS, read the JSON configuration file and connect to the specified network*/
-/*if that network can't be found then an acces point is created, so that the user can connect using his/her phone/tablet*/
-/*and fill in the correct settings, if these settings are correct, then this function will exit and normal code can*/
-/*continue, therefore no wifimanager or hardcoded settings are required. Everything is conveniently stored in the JSON file*/
+/*this routine will open the SPIFFS, read the JSON configuration file and start connecting to the specified network*/
+/*in the background (see Network.cpp), if that network can't be found then an acces point is created, so that the user*/
+/*can connect using his/her phone/tablet and fill in the correct settings. Therefore no wifimanager or hardcoded settings*/
+/*are required. Everything is conveniently stored in the JSON file*/
 /*these files are to be located along with the webserver files in the /data folder of the sketch folder*/
 void WebConfig_init(void)
 {
-  unsigned int nmbr_of_networks=0;
-  unsigned int i=0;
-  bool network_ok = false;
-  unsigned char timeout = 0;
-  char c_ssid[32];  /*working register to port the value of the SSID to the wifi network routines (which require char and not String)*/
-  char c_key[32];  /*working register to port the value of the key to the wifi network routines (which require char and not String)*/
-  String prev_ssid = "";  /*variable to keep track of a changing SSID*/
-  String prev_key = "";   /*variable to keep track of a changing KEY*/
-
   if(Config_load() == false)
   {
     ESP.restart();  /*force reset on failure*/
   } 
 
-  while(1)  /*keep looping here until we are connected to a real network*/
-  {
-    prev_ssid = cfg.ssid;
-    prev_key = cfg.key;
-    
-    Serial.println(F("scanning for networks"));   
-    WiFi.disconnect();                /*only required when the Cassiopei is reset, this is not required when the cassiopei is power-on*/
-    WiFi.persistent(false);           /*Do not memorise new wifi connections*/
-    //ESP.flashEraseSector(0x3fe); // Erase remembered connection info. (Only do this once).
-    WiFi.mode(WIFI_STA);              /*connect to an existing WiFi network (the ESP8266 will be used as a STATION)*/
-    WiFi.hostname(WIFIHOSTNAME);      /*the name of this device. This name is shown in the list of connected devices in your router*/
-    nmbr_of_networks = WiFi.scanNetworks(); /*WiFi.scanNetworks will return the number of networks found*/
-    if (nmbr_of_networks > 0)
-    {
-      for (i=0; i<nmbr_of_networks; ++i)  /*show all the found networks*/
-      {
-        Serial.print(WiFi.SSID(i));
-        Serial.print(F(" ("));
-        Serial.print(WiFi.RSSI(i));
-        Serial.print(F(" dB)"));
-        Serial.println((WiFi.encryptionType(i) == ENC_TYPE_NONE)?" ":"*");
-        delay(1); /*we could also yield*/
-      }
-
-      Serial.print(F("Searching for:"));       /*attempt to connect to preferred network*/
-      Serial.print(cfg.ssid);
-      network_ok = false;   /*unless we find something, we fail*/               
-      for (i=0;i<nmbr_of_networks;++i)
-      {
-        delay(1); /*we could also yield*/
-        if(cfg.ssid == WiFi.SSID(i))        /*compare network name with name from list, try them all until we find a match*/
-        {
-          Serial.println(F(",found"));                               /*network has been found, now try to connect*/
-          cfg.ssid.toCharArray(c_ssid, (cfg.ssid.length()+1));    /*this crazy construction is required because wifi.begin cannot accept strings ?!?!?!*/
-          cfg.key.toCharArray(c_key,(cfg.key.length()+1));        /*this crazy construction is required because wifi.begin cannot accept strings ?!?!?!*/       
-          Serial.println(F("Connecting..."));
-          WiFi.begin(c_ssid, c_key);        
-
-          network_ok = true;  /*we are almost there, unless we timeout (wifi problem or password incorrect), we are ok*/          
-          timeout = 30;       /*the timeout in seconds, if we do not succeed with the timeout limits we must accept failure and carry on*/
-          while(WiFi.status() != WL_CONNECTED)
-          {
-            delay(1000);
-            Serial.print(F("+"));
-            if(timeout-- == 0)
-            {
-              Serial.println(F("Failed to connect, check key value"));
-              cfg.status_msg = "Key is rejected";      /*update the status message*/
-              network_ok = false;            
-              break;
-            }
-          }
-        }
-      }
-
-      Serial.println(F(""));   
-      if(network_ok == true)
-      {
-        Serial.print(F("Network: "));    /*everything went fine, we are basically done here*/
-        Serial.print(WiFi.SSID());
-        Serial.print(F(", IP: "));
-        Serial.println(WiFi.localIP());
-        Serial.print(F("You may also go to: "));
-        Serial.print(WIFIHOSTNAME);
-        Serial.println(F("/"));
-        Webserver_init();                             /*initialize webserver*/    
-        return; /*exit this routine, return to "main"*/
-      }
-      else
-      {         
-        IPAddress Ip(192, 168, 1, 1);
-        IPAddress NMask(255, 255, 255, 0);
-        WiFi.softAPConfig(Ip, Ip, NMask);
-        WiFi.mode(WIFI_AP_STA);   /*could not connect to network, so we set up our own network as a means to do allows for configuration*/
-        Serial.println(WiFi.softAPIP());          
-        Webserver_init();         /*initialize webserver*/            
-        while(1)
-        {
-          Webserver_process();    /*keep serving the page as it is the only thing it can do, hoping that the user will modify the settings here so we can continue*/            
-          if((prev_ssid != cfg.ssid) || (prev_key != cfg.key)) /*check if SSID and/or KEY settings have changed, if so then repeat the cycle, perhaps settings are correct now*/
-          {
-            Serial.println(F("Settings have changed, try again"));
-            break;  /*try again but now with the new settings*/
-          }
-        }
-      }
-    }
-  }
+  Network_init();     /*returns immediately, Network_process() does the connecting*/
+  Webserver_init();   /*initialize webserver, it listens on every address we get (also the one of the access point)*/
 }
 
 /*load settings from JSON configuration file*/
 bool Config_load(void)
 { 
-  String str=""; /*a tempstorage space for converion purposes*/
+  unsigned char i;
+  const char *value;
   
   File configFile = SPIFFS.open(CONFIGFILENAME, "r"); 
   if (!configFile)
@@ -155,17 +186,18 @@ bool Config_load(void)
   }
 
   size_t size = configFile.size();
-  if (size > 1024)
+  if (size > CONFIG_SIZE_MAX)
   {
     Serial.println(F("Config file size is too large"));
     return false;
   }
 
-  std::unique_ptr<char[]> buf(new char[size]);  /*Allocate a buffer to store contents of the file.*/
-  configFile.readBytes(buf.get(), size);        /*We don't use String here because ArduinoJson library requires the input buffer to be mutable.*/
+  configFile.readBytes(config_text, size);      /*the ArduinoJson library requires the input buffer to be mutable, it is parsed in place*/
+  config_text[size] = 0;
+  configFile.close();
 
-  StaticJsonBuffer<200> jsonBuffer;
-  JsonObject& json = jsonBuffer.parseObject(buf.get());
+  StaticJsonBuffer<400> jsonBuffer;
+  JsonObject& json = jsonBuffer.parseObject(config_text);
 
   if (!json.success())
   {
@@ -175,22 +207,31 @@ bool Config_load(void)
 
   Serial.println(F("Loading settings"));
   /*copy all values from the JSON file into the proper variables*/
-  cfg.ssid = json["ssid"].asString();   /*the .asString() is required to convert the type of the json library (which is const char*) to a regular String type*/
-  cfg.key = json["key"].asString();     /*the .asString() is required to convert the type of the json library (which is const char*) to a regular String type*/
-  cfg.ntp = json["ntp"].asString();     /*the .asString() is required to convert the type of the json library (which is const char*) to a regular String type*/
-  str = json["offset"].asString();      /*the .asString() is required to convert the type of the json library (which is const char*) to a regular String type*/
-  cfg.offset = str.toFloat();           /*convert the String to a real value we can store in an float*/
-  if(json["dst"] == true)    {cfg.dst = true;}     else {cfg.dst = false;}
-  if(json["alarm"] == true)  {cfg.alarm = true;}   else {cfg.alarm = false;}
-  if(json["chime"] == true)  {cfg.chime = true;}   else {cfg.chime = false;}
+  for(i=0; i<SETTINGS_COUNT; i++)
+  {
+    if(json.containsKey(settings[i].name) == false)   /*older configuration files do not have all settings, keep the default*/
+    {
+      continue;
+    }
+    switch(settings[i].type)
+    {
+      case SETTING_FLOAT: {*(float *)((char *)&cfg + settings[i].offset) = json[settings[i].name].as<float>(); break;}
+      case SETTING_ULONG: {*(unsigned long *)((char *)&cfg + settings[i].offset) = json[settings[i].name].as<unsigned long>(); break;}
+      case SETTING_BOOL:  {*(bool *)((char *)&cfg + settings[i].offset) = json[settings[i].name].as<bool>();   break;}
+      default:
+      {
+        value = json[settings[i].name].as<const char*>();
+        setting_set(&settings[i], (value != NULL) ? value : "");
+        break;
+      }
+    }
+  }
+  Journal_replay(setting_replay);        /*the changes that were made after the file was written*/
+  TZ_init(cfg.tz, cfg.offset, cfg.dst);  /*the timezone rule is parsed only once, not every time the time is needed*/
+  Agenda_init(cfg.agenda);               /*the same goes for the alarm and chime rules*/
+  Scale_init(cfg.steps);                 /*the steps per minute of this clock*/
  
-//  Serial.println(cfg.ssid);
-//  Serial.println(cfg.key);
-//  Serial.println(cfg.ntp);
-//  Serial.println(cfg.offset);
-//  Serial.println(cfg.dst);    Serial.print(F(" stringvalue "));  str = json["dst"].asString();   Serial.println(str);
-//  Serial.println(cfg.alarm);  Serial.print(F(" stringvalue "));  str = json["alarm"].asString(); Serial.println(str);  
-//  Serial.println(cfg.chime);  Serial.print(F(" stringvalue "));  str = json["chime"].asString(); Serial.println(str);
+//  for(i=0; i<SETTINGS_COUNT; i++) {setting_print(&settings[i]);}
 
   return true;
 }
@@ -198,16 +239,10 @@ bool Config_load(void)
 /*save settings to JSON configuration file*/
 bool Config_save(void)
 {
-  StaticJsonBuffer<200> jsonBuffer;
+  StaticJsonBuffer<400> jsonBuffer;   /*only pointers to the settings are stored, the strings are not copied*/
   JsonObject& json = jsonBuffer.createObject();
  
-  json["ssid"] = cfg.ssid;
-  json["key"] = cfg.key;
-  json["ntp"] = cfg.ntp;
-  json["offset"] = (float) cfg.offset;
-  json["dst"] = (bool) cfg.dst;
-  json["alarm"] = (bool) cfg.alarm;
-  json["chime"] = (bool) cfg.chime;
+  config_fill(json, true);
   File configFile = SPIFFS.open(CONFIGFILENAME, "w");
   if (!configFile)
   {
@@ -216,99 +251,442 @@ bool Config_save(void)
   }
 
   json.printTo(configFile);
+  configFile.close();
   Serial.println(F("Data has been written to file"));
   return true;
 }
 
+/*the current settings, as they would be written to the configuration file (the file itself may be older, see the journal), without the secrets*/
+void config_send(void)
+{
+  StaticJsonBuffer<400> jsonBuffer;
+  JsonObject& json = jsonBuffer.createObject();
+
+  Power_activity();   /*somebody opened the settings page*/
+  config_fill(json, false);
+  json.printTo(config_text, sizeof(config_text));
+  server.sendHeader(header_cache, cache_always);
+  server.send(200, "application/json", config_text);
+}
+
+/*put all settings in a JSON object, the secret ones only when secrets is true*/
+void config_fill(JsonObject& json, bool secrets)
+{
+  unsigned char i;
+
+  for(i=0; i<SETTINGS_COUNT; i++)
+  {
+    if(((settings[i].flags & SETTING_SECRET) != 0) && (secrets == false))
+    {
+      continue;
+    }
+    switch(settings[i].type)
+    {
+      case SETTING_FLOAT: {json[settings[i].name] = *(float *)((char *)&cfg + settings[i].offset); break;}
+      case SETTING_ULONG: {json[settings[i].name] = *(unsigned long *)((char *)&cfg + settings[i].offset); break;}
+      case SETTING_BOOL:  {json[settings[i].name] = *(bool *)((char *)&cfg + settings[i].offset);  break;}
+      default:            {json[settings[i].name] = (const char *)((char *)&cfg + settings[i].offset); break;}
+    }
+  }
+}
+
+/*a setting from the journal, copy it into place (when it still fits)*/
+void setting_replay(unsigned char id, const void *data, unsigned char len)
+{
+  char *p;
+
+  if((id >= SETTINGS_COUNT) || (len > settings[id].size) || (len == 0))
+  {
+    return;
+  }
+  p = (char *)&cfg + settings[id].offset;
+  memcpy(p, data, len);
+  if((settings[id].type == SETTING_TEXT) || (settings[id].type == SETTING_TRIMMED))
+  {
+    p[len - 1] = 0;   /*strings are stored including the terminating 0, but make sure*/
+  }
+}
+
+/*find a setting by its name, returns NULL when there is no such setting*/
+const settingTYPE* setting_find(const char *name)
+{
+  unsigned char i;
+
+  for(i=0; i<SETTINGS_COUNT; i++)
+  {
+    if(strcmp(settings[i].name, name) == 0)
+    {
+      return(&settings[i]);
+    }
+  }
+  return(NULL);
+}
+
+/*change a setting, the value is text (as it comes from the form)*/
+void setting_set(const settingTYPE *setting, const char *value)
+{
+  char *p = (char *)&cfg + setting->offset;
+  size_t len;
+
+  switch(setting->type)
+  {
+    case SETTING_FLOAT: {*(float *)p = atof(value);               break;}
+    case SETTING_ULONG: {*(unsigned long *)p = strtoul(value, NULL, 10); break;}
+    case SETTING_BOOL:  {*(bool *)p = (strcmp(value, "on") == 0); break;}
+    case SETTING_TRIMMED:
+    {
+      while(*value == ' ') {value++;}
+      strlcpy(p, value, setting->size);
+      len = strlen(p);
+      while((len > 0) && (p[len - 1] == ' ')) {p[--len] = 0;}
+      break;
+    }
+    default:            {strlcpy(p, value, setting->size);        break;}
+  }
+}
+
+/*change a setting and store it in the journal when it has changed, false when the journal could not be written*/
+bool setting_store(const settingTYPE *setting, const char *value)
+{
+  char previous[JOURNAL_DATA_MAX];  /*the value before the change*/
+  char *p = (char *)&cfg + setting->offset;
+  size_t len;
+  bool stored;
+
+  memcpy(previous, p, setting->size);
+  setting_set(setting, value);
+  if(memcmp(previous, p, setting->size) == 0)   /*only the changes are stored in the journal*/
+  {
+    return(true);
+  }
+  len = ((setting->type == SETTING_TEXT) || (setting->type == SETTING_TRIMMED)) ? (strlen(p) + 1) : setting->size;
+  stored = Journal_setting(setting - settings, p, len);
+  Eventlog_add(EVENT_SETTING, setting - settings, stored);
+  return(stored);
+}
+
+/*change a setting (the value is text, as it comes from the form) and store it in the journal*/
+bool Config_set(const char *name, const char *value)
+{
+  const settingTYPE *setting = setting_find(name);
+
+  if(setting == NULL)
+  {
+    return(false);
+  }
+  if(setting_store(setting, value) == false)
+  {
+    return(Config_save());  /*the journal could not be written, save the new value to the JSON file instead*/
+  }
+  return(true);
+}
+
+/*print the name and value of a setting to the serial port*/
+void setting_print(const settingTYPE *setting)
+{
+  char *p = (char *)&cfg + setting->offset;
+
+  Serial.print(F("cfg."));
+  Serial.print(setting->name);
+  Serial.print(F("="));
+  switch(setting->type)
+  {
+    case SETTING_FLOAT: {Serial.println(*(float *)p); break;}
+    case SETTING_ULONG: {Serial.println(*(unsigned long *)p); break;}
+    case SETTING_BOOL:  {Serial.println(*(bool *)p);  break;}
+    default:            {Serial.println(p);           break;}
+  }
+}
+
 /*----------------------------------------------------------------*/
 
 /*when not specified, the browser may have send a submit or wants to download a file from the spiffs*/
 void handleNotFound(void)
 {
-//  const char* temp[32];
+  const char *uri = server.uri().c_str();   /*the strings of the request are kept by the webserver, they are used as they are*/
+  const settingTYPE *setting;
+  bool journal_ok = true;
+  size_t len;
+  uint8_t i;
+
+  Power_activity();   /*a browser is using the webpages, respond quickly for a while*/
+
   /*this routine will process the values that are send by the connected browswer when a user presses a submitbutton on the form*/
   if (server.args() > 0 )
   {
-    Serial.println(F("Handling submit:"));    
-    for ( uint8_t i = 0; i < server.args(); i++ )
+    for (i = 0; i < server.args(); i++ )
     {
-      Serial.print(server.argName(i));
-      Serial.print(F("="));
-      Serial.println(server.arg(i));      
-
-      /*copy the received arguments into the corresponding variables*/
-      if (server.argName(i) == "ssid")        {cfg.ssid=server.arg(i);}
-      else if (server.argName(i) == "key")    {cfg.key=server.arg(i);}
-      else if (server.argName(i) == "ntp")    {cfg.ntp=server.arg(i);}
-      else if (server.argName(i) == "offset") {cfg.offset=server.arg(i).toFloat();}
-      else if (server.argName(i) == "dst")    {if(server.arg(i)=="on") {cfg.dst=true;} else {cfg.dst=false;}}
-      else if (server.argName(i) == "alarm")  {if(server.arg(i)=="on") {cfg.alarm=true;} else {cfg.alarm=false;}}
-      else if (server.argName(i) == "chime")  {if(server.arg(i)=="on") {cfg.chime=true;} else {cfg.chime=false;}}
+      setting = setting_find(server.argName(i).c_str());  /*copy the received arguments into the corresponding variables*/
+      if((setting != NULL) && (((setting->flags & SETTING_SECRET) == 0) || (server.arg(i).length() > 0)))  /*the form doesn't know the secrets, empty means unchanged*/
+      {
+        journal_ok = setting_store(setting, server.arg(i).c_str()) && journal_ok;
+      }
     }
 
-    Serial.println(F("The data after processing:"));
-    Serial.print(F("cfg.ssid  ="));  Serial.println(cfg.ssid);
-    Serial.print(F("cfg.key   ="));  Serial.println(cfg.key);
-    Serial.print(F("cfg.ntp   ="));  Serial.println(cfg.ntp);
-    Serial.print(F("cfg.offset="));  Serial.println(cfg.offset);
-    Serial.print(F("cfg.dst   ="));  Serial.println(cfg.dst);
-    Serial.print(F("cfg.alarm ="));  Serial.println(cfg.alarm);
-    Serial.print(F("cfg.chime ="));  Serial.println(cfg.chime); 
-    
-    Config_save();  /*save these new values to the JSON file*/
+    TZ_init(cfg.tz, cfg.offset, cfg.dst);  /*the timezone settings may have changed*/
+    Agenda_init(cfg.agenda);               /*and the alarm and chime rules*/
+    if(journal_ok == false)
+    {
+      Config_save();  /*the journal could not be written, save these new values to the JSON file instead*/
+    }
     redirect_to_mainmenu();
+    Eventlog_add(EVENT_HTTP, 302, uri_tag(uri));   /*the changed settings have their own events*/
+  }
+  else if(handleFileRead(uri) == true) /*check if the file is in the filesystem, if not then respond with the error message below*/
+  {
+    Eventlog_add(EVENT_HTTP, 200, uri_tag(uri));
   }
-  else if(!handleFileRead(server.uri())) /*check if the file is in the filesystem, if not then respond with the error message below*/
-  {
-    Serial.println(F("handling file request"));        
-    String message = "Request file not found\n\n";
-    message += "URI: ";
-    message += server.uri();
-    message += "\nMethod: ";
-    message += (server.method() == HTTP_GET)?"GET":"POST";
-    message += "\nArguments: ";
-    message += server.args();
-    message += "\n";
-    for (uint8_t i=0; i<server.args(); i++)
+  else
+  {
+    len = snprintf(message, sizeof(message), "Request file not found\n\nURI: %s\nMethod: %s\nArguments: %d\n", uri, (server.method() == HTTP_GET)?"GET":"POST", server.args());
+    for (i=0; (i<server.args()) && (len<sizeof(message)); i++)
     {
-      message += " NAME:"+server.argName(i) + "\n VALUE:" + server.arg(i) + "\n";
+      len += snprintf(message + len, sizeof(message) - len, " NAME:%s\n VALUE:%s\n", server.argName(i).c_str(), server.arg(i).c_str());
     }
     server.send(404, "text/plain", message);
-    Serial.print(message);
+    Eventlog_add(EVENT_HTTP, 404, uri_tag(uri));
   }
 }
 
 
-bool handleFileRead(String path)
+/*send a file from the SPIFFS, files from the manifest are sent with an ETag, so the browser only downloads them when they have changed*/
+bool handleFileRead(const char *uri)
 {
-  //Serial.println(F("handleFileRead: " + path));
-  if(path.endsWith("/"))
+  static char path[40];   /*the name of the file in the SPIFFS*/
+  size_t len;
+
+  //Serial.print(F("handleFileRead: ")); Serial.println(uri);
+  if(strlcpy(path, uri, sizeof(path) - 3) >= (sizeof(path) - 3))   /*keep room for the .gz extension*/
   {
-    path += "index.htm";
+    return false;   /*such a long name can't be in the SPIFFS, a shortened name might be (and is not what was asked for)*/
+  }
+  len = strlen(path);
+  if((len > 0) && (path[len - 1] == '/'))
+  {
+    if(strlcat(path, "index.htm", sizeof(path) - 3) >= (sizeof(path) - 3))
+    {
+      return false;
+    }
   }
   
-  String contentType = getContentType(path);
-  String pathWithGz = path + ".gz";
-  if(SPIFFS.exists(pathWithGz) || SPIFFS.exists(path))
+  for(len=0; len<(sizeof(internal_files) / sizeof(internal_files[0])); len++)
   {
-    if(SPIFFS.exists(pathWithGz))
+    if(strcmp(path, internal_files[len]) == 0)
     {
-      path += ".gz";
+      return false;   /*answered as if it doesn't exist*/
     }
-    File file = SPIFFS.open(path, "r");
-    size_t sent = server.streamFile(file, contentType);
+  }
+
+  const String &contentType = getContentType(path);
+  web_assetTYPE *asset = Webassets_find(path);
+  File file;
+
+  if(asset != NULL)   /*a file from the manifest, its hash is known*/
+  {
+    if(server.header(HEADER_ETAG) == asset->etag)   /*the browser already has this version, no need to read the flash*/
+    {
+      server.sendHeader(header_etag, asset->etag);
+      server.send(304, "text/plain", "");
+      return true;
+    }
+
+    if(asset->gz == true)
+    {
+      strcat(path, ".gz");
+    }
+    file = SPIFFS.open(path, "r");
+    if(!file)
+    {
+      return false;
+    }
+    server.sendHeader(header_etag, asset->etag);
+    server.sendHeader(header_cache, (contentType == "text/html") ? cache_always : cache_keep);  /*the pages must always be checked (this costs only a 304), the rest is kept by the browser*/
+    server.streamFile(file, contentType);
     file.close();
     return true;
   }
-  return false;
+
+  /*not in the manifest (like the configuration file), so it may change at any time*/
+  len = strlen(path);
+  strcat(path, ".gz");
+  file = SPIFFS.open(path, "r");
+  if(!file)
+  {
+    path[len] = 0;
+    file = SPIFFS.open(path, "r");
+  }
+  if(!file)
+  {
+    return false;
+  }
+  server.sendHeader(header_cache, cache_always);
+  server.streamFile(file, contentType);
+  file.close();
+  return true;
+}
+
+/*read the list of web files (made by tools/web_gzip.py) into the table*/
+void Webassets_load(void)
+{
+  unsigned char i;
+
+  web_asset_count = 0;
+  File f = SPIFFS.open(WEBASSETSFILE, "r");
+  if(!f)
+  {
+    Serial.println(F("No web manifest, files are served without caching"));
+    return;
+  }
+
+  size_t size = f.size();
+  std::unique_ptr<char[]> buf(new char[size + 1]);  /*the ArduinoJson library requires the input buffer to be mutable*/
+  f.readBytes(buf.get(), size);
+  buf[size] = 0;
+  f.close();
+
+  DynamicJsonBuffer jsonBuffer;       /*only required during boot, so don't keep it on the stack or in static memory*/
+  JsonArray& json = jsonBuffer.parseArray(buf.get());
+  if(!json.success())
+  {
+    Serial.println(F("Failed to parse web manifest"));
+    return;
+  }
+
+  for(i=0; (i<json.size()) && (web_asset_count<WEB_ASSETS_MAX); i++)
+  {
+    JsonObject& entry = json[i].asObject();
+    const char *path = entry["path"];
+    const char *etag = entry["etag"];
+    if((path == NULL) || (etag == NULL) || (strlen(path) >= sizeof(web_assets[0].path)))
+    {
+      continue;
+    }
+    strcpy(web_assets[web_asset_count].path, path);
+    web_assets[web_asset_count].etag = "\"";     /*a strong ETag is a quoted string*/
+    web_assets[web_asset_count].etag += etag;
+    web_assets[web_asset_count].etag += "\"";
+    web_assets[web_asset_count].gz = entry["gz"];
+    web_asset_count++;
+  }
+  Serial.print(F("Web files: "));
+  Serial.println(web_asset_count);
+}
+
+/*find a file in the table, returns NULL when it isn't there*/
+web_assetTYPE* Webassets_find(const char *path)
+{
+  unsigned char i;
+
+  for(i=0; i<web_asset_count; i++)
+  {
+    if(strcmp(web_assets[i].path, path) == 0)
+    {
+      return(&web_assets[i]);
+    }
+  }
+  return(NULL);
+}
+
+/*send the event log (binary)*/
+void handleEvents(void)
+{
+  server.setContentLength(Eventlog_size());
+  server.send(200, "application/octet-stream", "");
+  Eventlog_dump(events_write);
+}
+
+/*one part of the event log*/
+void events_write(const void *data, size_t len)
+{
+  server.sendContent((const char *)data, len);
+}
+
+/*the first 4 characters of the URI (after the /) as a number, so an event can show which page was requested*/
+long uri_tag(const char *uri)
+{
+  unsigned long tag = 0;
+  unsigned char i;
+
+  if(*uri == '/')
+  {
+    uri++;
+  }
+  for(i=0; (i<4) && (uri[i] != 0); i++)
+  {
+    tag = tag | ((unsigned long)(uint8_t)uri[i] << (8 * i));
+  }
+  return((long)tag);
+}
+
+/*a browser wants to receive the status (Server-Sent Events), the connection is kept open and an update is sent when the status changes*/
+void handleStatusStream(void)
+{
+  unsigned char i;
+
+  for(i=0; i<STREAM_CLIENTS; i++)
+  {
+    if(!stream_clients[i].connected())  /*a free place*/
+    {
+      break;
+    }
+  }
+
+  if(i == STREAM_CLIENTS)
+  {
+    server.send(503, "text/plain", "Too many listeners");  /*the browser will fall back to polling*/
+    return;
+  }
+
+  stream_clients[i] = server.client();  /*keep the connection, the webserver lets go of it when we don't send a response*/
+  stream_clients[i].setNoDelay(true);
+  stream_clients[i].print(F("HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\nConnection: keep-alive\r\n\r\nretry: 5000\n"));
+  stream_clients[i].print(F("data: "));   /*the new listener must know the current status*/
+  stream_clients[i].print(Status_text());
+  stream_clients[i].print(F("\n\n"));
+}
+
+/*send the status to all listening browsers, but only when it has changed*/
+void Statusstream_process(void)
+{
+  unsigned char i;
+  unsigned long version = Status_version();
+  const char *text = NULL;
+
+  if((version == stream_version) && ((millis() - stream_millis) < STREAM_KEEPALIVE))
+  {
+    return;
+  }
+
+  for(i=0; i<STREAM_CLIENTS; i++)
+  {
+    if(stream_clients[i].connected())
+    {
+      Power_activity();   /*the page is open, the updates must not be delayed*/
+      if(version != stream_version)
+      {
+        if(text == NULL)
+        {
+          text = Status_text();   /*only made when there is somebody to send it to*/
+        }
+        stream_clients[i].print(F("data: "));
+        stream_clients[i].print(text);
+        stream_clients[i].print(F("\n\n"));
+      }
+      else
+      {
+        stream_clients[i].print(F(":\n\n"));  /*a comment, ignored by the browser, when it fails the browser is gone and the place is freed*/
+      }
+    }
+  }
+  stream_version = version;
+  stream_millis = millis();
 }
 
 /*A simple redirecting HTML page, required to force the user to go to the correct URL*/
 /*This makes it possible for the user to enter only the IP-address in the browser to go to the main menu*/
 void redirect_to_mainmenu(void)
 {
-  String message = page_redirect2mainmenu;
-  server.send(200, "text/html", message);  
+  server.send_P(200, "text/html", page_redirect2mainmenu);  
 }
 
 void returnOK(void)
@@ -316,36 +694,52 @@ void returnOK(void)
   server.send(200, "text/plain", "");
 }
 
-void returnFail(String msg)
+void returnFail(const char *msg)
 {
-  server.send(500, "text/plain", msg + "\r\n");
+  server.send(500, "text/plain", msg);
 }
 
-String getContentType(String filename)
+/*the content type follows from the extension of the file*/
+const String& getContentType(const char *filename)
 {
-  if(server.hasArg("download")) return "application/octet-stream";
-  else if(filename.endsWith(".htm")) return "text/html";
-  else if(filename.endsWith(".html")) return "text/html";
-  else if(filename.endsWith(".css")) return "text/css";
-  else if(filename.endsWith(".js")) return "application/javascript";
-  else if(filename.endsWith(".png")) return "image/png";
-  else if(filename.endsWith(".gif")) return "image/gif";
-  else if(filename.endsWith(".jpg")) return "image/jpeg";
-  else if(filename.endsWith(".ico")) return "image/x-icon";
-  else if(filename.endsWith(".xml")) return "text/xml";
-  else if(filename.endsWith(".pdf")) return "application/x-pdf";
-  else if(filename.endsWith(".zip")) return "application/x-zip";
-  else if(filename.endsWith(".gz")) return "application/x-gzip";
-  return "text/plain";
+  size_t len = strlen(filename);
+  size_t ext;
+  unsigned char i;
+
+  for(i=0; i<server.args(); i++)    /*hasArg() would turn the name into a String first*/
+  {
+    if(strcmp(server.argName(i).c_str(), "download") == 0) return type_download;
+  }
+  for(i=0; i<(sizeof(content_types) / sizeof(content_types[0])); i++)
+  {
+    ext = strlen(content_types[i].ext);
+    if((len >= ext) && (strcmp(filename + len - ext, content_types[i].ext) == 0))
+    {
+      return(content_types[i].type);
+    }
+  }
+  return(type_plain);
 }
 
 /*initialize the webserver*/
 void Webserver_init(void)
 {
+  static const char *headerkeys[] = {"If-None-Match"};   /*the webserver only keeps the request headers we ask for, see HEADER_ETAG*/
+
   Serial.println(F("Initializing webserver"));
+  Webassets_load();
+  server.collectHeaders(headerkeys, 1);
   server.on("/", HTTP_GET, redirect_to_mainmenu);
   server.on("/btn_MAINMENU", HTTP_GET, redirect_to_mainmenu);   /*used by filemanager only*/
-  server.on("/status_message.txt", []() {server.send(200, "text/plain", cfg.status_msg);});   
+  server.on("/config.json", HTTP_GET, config_send);   /*made from the settings in memory, the file in the SPIFFS doesn't contain the changes in the journal*/
+  server.on("/status_message.txt", []() {server.send(200, "text/plain", Status_text());});   /*for browsers that can't handle the status stream*/
+  server.on("/status_stream", HTTP_GET, handleStatusStream);   /*the status is pushed to the browser when it changes*/
+  server.on("/metrics", []() {server.send(200, "text/plain", Metrics_text());});   /*timing and memory statistics*/
+  server.on("/sensorbar", []() {server.send(200, "text/plain", Sensorbar_text());});  /*the learned sensor edges and the position corrections*/
+  server.on("/calibrate", []() {Calibration_request(); redirect_to_mainmenu();});   /*measure the steps per minute, the status message shows the progress*/
+  server.on("/power", []() {server.send(200, "text/plain", Power_text());});         /*the time spent in every power state and the estimated current*/
+  server.on("/beacon", []() {server.send(200, "text/plain", Beacon_text());});       /*the time beacons that were sent or received*/
+  server.on("/events", HTTP_GET, handleEvents);     /*the last events in binary, use tools/event_log.py to read them*/
 
 //  server.on("/btn_dosomething", []() {message= "Timezone="; message+=var_timezone; server.send(200, "text/plain", message);});                                     
 
@@ -360,8 +754,9 @@ void Webserver_init(void)
 /*just process all incoming/outgoing webserver related actions*/
 void Webserver_process(void)
 {
-  Serial.print(F("Free=")); /*show available RAM*/
-  Serial.println(ESP.getFreeHeap()); /*show available RAM*/            
+  unsigned long start_micros = micros();
   server.handleClient();  /*Handle incoming connections*/
+  Statusstream_process(); /*send the status to the browsers that are listening*/
+  Metrics_record(METRIC_HTTP, micros() - start_micros);  /*the free heap and response times can be found on the /metrics page*/
 }
-
+
@@ -3,23 +3,38 @@
 
 
 #define CONFIGFILENAME  "/config.json"    /*this is the name of the configuration file where all settings are stored*/
+#define CONFIG_SIZE_MAX 768               /*the largest configuration file we accept (it is read into a static buffer)*/
 #define WIFIHOSTNAME    "linear-clock"    /*the name of this device. This name is shown in the list of connected devices in your router*/
+#define WEBASSETSFILE   "/web.json"       /*the list of web files with their hashes, made by tools/web_gzip.py*/
+#define WEB_ASSETS_MAX  12                /*the maximum number of files in that list*/
+#define WEB_MAX_AGE     "max-age=604800"  /*the browser may keep scripts, stylesheets and images for a week without asking*/
+#define STREAM_CLIENTS  2                 /*the number of browsers that can receive the status stream at the same time*/
+#define STREAM_KEEPALIVE 30000            /*when nothing changes, send something every ... ms to find out if the browser is still there*/
 
 void WebConfig_init(void);                /*do SPIFFS.begin() before calling WebConfig_init(); This routine will allow for configuration of ALL settings even the SSID and KEY values of the home network*/
 void Webserver_process(void);             /*handle the webserver*/
+bool Config_set(const char *name, const char *value);  /*change a setting (the value is text, as it comes from the form) and store it in the journal*/
 
 
 /*a simple struct to hold all settings*/
 typedef struct
 {
-  String status_msg = "n.a.";       /*this is not a setting but a holder for the status message*/
-  String ssid = "enter_SSID_here";  /*default value should be entered here (must be const char* otherwise it will not work with json related code)*/
-  String key = "enter_KEY_here";    /*default value should be entered here (must be const char* otherwise it will not work with json related code)*/
-  String ntp = "time.nist.gov";     /*default value should be entered here (must be const char* otherwise it will not work with json related code)*/
+  char ssid[33] = "enter_SSID_here";  /*default value should be entered here (an SSID is at most 32 characters)*/
+  char key[65] = "enter_KEY_here";    /*default value should be entered here (a WPA key is at most 64 characters)*/
+  char ntp[96] = "pool.ntp.org,time.nist.gov";  /*one or more servers (separated by a comma), default value should be entered here*/
   float offset = 0;                 /*default value should be entered here*/
   bool dst = false;                 /*default value should be entered here*/
+  char tz[48] = "";                 /*POSIX timezone rule (like "CET-1CEST,M3.5.0,M10.5.0/3"), when empty the offset and dst values above are used*/
   bool alarm = true;                /*default value should be entered here*/
   bool chime = true;                /*default value should be entered here*/
+  unsigned long steps = 4076UL << 16; /*steps per minute (16.16 fixed point), measured by the calibration (/calibrate), a change is used after a reset*/
+  bool power = false;               /*use light sleep between the minutes (see Power.cpp)*/
+  char beacon[10] = "off";          /*"off", "master" (send the time to the other clocks) or "follower" (get the time from the master), a change is used after a reset*/
+  char beacon_key[17] = "";         /*the secret that is shared by all clocks on the LAN, the beacons are signed with it*/
+  char stepmode[6] = "half";        /*the way the motor is driven: "half", "full" (more torque, faster) or "wave" (see Stepper.h), a change is used after a reset*/
+  bool smooth = false;              /*move the indicator continuously (a few steps at a time) instead of once a minute*/
+  char agenda[128] = "chime * *:00 hours; chime * *:15,30,45 quarter";  /*the alarm, chime and quiet rules, separated by a ';' (see Agenda.cpp)*/
+  unsigned long cruise = 0;         /*us per half-step of long moves (homing, large corrections), 0 = the default of the step mode (see Stepper.h), a change is used after a reset*/
 } config_structTYPE;
 
 extern config_structTYPE cfg;  /*structure holding all the settings that should be available to all callers who includes this .h file*/
@@ -45,4 +60,4 @@ const char page_redirect2mainmenu[] PROGMEM = R"=====(
 )=====";
 
 
-#endif
+#endif
@@ -0,0 +1,640 @@
+/* Arduino core (host)
+ * ===================
+ * Virtual time, timer1, the GPIO registers, the serial port and the ESP class.
+ *
+ * Everything is counted in cycles of the 80MHz CPU clock. Time only moves forward when the sketch waits
+ * (delay(), yield()), at that moment the timer interrupt is called for every tick that falls in the wait,
+ * at exactly the moment it is due. This way a day of clock time runs in a few seconds and every run is the
+ * same. After every change of the outputs the model of the mechanics is told about it.
+ *
+ * malloc() is counted while a request is handled (see WebServer.cpp), the work of the core itself (the webserver
+ * and the SPIFFS) is not counted. String keeps up to 11 characters in the object itself and longer ones on the
+ * heap, like the String of the ESP8266 core does.
+*/
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include "Hal.h"
+
+/*--------------------------------------------*/
+static unsigned long long now_cycles = 0;     /*the virtual time*/
+static timercallback timer_isr = NULL;
+static bool timer_enabled = false;
+static bool timer_reload = false;
+static unsigned char timer_shift = 4;         /*timer ticks to cycles*/
+static uint32_t timer_load = 0;
+static unsigned long long timer_due = 0;      /*the moment of the next interrupt (in cycles)*/
+static bool in_isr = false;
+
+static uint32_t gpo = 0;                      /*the levels of the outputs GPIO0..15*/
+static uint32_t gpo_reported = 0xFFFFFFFF;    /*the levels the mechanics know about*/
+static hal_outputsTYPE outputs_changed = NULL;
+static hal_inputsTYPE inputs_read = NULL;
+
+static bool verbose = false;
+static rst_info reset_info = {REASON_DEFAULT_RST};
+static uint8_t rtc_memory[HAL_RTC_SIZE];
+static unsigned long random_state = 1;
+static unsigned long yields = 0;              /*the number of calls of yield()*/
+static bool heap_counting = false;            /*count the calls of malloc()*/
+static unsigned char heap_paused = 0;         /*the core is busy, its allocations don't count*/
+static unsigned long heap_allocations = 0;
+
+hal_set_register GPOS;
+hal_clear_register GPOC;
+hal_input_register GPI;
+volatile uint32_t GP16O = 0;
+HardwareSerial Serial;
+EspClass ESP;
+
+/*------------------------------------------------------------------------------------------*/
+void hal_outputs(void);
+void hal_network_run(void);   /*see WiFi.cpp*/
+void hal_heap_count(bool enable);
+unsigned long hal_heap_allocations(void);
+void hal_heap_pause(void);
+void hal_heap_resume(void);
+extern "C" void *__libc_malloc(size_t size);
+/*------------------------------------------------------------------------------------------*/
+
+/*the mechanics: outputs is called when the coils (or any other output) change, inputs gives the level of the pins*/
+void Hal_attach(hal_outputsTYPE outputs, hal_inputsTYPE inputs)
+{
+  outputs_changed = outputs;
+  inputs_read = inputs;
+  gpo_reported = 0xFFFFFFFF;
+  hal_outputs();
+}
+
+/*let time pass, the timer interrupts that are due are done on the way*/
+void Hal_advance(unsigned long long us)
+{
+  unsigned long long end = now_cycles + (us * HAL_CYCLES_PER_US);
+
+  hal_outputs();
+  while((timer_enabled == true) && (timer_isr != NULL) && (timer_due <= end))
+  {
+    now_cycles = timer_due;
+    if(timer_reload == true)
+    {
+      timer_due = now_cycles + ((unsigned long long)timer_load << timer_shift);   /*the interrupt routine may load another value*/
+    }
+    else
+    {
+      timer_enabled = false;
+    }
+    in_isr = true;
+    timer_isr();
+    in_isr = false;
+    hal_outputs();
+  }
+  now_cycles = end;
+  hal_network_run();
+}
+
+/*the virtual time in us since the start, this doesn't wrap*/
+unsigned long long Hal_micros(void)
+{
+  return(now_cycles / HAL_CYCLES_PER_US);
+}
+
+unsigned long long Hal_cycles(void)
+{
+  return(now_cycles);
+}
+
+void Hal_verbose(bool enable)
+{
+  verbose = enable;
+}
+
+void Hal_reset_reason(uint32_t reason)
+{
+  reset_info.reason = reason;
+}
+
+uint8_t* Hal_rtc_memory(void)
+{
+  return(rtc_memory);
+}
+
+unsigned long Hal_yields(void)
+{
+  return(yields);
+}
+
+/*tell the mechanics about a change of the outputs, GPIO16 is bit 16*/
+void hal_outputs(void)
+{
+  uint32_t levels = (gpo & 0xFFFF) | ((GP16O & 1) << 16);
+
+  if((levels != gpo_reported) && (outputs_changed != NULL))
+  {
+    gpo_reported = levels;
+    outputs_changed(levels);
+  }
+}
+
+/*start (and clear) or stop counting the calls of malloc()*/
+void hal_heap_count(bool enable)
+{
+  heap_counting = enable;
+  heap_paused = 0;
+  if(enable == true)
+  {
+    heap_allocations = 0;
+  }
+}
+
+unsigned long hal_heap_allocations(void)
+{
+  return(heap_allocations);
+}
+
+/*the core does its own work, like the webserver collecting the response, this isn't counted*/
+void hal_heap_pause(void)
+{
+  heap_paused++;
+}
+
+void hal_heap_resume(void)
+{
+  if(heap_paused > 0)
+  {
+    heap_paused--;
+  }
+}
+
+/*every allocation of the program comes here (operator new, std::string and String too)*/
+extern "C" void *malloc(size_t size)
+{
+  if((heap_counting == true) && (heap_paused == 0))
+  {
+    heap_allocations++;
+  }
+  return(__libc_malloc(size));
+}
+
+/*................................................................*/
+
+unsigned long millis(void)
+{
+  return((unsigned long)(now_cycles / (HAL_CYCLES_PER_US * 1000ULL)));
+}
+
+unsigned long micros(void)
+{
+  return((unsigned long)(now_cycles / HAL_CYCLES_PER_US));   /*wraps after 71 minutes, just like on the ESP*/
+}
+
+void delay(unsigned long ms)
+{
+  Hal_advance(ms * 1000ULL);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  Hal_advance(us);
+}
+
+void yield(void)
+{
+  yields++;
+  Hal_advance(HAL_YIELD_US);
+}
+
+void noInterrupts(void)
+{
+}
+
+void interrupts(void)
+{
+}
+
+long random(long howbig)
+{
+  if(howbig <= 0)
+  {
+    return(0);
+  }
+  random_state = (random_state * 1103515245UL) + 12345UL;   /*the same sequence every run*/
+  return((long)((random_state >> 8) % (unsigned long)howbig));
+}
+
+long random(long howsmall, long howbig)
+{
+  if(howsmall >= howbig)
+  {
+    return(howsmall);
+  }
+  return(howsmall + random(howbig - howsmall));
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  (void)pin;
+  (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  if(pin == 16)
+  {
+    GP16O = (value != LOW) ? 1 : 0;
+  }
+  else if(value != LOW)
+  {
+    gpo = gpo | (1UL << pin);
+  }
+  else
+  {
+    gpo = gpo & ~(1UL << pin);
+  }
+  hal_outputs();
+}
+
+int digitalRead(uint8_t pin)
+{
+  uint32_t levels = GPI;
+
+  return((levels >> pin) & 1);
+}
+
+void hal_set_register::operator=(uint32_t bits)
+{
+  gpo = gpo | bits;
+}
+
+void hal_clear_register::operator=(uint32_t bits)
+{
+  gpo = gpo & ~bits;
+}
+
+/*the inputs, the mechanics must know the outputs first (the interrupt writes the coils and then reads the sensors)*/
+hal_input_register::operator uint32_t() const
+{
+  hal_outputs();
+  if(inputs_read == NULL)
+  {
+    return(0xFFFFFFFF);   /*all pins are pulled up*/
+  }
+  return(inputs_read());
+}
+
+/*................................................................*/
+
+void timer1_isr_init(void)
+{
+}
+
+void timer1_attachInterrupt(timercallback userFunc)
+{
+  timer_isr = userFunc;
+}
+
+void timer1_detachInterrupt(void)
+{
+  timer_isr = NULL;
+  timer_enabled = false;
+}
+
+void timer1_enable(uint8_t divider, uint8_t int_type, uint8_t reload)
+{
+  (void)int_type;
+  timer_shift = (divider == TIM_DIV256) ? 8 : ((divider == TIM_DIV16) ? 4 : 0);
+  timer_reload = (reload == TIM_LOOP);
+  timer_enabled = true;
+}
+
+void timer1_disable(void)
+{
+  timer_enabled = false;
+}
+
+/*(re)load the timer, it counts down from this value, also when it was already running*/
+void timer1_write(uint32_t ticks)
+{
+  timer_load = ticks;
+  timer_due = now_cycles + ((unsigned long long)ticks << timer_shift);
+}
+
+/*................................................................*/
+
+extern "C" size_t strlcpy(char *dst, const char *src, size_t size)
+{
+  size_t len = strlen(src);
+
+  if(size > 0)
+  {
+    size_t n = (len >= size) ? (size - 1) : len;
+    memcpy(dst, src, n);
+    dst[n] = 0;
+  }
+  return(len);
+}
+
+extern "C" size_t strlcat(char *dst, const char *src, size_t size)
+{
+  size_t len = strnlen(dst, size);
+
+  if(len == size)
+  {
+    return(len + strlen(src));
+  }
+  return(len + strlcpy(dst + len, src, size - len));
+}
+
+/*................................................................*/
+
+String::String(const char *s) : text((s != NULL) ? s : "") {heap();}
+String::String(const String &s) : text(s.text) {heap();}
+String::String(char c) : text(1, c) {}
+String::String(int value) : text(std::to_string(value)) {}
+String::String(unsigned int value) : text(std::to_string(value)) {}
+String::String(long value) : text(std::to_string(value)) {}
+String::String(unsigned long value) : text(std::to_string(value)) {}
+
+String::String(double value, unsigned char decimals)
+{
+  char buf[40];
+
+  snprintf(buf, sizeof(buf), "%.*f", decimals, value);
+  text = buf;
+}
+
+String& String::operator=(const String &s)          {text = s.text; heap(); return(*this);}
+String& String::operator=(const char *s)            {text = (s != NULL) ? s : ""; heap(); return(*this);}
+String& String::operator+=(const String &s)         {text += s.text; heap(); return(*this);}
+String& String::operator+=(const char *s)           {text += s; heap(); return(*this);}
+String& String::operator+=(char c)                  {text += c; return(*this);}
+String& String::operator+=(int value)               {text += std::to_string(value); return(*this);}
+String& String::operator+=(unsigned int value)      {text += std::to_string(value); return(*this);}
+String& String::operator+=(long value)              {text += std::to_string(value); return(*this);}
+String& String::operator+=(unsigned long value)     {text += std::to_string(value); return(*this);}
+String& String::operator+=(unsigned char value)     {text += std::to_string(value); return(*this);}
+String operator+(const String &a, const String &b)  {String s(a); s += b; return(s);}
+String operator+(const String &a, const char *b)    {String s(a); s += b; return(s);}
+String operator+(const char *a, const String &b)    {String s(a); s += b; return(s);}
+bool String::operator==(const String &s) const      {return(text == s.text);}
+bool String::operator==(const char *s) const        {return(text == s);}
+bool String::operator!=(const String &s) const      {return(text != s.text);}
+bool String::operator!=(const char *s) const        {return(text != s);}
+char String::operator[](unsigned int index) const   {return((index < text.size()) ? text[index] : 0);}
+unsigned int String::length(void) const             {return(text.size());}
+const char* String::c_str(void) const               {return(text.c_str());}
+bool String::reserve(unsigned int size)             {text.reserve(size); return(true);}
+void String::toCharArray(char *buf, unsigned int size) const {strlcpy(buf, text.c_str(), size);}
+bool String::startsWith(const String &s) const      {return(text.compare(0, s.text.size(), s.text) == 0);}
+long String::toInt(void) const                      {return(atol(text.c_str()));}
+float String::toFloat(void) const                   {return(atof(text.c_str()));}
+
+bool String::endsWith(const String &s) const
+{
+  return((text.size() >= s.text.size()) && (text.compare(text.size() - s.text.size(), s.text.size(), s.text) == 0));
+}
+
+int String::indexOf(char c) const
+{
+  size_t i = text.find(c);
+
+  return((i == std::string::npos) ? -1 : (int)i);
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+  if((from >= text.size()) || (to <= from))
+  {
+    return(String());
+  }
+  return(String(text.substr(from, to - from).c_str()));
+}
+
+/*a text that doesn't fit in the object itself goes to the heap (std::string keeps 15 characters in the object)*/
+void String::heap(void)
+{
+  if((text.size() > HAL_STRING_SSO) && (text.capacity() <= 15))
+  {
+    text.reserve(16);
+  }
+}
+
+void String::trim(void)
+{
+  size_t first = text.find_first_not_of(" \t\r\n");
+  size_t last = text.find_last_not_of(" \t\r\n");
+
+  text = (first == std::string::npos) ? "" : text.substr(first, last - first + 1);
+}
+
+/*................................................................*/
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t i;
+
+  for(i=0; i<size; i++)
+  {
+    write(buffer[i]);
+  }
+  return(size);
+}
+
+size_t Print::write(const char *s)                  {return(write((const uint8_t *)s, strlen(s)));}
+size_t Print::write(const char *buffer, size_t size){return(write((const uint8_t *)buffer, size));}
+size_t Print::print(const String &s)                {return(write(s.c_str()));}
+size_t Print::print(const char *s)                  {return(write(s));}
+size_t Print::print(char c)                         {return(write((uint8_t)c));}
+size_t Print::print(unsigned char value, int base)  {return(print_number(value, base));}
+size_t Print::print(unsigned int value, int base)   {return(print_number(value, base));}
+size_t Print::print(unsigned long value, int base)  {return(print_number(value, base));}
+size_t Print::println(void)                         {return(write("\r\n"));}
+size_t Print::println(const String &s)              {return(print(s) + println());}
+size_t Print::println(const char *s)                {return(print(s) + println());}
+size_t Print::println(char c)                       {return(print(c) + println());}
+size_t Print::println(unsigned char value, int base){return(print(value, base) + println());}
+size_t Print::println(int value, int base)          {return(print(value, base) + println());}
+size_t Print::println(unsigned int value, int base) {return(print(value, base) + println());}
+size_t Print::println(long value, int base)         {return(print(value, base) + println());}
+size_t Print::println(unsigned long value, int base){return(print(value, base) + println());}
+size_t Print::println(double value, int decimals)   {return(print(value, decimals) + println());}
+
+size_t Print::print(int value, int base)
+{
+  return(print((long)value, base));
+}
+
+size_t Print::print(long value, int base)
+{
+  if((base == 10) && (value < 0))
+  {
+    return(print('-') + print_number(-(unsigned long)value, 10));
+  }
+  return(print_number((unsigned long)value, base));
+}
+
+size_t Print::print(double value, int decimals)
+{
+  char buf[40];
+
+  snprintf(buf, sizeof(buf), "%.*f", decimals, value);
+  return(write(buf));
+}
+
+size_t Print::printf(const char *format, ...)
+{
+  char buf[256];
+  va_list args;
+  int len;
+
+  va_start(args, format);
+  len = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  if(len < 0)
+  {
+    return(0);
+  }
+  return(write((const uint8_t *)buf, min((size_t)len, sizeof(buf) - 1)));
+}
+
+size_t Print::print_number(unsigned long value, int base)
+{
+  char buf[8 * sizeof(long) + 1];
+  char *p = &buf[sizeof(buf) - 1];
+
+  if(base < 2)
+  {
+    base = 10;
+  }
+  *p = 0;
+  do
+  {
+    *--p = "0123456789ABCDEF"[value % base];
+    value = value / base;
+  } while(value > 0);
+  return(write(p));
+}
+
+size_t Stream::readBytes(char *buffer, size_t length)
+{
+  return(readBytes((uint8_t *)buffer, length));
+}
+
+size_t Stream::readBytes(uint8_t *buffer, size_t length)
+{
+  size_t n = 0;
+  int c;
+
+  while(n < length)
+  {
+    c = read();
+    if(c < 0)
+    {
+      break;
+    }
+    buffer[n++] = (uint8_t)c;
+  }
+  return(n);
+}
+
+String Stream::readStringUntil(char terminator)
+{
+  String s;
+  int c;
+
+  while(((c = read()) >= 0) && (c != terminator))
+  {
+    s += (char)c;
+  }
+  return(s);
+}
+
+/*the first number in the stream, everything in front of it is skipped*/
+long Stream::parseInt(void)
+{
+  long value = 0;
+  bool negative = false;
+  int c;
+
+  while(((c = peek()) >= 0) && (c != '-') && ((c < '0') || (c > '9')))
+  {
+    read();
+  }
+  if(c == '-')
+  {
+    negative = true;
+    read();
+  }
+  while(((c = peek()) >= '0') && (c <= '9'))
+  {
+    value = (value * 10) + (c - '0');
+    read();
+  }
+  return(negative ? -value : value);
+}
+
+void HardwareSerial::begin(unsigned long baud)
+{
+  (void)baud;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  if(verbose == true)
+  {
+    putchar(c);
+  }
+  return(1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+  if(verbose == true)
+  {
+    fwrite(buffer, 1, size, stdout);
+  }
+  return(size);
+}
+
+int HardwareSerial::available(void)         {return(0);}
+int HardwareSerial::read(void)              {return(-1);}
+int HardwareSerial::peek(void)              {return(-1);}
+int HardwareSerial::availableForWrite(void) {return(128);}   /*the size of the transmit buffer*/
+
+/*................................................................*/
+
+uint32_t EspClass::getFreeHeap(void)          {return(30000);}
+uint8_t EspClass::getHeapFragmentation(void)  {return(5);}
+uint16_t EspClass::getMaxFreeBlockSize(void)  {return(25000);}
+uint32_t EspClass::getFlashChipSize(void)     {return(4UL << 20);}
+uint32_t EspClass::getChipId(void)            {return(0x00C10C);}
+uint32_t EspClass::getCycleCount(void)        {return((uint32_t)now_cycles);}
+rst_info* EspClass::getResetInfoPtr(void)     {return(&reset_info);}
+
+/*the offset is in blocks of 4 bytes, just like on the ESP*/
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t *data, size_t size)
+{
+  if(((offset * 4) + size) > sizeof(rtc_memory))
+  {
+    return(false);
+  }
+  memcpy(data, &rtc_memory[offset * 4], size);
+  return(true);
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t *data, size_t size)
+{
+  if(((offset * 4) + size) > sizeof(rtc_memory))
+  {
+    return(false);
+  }
+  memcpy(&rtc_memory[offset * 4], data, size);
+  return(true);
+}
+
+/*the sketch gave up, a test can't continue after this*/
+void EspClass::restart(void)
+{
+  fflush(stdout);
+  fprintf(stderr, "ESP.restart() at %llu us\n", Hal_micros());
+  exit(2);
+}
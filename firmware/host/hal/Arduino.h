@@ -0,0 +1,242 @@
+/* Arduino core (host)
+ * ===================
+ * The parts of the ESP8266 Arduino core that the sketch uses, so it can be compiled and run on a PC.
+ * Time is virtual: it only advances in delay(), yield() and delayMicroseconds() (and in Hal_advance()),
+ * and the timer1 interrupt is called at the exact moments it is due. The GPIO registers are routed to the
+ * model of the mechanics (see Hal.h), so the stepper engine and the sensors work just like on the ESP.
+*/
+
+#ifndef __ARDUINO_H
+#define __ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+
+using std::min;
+using std::max;
+using std::abs;
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH              1
+#define LOW               0
+#define INPUT             0
+#define OUTPUT            1
+#define INPUT_PULLUP      2
+
+/*there is no separate flash address space on the PC*/
+#define F(x)              (x)
+#define PSTR(x)           (x)
+#define FPSTR(x)          (x)
+#define PROGMEM
+#define ICACHE_RAM_ATTR
+#define IRAM_ATTR
+#define ICACHE_FLASH_ATTR
+#define memcpy_P          memcpy
+#define strcmp_P          strcmp
+#define strlen_P          strlen
+#define snprintf_P        snprintf
+#define pgm_read_byte(p)  (*(const uint8_t *)(p))
+#define pgm_read_word(p)  (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+typedef char __FlashStringHelper;
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield(void);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+void noInterrupts(void);
+void interrupts(void);
+long random(long howbig);
+long random(long howsmall, long howbig);
+
+/*the GPIO registers, writing GPOS sets the bits, writing GPOC clears them, GPI holds the levels of the pins*/
+struct hal_set_register
+{
+  void operator=(uint32_t bits);
+};
+struct hal_clear_register
+{
+  void operator=(uint32_t bits);
+};
+struct hal_input_register
+{
+  operator uint32_t() const;
+};
+extern hal_set_register GPOS;
+extern hal_clear_register GPOC;
+extern hal_input_register GPI;
+extern volatile uint32_t GP16O;   /*GPIO16 has its own register*/
+
+/*timer1, it counts the 80MHz clock divided by 1, 16 or 256*/
+#define TIM_DIV1          0
+#define TIM_DIV16         1
+#define TIM_DIV256        3
+#define TIM_EDGE          0
+#define TIM_LEVEL         1
+#define TIM_SINGLE        0
+#define TIM_LOOP          1
+
+typedef void (*timercallback)(void);
+void timer1_isr_init(void);
+void timer1_attachInterrupt(timercallback userFunc);
+void timer1_detachInterrupt(void);
+void timer1_enable(uint8_t divider, uint8_t int_type, uint8_t reload);
+void timer1_disable(void);
+void timer1_write(uint32_t ticks);
+
+extern "C" size_t strlcpy(char *dst, const char *src, size_t size);
+extern "C" size_t strlcat(char *dst, const char *src, size_t size);
+
+/*----------------------------------------------------------------*/
+
+class String
+{
+public:
+  String(const char *s = "");
+  String(const String &s);
+  String(char c);
+  String(int value);
+  String(unsigned int value);
+  String(long value);
+  String(unsigned long value);
+  String(double value, unsigned char decimals = 2);
+  String& operator=(const String &s);
+  String& operator=(const char *s);
+  String& operator+=(const String &s);
+  String& operator+=(const char *s);
+  String& operator+=(char c);
+  String& operator+=(int value);
+  String& operator+=(unsigned int value);
+  String& operator+=(long value);
+  String& operator+=(unsigned long value);
+  String& operator+=(unsigned char value);
+  friend String operator+(const String &a, const String &b);
+  friend String operator+(const String &a, const char *b);
+  friend String operator+(const char *a, const String &b);
+  bool operator==(const String &s) const;
+  bool operator==(const char *s) const;
+  bool operator!=(const String &s) const;
+  bool operator!=(const char *s) const;
+  char operator[](unsigned int index) const;
+  unsigned int length(void) const;
+  const char* c_str(void) const;
+  bool reserve(unsigned int size);
+  void toCharArray(char *buf, unsigned int size) const;
+  bool startsWith(const String &s) const;
+  bool endsWith(const String &s) const;
+  int indexOf(char c) const;
+  String substring(unsigned int from, unsigned int to) const;
+  void trim(void);
+  long toInt(void) const;
+  float toFloat(void) const;
+
+private:
+  std::string text;
+  void heap(void);
+};
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *s);
+  size_t write(const char *buffer, size_t size);
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+  size_t print(const String &s);
+  size_t print(const char *s);
+  size_t print(char c);
+  size_t print(unsigned char value, int base = 10);
+  size_t print(int value, int base = 10);
+  size_t print(unsigned int value, int base = 10);
+  size_t print(long value, int base = 10);
+  size_t print(unsigned long value, int base = 10);
+  size_t print(double value, int decimals = 2);
+  size_t println(void);
+  size_t println(const String &s);
+  size_t println(const char *s);
+  size_t println(char c);
+  size_t println(unsigned char value, int base = 10);
+  size_t println(int value, int base = 10);
+  size_t println(unsigned int value, int base = 10);
+  size_t println(long value, int base = 10);
+  size_t println(unsigned long value, int base = 10);
+  size_t println(double value, int decimals = 2);
+
+private:
+  size_t print_number(unsigned long value, int base);
+};
+
+class Stream : public Print
+{
+public:
+  virtual int available(void) = 0;
+  virtual int read(void) = 0;
+  virtual int peek(void) = 0;
+  virtual void flush(void) {}
+  size_t readBytes(char *buffer, size_t length);
+  size_t readBytes(uint8_t *buffer, size_t length);
+  String readStringUntil(char terminator);
+  long parseInt(void);
+};
+
+class HardwareSerial : public Stream
+{
+public:
+  void begin(unsigned long baud);
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int available(void) override;
+  int read(void) override;
+  int peek(void) override;
+  int availableForWrite(void);
+};
+extern HardwareSerial Serial;
+
+/*----------------------------------------------------------------*/
+
+struct rst_info
+{
+  uint32_t reason;
+};
+enum rst_reason {REASON_DEFAULT_RST = 0,    /*power-on*/
+                 REASON_WDT_RST,
+                 REASON_EXCEPTION_RST,
+                 REASON_SOFT_WDT_RST,
+                 REASON_SOFT_RESTART,
+                 REASON_DEEP_SLEEP_AWAKE,
+                 REASON_EXT_SYS_RST
+                };
+
+class EspClass
+{
+public:
+  uint32_t getFreeHeap(void);
+  uint8_t getHeapFragmentation(void);
+  uint16_t getMaxFreeBlockSize(void);
+  uint32_t getFlashChipSize(void);
+  uint32_t getChipId(void);
+  uint32_t getCycleCount(void);
+  rst_info* getResetInfoPtr(void);
+  bool rtcUserMemoryRead(uint32_t offset, uint32_t *data, size_t size);
+  bool rtcUserMemoryWrite(uint32_t offset, uint32_t *data, size_t size);
+  void restart(void);
+};
+extern EspClass ESP;
+
+#endif
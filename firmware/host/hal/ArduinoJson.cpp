@@ -0,0 +1,659 @@
+/* ArduinoJson (host)
+ * ==================
+ * A small recursive parser and printer, enough for the configuration file and the manifests. The library keeps
+ * the contents of a StaticJsonBuffer in the buffer itself, so the containers of this imitation aren't counted as
+ * allocations of the sketch (see Hal_http_allocations()).
+*/
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/*--------------------------------------------*/
+static JsonVariant null_variant;    /*what is found when the key or index doesn't exist*/
+
+/*------------------------------------------------------------------------------------------*/
+static void skip_spaces(const char *&p);
+static size_t print_string(Print &out, const char *text);
+void hal_heap_pause(void);    /*see Arduino.cpp*/
+void hal_heap_resume(void);
+/*------------------------------------------------------------------------------------------*/
+
+/*the allocations for a StaticJsonBuffer are not counted, from its first member on*/
+static bool fixed_memory_start(bool fixed)
+{
+  if(fixed == true)
+  {
+    hal_heap_pause();
+  }
+  return(fixed);
+}
+
+/*while it exists, the allocations for a StaticJsonBuffer are not counted*/
+class FixedMemory
+{
+public:
+  FixedMemory(const JsonBuffer *owner) : paused((owner != NULL) && (owner->fixed == true)) {if(paused == true) {hal_heap_pause();}}
+  ~FixedMemory() {if(paused == true) {hal_heap_resume();}}
+
+private:
+  bool paused;
+};
+
+/*a Print that writes into a buffer (always terminated)*/
+class BufferPrint : public Print
+{
+public:
+  BufferPrint(char *buffer, size_t size) : buf(buffer), len(0), max(size) {if(size > 0) {buffer[0] = 0;}}
+  size_t write(uint8_t c) override
+  {
+    if((len + 1) >= max)
+    {
+      return(0);
+    }
+    buf[len++] = c;
+    buf[len] = 0;
+    return(1);
+  }
+  using Print::write;
+
+private:
+  char *buf;
+  size_t len;
+  size_t max;
+};
+
+class StringPrint : public Print
+{
+public:
+  StringPrint(String &text) : str(text) {}
+  size_t write(uint8_t c) override {str += (char)c; return(1);}
+  using Print::write;
+
+private:
+  String &str;
+};
+
+/*................................................................*/
+
+JsonVariant::JsonVariant() : type(JSON_NULL)
+{
+  value.l = 0;
+}
+
+void JsonVariant::set(bool v)           {type = JSON_BOOL;   value.b = v;}
+void JsonVariant::set(long v)           {type = JSON_LONG;   value.l = v;}
+void JsonVariant::set(double v)         {type = JSON_DOUBLE; value.d = v;}
+void JsonVariant::set(JsonObject &v)    {type = JSON_OBJECT; value.o = &v;}
+void JsonVariant::set(JsonArray &v)     {type = JSON_ARRAY;  value.a = &v;}
+
+void JsonVariant::set(const char *v)
+{
+  type = (v != NULL) ? JSON_STRING : JSON_NULL;
+  value.s = v;
+}
+
+bool JsonVariant::success(void) const
+{
+  return(type != JSON_NULL);
+}
+
+JsonVariant& JsonVariant::operator[](const char *key) const
+{
+  if(type == JSON_OBJECT)
+  {
+    return((*value.o)[key]);
+  }
+  null_variant = JsonVariant();
+  return(null_variant);
+}
+
+JsonVariant& JsonVariant::operator[](size_t index) const
+{
+  if(type == JSON_ARRAY)
+  {
+    return((*value.a)[index]);
+  }
+  null_variant = JsonVariant();
+  return(null_variant);
+}
+
+JsonObject& JsonVariant::asObject(void) const
+{
+  return((type == JSON_OBJECT) ? *value.o : JsonObject::invalid());
+}
+
+JsonArray& JsonVariant::asArray(void) const
+{
+  return((type == JSON_ARRAY) ? *value.a : JsonArray::invalid());
+}
+
+bool JsonVariant::convert(bool *) const
+{
+  switch(type)
+  {
+    case JSON_BOOL:   {return(value.b);}
+    case JSON_STRING: {return(strcmp(value.s, "true") == 0);}
+    default:          {return(as_long() != 0);}
+  }
+}
+
+const char* JsonVariant::convert(const char **) const
+{
+  return((type == JSON_STRING) ? value.s : NULL);
+}
+
+long JsonVariant::as_long(void) const
+{
+  switch(type)
+  {
+    case JSON_BOOL:     {return(value.b ? 1 : 0);}
+    case JSON_LONG:
+    case JSON_UNSIGNED: {return(value.l);}
+    case JSON_DOUBLE:   {return((long)value.d);}
+    case JSON_STRING:   {return((long)strtoul(value.s, NULL, 10));}
+    default:            {return(0);}
+  }
+}
+
+double JsonVariant::as_double(void) const
+{
+  switch(type)
+  {
+    case JSON_DOUBLE:   {return(value.d);}
+    case JSON_UNSIGNED: {return((double)(unsigned long)value.l);}
+    case JSON_STRING:   {return(strtod(value.s, NULL));}
+    default:            {return((double)as_long());}
+  }
+}
+
+size_t JsonVariant::printTo(Print &out) const
+{
+  char text[32];
+
+  switch(type)
+  {
+    case JSON_BOOL:     {return(out.print(value.b ? "true" : "false"));}
+    case JSON_LONG:     {return(out.print(value.l));}
+    case JSON_UNSIGNED: {return(out.print((unsigned long)value.l));}
+    case JSON_DOUBLE:   {snprintf(text, sizeof(text), "%.9g", value.d); return(out.print(text));}
+    case JSON_STRING:   {return(print_string(out, value.s));}
+    case JSON_OBJECT:   {return(value.o->printTo(out));}
+    case JSON_ARRAY:    {return(value.a->printTo(out));}
+    default:            {return(out.print("null"));}
+  }
+}
+
+/*................................................................*/
+
+JsonObject::JsonObject(JsonBuffer *owner) : buffer(owner) {}
+
+JsonObject& JsonObject::invalid(void)
+{
+  static JsonObject object(NULL);
+
+  object.members.clear();
+  return(object);
+}
+
+bool JsonObject::success(void) const
+{
+  return(buffer != NULL);
+}
+
+/*the member with this name, it is added when it doesn't exist (the key is not copied)*/
+JsonVariant& JsonObject::operator[](const char *key)
+{
+  for(auto &member : members)
+  {
+    if(strcmp(member.first, key) == 0)
+    {
+      return(member.second);
+    }
+  }
+  if(buffer == NULL)
+  {
+    null_variant = JsonVariant();
+    return(null_variant);
+  }
+  FixedMemory memory(buffer);
+  members.push_back(std::make_pair(key, JsonVariant()));
+  return(members.back().second);
+}
+
+bool JsonObject::containsKey(const char *key) const
+{
+  for(auto &member : members)
+  {
+    if(strcmp(member.first, key) == 0)
+    {
+      return(true);
+    }
+  }
+  return(false);
+}
+
+JsonArray& JsonObject::createNestedArray(const char *key)
+{
+  if(buffer == NULL)
+  {
+    return(JsonArray::invalid());
+  }
+  JsonArray &array = buffer->createArray();
+  (*this)[key].set(array);
+  return(array);
+}
+
+JsonObject& JsonObject::createNestedObject(const char *key)
+{
+  if(buffer == NULL)
+  {
+    return(invalid());
+  }
+  JsonObject &object = buffer->createObject();
+  (*this)[key].set(object);
+  return(object);
+}
+
+size_t JsonObject::size(void) const
+{
+  return(members.size());
+}
+
+size_t JsonObject::printTo(Print &out) const
+{
+  size_t n = out.print('{');
+  bool first = true;
+
+  for(auto &member : members)
+  {
+    if(first == false)
+    {
+      n = n + out.print(',');
+    }
+    first = false;
+    n = n + print_string(out, member.first);
+    n = n + out.print(':');
+    n = n + member.second.printTo(out);
+  }
+  return(n + out.print('}'));
+}
+
+size_t JsonObject::printTo(char *buffer, size_t size) const
+{
+  BufferPrint out(buffer, size);
+
+  return(printTo(out));
+}
+
+size_t JsonObject::printTo(String &text) const
+{
+  StringPrint out(text);
+
+  return(printTo(out));
+}
+
+/*................................................................*/
+
+JsonArray::JsonArray(JsonBuffer *owner) : buffer(owner) {}
+
+JsonArray& JsonArray::invalid(void)
+{
+  static JsonArray array(NULL);
+
+  array.elements.clear();
+  return(array);
+}
+
+bool JsonArray::success(void) const
+{
+  return(buffer != NULL);
+}
+
+size_t JsonArray::size(void) const
+{
+  return(elements.size());
+}
+
+JsonVariant& JsonArray::operator[](size_t index)
+{
+  if(index < elements.size())
+  {
+    return(elements[index]);
+  }
+  null_variant = JsonVariant();
+  return(null_variant);
+}
+
+JsonObject& JsonArray::createNestedObject(void)
+{
+  if(buffer == NULL)
+  {
+    return(JsonObject::invalid());
+  }
+  JsonObject &object = buffer->createObject();
+  FixedMemory memory(buffer);
+  elements.push_back(JsonVariant());
+  elements.back().set(object);
+  return(object);
+}
+
+JsonArray& JsonArray::createNestedArray(void)
+{
+  if(buffer == NULL)
+  {
+    return(invalid());
+  }
+  JsonArray &array = buffer->createArray();
+  FixedMemory memory(buffer);
+  elements.push_back(JsonVariant());
+  elements.back().set(array);
+  return(array);
+}
+
+size_t JsonArray::printTo(Print &out) const
+{
+  size_t n = out.print('[');
+  size_t i;
+
+  for(i=0; i<elements.size(); i++)
+  {
+    if(i > 0)
+    {
+      n = n + out.print(',');
+    }
+    n = n + elements[i].printTo(out);
+  }
+  return(n + out.print(']'));
+}
+
+size_t JsonArray::printTo(char *buffer, size_t size) const
+{
+  BufferPrint out(buffer, size);
+
+  return(printTo(out));
+}
+
+/*................................................................*/
+
+JsonBuffer::JsonBuffer(bool fixed_memory) : fixed(fixed_memory_start(fixed_memory))
+{
+  if(fixed == true)
+  {
+    hal_heap_resume();    /*the containers are there*/
+  }
+}
+
+JsonObject& JsonBuffer::createObject(void)
+{
+  FixedMemory memory(this);
+  objects.push_back(JsonObject(this));
+  return(objects.back());
+}
+
+JsonArray& JsonBuffer::createArray(void)
+{
+  FixedMemory memory(this);
+  arrays.push_back(JsonArray(this));
+  return(arrays.back());
+}
+
+const char* JsonBuffer::strdup(const std::string &text)
+{
+  FixedMemory memory(this);
+  strings.push_back(text);
+  return(strings.back().c_str());
+}
+
+JsonObject& JsonBuffer::parseObject(char *json)
+{
+  return(parseObject((const char *)json));
+}
+
+JsonObject& JsonBuffer::parseObject(const String &json)
+{
+  return(parseObject(json.c_str()));
+}
+
+JsonObject& JsonBuffer::parseObject(const char *json)
+{
+  FixedMemory memory(this);
+  const char *p = json;
+  JsonObject &object = createObject();
+
+  if((json == NULL) || (parse_object(p, object) == false))
+  {
+    return(JsonObject::invalid());
+  }
+  return(object);
+}
+
+JsonArray& JsonBuffer::parseArray(char *json)
+{
+  return(parseArray((const char *)json));
+}
+
+JsonArray& JsonBuffer::parseArray(const char *json)
+{
+  FixedMemory memory(this);
+  const char *p = json;
+  JsonArray &array = createArray();
+
+  if((json == NULL) || (parse_array(p, array) == false))
+  {
+    return(JsonArray::invalid());
+  }
+  return(array);
+}
+
+bool JsonBuffer::parse_object(const char *&p, JsonObject &object)
+{
+  std::string key;
+
+  skip_spaces(p);
+  if(*p++ != '{')
+  {
+    return(false);
+  }
+  skip_spaces(p);
+  if(*p == '}')
+  {
+    p++;
+    return(true);
+  }
+  while(1)
+  {
+    skip_spaces(p);
+    if(parse_string(p, key) == false)
+    {
+      return(false);
+    }
+    skip_spaces(p);
+    if(*p++ != ':')
+    {
+      return(false);
+    }
+    object.members.push_back(std::make_pair(strdup(key), JsonVariant()));
+    if(parse_value(p, object.members.back().second) == false)
+    {
+      return(false);
+    }
+    skip_spaces(p);
+    if(*p == '}')
+    {
+      p++;
+      return(true);
+    }
+    if(*p++ != ',')
+    {
+      return(false);
+    }
+  }
+}
+
+bool JsonBuffer::parse_array(const char *&p, JsonArray &array)
+{
+  skip_spaces(p);
+  if(*p++ != '[')
+  {
+    return(false);
+  }
+  skip_spaces(p);
+  if(*p == ']')
+  {
+    p++;
+    return(true);
+  }
+  while(1)
+  {
+    array.elements.push_back(JsonVariant());
+    if(parse_value(p, array.elements.back()) == false)
+    {
+      return(false);
+    }
+    skip_spaces(p);
+    if(*p == ']')
+    {
+      p++;
+      return(true);
+    }
+    if(*p++ != ',')
+    {
+      return(false);
+    }
+  }
+}
+
+bool JsonBuffer::parse_value(const char *&p, JsonVariant &value)
+{
+  std::string text;
+  char *end;
+  double d;
+  long l;
+
+  skip_spaces(p);
+  if(*p == '{')
+  {
+    JsonObject &object = createObject();
+    value.set(object);
+    return(parse_object(p, object));
+  }
+  if(*p == '[')
+  {
+    JsonArray &array = createArray();
+    value.set(array);
+    return(parse_array(p, array));
+  }
+  if(*p == '"')
+  {
+    if(parse_string(p, text) == false)
+    {
+      return(false);
+    }
+    value.set(strdup(text));
+    return(true);
+  }
+  if(strncmp(p, "true", 4) == 0)   {p += 4; value.set(true);  return(true);}
+  if(strncmp(p, "false", 5) == 0)  {p += 5; value.set(false); return(true);}
+  if(strncmp(p, "null", 4) == 0)   {p += 4; value = JsonVariant(); return(true);}
+
+  d = strtod(p, &end);
+  if(end == p)
+  {
+    return(false);
+  }
+  l = strtol(p, NULL, 10);
+  if(strcspn(p, ".eE") < (size_t)(end - p))
+  {
+    value.set(d);
+  }
+  else if((l < 0) || (d <= (double)0x7FFFFFFFL))
+  {
+    value.set(l);
+  }
+  else
+  {
+    value.set((unsigned long)strtoul(p, NULL, 10));
+  }
+  p = end;
+  return(true);
+}
+
+bool JsonBuffer::parse_string(const char *&p, std::string &text)
+{
+  text.clear();
+  if(*p++ != '"')
+  {
+    return(false);
+  }
+  while(*p != '"')
+  {
+    if(*p == 0)
+    {
+      return(false);
+    }
+    if(*p == '\\')
+    {
+      p++;
+      switch(*p)
+      {
+        case 'n': {text += '\n'; break;}
+        case 'r': {text += '\r'; break;}
+        case 't': {text += '\t'; break;}
+        case 'b': {text += '\b'; break;}
+        case 'f': {text += '\f'; break;}
+        case 'u': {text += (char)strtol(std::string(p + 1, 4).c_str(), NULL, 16); p += 4; break;}  /*only ASCII*/
+        case 0:   {return(false);}
+        default:  {text += *p; break;}
+      }
+      p++;
+    }
+    else
+    {
+      text += *p++;
+    }
+  }
+  p++;
+  return(true);
+}
+
+/*................................................................*/
+
+static void skip_spaces(const char *&p)
+{
+  while((*p == ' ') || (*p == '\t') || (*p == '\r') || (*p == '\n'))
+  {
+    p++;
+  }
+}
+
+static size_t print_string(Print &out, const char *text)
+{
+  size_t n = out.print('"');
+  char code[8];
+
+  for(; *text != 0; text++)
+  {
+    switch(*text)
+    {
+      case '"':  {n = n + out.print("\\\""); break;}
+      case '\\': {n = n + out.print("\\\\"); break;}
+      case '\n': {n = n + out.print("\\n");  break;}
+      case '\r': {n = n + out.print("\\r");  break;}
+      case '\t': {n = n + out.print("\\t");  break;}
+      default:
+      {
+        if((uint8_t)*text < 0x20)
+        {
+          snprintf(code, sizeof(code), "\\u%04x", (uint8_t)*text);
+          n = n + out.print(code);
+        }
+        else
+        {
+          n = n + out.print(*text);
+        }
+        break;
+      }
+    }
+  }
+  return(n + out.print('"'));
+}
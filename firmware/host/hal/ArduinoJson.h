@@ -0,0 +1,157 @@
+#ifndef __ARDUINOJSON_H
+#define __ARDUINOJSON_H
+
+/* ArduinoJson (host), the part of the version 5 API that the sketch uses:
+ * objects and arrays (also nested), parsing and printing, the values are read with as<>() or by assignment.
+ * Strings that are assigned as const char* are not copied (just like in version 5).
+*/
+
+#include <Arduino.h>
+#include <deque>
+#include <type_traits>
+#include <vector>
+
+/*------------------------------------------*/
+
+class JsonArray;
+class JsonObject;
+class JsonBuffer;
+
+class JsonVariant
+{
+public:
+  JsonVariant();
+  JsonVariant(const JsonVariant &other) = default;
+  JsonVariant& operator=(const JsonVariant &other) = default;
+  template<typename T> JsonVariant& operator=(const T &value) {set(value); return(*this);}
+
+  template<typename T> T as() const {return(convert((T *)NULL));}
+  template<typename T> operator T() const {return(as<T>());}
+  JsonVariant& operator[](const char *key) const;
+  JsonVariant& operator[](size_t index) const;
+  JsonObject& asObject(void) const;
+  JsonArray& asArray(void) const;
+  bool success(void) const;
+  size_t printTo(Print &out) const;
+
+  void set(bool value);
+  void set(char value)                {set((long)value);}
+  void set(signed char value)         {set((long)value);}
+  void set(unsigned char value)       {set((long)value);}
+  void set(short value)               {set((long)value);}
+  void set(unsigned short value)      {set((long)value);}
+  void set(int value)                 {set((long)value);}
+  void set(unsigned int value)        {set((long)value);}
+  void set(long value);
+  void set(unsigned long value)       {set((long)value); type = JSON_UNSIGNED;}
+  void set(float value)               {set((double)value);}
+  void set(double value);
+  void set(const char *value);
+  void set(char *value)               {set((const char *)value);}
+  void set(JsonObject &value);
+  void set(JsonArray &value);
+
+private:
+  enum json_types {JSON_NULL, JSON_BOOL, JSON_LONG, JSON_UNSIGNED, JSON_DOUBLE, JSON_STRING, JSON_OBJECT, JSON_ARRAY};
+
+  unsigned char type;
+  union
+  {
+    bool b;
+    long l;
+    double d;
+    const char *s;
+    JsonObject *o;
+    JsonArray *a;
+  } value;
+
+  bool convert(bool *) const;
+  const char* convert(const char **) const;
+  float convert(float *) const                {return((float)as_double());}
+  double convert(double *) const              {return(as_double());}
+  template<typename T> typename std::enable_if<std::is_integral<T>::value, T>::type convert(T *) const {return((T)as_long());}
+  long as_long(void) const;
+  double as_double(void) const;
+};
+
+class JsonObject
+{
+public:
+  JsonObject(JsonBuffer *owner);
+  bool success(void) const;
+  JsonVariant& operator[](const char *key);
+  bool containsKey(const char *key) const;
+  JsonArray& createNestedArray(const char *key);
+  JsonObject& createNestedObject(const char *key);
+  size_t size(void) const;
+  size_t printTo(Print &out) const;
+  size_t printTo(char *buffer, size_t size) const;
+  size_t printTo(String &text) const;
+  static JsonObject& invalid(void);
+
+private:
+  friend class JsonBuffer;
+  JsonBuffer *buffer;
+  std::vector<std::pair<const char *, JsonVariant> > members;
+};
+
+class JsonArray
+{
+public:
+  JsonArray(JsonBuffer *owner);
+  bool success(void) const;
+  size_t size(void) const;
+  JsonVariant& operator[](size_t index);
+  template<typename T> bool add(const T &value) {elements.push_back(JsonVariant()); elements.back().set(value); return(true);}
+  JsonObject& createNestedObject(void);
+  JsonArray& createNestedArray(void);
+  size_t printTo(Print &out) const;
+  size_t printTo(char *buffer, size_t size) const;
+  static JsonArray& invalid(void);
+
+private:
+  friend class JsonBuffer;
+  JsonBuffer *buffer;
+  std::vector<JsonVariant> elements;
+};
+
+/*owns all objects, arrays and parsed strings*/
+class JsonBuffer
+{
+public:
+  bool fixed;     /*a StaticJsonBuffer, the library keeps everything in the buffer itself (this comes before the containers)*/
+
+  JsonBuffer(bool fixed_memory = false);
+  JsonObject& createObject(void);
+  JsonArray& createArray(void);
+  JsonObject& parseObject(char *json);
+  JsonObject& parseObject(const char *json);
+  JsonObject& parseObject(const String &json);
+  JsonArray& parseArray(char *json);
+  JsonArray& parseArray(const char *json);
+  const char* strdup(const std::string &text);
+
+private:
+  std::deque<JsonObject> objects;
+  std::deque<JsonArray> arrays;
+  std::deque<std::string> strings;
+
+  bool parse_value(const char *&p, JsonVariant &value);
+  bool parse_string(const char *&p, std::string &text);
+  bool parse_object(const char *&p, JsonObject &object);
+  bool parse_array(const char *&p, JsonArray &array);
+};
+
+class DynamicJsonBuffer : public JsonBuffer
+{
+public:
+  DynamicJsonBuffer(size_t block_size = 256) {(void)block_size;}
+};
+
+template<size_t CAPACITY> class StaticJsonBuffer : public JsonBuffer
+{
+public:
+  StaticJsonBuffer() : JsonBuffer(true) {}
+};
+
+#endif
@@ -0,0 +1 @@
+#include "AudioLib.h"
@@ -0,0 +1,94 @@
+/* ESP8266Audio (host)
+ * ===================
+ * Nothing is decoded, the generator only takes the time that the sample would take.
+*/
+
+#include <Arduino.h>
+#include "AudioLib.h"
+
+/*--------------------------------------------*/
+#define WAV_BYTES_PER_MS    8   /*8 kHz, 8 bit, mono*/
+
+/*------------------------------------------------------------------------------------------*/
+
+bool AudioFileSourceSPIFFS::open(const char *filename)
+{
+  f = SPIFFS.open(filename, "r");
+  return((bool)f);
+}
+
+bool AudioFileSourceSPIFFS::isOpen(void)
+{
+  return((bool)f);
+}
+
+uint32_t AudioFileSourceSPIFFS::getSize(void)
+{
+  return(f.size());
+}
+
+bool AudioFileSourceSPIFFS::close(void)
+{
+  f.close();
+  return(true);
+}
+
+bool AudioFileSourcePROGMEM::open(const void *buffer, uint32_t length)
+{
+  data = buffer;
+  size = length;
+  return(data != NULL);
+}
+
+bool AudioFileSourcePROGMEM::isOpen(void)
+{
+  return(data != NULL);
+}
+
+uint32_t AudioFileSourcePROGMEM::getSize(void)
+{
+  return(size);
+}
+
+bool AudioFileSourcePROGMEM::close(void)
+{
+  data = NULL;
+  return(true);
+}
+
+/*................................................................*/
+
+bool AudioGeneratorWAV::begin(AudioFileSource *src, AudioOutput *output)
+{
+  (void)output;
+  if((src == NULL) || (src->isOpen() == false))
+  {
+    return(false);
+  }
+  source = src;
+  start_ms = millis();
+  duration_ms = src->getSize() / WAV_BYTES_PER_MS;
+  running = true;
+  return(true);
+}
+
+/*false when the sample is over*/
+bool AudioGeneratorWAV::loop(void)
+{
+  return(running && ((millis() - start_ms) < duration_ms));
+}
+
+bool AudioGeneratorWAV::stop(void)
+{
+  if(source != NULL)
+  {
+    source->close();
+  }
+  running = false;
+  return(true);
+}
+
+bool AudioGeneratorWAV::isRunning(void)
+{
+  return(running);
+}
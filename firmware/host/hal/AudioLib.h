@@ -0,0 +1,72 @@
+#ifndef __AUDIOLIB_H
+#define __AUDIOLIB_H
+
+/* ESP8266Audio (host), a sample "plays" for as long as an 8 kHz 8 bit mono WAV of the same size would take */
+
+#include <Arduino.h>
+#include <FS.h>
+
+/*------------------------------------------*/
+
+class AudioFileSource
+{
+public:
+  virtual ~AudioFileSource() {}
+  virtual bool isOpen(void) = 0;
+  virtual uint32_t getSize(void) = 0;
+  virtual bool close(void) = 0;
+};
+
+class AudioFileSourceSPIFFS : public AudioFileSource
+{
+public:
+  bool open(const char *filename);
+  bool isOpen(void) override;
+  uint32_t getSize(void) override;
+  bool close(void) override;
+
+private:
+  File f;
+};
+
+class AudioFileSourcePROGMEM : public AudioFileSource
+{
+public:
+  AudioFileSourcePROGMEM() : data(NULL), size(0) {}
+  bool open(const void *buffer, uint32_t length);
+  bool isOpen(void) override;
+  uint32_t getSize(void) override;
+  bool close(void) override;
+
+private:
+  const void *data;
+  uint32_t size;
+};
+
+class AudioOutput
+{
+public:
+  virtual ~AudioOutput() {}
+};
+
+class AudioOutputI2SNoDAC : public AudioOutput
+{
+};
+
+class AudioGeneratorWAV
+{
+public:
+  AudioGeneratorWAV() : source(NULL), running(false), start_ms(0), duration_ms(0) {}
+  bool begin(AudioFileSource *source, AudioOutput *output);
+  bool loop(void);
+  bool stop(void);
+  bool isRunning(void);
+
+private:
+  AudioFileSource *source;
+  bool running;
+  unsigned long start_ms;
+  unsigned long duration_ms;
+};
+
+#endif
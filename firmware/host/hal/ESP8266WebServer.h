@@ -0,0 +1,88 @@
+#ifndef __ESP8266WEBSERVER_H
+#define __ESP8266WEBSERVER_H
+
+/* The webserver (host), the requests come from Hal_http() and the response is kept for the test */
+
+#include <ESP8266WiFi.h>
+#include <FS.h>
+#include <functional>
+#include <vector>
+#include "Hal.h"
+
+/*------------------------------------------*/
+
+enum HTTPMethod {HTTP_ANY,
+                 HTTP_GET,
+                 HTTP_POST,
+                 HTTP_PUT,
+                 HTTP_PATCH,
+                 HTTP_DELETE,
+                 HTTP_OPTIONS
+                };
+
+#define CONTENT_LENGTH_UNKNOWN  ((size_t)-1)
+
+class ESP8266WebServer
+{
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  ESP8266WebServer(int port = 80);
+  void begin(void);
+  void handleClient(void);
+  void on(const char *uri, THandlerFunction handler);
+  void on(const char *uri, HTTPMethod method, THandlerFunction handler);
+  void onNotFound(THandlerFunction handler);
+  void collectHeaders(const char *headerKeys[], size_t count);
+
+  const String& uri(void);                  /*the same signatures as the core (3.x), a name given as text becomes a String*/
+  HTTPMethod method(void);
+  int args(void);
+  const String& arg(int index);
+  const String& arg(const String &name);
+  const String& argName(int index);
+  bool hasArg(const String &name);
+  int headers(void);
+  const String& header(int index);
+  const String& header(const String &name);
+  const String& headerName(int index);
+  bool hasHeader(const String &name);
+  WiFiClient client(void);
+
+  void send(int code, const char *content_type, const String &content);
+  void send(int code, const char *content_type, const char *content);
+  void send(int code, const char *content_type, const char *content, size_t length);
+  void send_P(int code, const char *content_type, const char *content);
+  void send_P(int code, const char *content_type, const char *content, size_t length);
+  void sendHeader(const String &name, const String &value, bool first = false);
+  void setContentLength(size_t length);
+  void sendContent(const String &content);
+  void sendContent(const char *content, size_t length);
+  void sendContent_P(const char *content);
+  void sendContent_P(const char *content, size_t length);
+  size_t streamFile(File &file, const String &content_type);
+
+  bool request(const char *uri, const char *args, hal_responseTYPE *response);
+  void request_header(const char *name, const char *value);
+  void request_done(void);
+
+private:
+  typedef struct
+  {
+    String uri;
+    HTTPMethod method;
+    THandlerFunction handler;
+  } routeTYPE;
+
+  std::vector<routeTYPE> routes;
+  THandlerFunction not_found;
+  String request_uri;
+  std::vector<String> arg_names;
+  std::vector<String> arg_values;
+  std::vector<String> header_names;     /*the headers that are collected*/
+  std::vector<String> header_values;    /*of the current request*/
+  String empty;
+  hal_responseTYPE *current;
+};
+
+#endif
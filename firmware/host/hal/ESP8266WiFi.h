@@ -0,0 +1,93 @@
+#ifndef __ESP8266WIFI_H
+#define __ESP8266WIFI_H
+
+/* WiFi (host), there is one access point (see Hal_network()), connecting and scanning take a while */
+
+#include <Arduino.h>
+#include <IPAddress.h>
+
+/*------------------------------------------*/
+
+enum wl_status_t {WL_NO_SHIELD = 255,
+                  WL_IDLE_STATUS = 0,
+                  WL_NO_SSID_AVAIL,
+                  WL_SCAN_COMPLETED,
+                  WL_CONNECTED,
+                  WL_CONNECT_FAILED,
+                  WL_CONNECTION_LOST,
+                  WL_DISCONNECTED
+                 };
+enum WiFiMode_t {WIFI_OFF = 0,
+                 WIFI_STA = 1,
+                 WIFI_AP = 2,
+                 WIFI_AP_STA = 3
+                };
+enum WiFiSleepType_t {WIFI_NONE_SLEEP = 0,
+                      WIFI_LIGHT_SLEEP = 1,
+                      WIFI_MODEM_SLEEP = 2
+                     };
+
+#define ENC_TYPE_NONE       7
+#define ENC_TYPE_CCMP       4
+#define WIFI_SCAN_RUNNING   (-1)
+#define WIFI_SCAN_FAILED    (-2)
+
+/*a TCP connection, the host has none*/
+class WiFiClient : public Stream
+{
+public:
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int available(void) override;
+  int read(void) override;
+  int peek(void) override;
+  bool connected(void);
+  operator bool(void);
+  void stop(void);
+  void setNoDelay(bool nodelay);
+  IPAddress remoteIP(void);
+  int availableForWrite(void);
+};
+
+class ESP8266WiFiClass
+{
+public:
+  bool mode(WiFiMode_t mode);
+  WiFiMode_t getMode(void);
+  void persistent(bool persistent);
+  bool setAutoReconnect(bool autoReconnect);
+  bool hostname(const char *name);
+  int begin(const char *ssid, const char *key, int32_t channel = 0, const uint8_t *bssid = NULL, bool connect = true);
+  bool config(IPAddress local_ip, IPAddress gateway, IPAddress subnet, IPAddress dns1 = IPAddress(), IPAddress dns2 = IPAddress());
+  bool disconnect(bool wifioff = false);
+  bool isConnected(void);
+  wl_status_t status(void);
+  int8_t scanNetworks(bool async = false, bool show_hidden = false);
+  int8_t scanComplete(void);
+  void scanDelete(void);
+  String SSID(uint8_t index);
+  String SSID(void);
+  int32_t RSSI(uint8_t index);
+  int32_t RSSI(void);
+  uint8_t encryptionType(uint8_t index);
+  uint8_t* BSSID(uint8_t index);
+  uint8_t* BSSID(void);
+  int32_t channel(uint8_t index);
+  int32_t channel(void);
+  IPAddress localIP(void);
+  IPAddress subnetMask(void);
+  IPAddress gatewayIP(void);
+  IPAddress dnsIP(uint8_t index = 0);
+  bool softAPConfig(IPAddress local_ip, IPAddress gateway, IPAddress subnet);
+  bool softAP(const char *ssid, const char *key = NULL);
+  bool softAPdisconnect(bool wifioff = false);
+  IPAddress softAPIP(void);
+  int hostByName(const char *name, IPAddress &result);
+  bool setSleepMode(WiFiSleepType_t type, uint8_t listenInterval = 0);
+  WiFiSleepType_t getSleepMode(void);
+  void setOutputPower(float dBm);
+};
+extern ESP8266WiFiClass WiFi;
+
+#endif
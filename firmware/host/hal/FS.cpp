@@ -0,0 +1,349 @@
+/* SPIFFS (host)
+ * =============
+ * The files are kept in memory. An open file shares its contents with the file system, so a file that is
+ * removed or renamed while it is open behaves like on the SPIFFS (the open handle keeps the old contents).
+*/
+
+#include <Arduino.h>
+#include <FS.h>
+#include <dirent.h>
+#include "Hal.h"
+
+/*--------------------------------------------*/
+#define SPIFFS_SIZE   (1024UL * 1024UL)   /*the size of the file system (a 4M flash with 1M SPIFFS)*/
+
+static std::map<std::string, std::shared_ptr<hal_fileTYPE> > files;
+
+FS SPIFFS;
+
+/*------------------------------------------------------------------------------------------*/
+File fs_open(const char *path, const char *mode);
+void hal_heap_pause(void);    /*see Arduino.cpp*/
+void hal_heap_resume(void);
+/*------------------------------------------------------------------------------------------*/
+
+/*put the files of this folder in the SPIFFS (like uploading the data folder of the sketch)*/
+bool Hal_spiffs_load(const char *folder)
+{
+  DIR *dir = opendir(folder);
+  struct dirent *entry;
+  std::string path;
+  char buf[4096];
+  size_t n;
+
+  if(dir == NULL)
+  {
+    return(false);
+  }
+  while((entry = readdir(dir)) != NULL)
+  {
+    if(entry->d_name[0] == '.')
+    {
+      continue;
+    }
+    path = std::string(folder) + "/" + entry->d_name;
+    FILE *f = fopen(path.c_str(), "rb");
+    if(f == NULL)
+    {
+      continue;
+    }
+    std::shared_ptr<hal_fileTYPE> file = std::make_shared<hal_fileTYPE>();
+    file->writes = 0;
+    while((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+      file->data.append(buf, n);
+    }
+    fclose(f);
+    files[std::string("/") + entry->d_name] = file;
+  }
+  closedir(dir);
+  return(true);
+}
+
+void Hal_spiffs_write(const char *path, const char *text)
+{
+  std::shared_ptr<hal_fileTYPE> file = std::make_shared<hal_fileTYPE>();
+
+  file->data = text;
+  file->writes = 0;
+  files[path] = file;
+}
+
+bool Hal_spiffs_read(const char *path, std::string *data)
+{
+  auto it = files.find(path);
+
+  if(it == files.end())
+  {
+    return(false);
+  }
+  *data = it->second->data;
+  return(true);
+}
+
+unsigned long Hal_spiffs_writes(const char *path)
+{
+  auto it = files.find(path);
+
+  return((it == files.end()) ? 0 : it->second->writes);
+}
+
+/*................................................................*/
+
+bool FS::begin(void)
+{
+  return(true);
+}
+
+void FS::end(void)
+{
+}
+
+bool FS::format(void)
+{
+  files.clear();
+  return(true);
+}
+
+/*mode is "r", "w" (the file is emptied) or "a" (writing starts at the end), the core allocates the file object*/
+File FS::open(const char *path, const char *mode)
+{
+  File file;
+
+  hal_heap_pause();
+  file = fs_open(path, mode);
+  hal_heap_resume();
+  return(file);
+}
+
+File fs_open(const char *path, const char *mode)
+{
+  auto it = files.find(path);
+  std::shared_ptr<hal_fileTYPE> file;
+
+  if(mode[0] == 'r')
+  {
+    if(it == files.end())
+    {
+      return(File());
+    }
+    return(File(path, it->second, (mode[1] == '+'), 0));
+  }
+
+  if((it == files.end()) || (mode[0] == 'w'))
+  {
+    file = std::make_shared<hal_fileTYPE>();    /*a new file, an open handle of the old one keeps the old contents*/
+    file->writes = (it == files.end()) ? 0 : it->second->writes;
+    files[path] = file;
+  }
+  else
+  {
+    file = it->second;
+  }
+  file->writes++;
+  return(File(path, file, true, file->data.size()));
+}
+
+File FS::open(const String &path, const char *mode)
+{
+  return(open(path.c_str(), mode));
+}
+
+bool FS::exists(const char *path)
+{
+  return(files.find(path) != files.end());
+}
+
+bool FS::exists(const String &path)
+{
+  return(exists(path.c_str()));
+}
+
+bool FS::remove(const char *path)
+{
+  return(files.erase(path) > 0);
+}
+
+bool FS::rename(const char *from, const char *to)
+{
+  auto it = files.find(from);
+
+  if((it == files.end()) || exists(to))
+  {
+    return(false);
+  }
+  files[to] = it->second;
+  files.erase(it);
+  return(true);
+}
+
+Dir FS::openDir(const char *path)
+{
+  return(Dir(path));
+}
+
+bool FS::info(FSInfo &info)
+{
+  size_t used = 0;
+
+  for(auto &it : files)
+  {
+    used = used + ((it.second->data.size() + 255) & ~255UL);   /*a file uses whole pages*/
+  }
+  info.totalBytes = SPIFFS_SIZE;
+  info.usedBytes = used;
+  info.blockSize = 8192;
+  info.pageSize = 256;
+  info.maxOpenFiles = 5;
+  info.maxPathLength = 32;
+  return(true);
+}
+
+/*................................................................*/
+
+File::File() : file(), file_writable(false), file_position(0) {}
+
+File::File(const std::string &name, std::shared_ptr<hal_fileTYPE> data, bool writable, size_t position)
+  : file_name(name), file(data), file_writable(writable), file_position(position) {}
+
+File::operator bool() const
+{
+  return(file != nullptr);
+}
+
+size_t File::write(uint8_t c)
+{
+  return(write(&c, 1));
+}
+
+size_t File::write(const uint8_t *buffer, size_t size)
+{
+  if((file == nullptr) || (file_writable == false))
+  {
+    return(0);
+  }
+  if(file_position > file->data.size())
+  {
+    file_position = file->data.size();
+  }
+  file->data.replace(file_position, min(size, file->data.size() - file_position), (const char *)buffer, size);
+  file_position = file_position + size;
+  return(size);
+}
+
+int File::available(void)
+{
+  if((file == nullptr) || (file_position >= file->data.size()))
+  {
+    return(0);
+  }
+  return(file->data.size() - file_position);
+}
+
+int File::read(void)
+{
+  if(available() == 0)
+  {
+    return(-1);
+  }
+  return((uint8_t)file->data[file_position++]);
+}
+
+int File::peek(void)
+{
+  if(available() == 0)
+  {
+    return(-1);
+  }
+  return((uint8_t)file->data[file_position]);
+}
+
+int File::read(uint8_t *buffer, size_t size)
+{
+  size_t n = min(size, (size_t)available());
+
+  if(n > 0)
+  {
+    memcpy(buffer, file->data.data() + file_position, n);
+    file_position = file_position + n;
+  }
+  return(n);
+}
+
+bool File::seek(uint32_t pos, SeekMode mode)
+{
+  size_t base = 0;
+
+  if(file == nullptr)
+  {
+    return(false);
+  }
+  if(mode == SeekCur)
+  {
+    base = file_position;
+  }
+  else if(mode == SeekEnd)
+  {
+    base = file->data.size();
+  }
+  if((base + pos) > file->data.size())
+  {
+    return(false);
+  }
+  file_position = base + pos;
+  return(true);
+}
+
+size_t File::position(void) const
+{
+  return(file_position);
+}
+
+size_t File::size(void) const
+{
+  return((file == nullptr) ? 0 : file->data.size());
+}
+
+const char* File::name(void) const
+{
+  return(file_name.c_str());
+}
+
+void File::close(void)
+{
+  file = nullptr;
+}
+
+/*................................................................*/
+
+Dir::Dir(const std::string &prefix) : dir_prefix(prefix) {}
+
+/*the files are visited in alphabetical order*/
+bool Dir::next(void)
+{
+  auto it = current.empty() ? files.lower_bound(dir_prefix) : files.upper_bound(current);
+
+  if((it == files.end()) || (it->first.compare(0, dir_prefix.size(), dir_prefix) != 0))
+  {
+    return(false);
+  }
+  current = it->first;
+  return(true);
+}
+
+String Dir::fileName(void)
+{
+  return(String(current.c_str()));
+}
+
+size_t Dir::fileSize(void)
+{
+  auto it = files.find(current);
+
+  return((it == files.end()) ? 0 : it->second->data.size());
+}
+
+File Dir::openFile(const char *mode)
+{
+  return(SPIFFS.open(current.c_str(), mode));
+}
@@ -0,0 +1,89 @@
+#ifndef __FS_H
+#define __FS_H
+
+/* The SPIFFS (host), the files are kept in memory */
+
+#include <Arduino.h>
+#include <map>
+
+/*------------------------------------------*/
+
+enum SeekMode {SeekSet = 0,
+               SeekCur = 1,
+               SeekEnd = 2
+              };
+
+struct FSInfo
+{
+  size_t totalBytes;
+  size_t usedBytes;
+  size_t blockSize;
+  size_t pageSize;
+  size_t maxOpenFiles;
+  size_t maxPathLength;
+};
+
+struct hal_fileTYPE
+{
+  std::string data;
+  unsigned long writes;   /*the number of times the file was opened for writing*/
+};
+
+class File : public Stream
+{
+public:
+  File();
+  File(const std::string &name, std::shared_ptr<hal_fileTYPE> data, bool writable, size_t position);
+  operator bool() const;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int available(void) override;
+  int read(void) override;
+  int peek(void) override;
+  int read(uint8_t *buffer, size_t size);
+  bool seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position(void) const;
+  size_t size(void) const;
+  const char* name(void) const;
+  void close(void);
+
+private:
+  std::string file_name;
+  std::shared_ptr<hal_fileTYPE> file;
+  bool file_writable;
+  size_t file_position;
+};
+
+class Dir
+{
+public:
+  Dir(const std::string &prefix);
+  bool next(void);
+  String fileName(void);
+  size_t fileSize(void);
+  File openFile(const char *mode);
+
+private:
+  std::string dir_prefix;
+  std::string current;
+};
+
+class FS
+{
+public:
+  bool begin(void);
+  void end(void);
+  bool format(void);
+  File open(const char *path, const char *mode);
+  File open(const String &path, const char *mode);
+  bool exists(const char *path);
+  bool exists(const String &path);
+  bool remove(const char *path);
+  bool rename(const char *from, const char *to);
+  Dir openDir(const char *path);
+  bool info(FSInfo &info);
+};
+extern FS SPIFFS;
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef __HAL_H
+#define __HAL_H
+
+/* The control side of the host core, used by the simulation and the tests (the sketch doesn't know about it) */
+
+#include <Arduino.h>
+
+/*------------------------------------------*/
+
+#define HAL_CYCLES_PER_US   80      /*the CPU clock of the ESP8266, everything is counted in these cycles*/
+#define HAL_YIELD_US        50      /*the time that passes in a yield() (the SDK does its own work)*/
+#define HAL_RTC_SIZE        512     /*the bytes of RTC memory that are available to the user*/
+#define HAL_UDP_LATENCY_US  15000   /*the time a packet needs to get to the server and back*/
+#define HAL_STRING_SSO      11      /*a String keeps this many characters in the object itself, a longer text is on the heap*/
+
+/*the mechanics, the outputs are reported after every change (and after every interrupt), the inputs are read when needed*/
+typedef void (*hal_outputsTYPE)(uint32_t levels);   /*GPIO0..16 as bits*/
+typedef uint32_t (*hal_inputsTYPE)(void);           /*GPIO0..16 as bits*/
+
+/*the answer of the webserver to a request*/
+typedef struct
+{
+  int code;
+  std::string type;
+  std::string body;
+  std::string headers;    /*"name: value\n" for every header that was sent*/
+} hal_responseTYPE;
+
+/*the behaviour of a timeserver (the others answer at once with the right time)*/
+typedef struct
+{
+  bool resolves;              /*false: the name can't be looked up*/
+  bool valid;                 /*false: the server answers with a "kiss of death"*/
+  unsigned long out_us;       /*the time the request needs to get to the server*/
+  unsigned long hold_us;      /*the time the server keeps the request (it reports this in its timestamps)*/
+  unsigned long back_us;      /*the time the reply needs to get back*/
+  long offset_us;             /*the error of the clock of the server*/
+} hal_ntp_serverTYPE;
+
+void Hal_attach(hal_outputsTYPE outputs, hal_inputsTYPE inputs);
+void Hal_advance(unsigned long long us);          /*let time pass (the timer interrupt and the network run)*/
+unsigned long long Hal_micros(void);              /*the virtual time in us since the start, this doesn't wrap*/
+unsigned long long Hal_cycles(void);              /*the same, in CPU cycles*/
+void Hal_verbose(bool enable);                    /*print the output of the serial port*/
+void Hal_reset_reason(uint32_t reason);           /*what ESP.getResetInfoPtr() reports*/
+uint8_t* Hal_rtc_memory(void);                    /*HAL_RTC_SIZE bytes, kept by a warm reset*/
+unsigned long Hal_yields(void);                   /*the number of times the sketch called yield(), that is when the SDK (and the watchdog) get their turn*/
+
+void Hal_utc(unsigned long long utc_us);          /*the real time (UTC in us since 1970) at this moment, the timeservers answer with it*/
+unsigned long long Hal_utc_now(void);
+void Hal_network(const char *ssid, const char *key);  /*the access point that can be found*/
+void Hal_ntp(bool reachable);                     /*false: the timeservers don't answer*/
+unsigned long Hal_ntp_requests(void);             /*the number of requests the timeservers have received*/
+void Hal_ntp_server(const char *name, const hal_ntp_serverTYPE *behaviour);  /*how this timeserver answers*/
+unsigned long Hal_ntp_server_requests(const char *name);  /*the number of requests this timeserver has received*/
+void Hal_udp_send(uint16_t port, const uint8_t *data, size_t size);  /*a packet arrives at the sockets on this port*/
+unsigned long Hal_sleep_changes(void);            /*the number of times the WiFi sleep mode has changed*/
+bool Hal_http(const char *uri, const char *args, hal_responseTYPE *response);  /*a request to the webserver ("name=value&..."), false when nobody handled it*/
+void Hal_http_header(const char *name, const char *value);  /*a header of the next request (like If-None-Match)*/
+unsigned long Hal_http_allocations(void);         /*the heap allocations the sketch made while handling the last request (those of the core are not counted)*/
+
+bool Hal_spiffs_load(const char *folder);         /*put the files of this folder in the SPIFFS*/
+void Hal_spiffs_write(const char *path, const char *text);
+bool Hal_spiffs_read(const char *path, std::string *data);
+unsigned long Hal_spiffs_writes(const char *path);  /*the number of times a file was opened for writing or appending*/
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef __IPADDRESS_H
+#define __IPADDRESS_H
+
+/* IPAddress (host), the address is kept like lwIP does: the first byte of the address is the lowest byte */
+
+#include <Arduino.h>
+
+/*------------------------------------------*/
+
+struct ip_addr;
+
+class IPAddress
+{
+public:
+  IPAddress();
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d);
+  IPAddress(uint32_t address);
+  IPAddress(const struct ip_addr *address);
+  operator uint32_t() const;
+  uint8_t operator[](int index) const;
+  bool operator==(const IPAddress &other) const;
+  bool operator!=(const IPAddress &other) const;
+  bool fromString(const char *text);
+  bool isSet(void) const;
+  String toString(void) const;
+
+private:
+  uint32_t addr;
+};
+
+#endif
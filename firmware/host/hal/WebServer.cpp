@@ -0,0 +1,358 @@
+/* Webserver (host)
+ * ================
+ * There is no TCP, a test hands a request to Hal_http() and the handler of the sketch is called directly,
+ * just like handleClient() would do. Everything the handler sends is collected in the response. The calls of
+ * malloc() the handler makes are counted, except those of the webserver itself (on the ESP it keeps the request
+ * and the response in Strings as well).
+*/
+
+#include <Arduino.h>
+#include <ESP8266WebServer.h>
+
+/*--------------------------------------------*/
+static ESP8266WebServer *instance = NULL;   /*the sketch has a single webserver*/
+static unsigned long allocations = 0;       /*made by the handler of the last request*/
+
+/*------------------------------------------------------------------------------------------*/
+void hal_heap_count(bool enable);           /*see Arduino.cpp*/
+unsigned long hal_heap_allocations(void);
+void hal_heap_pause(void);
+void hal_heap_resume(void);
+/*------------------------------------------------------------------------------------------*/
+
+/*a request to the webserver, args is like "name=value&name=value" (or NULL), false when nobody handled it*/
+bool Hal_http(const char *uri, const char *args, hal_responseTYPE *response)
+{
+  if(instance == NULL)
+  {
+    return(false);
+  }
+  return(instance->request(uri, args, response));
+}
+
+/*a header of the next request, only the headers the sketch collects are kept*/
+void Hal_http_header(const char *name, const char *value)
+{
+  if(instance != NULL)
+  {
+    instance->request_header(name, value);
+  }
+}
+
+unsigned long Hal_http_allocations(void)
+{
+  return(allocations);
+}
+
+/*................................................................*/
+
+ESP8266WebServer::ESP8266WebServer(int port) : current(NULL)
+{
+  (void)port;
+  instance = this;
+}
+
+void ESP8266WebServer::begin(void)
+{
+}
+
+void ESP8266WebServer::handleClient(void)
+{
+}
+
+void ESP8266WebServer::on(const char *uri, THandlerFunction handler)
+{
+  on(uri, HTTP_ANY, handler);
+}
+
+void ESP8266WebServer::on(const char *uri, HTTPMethod method, THandlerFunction handler)
+{
+  routeTYPE route;
+
+  route.uri = uri;
+  route.method = method;
+  route.handler = handler;
+  routes.push_back(route);
+}
+
+void ESP8266WebServer::onNotFound(THandlerFunction handler)
+{
+  not_found = handler;
+}
+
+void ESP8266WebServer::collectHeaders(const char *headerKeys[], size_t count)
+{
+  size_t i;
+
+  header_names.clear();
+  header_values.clear();
+  for(i=0; i<count; i++)
+  {
+    header_names.push_back(String(headerKeys[i]));
+    header_values.push_back(String());
+  }
+}
+
+void ESP8266WebServer::request_header(const char *name, const char *value)
+{
+  size_t i;
+
+  for(i=0; i<header_names.size(); i++)
+  {
+    if(strcasecmp(header_names[i].c_str(), name) == 0)
+    {
+      header_values[i] = value;
+    }
+  }
+}
+
+/*handle a GET request*/
+bool ESP8266WebServer::request(const char *uri, const char *args, hal_responseTYPE *response)
+{
+  std::string pairs = (args != NULL) ? args : "";
+  size_t start = 0;
+  size_t end;
+  size_t equal;
+
+  request_uri = uri;
+  arg_names.clear();
+  arg_values.clear();
+  while(start < pairs.size())
+  {
+    end = pairs.find('&', start);
+    if(end == std::string::npos)
+    {
+      end = pairs.size();
+    }
+    equal = pairs.find('=', start);
+    if((equal == std::string::npos) || (equal > end))
+    {
+      equal = end;
+    }
+    arg_names.push_back(String(pairs.substr(start, equal - start).c_str()));
+    arg_values.push_back(String((equal < end) ? pairs.substr(equal + 1, end - equal - 1).c_str() : ""));
+    start = end + 1;
+  }
+
+  response->code = 0;
+  response->type.clear();
+  response->body.clear();
+  response->headers.clear();
+  current = response;
+  for(routeTYPE &route : routes)
+  {
+    if((route.uri == uri) && ((route.method == HTTP_ANY) || (route.method == HTTP_GET)))
+    {
+      hal_heap_count(true);
+      route.handler();
+      hal_heap_count(false);
+      allocations = hal_heap_allocations();
+      request_done();
+      return(true);
+    }
+  }
+  hal_heap_count(true);
+  if(not_found)
+  {
+    not_found();
+  }
+  hal_heap_count(false);
+  allocations = hal_heap_allocations();
+  request_done();
+  return(response->code != 0);
+}
+
+/*the headers only belong to one request*/
+void ESP8266WebServer::request_done(void)
+{
+  size_t i;
+
+  current = NULL;
+  for(i=0; i<header_values.size(); i++)
+  {
+    header_values[i] = "";
+  }
+}
+
+const String& ESP8266WebServer::uri(void)
+{
+  return(request_uri);
+}
+
+HTTPMethod ESP8266WebServer::method(void)
+{
+  return(HTTP_GET);
+}
+
+int ESP8266WebServer::args(void)
+{
+  return(arg_names.size());
+}
+
+const String& ESP8266WebServer::arg(int index)
+{
+  return(((index >= 0) && ((size_t)index < arg_values.size())) ? arg_values[index] : empty);
+}
+
+const String& ESP8266WebServer::arg(const String &name)
+{
+  size_t i;
+
+  for(i=0; i<arg_names.size(); i++)
+  {
+    if(arg_names[i] == name)
+    {
+      return(arg_values[i]);
+    }
+  }
+  return(empty);
+}
+
+const String& ESP8266WebServer::argName(int index)
+{
+  return(((index >= 0) && ((size_t)index < arg_names.size())) ? arg_names[index] : empty);
+}
+
+bool ESP8266WebServer::hasArg(const String &name)
+{
+  size_t i;
+
+  for(i=0; i<arg_names.size(); i++)
+  {
+    if(arg_names[i] == name)
+    {
+      return(true);
+    }
+  }
+  return(false);
+}
+
+int ESP8266WebServer::headers(void)
+{
+  return(header_names.size());
+}
+
+const String& ESP8266WebServer::header(int index)
+{
+  return(((index >= 0) && ((size_t)index < header_values.size())) ? header_values[index] : empty);
+}
+
+const String& ESP8266WebServer::header(const String &name)
+{
+  size_t i;
+
+  for(i=0; i<header_names.size(); i++)
+  {
+    if(strcasecmp(header_names[i].c_str(), name.c_str()) == 0)
+    {
+      return(header_values[i]);
+    }
+  }
+  return(empty);
+}
+
+const String& ESP8266WebServer::headerName(int index)
+{
+  return(((index >= 0) && ((size_t)index < header_names.size())) ? header_names[index] : empty);
+}
+
+bool ESP8266WebServer::hasHeader(const String &name)
+{
+  return(header(name).length() > 0);
+}
+
+WiFiClient ESP8266WebServer::client(void)
+{
+  return(WiFiClient());
+}
+
+/*................................................................*/
+
+void ESP8266WebServer::send(int code, const char *content_type, const String &content)
+{
+  send(code, content_type, content.c_str(), content.length());
+}
+
+void ESP8266WebServer::send(int code, const char *content_type, const char *content)
+{
+  send(code, content_type, content, strlen(content));
+}
+
+void ESP8266WebServer::send(int code, const char *content_type, const char *content, size_t length)
+{
+  if(current == NULL)
+  {
+    return;
+  }
+  hal_heap_pause();
+  current->code = code;
+  current->type = content_type;
+  current->body.append(content, length);
+  hal_heap_resume();
+}
+
+void ESP8266WebServer::send_P(int code, const char *content_type, const char *content)
+{
+  send(code, content_type, content);
+}
+
+void ESP8266WebServer::send_P(int code, const char *content_type, const char *content, size_t length)
+{
+  send(code, content_type, content, length);
+}
+
+void ESP8266WebServer::sendHeader(const String &name, const String &value, bool first)
+{
+  (void)first;
+  if(current != NULL)
+  {
+    hal_heap_pause();
+    current->headers += std::string(name.c_str()) + ": " + value.c_str() + "\n";
+    hal_heap_resume();
+  }
+}
+
+void ESP8266WebServer::setContentLength(size_t length)
+{
+  (void)length;
+}
+
+void ESP8266WebServer::sendContent(const String &content)
+{
+  sendContent(content.c_str(), content.length());
+}
+
+void ESP8266WebServer::sendContent(const char *content, size_t length)
+{
+  if(current != NULL)
+  {
+    hal_heap_pause();
+    current->body.append(content, length);
+    hal_heap_resume();
+  }
+}
+
+void ESP8266WebServer::sendContent_P(const char *content)
+{
+  sendContent(content, strlen(content));
+}
+
+void ESP8266WebServer::sendContent_P(const char *content, size_t length)
+{
+  sendContent(content, length);
+}
+
+size_t ESP8266WebServer::streamFile(File &file, const String &content_type)
+{
+  uint8_t buf[512];
+  int n;
+  size_t total = 0;
+
+  send(200, content_type.c_str(), "", 0);
+  while((n = file.read(buf, sizeof(buf))) > 0)
+  {
+    sendContent((const char *)buf, n);
+    total = total + n;
+  }
+  return(total);
+}
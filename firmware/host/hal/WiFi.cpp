@@ -0,0 +1,593 @@
+/* WiFi (host)
+ * ===========
+ * One access point (set with Hal_network()) that is found by a scan and accepts the right key, the name
+ * lookups answer after a short while and the timeservers reply to every request with the time of the
+ * simulation (Hal_utc()). A test can make a timeserver slow, wrong or unknown (Hal_ntp_server()). Packets for
+ * the other ports (the beacons) arrive at the other sockets on that port (a LAN with all the clocks on it), a test
+ * can put in packets of its own as well.
+*/
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <vector>
+#include "Hal.h"
+
+extern "C" {
+#include "lwip/dns.h"
+}
+
+/*--------------------------------------------*/
+#define WIFI_CONNECT_US   1500000ULL  /*the time it takes to associate and get an address*/
+#define WIFI_SCAN_US      2200000ULL  /*the time a scan of all channels takes*/
+#define DNS_DELAY_US      30000ULL    /*the time the resolver needs*/
+#define NTP_PORT          123
+#define LAN_LATENCY_US    500ULL      /*the time a packet needs to get to another clock on the LAN*/
+#define NTP_SEVENTY_YEARS 2208988800ULL
+
+typedef struct
+{
+  std::string name;
+  dns_found_callback found;
+  void *arg;
+  unsigned long long due_us;
+} dns_queryTYPE;
+
+typedef struct
+{
+  std::string name;
+  IPAddress ip;
+  hal_ntp_serverTYPE behaviour;
+  unsigned long requests;
+} ntp_serverTYPE;
+
+static std::string network_ssid = "linear";
+static std::string network_key = "clock";
+static bool ntp_reachable = true;
+static unsigned long ntp_requests = 0;
+static unsigned long long utc_base_us = 1700000000ULL * 1000000ULL;   /*the real time at the moment utc_set_us*/
+static unsigned long long utc_set_us = 0;
+
+static WiFiMode_t wifi_mode = WIFI_OFF;
+static bool wifi_connecting = false;
+static unsigned long long connect_us = 0;     /*the moment the connection is made*/
+static bool scan_started = false;
+static unsigned long long scan_us = 0;        /*the moment the scan is complete*/
+static WiFiSleepType_t sleep_mode = WIFI_NONE_SLEEP;
+static unsigned long sleep_changes = 0;
+static uint8_t bssid[6] = {0x02, 0x00, 0x5E, 0x10, 0x20, 0x30};
+
+static std::vector<dns_queryTYPE> queries;
+static std::vector<ntp_serverTYPE> ntp_servers;   /*the timeservers that don't behave like the others*/
+
+ESP8266WiFiClass WiFi;
+
+/*------------------------------------------------------------------------------------------*/
+void hal_network_run(void);
+std::vector<WiFiUDP *>& udp_sockets(void);
+ntp_serverTYPE* ntp_find(const char *name);
+void ntp_reply(const std::string &request, const IPAddress &server, WiFiUDP *socket);
+void ntp_stamp(unsigned long long utc_us, std::string &packet, size_t offset);
+/*------------------------------------------------------------------------------------------*/
+
+/*the real time (UTC in us since 1970) at this moment*/
+void Hal_utc(unsigned long long utc_us)
+{
+  utc_base_us = utc_us;
+  utc_set_us = Hal_micros();
+}
+
+unsigned long long Hal_utc_now(void)
+{
+  return(utc_base_us + (Hal_micros() - utc_set_us));
+}
+
+void Hal_network(const char *ssid, const char *key)
+{
+  network_ssid = ssid;
+  network_key = key;
+}
+
+void Hal_ntp(bool reachable)
+{
+  ntp_reachable = reachable;
+}
+
+unsigned long Hal_ntp_requests(void)
+{
+  return(ntp_requests);
+}
+
+/*the behaviour of one timeserver, it gets an address of its own*/
+void Hal_ntp_server(const char *name, const hal_ntp_serverTYPE *behaviour)
+{
+  ntp_serverTYPE *server = ntp_find(name);
+
+  if(server == NULL)
+  {
+    ntp_servers.push_back(ntp_serverTYPE());
+    server = &ntp_servers.back();
+    server->name = name;
+    server->ip = IPAddress(10, 0, 1, ntp_servers.size());
+    server->requests = 0;
+  }
+  server->behaviour = *behaviour;
+}
+
+unsigned long Hal_ntp_server_requests(const char *name)
+{
+  ntp_serverTYPE *server = ntp_find(name);
+
+  return((server != NULL) ? server->requests : 0);
+}
+
+ntp_serverTYPE* ntp_find(const char *name)
+{
+  for(ntp_serverTYPE &server : ntp_servers)
+  {
+    if(server.name == name)
+    {
+      return(&server);
+    }
+  }
+  return(NULL);
+}
+
+unsigned long Hal_sleep_changes(void)
+{
+  return(sleep_changes);
+}
+
+/*the sockets of the sketch are constructed before main(), so the list must exist before the first one*/
+std::vector<WiFiUDP *>& udp_sockets(void)
+{
+  static std::vector<WiFiUDP *> sockets;
+
+  return(sockets);
+}
+
+/*a packet arrives at all sockets that listen on this port*/
+void Hal_udp_send(uint16_t port, const uint8_t *data, size_t size)
+{
+  hal_packetTYPE packet;
+
+  packet.arrival_us = Hal_micros();
+  packet.remote = IPAddress(192, 168, 1, 10);
+  packet.port = port;
+  packet.data.assign((const char *)data, size);
+  for(WiFiUDP *socket : udp_sockets())
+  {
+    if(socket->localPort() == port)
+    {
+      socket->receive(packet);
+    }
+  }
+}
+
+/*called when time has passed, the resolver answers*/
+void hal_network_run(void)
+{
+  ip_addr_t addr;
+  ntp_serverTYPE *server;
+  size_t i = 0;
+
+  while(i < queries.size())
+  {
+    if(queries[i].due_us > Hal_micros())
+    {
+      i++;
+      continue;
+    }
+    dns_queryTYPE query = queries[i];
+    queries.erase(queries.begin() + i);
+    addr.addr = IPAddress(10, 0, 0, 1 + (query.name.size() % 200));   /*every name has its own address*/
+    server = ntp_find(query.name.c_str());
+    if(server != NULL)
+    {
+      addr.addr = server->ip;
+    }
+    if((WiFi.status() != WL_CONNECTED) || ((server != NULL) && (server->behaviour.resolves == false)))
+    {
+      query.found(query.name.c_str(), NULL, query.arg);
+    }
+    else
+    {
+      query.found(query.name.c_str(), &addr, query.arg);
+    }
+  }
+}
+
+err_t dns_gethostbyname(const char *hostname, ip_addr_t *addr, dns_found_callback found, void *callback_arg)
+{
+  IPAddress ip;
+  dns_queryTYPE query;
+
+  if((hostname == NULL) || (hostname[0] == 0))
+  {
+    return(ERR_ARG);
+  }
+  if(ip.fromString(hostname) == true)
+  {
+    addr->addr = ip;
+    return(ERR_OK);
+  }
+  query.name = hostname;
+  query.found = found;
+  query.arg = callback_arg;
+  query.due_us = Hal_micros() + DNS_DELAY_US;
+  queries.push_back(query);
+  return(ERR_INPROGRESS);
+}
+
+/*the answer of a timeserver, the originate timestamp is the transmit timestamp of the request*/
+void ntp_reply(const std::string &request, const IPAddress &server, WiFiUDP *socket)
+{
+  hal_packetTYPE reply;
+  hal_ntp_serverTYPE behaviour = {true, true, HAL_UDP_LATENCY_US / 2, 0, HAL_UDP_LATENCY_US / 2, 0};
+  unsigned long long server_us;
+
+  for(ntp_serverTYPE &known : ntp_servers)
+  {
+    if(known.ip == server)
+    {
+      behaviour = known.behaviour;
+      known.requests++;
+    }
+  }
+  server_us = Hal_utc_now() + behaviour.out_us + behaviour.offset_us;   /*the moment the request arrives, according to the server*/
+
+  reply.arrival_us = Hal_micros() + behaviour.out_us + behaviour.hold_us + behaviour.back_us;
+  reply.remote = server;
+  reply.port = NTP_PORT;
+  reply.data.assign(48, 0);
+  reply.data[0] = 0x24;    /*no leap second, version 4, server*/
+  reply.data[1] = (behaviour.valid == true) ? 2 : 0;   /*stratum, 0 is a "kiss of death"*/
+  reply.data[2] = 6;
+  reply.data[3] = (char)0xEC;
+  reply.data.replace(24, 8, request, 40, 8);
+  ntp_stamp(server_us, reply.data, 32);
+  ntp_stamp(server_us + behaviour.hold_us, reply.data, 40);
+  socket->receive(reply);
+}
+
+void ntp_stamp(unsigned long long utc_us, std::string &packet, size_t offset)
+{
+  unsigned long long sec = (utc_us / 1000000ULL) + NTP_SEVENTY_YEARS;
+  unsigned long long frac = ((utc_us % 1000000ULL) << 32) / 1000000ULL;
+  unsigned char i;
+
+  for(i=0; i<4; i++)
+  {
+    packet[offset + i] = (char)(sec >> (24 - (8 * i)));
+    packet[offset + 4 + i] = (char)(frac >> (24 - (8 * i)));
+  }
+}
+
+/*................................................................*/
+
+IPAddress::IPAddress() : addr(0) {}
+IPAddress::IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : addr(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+IPAddress::IPAddress(uint32_t address) : addr(address) {}
+IPAddress::IPAddress(const struct ip_addr *address) : addr(address->addr) {}
+IPAddress::operator uint32_t() const                    {return(addr);}
+uint8_t IPAddress::operator[](int index) const          {return((addr >> (8 * index)) & 0xFF);}
+bool IPAddress::operator==(const IPAddress &other) const {return(addr == other.addr);}
+bool IPAddress::operator!=(const IPAddress &other) const {return(addr != other.addr);}
+bool IPAddress::isSet(void) const                       {return(addr != 0);}
+
+bool IPAddress::fromString(const char *text)
+{
+  unsigned int b[4];
+  char end;
+
+  if((sscanf(text, "%u.%u.%u.%u%c", &b[0], &b[1], &b[2], &b[3], &end) != 4) || (b[0] > 255) || (b[1] > 255) || (b[2] > 255) || (b[3] > 255))
+  {
+    return(false);
+  }
+  addr = IPAddress(b[0], b[1], b[2], b[3]);
+  return(true);
+}
+
+String IPAddress::toString(void) const
+{
+  char text[16];
+
+  snprintf(text, sizeof(text), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+  return(String(text));
+}
+
+/*................................................................*/
+
+size_t WiFiClient::write(uint8_t c)                             {(void)c; return(0);}
+size_t WiFiClient::write(const uint8_t *buffer, size_t size)    {(void)buffer; (void)size; return(0);}
+int WiFiClient::available(void)                                 {return(0);}
+int WiFiClient::read(void)                                      {return(-1);}
+int WiFiClient::peek(void)                                      {return(-1);}
+bool WiFiClient::connected(void)                                {return(false);}
+WiFiClient::operator bool(void)                                 {return(false);}
+void WiFiClient::stop(void)                                     {}
+void WiFiClient::setNoDelay(bool nodelay)                       {(void)nodelay;}
+IPAddress WiFiClient::remoteIP(void)                            {return(IPAddress());}
+int WiFiClient::availableForWrite(void)                         {return(0);}
+
+/*................................................................*/
+
+bool ESP8266WiFiClass::mode(WiFiMode_t mode)                    {wifi_mode = mode; return(true);}
+WiFiMode_t ESP8266WiFiClass::getMode(void)                      {return(wifi_mode);}
+void ESP8266WiFiClass::persistent(bool persistent)              {(void)persistent;}
+bool ESP8266WiFiClass::setAutoReconnect(bool autoReconnect)     {(void)autoReconnect; return(true);}
+bool ESP8266WiFiClass::hostname(const char *name)               {(void)name; return(true);}
+bool ESP8266WiFiClass::isConnected(void)                        {return(status() == WL_CONNECTED);}
+void ESP8266WiFiClass::scanDelete(void)                         {scan_started = false;}
+String ESP8266WiFiClass::SSID(uint8_t index)                    {(void)index; return(String(network_ssid.c_str()));}
+String ESP8266WiFiClass::SSID(void)                             {return(String(network_ssid.c_str()));}
+int32_t ESP8266WiFiClass::RSSI(uint8_t index)                   {(void)index; return(-60);}
+int32_t ESP8266WiFiClass::RSSI(void)                            {return(-60);}
+uint8_t ESP8266WiFiClass::encryptionType(uint8_t index)         {(void)index; return(ENC_TYPE_CCMP);}
+uint8_t* ESP8266WiFiClass::BSSID(uint8_t index)                 {(void)index; return(bssid);}
+uint8_t* ESP8266WiFiClass::BSSID(void)                          {return(bssid);}
+int32_t ESP8266WiFiClass::channel(uint8_t index)                {(void)index; return(6);}
+int32_t ESP8266WiFiClass::channel(void)                         {return(6);}
+IPAddress ESP8266WiFiClass::subnetMask(void)                    {return(IPAddress(255, 255, 255, 0));}
+IPAddress ESP8266WiFiClass::gatewayIP(void)                     {return(IPAddress(192, 168, 1, 1));}
+IPAddress ESP8266WiFiClass::dnsIP(uint8_t index)                {(void)index; return(IPAddress(192, 168, 1, 1));}
+bool ESP8266WiFiClass::softAPConfig(IPAddress local_ip, IPAddress gateway, IPAddress subnet) {(void)local_ip; (void)gateway; (void)subnet; return(true);}
+bool ESP8266WiFiClass::softAP(const char *ssid, const char *key){(void)ssid; (void)key; return(true);}
+bool ESP8266WiFiClass::softAPdisconnect(bool wifioff)           {(void)wifioff; return(true);}
+IPAddress ESP8266WiFiClass::softAPIP(void)                      {return(IPAddress(192, 168, 1, 1));}
+WiFiSleepType_t ESP8266WiFiClass::getSleepMode(void)            {return(sleep_mode);}
+void ESP8266WiFiClass::setOutputPower(float dBm)                {(void)dBm;}
+
+bool ESP8266WiFiClass::config(IPAddress local_ip, IPAddress gateway, IPAddress subnet, IPAddress dns1, IPAddress dns2)
+{
+  (void)local_ip; (void)gateway; (void)subnet; (void)dns1; (void)dns2;
+  return(true);
+}
+
+/*only our access point with the right key can be connected to*/
+int ESP8266WiFiClass::begin(const char *ssid, const char *key, int32_t channel, const uint8_t *bssid, bool connect)
+{
+  (void)channel;
+  (void)bssid;
+  wifi_connecting = false;
+  if((connect == true) && (network_ssid == ssid) && (network_key == key))
+  {
+    wifi_connecting = true;
+    connect_us = Hal_micros() + WIFI_CONNECT_US;
+  }
+  return(status());
+}
+
+bool ESP8266WiFiClass::disconnect(bool wifioff)
+{
+  (void)wifioff;
+  wifi_connecting = false;
+  return(true);
+}
+
+wl_status_t ESP8266WiFiClass::status(void)
+{
+  if((wifi_connecting == true) && (Hal_micros() >= connect_us))
+  {
+    return(WL_CONNECTED);
+  }
+  return(WL_DISCONNECTED);
+}
+
+int8_t ESP8266WiFiClass::scanNetworks(bool async, bool show_hidden)
+{
+  (void)show_hidden;
+  scan_started = true;
+  scan_us = Hal_micros() + WIFI_SCAN_US;
+  if(async == false)
+  {
+    Hal_advance(WIFI_SCAN_US);
+    return(scanComplete());
+  }
+  return(WIFI_SCAN_RUNNING);
+}
+
+int8_t ESP8266WiFiClass::scanComplete(void)
+{
+  if(scan_started == false)
+  {
+    return(WIFI_SCAN_FAILED);
+  }
+  if(Hal_micros() < scan_us)
+  {
+    return(WIFI_SCAN_RUNNING);
+  }
+  return(network_ssid.empty() ? 0 : 1);
+}
+
+IPAddress ESP8266WiFiClass::localIP(void)
+{
+  return((status() == WL_CONNECTED) ? IPAddress(192, 168, 1, 50) : IPAddress());
+}
+
+int ESP8266WiFiClass::hostByName(const char *name, IPAddress &result)
+{
+  if(result.fromString(name) == false)
+  {
+    result = IPAddress(10, 0, 0, 1 + (strlen(name) % 200));
+  }
+  return(1);
+}
+
+bool ESP8266WiFiClass::setSleepMode(WiFiSleepType_t type, uint8_t listenInterval)
+{
+  (void)listenInterval;
+  if(type != sleep_mode)
+  {
+    sleep_changes++;
+    sleep_mode = type;
+  }
+  return(true);
+}
+
+/*................................................................*/
+
+WiFiUDP::WiFiUDP() : local_port(0), current_position(0), out_port(0)
+{
+  udp_sockets().push_back(this);
+}
+
+WiFiUDP::~WiFiUDP()
+{
+  std::vector<WiFiUDP *> &sockets = udp_sockets();
+
+  sockets.erase(std::remove(sockets.begin(), sockets.end(), this), sockets.end());
+}
+
+uint8_t WiFiUDP::begin(uint16_t port)
+{
+  local_port = port;
+  return(1);
+}
+
+uint8_t WiFiUDP::beginMulticast(IPAddress interfaceAddr, IPAddress multicast, uint16_t port)
+{
+  (void)interfaceAddr;
+  (void)multicast;
+  local_port = port;
+  return(1);
+}
+
+void WiFiUDP::stop(void)
+{
+  local_port = 0;
+  queue.clear();
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port)
+{
+  out_ip = ip;
+  out_port = port;
+  out_data.clear();
+  return(1);
+}
+
+int WiFiUDP::beginPacketMulticast(IPAddress multicastAddress, uint16_t port, IPAddress interfaceAddress, int ttl)
+{
+  (void)interfaceAddress;
+  (void)ttl;
+  return(beginPacket(multicastAddress, port));
+}
+
+/*the packet leaves, the timeservers answer (when they can be reached), the other clocks receive the rest*/
+int WiFiUDP::endPacket(void)
+{
+  hal_packetTYPE packet;
+
+  if(WiFi.status() != WL_CONNECTED)
+  {
+    return(0);
+  }
+  if(out_port == NTP_PORT)
+  {
+    ntp_requests++;
+    if((ntp_reachable == true) && (out_data.size() >= 48))
+    {
+      ntp_reply(out_data, out_ip, this);
+    }
+    return(1);
+  }
+  packet.arrival_us = Hal_micros() + LAN_LATENCY_US;
+  packet.remote = WiFi.localIP();
+  packet.port = local_port;
+  packet.data = out_data;
+  for(WiFiUDP *socket : udp_sockets())
+  {
+    if((socket != this) && (socket->localPort() == out_port))
+    {
+      socket->receive(packet);
+    }
+  }
+  return(1);
+}
+
+size_t WiFiUDP::write(uint8_t c)
+{
+  out_data.push_back((char)c);
+  return(1);
+}
+
+size_t WiFiUDP::write(const uint8_t *buffer, size_t size)
+{
+  out_data.append((const char *)buffer, size);
+  return(size);
+}
+
+/*the next packet that has arrived, returns its size (0 when there is none)*/
+int WiFiUDP::parsePacket(void)
+{
+  if(queue.empty() || (queue.front().arrival_us > Hal_micros()))
+  {
+    current.data.clear();
+    current_position = 0;
+    return(0);
+  }
+  current = queue.front();
+  queue.pop_front();
+  current_position = 0;
+  return(current.data.size());
+}
+
+int WiFiUDP::available(void)
+{
+  return(current.data.size() - current_position);
+}
+
+int WiFiUDP::read(void)
+{
+  if(available() <= 0)
+  {
+    return(-1);
+  }
+  return((uint8_t)current.data[current_position++]);
+}
+
+int WiFiUDP::peek(void)
+{
+  if(available() <= 0)
+  {
+    return(-1);
+  }
+  return((uint8_t)current.data[current_position]);
+}
+
+int WiFiUDP::read(unsigned char *buffer, size_t len)
+{
+  size_t n = min(len, (size_t)available());
+
+  memcpy(buffer, current.data.data() + current_position, n);
+  current_position = current_position + n;
+  return(n);
+}
+
+int WiFiUDP::read(char *buffer, size_t len)
+{
+  return(read((unsigned char *)buffer, len));
+}
+
+void WiFiUDP::flush(void)
+{
+  current_position = current.data.size();
+}
+
+IPAddress WiFiUDP::remoteIP(void)       {return(current.remote);}
+uint16_t WiFiUDP::remotePort(void)      {return(current.port);}
+uint16_t WiFiUDP::localPort(void)       {return(local_port);}
+IPAddress WiFiUDP::destinationIP(void)  {return(IPAddress());}
+
+/*a packet for this socket, they are read in the order they arrive*/
+void WiFiUDP::receive(const hal_packetTYPE &packet)
+{
+  auto it = queue.begin();
+
+  while((it != queue.end()) && (it->arrival_us <= packet.arrival_us))
+  {
+    it++;
+  }
+  queue.insert(it, packet);
+}
@@ -0,0 +1,56 @@
+#ifndef __WIFIUDP_H
+#define __WIFIUDP_H
+
+/* UDP (host), the timeservers answer the requests to port 123, packets for other ports go to the other sockets on that port (or come from Hal_udp_send()) */
+
+#include <ESP8266WiFi.h>
+#include <deque>
+
+/*------------------------------------------*/
+
+struct hal_packetTYPE
+{
+  unsigned long long arrival_us;  /*the packet can be read from this moment on*/
+  IPAddress remote;
+  uint16_t port;
+  std::string data;
+};
+
+class WiFiUDP : public Stream
+{
+public:
+  WiFiUDP();
+  ~WiFiUDP();
+  uint8_t begin(uint16_t port);
+  uint8_t beginMulticast(IPAddress interfaceAddr, IPAddress multicast, uint16_t port);
+  void stop(void);
+  int beginPacket(IPAddress ip, uint16_t port);
+  int beginPacketMulticast(IPAddress multicastAddress, uint16_t port, IPAddress interfaceAddress, int ttl = 1);
+  int endPacket(void);
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int parsePacket(void);
+  int available(void) override;
+  int read(void) override;
+  int peek(void) override;
+  int read(unsigned char *buffer, size_t len);
+  int read(char *buffer, size_t len);
+  void flush(void) override;
+  IPAddress remoteIP(void);
+  uint16_t remotePort(void);
+  uint16_t localPort(void);
+  IPAddress destinationIP(void);
+  void receive(const hal_packetTYPE &packet);
+
+private:
+  uint16_t local_port;
+  std::deque<hal_packetTYPE> queue;   /*the packets that have not been parsed*/
+  hal_packetTYPE current;             /*the packet that is being read*/
+  size_t current_position;
+  IPAddress out_ip;
+  uint16_t out_port;
+  std::string out_data;
+};
+
+#endif
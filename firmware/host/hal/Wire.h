@@ -0,0 +1,15 @@
+#ifndef __WIRE_H
+#define __WIRE_H
+
+/* I2C (host), nothing is connected */
+
+#include <Arduino.h>
+
+class TwoWire
+{
+public:
+  void begin(int sda, int scl) {(void)sda; (void)scl;}
+};
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef __LWIP_DNS_H
+#define __LWIP_DNS_H
+
+/* The asynchronous resolver of lwIP (host), the answer comes after a while, see WiFi.cpp */
+
+#include <stdint.h>
+
+/*------------------------------------------*/
+
+typedef int8_t err_t;
+#define ERR_OK          0
+#define ERR_INPROGRESS  -5
+#define ERR_ARG         -16
+
+typedef struct ip_addr
+{
+  uint32_t addr;
+} ip_addr_t;
+
+#define ip_addr_get_ip4_u32(a)  ((a)->addr)
+#define ip4_addr_get_u32(a)     ((a)->addr)
+
+typedef void (*dns_found_callback)(const char *name, const ip_addr_t *ipaddr, void *callback_arg);
+err_t dns_gethostbyname(const char *hostname, ip_addr_t *addr, dns_found_callback found, void *callback_arg);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef __LWIP_INIT_H
+#define __LWIP_INIT_H
+
+/* lwIP (host), the version of the stack that the ESP8266 core uses by default */
+
+#define LWIP_VERSION_MAJOR  2
+
+#endif
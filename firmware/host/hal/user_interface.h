@@ -0,0 +1,8 @@
+#ifndef __USER_INTERFACE_H
+#define __USER_INTERFACE_H
+
+/* The SDK (host), the sketch only uses the reset reasons, these are in Arduino.h */
+
+#include <Arduino.h>
+
+#endif
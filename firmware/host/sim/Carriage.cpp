@@ -0,0 +1,169 @@
+/* Carriage
+ * ========
+ * The coils of the 28BYJ-48 are on GPIO13 (A), 14 (B), 12 (C) and 16 (D). Every pattern of the coils pulls the
+ * rotor to one of 8 phases, the difference with the previous phase is the number of half-steps (and the direction)
+ * the motor turns. A jump of 4 phases can't be followed, the rotor stays where it is.
+ *
+ * The sensors are active low. The home sensor is active above its edge. The updown sensor is high on the
+ * insulator between the two halves of the sensor bar and on the alarm blocks.
+*/
+
+#include <stdlib.h>
+#include <math.h>
+#include "Hal.h"
+#include "Carriage.h"
+
+/*--------------------------------------------*/
+#define COIL_A  13
+#define COIL_B  14
+#define COIL_C  12
+#define COIL_D  16
+
+static carriageTYPE carriage;
+static int phase = -1;                  /*the phase the rotor is in (-1: unknown, it takes the first pattern)*/
+static unsigned long steps = 0;
+static unsigned long skipped = 0;
+static bool energized = false;
+static unsigned long bounce_state = 1;  /*the contacts have their own random numbers, so the sketch gets the same ones with and without bouncing*/
+
+/*the pattern of every phase (A, B, C, D as bit 3...0), in the order of the turning direction UP*/
+static const unsigned char phases[8] = {0b0010, 0b0110, 0b0100, 0b0101, 0b0001, 0b1001, 0b1000, 0b1010};
+
+/*------------------------------------------------------------------------------------------*/
+static void carriage_outputs(uint32_t levels);
+static uint32_t carriage_inputs(void);
+static bool carriage_over(double minutes, double center);
+/*------------------------------------------------------------------------------------------*/
+
+void Carriage_init(const carriageTYPE *setup)
+{
+  carriage = *setup;
+  phase = -1;
+  steps = 0;
+  skipped = 0;
+  energized = false;
+  Hal_attach(carriage_outputs, carriage_inputs);
+}
+
+carriageTYPE* Carriage(void)
+{
+  return(&carriage);
+}
+
+double Carriage_minutes(void)
+{
+  return(carriage.position / carriage.ratio);
+}
+
+unsigned long Carriage_steps(void)
+{
+  return(steps);
+}
+
+bool Carriage_energized(void)
+{
+  return(energized);
+}
+
+unsigned long Carriage_skipped(void)
+{
+  return(skipped);
+}
+
+/*................................................................*/
+
+static void carriage_outputs(uint32_t levels)
+{
+  unsigned char pattern = (((levels >> COIL_A) & 1) << 3) | (((levels >> COIL_B) & 1) << 2) | (((levels >> COIL_C) & 1) << 1) | ((levels >> COIL_D) & 1);
+  int next = -1;
+  int delta;
+  int i;
+
+  energized = (pattern != 0);
+  for(i=0; i<8; i++)
+  {
+    if(phases[i] == pattern)
+    {
+      next = i;
+    }
+  }
+  if(next < 0)
+  {
+    return;     /*released (or nonsense), the gear holds the rotor*/
+  }
+  if(phase < 0)
+  {
+    phase = next;
+    return;
+  }
+
+  delta = (next - phase + 8) % 8;
+  if(delta == 4)
+  {
+    skipped++;  /*the rotor doesn't know which way to go*/
+    return;
+  }
+  if(delta > 4)
+  {
+    delta = delta - 8;
+  }
+  phase = next;
+  if(delta == 0)
+  {
+    return;
+  }
+  steps = steps + abs(delta);
+
+  carriage.position = carriage.position + delta;
+  if(carriage.position > (carriage.top * carriage.ratio))   /*against the end stop, the motor slips*/
+  {
+    carriage.position = carriage.top * carriage.ratio;
+  }
+  if(carriage.position < (carriage.bottom * carriage.ratio))
+  {
+    carriage.position = carriage.bottom * carriage.ratio;
+  }
+}
+
+static uint32_t carriage_inputs(void)
+{
+  double minutes = Carriage_minutes();
+  uint32_t levels = 0xFFFFFFFF;
+  bool updown = carriage_over(minutes, carriage.insulator);
+  double edge;
+  unsigned char i;
+
+  for(i=0; i<carriage.block_count; i++)
+  {
+    updown = updown || carriage_over(minutes, carriage.blocks[i]);
+  }
+
+  if(carriage.bounce > 0)   /*near an edge of the updown sensor the contact chatters*/
+  {
+    for(i=0; i<=carriage.block_count; i++)
+    {
+      edge = (i < carriage.block_count) ? carriage.blocks[i] : carriage.insulator;
+      if((fabs(carriage.position - ((edge - (CARRIAGE_BLOCK_WIDTH / 2)) * carriage.ratio)) < carriage.bounce) ||
+         (fabs(carriage.position - ((edge + (CARRIAGE_BLOCK_WIDTH / 2)) * carriage.ratio)) < carriage.bounce))
+      {
+        bounce_state = (bounce_state * 1103515245UL) + 12345UL;
+        updown = (((bounce_state >> 16) & 1) == 1);
+      }
+    }
+  }
+
+  if(updown == false)
+  {
+    levels &= ~(1UL << CARRIAGE_PIN_UPDOWN);
+  }
+  if(minutes >= carriage.home_edge)
+  {
+    levels &= ~(1UL << CARRIAGE_PIN_HOME);
+  }
+  return(levels);
+}
+
+static bool carriage_over(double minutes, double center)
+{
+  return((minutes >= (center - (CARRIAGE_BLOCK_WIDTH / 2))) && (minutes < (center + (CARRIAGE_BLOCK_WIDTH / 2))));
+}
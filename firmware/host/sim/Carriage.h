@@ -0,0 +1,38 @@
+#ifndef __CARRIAGE_H
+#define __CARRIAGE_H
+
+/* The mechanics of the clock: the motor, the threaded rod with the indicator and the sensor bar.
+ * The position of the indicator is in half-steps from the point 0:00 on the scale, the motor turns the way
+ * the coils tell it. UP is towards the home sensor (the position increases).
+*/
+
+#include <stdint.h>
+
+/*------------------------------------------*/
+
+#define CARRIAGE_PIN_UPDOWN     4
+#define CARRIAGE_PIN_HOME       5
+#define CARRIAGE_BLOCKS         4       /*the number of alarm blocks that can be placed*/
+#define CARRIAGE_BLOCK_WIDTH    6.0     /*the width of an alarm block (and the insulator) in minutes (mm)*/
+
+typedef struct
+{
+  double ratio;             /*the real number of half-steps per minute*/
+  double position;          /*in half-steps from 0:00*/
+  double home_edge;         /*in minutes, beyond this point the home sensor is active*/
+  double insulator;         /*in minutes, the center of the insulator between the two halves of the sensor bar*/
+  double blocks[CARRIAGE_BLOCKS];   /*in minutes, the centers of the alarm blocks (only the first block_count are used)*/
+  unsigned char block_count;
+  double top;               /*in minutes, the end stops, the motor slips when it pushes against them*/
+  double bottom;
+  unsigned int bounce;      /*within this number of half-steps from an edge of the updown sensor, it reads a random level*/
+} carriageTYPE;
+
+void Carriage_init(const carriageTYPE *setup);  /*connects to the pins of the host core*/
+carriageTYPE* Carriage(void);                    /*the state, it can be changed at any time (to lose steps for example)*/
+double Carriage_minutes(void);                   /*the position of the indicator on the scale*/
+unsigned long Carriage_steps(void);              /*the number of half-steps the motor has made (in any direction)*/
+bool Carriage_energized(void);                   /*true when a coil is on*/
+unsigned long Carriage_skipped(void);            /*the number of coil changes that the rotor couldn't follow*/
+
+#endif
@@ -0,0 +1,61 @@
+/* Sim
+ * ===
+ * The scheduler of the sketch sleeps (delay()) when nothing is due, on the host that only advances the virtual
+ * time, so a day of the clock takes a few seconds.
+*/
+
+#include <Arduino.h>
+#include "Hal.h"
+#include "Sim.h"
+#include "../../Lin_clock/Scheduler.h"
+
+/*--------------------------------------------*/
+#define SIM_HOME_MINUTES  ((11 * 60) + 59)  /*the point where the indicator waits during the last minute before noon*/
+
+void setup();
+
+/*------------------------------------------------------------------------------------------*/
+
+void Sim_boot(uint32_t reason)
+{
+  Hal_reset_reason(reason);
+  setup();
+}
+
+void Sim_run(unsigned long ms)
+{
+  unsigned long long end = Hal_micros() + (ms * 1000ULL);
+
+  while(Hal_micros() < end)
+  {
+    Scheduler_run();
+  }
+}
+
+bool Sim_until(bool (*done)(void), unsigned long ms)
+{
+  unsigned long long end = Hal_micros() + (ms * 1000ULL);
+
+  while(Hal_micros() < end)
+  {
+    if(done() == true)
+    {
+      return(true);
+    }
+    Scheduler_run();
+  }
+  return(done());
+}
+
+/*before noon the indicator moves up from 0:00, after noon it comes down again*/
+double Sim_expected(unsigned long long utc_us, long offset_s)
+{
+  unsigned long long local = (utc_us / 1000000ULL) + offset_s;
+  unsigned long minute = (local % 86400ULL) / 60;
+
+  if(minute < 720)
+  {
+    return((minute < SIM_HOME_MINUTES) ? minute : SIM_HOME_MINUTES);
+  }
+  return((minute > (SIM_HOME_MINUTES + 720)) ? 0 : ((SIM_HOME_MINUTES + 720) - minute));
+}
@@ -0,0 +1,15 @@
+#ifndef __SIM_H
+#define __SIM_H
+
+/* Runs the sketch on the host core, with the carriage (see Carriage.h) attached to the pins */
+
+#include <stdint.h>
+
+/*------------------------------------------*/
+
+void Sim_boot(uint32_t reason);                   /*start the sketch (setup()), reason is what ESP.getResetInfoPtr() reports*/
+void Sim_run(unsigned long ms);                   /*let the sketch run (the main loop) for this time*/
+bool Sim_until(bool (*done)(void), unsigned long ms);  /*run until done() returns true, false when that takes longer than ms*/
+double Sim_expected(unsigned long long utc_us, long offset_s);  /*the point on the scale (in minutes) the indicator should show at this moment*/
+
+#endif
@@ -0,0 +1,4 @@
+/* The sketch itself, the Arduino IDE adds the prototypes and Arduino.h, the functions above are declared in the sketch already */
+
+#include <Arduino.h>
+#include "../../Lin_clock/Lin_clock.ino"
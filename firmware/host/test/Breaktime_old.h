@@ -0,0 +1,64 @@
+#ifndef __BREAKTIME_OLD_H
+#define __BREAKTIME_OLD_H
+
+/* The original breaktime() (before it was made incremental), the reference for the test and the benchmark */
+
+/*------------------------------------------*/
+
+#define OLD_LEAP_YEAR(Y)    (((Y) > 0) && !((Y) % 4) && (((Y) % 100) || !((Y) % 400)))
+
+typedef struct
+{
+  unsigned int year;
+  unsigned char month;
+  unsigned char day;
+  unsigned char hour;
+  unsigned char minute;
+  unsigned char second;
+  unsigned char weekday;
+} old_timeTYPE;
+
+static const unsigned char old_monthDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+/*convert seconds since 1970 into a more user readable format*/
+static inline void old_breaktime(uint32_t timeInput, old_timeTYPE *t)
+{
+  uint32_t days;
+  unsigned char months;
+  unsigned char days_in_month;
+
+  t->second = timeInput % 60;
+  timeInput /= 60;
+  t->minute = timeInput % 60;
+  timeInput /= 60;
+  t->hour = timeInput % 24;
+  timeInput /= 24;
+  t->weekday = ((timeInput + 4) % 7) + 1;
+
+  t->year = 1970;
+  days = 0;
+  while((unsigned)(days += (OLD_LEAP_YEAR(t->year) ? 366 : 365)) <= timeInput)
+  {
+    t->year++;
+  }
+  days -= OLD_LEAP_YEAR(t->year) ? 366 : 365;
+  timeInput -= days;
+
+  for(months=0; months<12; months++)
+  {
+    if(months == 1)
+    {
+      days_in_month = OLD_LEAP_YEAR(t->year) ? 29 : 28;
+    }
+    else
+    {
+      days_in_month = old_monthDays[months];
+    }
+    if(timeInput >= days_in_month) {timeInput -= days_in_month;}
+    else                           {break;}
+  }
+  t->month = months + 1;
+  t->day = timeInput + 1;
+}
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef __CHECK_H
+#define __CHECK_H
+
+/* The tests are small programs, a failed check is printed and makes the program fail (ctest only looks at the exit code) */
+
+#include <stdio.h>
+
+/*------------------------------------------*/
+
+static int check_failures = 0;
+
+#define CHECK(condition)    check((condition), #condition, __FILE__, __LINE__)
+#define CHECK_RESULT()      ((check_failures == 0) ? 0 : 1)
+
+static inline bool check(bool ok, const char *condition, const char *file, int line)
+{
+  if(ok == false)
+  {
+    printf("%s:%d: check failed: %s\n", file, line, condition);
+    check_failures++;
+  }
+  return(ok);
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef __STEPS_H
+#define __STEPS_H
+
+/* Records every step the coils make: the moment (in CPU cycles) and the number of half-steps (negative is DOWN) */
+
+#include <vector>
+#include "Hal.h"
+
+/*------------------------------------------*/
+
+typedef struct
+{
+  unsigned long long cycles;
+  int halfsteps;
+} stepTYPE;
+
+static std::vector<stepTYPE> steps_recorded;
+static unsigned long long steps_start = 0;
+static int steps_phase = -1;
+
+/*the pattern of every phase (A, B, C, D as bit 3...0), in the order of the direction UP*/
+static const unsigned char steps_phases[8] = {0b0010, 0b0110, 0b0100, 0b0101, 0b0001, 0b1001, 0b1000, 0b1010};
+
+static void steps_outputs(uint32_t levels)
+{
+  unsigned char pattern = (((levels >> 13) & 1) << 3) | (((levels >> 14) & 1) << 2) | (((levels >> 12) & 1) << 1) | ((levels >> 16) & 1);
+  int delta;
+  int i;
+
+  for(i=0; i<8; i++)
+  {
+    if(steps_phases[i] == pattern)
+    {
+      if(steps_phase >= 0)
+      {
+        delta = (i - steps_phase + 8) % 8;
+        if(delta != 0)
+        {
+          steps_recorded.push_back({Hal_cycles(), (delta > 4) ? (delta - 8) : delta});
+        }
+      }
+      steps_phase = i;
+    }
+  }
+}
+
+/*start recording, the moment of the first step of the next move is measured from now*/
+static void Steps_record(void)
+{
+  Hal_attach(steps_outputs, NULL);
+  steps_recorded.clear();
+  steps_start = Hal_cycles();
+}
+
+/*the time (in us) between a step and the one before it (the first one is measured from the start)*/
+static double Steps_interval(size_t i)
+{
+  return((steps_recorded[i].cycles - ((i == 0) ? steps_start : steps_recorded[i - 1].cycles)) / (double)HAL_CYCLES_PER_US);
+}
+
+#endif
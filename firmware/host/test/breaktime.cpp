@@ -0,0 +1,89 @@
+/* breaktime() must give the same date and time as the original implementation, for every day from 1970 to 2106
+ * (the whole range of the 32 bit epoch), when it jumps and when it counts the seconds one by one */
+
+#include <Arduino.h>
+#include "NTP.h"
+#include "Breaktime_old.h"
+#include "Check.h"
+
+/*--------------------------------------------*/
+#define LAST_DAY    (0xFFFFFFFFUL / 86400UL)
+
+void breaktime(unsigned long timeInput);
+
+/*the seconds of the day that are converted directly (after a jump)*/
+static const uint32_t day_seconds[] = {0, 1, 59, 60, 61, 3599, 3600, 43199, 43200, 86340, 86398, 86399};
+
+/*------------------------------------------------------------------------------------------*/
+
+static bool same(uint32_t epoch)
+{
+  old_timeTYPE t;
+
+  old_breaktime(epoch, &t);
+  if((NTP_struct.year != t.year) || (NTP_struct.month != t.month) || (NTP_struct.day != t.day) || (NTP_struct.hour != t.hour) ||
+     (NTP_struct.minute != t.minute) || (NTP_struct.second != t.second) || (NTP_struct.weekday != t.weekday))
+  {
+    printf("%lu: %u-%u-%u %u:%u:%u (%u) instead of %u-%u-%u %u:%u:%u (%u)\n", (unsigned long)epoch,
+           NTP_struct.year, NTP_struct.month, NTP_struct.day, NTP_struct.hour, NTP_struct.minute, NTP_struct.second, NTP_struct.weekday,
+           t.year, t.month, t.day, t.hour, t.minute, t.second, t.weekday);
+    return(false);
+  }
+  return(true);
+}
+
+/*count the seconds one by one*/
+static void walk(uint32_t from, uint32_t count)
+{
+  uint32_t i;
+
+  for(i=0; i<count; i++)
+  {
+    breaktime(from + i);
+    if(CHECK(same(from + i)) == false)
+    {
+      return;
+    }
+  }
+}
+
+int main(void)
+{
+  unsigned long day;
+  unsigned char i;
+  uint32_t epoch;
+
+  NTP_struct.second = 58;           /*whatever was there before, the first call must not take it for the previous second*/
+  breaktime(0);
+  CHECK(same(0));
+  breaktime(0);
+  CHECK(same(0));
+
+  for(day=0; day<=LAST_DAY; day++)  /*every day, at the start, the end and some moments in between*/
+  {
+    for(i=0; i<(sizeof(day_seconds) / sizeof(day_seconds[0])); i++)
+    {
+      epoch = (day * 86400UL) + day_seconds[i];
+      if(epoch < (day * 86400UL))  /*beyond the end of the epoch*/
+      {
+        break;
+      }
+      breaktime(epoch);
+      if(CHECK(same(epoch)) == false)
+      {
+        return(CHECK_RESULT());
+      }
+    }
+  }
+
+  walk(0, 3 * 86400);               /*the first days*/
+  walk(951696000UL - 86400, 3 * 86400);   /*2000-02-28 ... 2000-03-02, a leap year (divisible by 400)*/
+  walk(1709078400UL, 2 * 86400);    /*2024-02-28 ... 2024-02-29*/
+  walk(1703980800UL, 2 * 86400);    /*2023-12-31 ... 2024-01-01*/
+  walk(4107456000UL, 3 * 86400);    /*2100-02-27 ... 2100-03-01, not a leap year*/
+  walk(0xFFFFFFFFUL - (2 * 86400), (2 * 86400) + 1);  /*up to the end of the epoch (2106-02-07)*/
+
+  breaktime(1700000000UL);          /*back in time*/
+  CHECK(same(1700000000UL));
+  return(CHECK_RESULT());
+}
@@ -0,0 +1,68 @@
+/* How long breaktime() takes, compared to the original implementation.
+ * Not a test (the numbers depend on the PC), run it by hand: ./breaktime_bench
+ * Counting: one call per second, as the clock does. Jumping: a random moment in 1970...2106 for every call. */
+
+#include <Arduino.h>
+#include <chrono>
+#include <vector>
+#include "NTP.h"
+#include "Breaktime_old.h"
+
+/*--------------------------------------------*/
+#define CALLS   10000000UL
+
+void breaktime(unsigned long timeInput);
+
+static volatile unsigned char sink;   /*so the compiler doesn't remove the work*/
+
+/*------------------------------------------------------------------------------------------*/
+
+static double ns_per_call(std::chrono::steady_clock::time_point start)
+{
+  return(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / CALLS);
+}
+
+int main(void)
+{
+  std::vector<uint32_t> moments(CALLS);
+  old_timeTYPE t;
+  unsigned long i;
+  uint32_t x = 1;
+
+  for(i=0; i<CALLS; i++)
+  {
+    x = (x * 1103515245UL) + 12345UL;
+    moments[i] = x;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for(i=0; i<CALLS; i++)
+  {
+    old_breaktime(1700000000UL + i, &t);
+    sink = t.year + t.month + t.day + t.second;
+  }
+  printf("counting: old %6.1f ns/call, ", ns_per_call(start));
+  start = std::chrono::steady_clock::now();
+  for(i=0; i<CALLS; i++)
+  {
+    breaktime(1700000000UL + i);
+    sink = NTP_struct.year + NTP_struct.month + NTP_struct.day + NTP_struct.second;
+  }
+  printf("new %6.1f ns/call\n", ns_per_call(start));
+
+  start = std::chrono::steady_clock::now();
+  for(i=0; i<CALLS; i++)
+  {
+    old_breaktime(moments[i], &t);
+    sink = t.year + t.month + t.day + t.second;
+  }
+  printf("jumping:  old %6.1f ns/call, ", ns_per_call(start));
+  start = std::chrono::steady_clock::now();
+  for(i=0; i<CALLS; i++)
+  {
+    breaktime(moments[i]);
+    sink = NTP_struct.year + NTP_struct.month + NTP_struct.day + NTP_struct.second;
+  }
+  printf("new %6.1f ns/call\n", ns_per_call(start));
+  return(0);
+}
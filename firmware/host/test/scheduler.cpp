@@ -0,0 +1,43 @@
+/* The scheduler with a task that is due all the time (like the clock and the audio while the motor runs and the
+ * sound plays): every pass must still yield, otherwise the SDK (the WiFi stack) and the watchdog get no turn. */
+
+#include <Arduino.h>
+#include "Hal.h"
+#include "Check.h"
+#include "Scheduler.h"
+
+/*--------------------------------------------*/
+#define PASSES  10000
+
+static unsigned long runs = 0;
+
+/*------------------------------------------------------------------------------------------*/
+
+static void busy_task(void)
+{
+  runs++;
+  delayMicroseconds(200);   /*a bit of work*/
+}
+
+static void slow_task(void)
+{
+}
+
+int main(void)
+{
+  unsigned long yields;
+  unsigned long i;
+
+  Scheduler_add(busy_task, 0);              /*always due*/
+  Scheduler_add(slow_task, 100000);
+
+  yields = Hal_yields();
+  for(i=0; i<PASSES; i++)
+  {
+    Scheduler_run();
+  }
+  printf("%lu passes, %lu runs, %lu yields\n", (unsigned long)PASSES, runs, Hal_yields() - yields);
+  CHECK(runs == PASSES);
+  CHECK((Hal_yields() - yields) >= PASSES);
+  return(CHECK_RESULT());
+}
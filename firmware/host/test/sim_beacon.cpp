@@ -0,0 +1,180 @@
+/* A follower (the sketch) and a master on one LAN: the master is a second copy of Beacon.cpp, compiled into its own
+ * namespace with a clock that is 250 ms ahead of the timeservers, so it is clear where the follower gets its time.
+ * The beacons go through the UDP of the host core. The follower must:
+ *   - lock to the master without asking the timeservers
+ *   - reject a beacon with a wrong key and a copy of a beacon it has accepted already
+ *   - still reject that copy after a warm reset (the time of the last beacon is kept in the RTC memory)
+ *   - use the timeservers again when the master has been quiet for BEACON_TIMEOUT
+*/
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include <unistd.h>
+#include "Hal.h"
+#include "Carriage.h"
+#include "Sim.h"
+#include "Check.h"
+#include "Beacon.h"
+#include "NTP.h"
+#include "Network.h"
+
+/*--------------------------------------------*/
+#define RATIO             (4076.0)
+#define START_UTC         1700000000ULL   /*Tue 14 Nov 2023 22:13:20 UTC*/
+#define MASTER_OFFSET_US  250000LL        /*the master is this far ahead of the timeservers*/
+#define ACCURATE_MS       15.0            /*the follower reads the beacons every 10 ms, the LAN adds a little*/
+
+static const char config[] = "{\"ssid\":\"linear\",\"key\":\"clock\",\"ntp\":\"pool.ntp.org\",\"offset\":\"0\",\"dst\":false,\"tz\":\"\",\"alarm\":false,\"chime\":false,\"beacon\":\"follower\",\"beacon_key\":\"secret\"}";
+
+/*the master, only the parts of the sketch that Beacon.cpp uses are imitated*/
+namespace master
+{
+  NTP_structTYPE NTP_struct;
+
+  unsigned long long NTP_now(void)            {return(Hal_utc_now() + MASTER_OFFSET_US);}
+  void NTP_follow(bool enable)                {(void)enable;}
+  void NTP_beacon(unsigned long long time_us) {(void)time_us;}
+  bool Network_connected(void)                {return(true);}
+
+  #include "Beacon.cpp"
+}
+
+/*------------------------------------------------------------------------------------------*/
+
+/*let the follower run, the master sends its beacons when it is on*/
+static void run(unsigned long ms, bool master_on)
+{
+  unsigned long i;
+
+  for(i=0; i<(ms / 10); i++)
+  {
+    if(master_on == true)
+    {
+      master::Beacon_process();
+    }
+    Sim_run(10);
+  }
+}
+
+/*a number from the beacon report of the follower*/
+static unsigned long report(const char *name)
+{
+  const char *p = strstr(Beacon_text(), name);
+
+  return((p != NULL) ? strtoul(p + strlen(name) + 1, NULL, 10) : 0xFFFFFFFFUL);
+}
+
+/*the difference (in ms) between the follower and the master*/
+static double error_ms(void)
+{
+  return(((double)(long long)(NTP_now() - master::NTP_now())) / 1000.0);
+}
+
+static void master_start(void)
+{
+  master::NTP_struct.synced = true;
+  master::Beacon_init("master", "secret");
+}
+
+int main(int argc, char *argv[])
+{
+  carriageTYPE carriage = {RATIO, 500.0 * RATIO, 777.0, 359.5, {}, 0, 800.0, -10.0, 0};
+  char folder[] = "/tmp/sim_beaconXXXXXX";
+  uint8_t forged[BEACON_SIZE];
+  uint8_t copy[BEACON_SIZE];
+  uint64_t tag;
+  unsigned long long utc;
+  unsigned char i;
+  FILE *f;
+
+  Hal_verbose(getenv("SIM_VERBOSE") != NULL);
+  Hal_network("linear", "clock");
+  Carriage_init(&carriage);
+  master_start();
+
+  if(argc == 2)     /*before the reset*/
+  {
+    Hal_spiffs_load(argv[1]);
+    Hal_spiffs_write("/config.json", config);
+    Hal_utc(START_UTC * 1000000ULL);
+    Sim_boot(REASON_DEFAULT_RST);
+    run(60000UL, true);
+    printf("following: %lu accepted, %lu rejected, error %.1f ms, %lu NTP requests\n", report("accepted"), report("rejected"), error_ms(), Hal_ntp_requests());
+    CHECK(report("accepted") >= 5);
+    CHECK(report("rejected") == 0);
+    CHECK(NTP_struct.synced == true);
+    CHECK((error_ms() > -ACCURATE_MS) && (error_ms() < ACCURATE_MS));
+    CHECK(Hal_ntp_requests() == 0);
+
+    memcpy(forged, master::packet, BEACON_SIZE);  /*ten seconds later, signed with the wrong key*/
+    forged[18]++;
+    forged[19] = 0;
+    tag = master::beacon_siphash((const uint8_t *)"not the secret!!", forged, 20);
+    for(i=0; i<8; i++)  {forged[20 + i] = tag >> (8 * i);}
+    Hal_udp_send(BEACON_PORT, forged, BEACON_SIZE);
+    memcpy(copy, master::packet, BEACON_SIZE);    /*the last beacon, it has been accepted already*/
+    Hal_udp_send(BEACON_PORT, copy, BEACON_SIZE);
+    run(100, false);
+    printf("forged and copied: %lu rejected, error %.1f ms\n", report("rejected"), error_ms());
+    CHECK(report("rejected") == 2);
+    CHECK((error_ms() > -ACCURATE_MS) && (error_ms() < ACCURATE_MS));
+
+    if(CHECK(mkdtemp(folder) != NULL) == false)
+    {
+      return(CHECK_RESULT());
+    }
+    f = fopen((std::string(folder) + "/state.bin").c_str(), "wb");
+    utc = Hal_utc_now();
+    fwrite(Hal_rtc_memory(), 1, HAL_RTC_SIZE, f);
+    fwrite(copy, 1, BEACON_SIZE, f);
+    fwrite(&utc, 1, sizeof(utc), f);
+    fclose(f);
+    fflush(stdout);
+    execl(argv[0], argv[0], argv[1], folder, (char *)NULL);
+    CHECK(false);
+    return(CHECK_RESULT());
+  }
+  if(argc != 3)
+  {
+    printf("usage: %s <data folder>\n", argv[0]);
+    return(1);
+  }
+
+  Hal_spiffs_load(argv[1]);                       /*after the reset, only the RTC memory is kept*/
+  Hal_spiffs_write("/config.json", config);
+  f = fopen((std::string(argv[2]) + "/state.bin").c_str(), "rb");
+  CHECK(fread(Hal_rtc_memory(), 1, HAL_RTC_SIZE, f) == HAL_RTC_SIZE);
+  CHECK(fread(copy, 1, BEACON_SIZE, f) == BEACON_SIZE);
+  CHECK(fread(&utc, 1, sizeof(utc), f) == sizeof(utc));
+  fclose(f);
+  CHECK(system((std::string("rm -rf ") + argv[2]).c_str()) == 0);
+  Hal_utc(utc + 1000000ULL);                      /*the reset took a second*/
+  Sim_boot(REASON_SOFT_RESTART);
+
+  run(5000UL, false);                             /*connected and joined*/
+  Hal_udp_send(BEACON_PORT, copy, BEACON_SIZE);
+  run(100, false);
+  printf("copy after the reset: %lu accepted, %lu rejected\n", report("accepted"), report("rejected"));
+  CHECK(report("accepted") == 0);
+  CHECK(report("rejected") == 1);
+  CHECK(NTP_struct.synced == false);
+
+  run(20000UL, true);
+  printf("master again: %lu accepted, error %.1f ms\n", report("accepted"), error_ms());
+  CHECK(report("accepted") >= 2);
+  CHECK(NTP_struct.synced == true);
+  CHECK((error_ms() > -ACCURATE_MS) && (error_ms() < ACCURATE_MS));
+
+  run(BEACON_TIMEOUT - 5000UL, false);            /*the master is gone, the follower waits a while*/
+  CHECK(report("following") == 1);
+  CHECK(Hal_ntp_requests() == 0);
+  run(15000UL, false);
+  printf("master lost: following %lu, %lu NTP requests, offset %ld ms\n", report("following"), Hal_ntp_requests(), NTP_struct.offset_ms);
+  CHECK(report("following") == 0);
+  CHECK(Hal_ntp_requests() > 0);
+  CHECK((NTP_struct.offset_ms > -270) && (NTP_struct.offset_ms < -230));   /*the timeservers are 250 ms behind the master*/
+  run(30000UL, false);                            /*the offset is slewed away, it is not mistaken for drift*/
+  CHECK(((long long)(NTP_now() - Hal_utc_now()) > -2000LL) && ((long long)(NTP_now() - Hal_utc_now()) < 2000LL));
+  return(CHECK_RESULT());
+}
@@ -0,0 +1,79 @@
+/* Calibration on a clock whose gearbox differs from the default: with an alarm block close to the insulator it must
+ * refuse, with the blocks further away it must measure the ratio, after which the time is right over the whole scale.
+*/
+
+#include <Arduino.h>
+#include <math.h>
+#include "Hal.h"
+#include "Carriage.h"
+#include "Sim.h"
+#include "Check.h"
+#include "Scale.h"
+
+/*--------------------------------------------*/
+#define RATIO           (4050.0)        /*0.6% less than the default of the firmware*/
+#define START_UTC       1700000000ULL   /*Tue 14 Nov 2023 22:13:20 UTC*/
+#define HOUR_MS         (60UL * 60UL * 1000UL)
+#define CHECK_EVERY_MS  (10UL * 60UL * 1000UL)
+
+static const char config[] = "{\"ssid\":\"linear\",\"key\":\"clock\",\"ntp\":\"pool.ntp.org\",\"offset\":\"0\",\"dst\":false,\"tz\":\"\",\"alarm\":false,\"chime\":false}";
+
+/*------------------------------------------------------------------------------------------*/
+
+static bool shown(void)
+{
+  return(fabs(Carriage_minutes() - Sim_expected(Hal_utc_now(), 0)) < 0.1);
+}
+
+static bool calibrated(void)
+{
+  return(Scale_ratio() != SCALE_DEFAULT);
+}
+
+static void calibrate(void)
+{
+  hal_responseTYPE response;
+
+  Hal_http("/calibrate", NULL, &response);
+}
+
+int main(int argc, char *argv[])
+{
+  carriageTYPE carriage = {RATIO, 500.0 * RATIO, 777.0, 359.5, {370.0, 700.0}, 2, 800.0, -10.0, 0};
+  unsigned long i;
+  double error;
+  double worst = 0;
+
+  (void)argc;
+  Hal_verbose(getenv("SIM_VERBOSE") != NULL);
+  Hal_spiffs_load(argv[1]);
+  Hal_spiffs_write("/config.json", config);
+  Hal_utc(START_UTC * 1000000ULL);
+  Hal_network("linear", "clock");
+  Carriage_init(&carriage);
+
+  Sim_boot(REASON_DEFAULT_RST);
+  Sim_run(2UL * HOUR_MS);
+
+  calibrate();                                /*a block at 6:10 looks like the insulator*/
+  CHECK(Sim_until(calibrated, 4UL * HOUR_MS) == false);
+
+  Carriage()->blocks[0] = 320.0;              /*moved away from 6:00*/
+  calibrate();
+  CHECK(Sim_until(calibrated, 2UL * HOUR_MS) == true);
+  printf("measured %.3f steps per minute\n", Scale_ratio() / 65536.0);
+  CHECK(fabs((Scale_ratio() / 65536.0) - RATIO) < 0.5);
+  CHECK(Sim_until(shown, 2UL * HOUR_MS) == true);
+
+  for(i=0; i<((24UL * HOUR_MS) / CHECK_EVERY_MS); i++)    /*0:00 to 11:59 and back*/
+  {
+    Sim_run(CHECK_EVERY_MS);
+    Sim_run((90000UL - ((Hal_utc_now() / 1000ULL) % 60000ULL)) % 60000UL);
+    error = fabs(Carriage_minutes() - Sim_expected(Hal_utc_now(), 0));
+    worst = (error > worst) ? error : worst;
+  }
+  printf("worst error %.3f minutes\n", worst);
+  CHECK(worst < 0.1);
+  CHECK(Carriage_skipped() == 0);
+  return(CHECK_RESULT());
+}
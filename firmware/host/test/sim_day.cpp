@@ -0,0 +1,63 @@
+/* A day of the clock in full-step mode: it boots, homes, gets the time and shows it for 24 hours (in a few seconds of real time) */
+
+#include <Arduino.h>
+#include <math.h>
+#include "Hal.h"
+#include "Carriage.h"
+#include "Sim.h"
+#include "Check.h"
+#include "Homing.h"
+#include "Stepper.h"
+
+/*--------------------------------------------*/
+#define RATIO           (4076.0)    /*the gearbox matches the default of the firmware*/
+#define START_UTC       1700000000ULL   /*Tue 14 Nov 2023 22:13:20 UTC*/
+#define CHECK_EVERY_MS  (10UL * 60UL * 1000UL)
+#define START_MINUTES   500.0       /*the indicator is somewhere in the middle of the scale*/
+#define HOME_MINUTES    777.0       /*the edge of the home sensor*/
+
+static const char config[] = "{\"ssid\":\"linear\",\"key\":\"clock\",\"ntp\":\"pool.ntp.org\",\"offset\":\"0\",\"dst\":false,\"tz\":\"\",\"alarm\":false,\"chime\":false,\"stepmode\":\"full\"}";
+
+/*------------------------------------------------------------------------------------------*/
+
+static bool shown(void)
+{
+  return(fabs(Carriage_minutes() - Sim_expected(Hal_utc_now(), 0)) < 0.1);
+}
+
+int main(int argc, char *argv[])
+{
+  carriageTYPE carriage = {RATIO, START_MINUTES * RATIO, HOME_MINUTES, 359.5, {}, 0, 800.0, -10.0, 0};
+  double gentle_ms = (HOME_MINUTES - START_MINUTES) * RATIO * STEPPER_INTERVAL_SLOW / 1000.0;   /*the way up at the gentle speed*/
+  unsigned long i;
+  double error;
+  double worst = 0;
+
+  (void)argc;
+  Hal_verbose(getenv("SIM_VERBOSE") != NULL);
+  Hal_spiffs_load(argv[1]);
+  Hal_spiffs_write("/config.json", config);
+  Hal_utc(START_UTC * 1000000ULL);
+  Hal_network("linear", "clock");
+  Carriage_init(&carriage);
+
+  Sim_boot(REASON_DEFAULT_RST);
+  CHECK(Sim_until(shown, 40UL * 60UL * 1000UL) == true);  /*homing from the middle of the scale and the move to the time, at the gentle speed this takes 70 minutes, in full-step mode half of that*/
+  printf("homing took %lu ms (%.0f ms at the gentle speed), time shown after %llu ms\n", Homing_duration(), gentle_ms, Hal_micros() / 1000ULL);
+  CHECK(Homing_duration() < (gentle_ms * 0.6));     /*the coarse approach cruises, the slow phases near the edge take a few seconds*/
+
+  for(i=0; i<((24UL * 60UL * 60UL * 1000UL) / CHECK_EVERY_MS); i++)
+  {
+    Sim_run(CHECK_EVERY_MS);
+    Sim_run((90000UL - ((Hal_utc_now() / 1000ULL) % 60000ULL)) % 60000UL);  /*halfway a minute, the minute tick is over*/
+    error = fabs(Carriage_minutes() - Sim_expected(Hal_utc_now(), 0));
+    worst = (error > worst) ? error : worst;
+    if(CHECK(error < 0.1) == false)
+    {
+      printf("at %llu s: shows %.2f instead of %.2f\n", Hal_utc_now() / 1000000ULL, Carriage_minutes(), Sim_expected(Hal_utc_now(), 0));
+    }
+  }
+  printf("worst error %.3f minutes, %lu half-steps, %lu NTP requests\n", worst, Carriage_steps(), Hal_ntp_requests());
+  CHECK(Carriage_skipped() == 0);
+  return(CHECK_RESULT());
+}
@@ -0,0 +1,105 @@
+/* The timeservers as the clock meets them: all servers are asked at once and the reply with the shortest round trip
+ * sets the clock, also when a worse reply arrives first. A name that can't be looked up or a server that answers too
+ * late must not stop (or disturb) the others.
+ *   best: a "kiss of death", a fast reply that is off by 1.5 s and a slow (held) reply with the best round trip
+ *   dns:  one name can't be looked up, the others are used
+ *   late: the only server answers after the timeout, its reply must be thrown away
+*/
+
+#include <Arduino.h>
+#include "Hal.h"
+#include "Carriage.h"
+#include "Sim.h"
+#include "Check.h"
+#include "NTP.h"
+
+/*--------------------------------------------*/
+#define RATIO           (4076.0)
+#define START_UTC       1700000000ULL   /*Tue 14 Nov 2023 22:13:20 UTC*/
+#define SYNC_MS         30000UL         /*the network is there after a few seconds, the servers answer within the timeout*/
+
+static const char config_best[] = "{\"ssid\":\"linear\",\"key\":\"clock\",\"ntp\":\"kod.ntp.test,skewed.ntp.test,held.ntp.test\",\"offset\":\"0\",\"dst\":false,\"tz\":\"\",\"alarm\":false,\"chime\":false}";
+static const char config_dns[] = "{\"ssid\":\"linear\",\"key\":\"clock\",\"ntp\":\"missing.ntp.test,held.ntp.test,late.ntp.test\",\"offset\":\"0\",\"dst\":false,\"tz\":\"\",\"alarm\":false,\"chime\":false}";
+static const char config_late[] = "{\"ssid\":\"linear\",\"key\":\"clock\",\"ntp\":\"late.ntp.test\",\"offset\":\"0\",\"dst\":false,\"tz\":\"\",\"alarm\":false,\"chime\":false}";
+
+/*                                         resolves valid  out_us  hold_us  back_us  offset_us*/
+static const hal_ntp_serverTYPE kod     = {true,    false, 1000,   0,       1000,    0};
+static const hal_ntp_serverTYPE skewed  = {true,    true,  5000,   0,       60000,   1500000};  /*arrives first, but the round trip is 65 ms*/
+static const hal_ntp_serverTYPE held    = {true,    true,  10000,  300000,  10000,   0};        /*arrives last, the round trip is only 20 ms*/
+static const hal_ntp_serverTYPE missing = {false,   true,  10000,  0,       10000,   0};
+static const hal_ntp_serverTYPE late    = {true,    true,  10000,  0,       7000000, 3000000};  /*after the timeout of 5 s*/
+
+/*------------------------------------------------------------------------------------------*/
+
+static bool synced(void)
+{
+  return(NTP_struct.synced);
+}
+
+static bool failed(void)
+{
+  return(NTP_failed());
+}
+
+/*the difference (in ms) between our clock and the real time*/
+static double error_ms(void)
+{
+  return(((double)(long long)(NTP_now() - Hal_utc_now())) / 1000.0);
+}
+
+int main(int argc, char *argv[])
+{
+  carriageTYPE carriage = {RATIO, 500.0 * RATIO, 777.0, 359.5, {}, 0, 800.0, -10.0, 0};
+  const char *scenario = (argc > 2) ? argv[2] : "best";
+
+  Hal_verbose(getenv("SIM_VERBOSE") != NULL);
+  Hal_spiffs_load(argv[1]);
+  Hal_utc(START_UTC * 1000000ULL);
+  Hal_network("linear", "clock");
+  Hal_ntp_server("kod.ntp.test", &kod);
+  Hal_ntp_server("skewed.ntp.test", &skewed);
+  Hal_ntp_server("held.ntp.test", &held);
+  Hal_ntp_server("missing.ntp.test", &missing);
+  Hal_ntp_server("late.ntp.test", &late);
+  Carriage_init(&carriage);
+
+  if(strcmp(scenario, "best") == 0)
+  {
+    Hal_spiffs_write("/config.json", config_best);
+    Sim_boot(REASON_DEFAULT_RST);
+    CHECK(Sim_until(synced, SYNC_MS) == true);
+    printf("best: error %.1f ms, delay %lu ms\n", error_ms(), NTP_struct.delay_ms);
+    CHECK(Hal_ntp_server_requests("kod.ntp.test") == 1);
+    CHECK(Hal_ntp_server_requests("skewed.ntp.test") == 1);
+    CHECK(Hal_ntp_server_requests("held.ntp.test") == 1);
+    CHECK(NTP_struct.delay_ms == 20);                 /*the held reply, not the first one that arrived*/
+    CHECK((error_ms() > -2.0) && (error_ms() < 2.0));
+  }
+  else if(strcmp(scenario, "dns") == 0)
+  {
+    Hal_spiffs_write("/config.json", config_dns);
+    Sim_boot(REASON_DEFAULT_RST);
+    CHECK(Sim_until(synced, SYNC_MS) == true);
+    printf("dns: error %.1f ms, delay %lu ms\n", error_ms(), NTP_struct.delay_ms);
+    CHECK(Hal_ntp_server_requests("missing.ntp.test") == 0);
+    CHECK(Hal_ntp_server_requests("held.ntp.test") == 1);
+    CHECK(NTP_struct.delay_ms == 20);
+    CHECK((error_ms() > -2.0) && (error_ms() < 2.0));
+    Sim_run(10000UL);                                 /*the late reply arrives, it was not waited for*/
+    CHECK((error_ms() > -2.0) && (error_ms() < 2.0));
+  }
+  else if(strcmp(scenario, "late") == 0)
+  {
+    Hal_spiffs_write("/config.json", config_late);
+    Sim_boot(REASON_DEFAULT_RST);
+    CHECK(Sim_until(failed, 3 * SYNC_MS) == true);    /*every retry times out, the late replies belong to an earlier request*/
+    printf("late: %lu requests, synced %d\n", Hal_ntp_server_requests("late.ntp.test"), NTP_struct.synced);
+    CHECK(Hal_ntp_server_requests("late.ntp.test") == 3);
+    CHECK(NTP_struct.synced == false);
+  }
+  else
+  {
+    CHECK(false);
+  }
+  return(CHECK_RESULT());
+}
@@ -0,0 +1,51 @@
+/* The WiFi sleep mode of a running clock: with the indicator moving every minute light sleep is used in between,
+ * in smooth mode (the indicator moves every 1/4 s) the mode must not change all the time.
+*/
+
+#include <Arduino.h>
+#include "Hal.h"
+#include "Carriage.h"
+#include "Sim.h"
+#include "Check.h"
+
+/*--------------------------------------------*/
+#define RATIO           (4076.0)
+#define START_UTC       1700000000ULL   /*Tue 14 Nov 2023 22:13:20 UTC*/
+#define MEASURE_MS      (10UL * 60UL * 1000UL)
+
+static const char config_minute[] = "{\"ssid\":\"linear\",\"key\":\"clock\",\"ntp\":\"pool.ntp.org\",\"offset\":\"0\",\"dst\":false,\"tz\":\"\",\"alarm\":false,\"chime\":false,\"power\":true,\"smooth\":false}";
+static const char config_smooth[] = "{\"ssid\":\"linear\",\"key\":\"clock\",\"ntp\":\"pool.ntp.org\",\"offset\":\"0\",\"dst\":false,\"tz\":\"\",\"alarm\":false,\"chime\":false,\"power\":true,\"smooth\":true}";
+
+/*------------------------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+  carriageTYPE carriage = {RATIO, 500.0 * RATIO, 777.0, 359.5, {}, 0, 800.0, -10.0, 0};
+  bool smooth = ((argc > 2) && (strcmp(argv[2], "smooth") == 0));
+  unsigned long changes;
+
+  Hal_verbose(getenv("SIM_VERBOSE") != NULL);
+  Hal_spiffs_load(argv[1]);
+  Hal_spiffs_write("/config.json", smooth ? config_smooth : config_minute);
+  Hal_utc(START_UTC * 1000000ULL);
+  Hal_network("linear", "clock");
+  Carriage_init(&carriage);
+
+  Sim_boot(REASON_DEFAULT_RST);
+  Sim_run(2UL * 60UL * 60UL * 1000UL);        /*homed and showing the time*/
+
+  changes = Hal_sleep_changes();
+  Sim_run(MEASURE_MS);
+  changes = Hal_sleep_changes() - changes;
+  printf("%s: %lu sleep mode changes in %lu minutes\n", smooth ? "smooth" : "minute", changes, MEASURE_MS / 60000UL);
+  if(smooth == true)
+  {
+    CHECK(changes <= 2);
+  }
+  else
+  {
+    CHECK(changes >= (MEASURE_MS / 60000UL));     /*light sleep between the minute ticks*/
+    CHECK(changes <= (4 * (MEASURE_MS / 60000UL)));
+  }
+  return(CHECK_RESULT());
+}
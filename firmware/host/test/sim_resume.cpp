@@ -0,0 +1,153 @@
+/* A warm reset: the clock runs until the indicator is just above the insulator, then it is reset (the SPIFFS, the
+ * RTC memory and the carriage are kept, the program is started again). The stored position is checked at the
+ * nearest sensor edge:
+ *   slip   the indicator is a bit higher than the stored position, this is corrected at the edge
+ *   moved  the indicator is far from the stored position, the edge isn't found so the clock homes
+*/
+
+#include <Arduino.h>
+#include <FS.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "Hal.h"
+#include "Carriage.h"
+#include "Sim.h"
+#include "Check.h"
+
+/*--------------------------------------------*/
+#define RATIO           (4076.0)
+#define START_UTC       1700000000ULL   /*Tue 14 Nov 2023 22:13:20 UTC*/
+#define SLIP            200.0           /*half-steps, more than the tolerance and well within the window*/
+#define ACCURATE        32.0            /*half-steps, twice the tolerance of the sensor bar*/
+#define MOVED           (40.0 * RATIO)  /*far outside the window*/
+
+static const char config[] = "{\"ssid\":\"linear\",\"key\":\"clock\",\"ntp\":\"pool.ntp.org\",\"offset\":\"0\",\"dst\":false,\"tz\":\"\",\"alarm\":false,\"chime\":false}";
+
+/*------------------------------------------------------------------------------------------*/
+
+static bool shown(void)
+{
+  return(fabs(Carriage_minutes() - Sim_expected(Hal_utc_now(), 0)) < 0.1);
+}
+
+static bool settled(void)   /*homing passes the right point as well*/
+{
+  return((shown() == true) && (Carriage_energized() == false));
+}
+
+static bool above_insulator(void)
+{
+  return((Carriage_minutes() > 375.0) && (Carriage_energized() == false));
+}
+
+/*everything that survives a warm reset goes into this folder*/
+static void save(const char *folder)
+{
+  std::string path = std::string(folder) + "/spiffs";
+  Dir dir = SPIFFS.openDir("/");
+  uint8_t buf[256];
+  int n;
+  FILE *f;
+
+  mkdir(path.c_str(), 0700);
+  while(dir.next() == true)
+  {
+    File file = dir.openFile("r");
+    f = fopen((path + dir.fileName().c_str()).c_str(), "wb");
+    while((n = file.read(buf, sizeof(buf))) > 0)
+    {
+      fwrite(buf, 1, n, f);
+    }
+    fclose(f);
+  }
+  f = fopen((std::string(folder) + "/rtc.bin").c_str(), "wb");
+  fwrite(Hal_rtc_memory(), 1, HAL_RTC_SIZE, f);
+  fclose(f);
+  f = fopen((std::string(folder) + "/state.txt").c_str(), "w");
+  fprintf(f, "%.3f %llu\n", Carriage()->position, Hal_utc_now());
+  fclose(f);
+}
+
+static void restore(const char *folder, carriageTYPE *carriage)
+{
+  unsigned long long utc;
+  FILE *f;
+
+  Hal_spiffs_load((std::string(folder) + "/spiffs").c_str());
+  f = fopen((std::string(folder) + "/rtc.bin").c_str(), "rb");
+  CHECK(fread(Hal_rtc_memory(), 1, HAL_RTC_SIZE, f) == HAL_RTC_SIZE);
+  fclose(f);
+  f = fopen((std::string(folder) + "/state.txt").c_str(), "r");
+  CHECK(fscanf(f, "%lf %llu", &carriage->position, &utc) == 2);
+  fclose(f);
+  Hal_utc(utc + 1000000ULL);    /*the reset took a second*/
+  CHECK(system((std::string("rm -rf ") + folder).c_str()) == 0);
+}
+
+int main(int argc, char *argv[])
+{
+  carriageTYPE carriage = {RATIO, 500.0 * RATIO, 777.0, 359.5, {}, 0, 800.0, -10.0, 0};
+  char folder[] = "/tmp/sim_resumeXXXXXX";
+  unsigned long steps;
+
+  Hal_verbose(getenv("SIM_VERBOSE") != NULL);
+  Hal_network("linear", "clock");
+
+  if(argc == 3)     /*before the reset*/
+  {
+    Hal_spiffs_load(argv[1]);
+    Hal_spiffs_write("/config.json", config);
+    Hal_utc(START_UTC * 1000000ULL);
+    Carriage_init(&carriage);
+    Sim_boot(REASON_DEFAULT_RST);
+    CHECK(Sim_until(shown, 2UL * 60UL * 60UL * 1000UL) == true);
+    CHECK(Sim_until(above_insulator, 10UL * 60UL * 60UL * 1000UL) == true);   /*after 6:00 in the morning the indicator has crossed it going up*/
+    if(CHECK(mkdtemp(folder) != NULL) == false)
+    {
+      return(CHECK_RESULT());
+    }
+    save(folder);
+    printf("reset at %.2f minutes\n", Carriage_minutes());
+    fflush(stdout);
+    execl(argv[0], argv[0], argv[1], argv[2], folder, (char *)NULL);
+    CHECK(false);
+    return(CHECK_RESULT());
+  }
+  if(argc != 4)
+  {
+    printf("usage: %s <data folder> slip|moved\n", argv[0]);
+    return(1);
+  }
+
+  restore(argv[3], &carriage);
+  if(strcmp(argv[2], "slip") == 0)
+  {
+    carriage.position = carriage.position + SLIP;
+  }
+  else
+  {
+    carriage.position = carriage.position - MOVED;
+  }
+  Carriage_init(&carriage);
+  Sim_boot(REASON_SOFT_RESTART);
+
+  if(strcmp(argv[2], "slip") == 0)    /*the slip is less than the precision of shown()*/
+  {
+    Sim_run(10UL * 60UL * 1000UL);
+    Sim_run((90000UL - ((Hal_utc_now() / 1000ULL) % 60000ULL)) % 60000UL);
+    steps = Carriage_steps();
+    printf("%lu half-steps, error %.1f half-steps\n", steps, (Carriage_minutes() - Sim_expected(Hal_utc_now(), 0)) * RATIO);
+    CHECK(fabs(Carriage_minutes() - Sim_expected(Hal_utc_now(), 0)) < (ACCURATE / RATIO));
+    CHECK(steps < (60.0 * RATIO));      /*a short move to the edge and back, no homing*/
+  }
+  else
+  {
+    CHECK(Sim_until(settled, 2UL * 60UL * 60UL * 1000UL) == true);
+    steps = Carriage_steps();
+    printf("time shown after %llu ms, %lu half-steps\n", Hal_micros() / 1000ULL, steps);
+    CHECK(steps > (300.0 * RATIO));     /*it went all the way to the home sensor*/
+  }
+  CHECK(Carriage_skipped() == 0);
+  return(CHECK_RESULT());
+}
@@ -0,0 +1,97 @@
+/* The position check at the sensor edges: a day with a bouncing sensor and two alarm blocks (one of them is moved
+ * afterwards) must not cause a single correction, a day after the motor lost steps the position must be right again.
+*/
+
+#include <Arduino.h>
+#include <math.h>
+#include "Hal.h"
+#include "Carriage.h"
+#include "Sim.h"
+#include "Check.h"
+#include "Sensorbar.h"
+
+/*--------------------------------------------*/
+#define RATIO           (4076.0)
+#define START_UTC       1700000000ULL   /*Tue 14 Nov 2023 22:13:20 UTC*/
+#define DAY_MS          (24UL * 60UL * 60UL * 1000UL)
+#define CHECK_EVERY_MS  (10UL * 60UL * 1000UL)
+#define BOUNCE          12              /*half-steps around an edge of the updown sensor where it reads rubbish*/
+#define LOST            150.0           /*half-steps, a stall*/
+#define ACCURATE        32.0            /*half-steps, twice the tolerance of the sensor bar*/
+
+static const char config[] = "{\"ssid\":\"linear\",\"key\":\"clock\",\"ntp\":\"pool.ntp.org\",\"offset\":\"0\",\"dst\":false,\"tz\":\"\",\"alarm\":false,\"chime\":false}";
+
+/*------------------------------------------------------------------------------------------*/
+
+static bool shown(void)
+{
+  return(fabs(Carriage_minutes() - Sim_expected(Hal_utc_now(), 0)) < 0.1);
+}
+
+static unsigned long corrections(void)
+{
+  unsigned long n = 0;
+
+  sscanf(Sensorbar_text(), "corrections %lu", &n);
+  return(n);
+}
+
+/*the error (in half-steps) halfway a minute, after running this long*/
+static double run(unsigned long ms)
+{
+  Sim_run(ms);
+  Sim_run((90000UL - ((Hal_utc_now() / 1000ULL) % 60000ULL)) % 60000UL);
+  return((Carriage_minutes() - Sim_expected(Hal_utc_now(), 0)) * RATIO);
+}
+
+/*a day, checked every 10 minutes, returns the largest error (in half-steps)*/
+static double day(void)
+{
+  unsigned long i;
+  double error;
+  double worst = 0;
+
+  for(i=0; i<(DAY_MS / CHECK_EVERY_MS); i++)
+  {
+    error = fabs(run(CHECK_EVERY_MS));
+    worst = (error > worst) ? error : worst;
+  }
+  return(worst);
+}
+
+int main(int argc, char *argv[])
+{
+  carriageTYPE carriage = {RATIO, 500.0 * RATIO, 777.0, 359.5, {150.0, 560.0}, 2, 800.0, -10.0, BOUNCE};
+  double error;
+
+  (void)argc;
+  Hal_verbose(getenv("SIM_VERBOSE") != NULL);
+  Hal_spiffs_load(argv[1]);
+  Hal_spiffs_write("/config.json", config);
+  Hal_utc(START_UTC * 1000000ULL);
+  Hal_network("linear", "clock");
+  Carriage_init(&carriage);
+
+  Sim_boot(REASON_DEFAULT_RST);
+  CHECK(Sim_until(shown, 2UL * 60UL * 60UL * 1000UL) == true);
+
+  error = day();                              /*the sensor bounces and the blocks are crossed, nothing to correct*/
+  printf("first day: worst error %.1f half-steps, %lu corrections\n", error, corrections());
+  CHECK(error < ACCURATE);
+  CHECK(corrections() == 0);
+
+  Carriage()->blocks[1] = 561.0;              /*the user moves a block, its edges are never learned*/
+  error = day();
+  printf("block moved: worst error %.1f half-steps, %lu corrections\n", error, corrections());
+  CHECK(error < ACCURATE);
+  CHECK(corrections() == 0);
+
+  Carriage()->position = Carriage()->position - LOST;   /*the motor stalls*/
+  Sim_run(DAY_MS + (DAY_MS / 2));             /*the insulator is crossed going up and going down, that is four edges*/
+  error = run(0);
+  printf("after losing steps: error %.1f half-steps, %lu corrections\n%s", error, corrections(), Sensorbar_text());
+  CHECK(fabs(error) < ACCURATE);
+  CHECK(corrections() == 1);
+  CHECK(Carriage_skipped() == 0);
+  return(CHECK_RESULT());
+}
@@ -0,0 +1,120 @@
+/* The webserver of a running clock: the pages, the files that may not be served and the settings. Once the clock
+ * runs, handling a request must not allocate any memory (the webserver of the core itself does, that isn't counted). */
+
+#include <Arduino.h>
+#include "Hal.h"
+#include "Carriage.h"
+#include "Sim.h"
+#include "Check.h"
+#include "WebConfig.h"
+
+/*--------------------------------------------*/
+#define RATIO   (4076.0)
+
+static const char config[] = "{\"ssid\":\"linear\",\"key\":\"clock\",\"ntp\":\"pool.ntp.org\",\"offset\":\"0\",\"dst\":false,\"tz\":\"\",\"alarm\":false,\"chime\":false}";
+
+/*------------------------------------------------------------------------------------------*/
+
+static int get(const char *uri, hal_responseTYPE *response)
+{
+  *response = hal_responseTYPE();
+  Hal_http(uri, NULL, response);
+  return(response->code);
+}
+
+/*the ETag the browser got with this page*/
+static std::string etag(const hal_responseTYPE *response)
+{
+  size_t start = response->headers.find("ETag: ");
+  size_t end;
+
+  if(start == std::string::npos)
+  {
+    return("");
+  }
+  start = start + 6;
+  end = response->headers.find('\n', start);
+  return(response->headers.substr(start, end - start));
+}
+
+/*the allocations of a request, printed when there are any*/
+static unsigned long allocations(const char *uri, const char *args)
+{
+  hal_responseTYPE response;
+
+  Hal_http(uri, args, &response);
+  if(Hal_http_allocations() != 0)
+  {
+    printf("%s%s%s: %d, %lu allocations\n", uri, (args != NULL) ? "?" : "", (args != NULL) ? args : "", response.code, Hal_http_allocations());
+  }
+  return(Hal_http_allocations());
+}
+
+int main(int argc, char *argv[])
+{
+  carriageTYPE carriage = {RATIO, 700.0 * RATIO, 777.0, 359.5, {}, 0, 800.0, -10.0, 0};
+  hal_responseTYPE response;
+  std::string uri;
+  std::string tag;
+
+  (void)argc;
+  Hal_verbose(getenv("SIM_VERBOSE") != NULL);
+  Hal_spiffs_load(argv[1]);
+  Hal_spiffs_write("/config.json", config);
+  Hal_utc(1700000000ULL * 1000000ULL);
+  Hal_network("linear", "clock");
+  Carriage_init(&carriage);
+  Sim_boot(REASON_DEFAULT_RST);
+  Sim_run(10000);
+
+  CHECK(get("/index.htm", &response) == 200);
+  CHECK(response.type == "text/html");
+  CHECK(get("/style.css", &response) == 200);
+  CHECK(get("/index - werkt.htm", &response) == 404);   /*an old copy of the page, it is not uploaded*/
+
+  CHECK(get("/jquery.min.js", &response) == 200);
+  tag = etag(&response);
+  CHECK(tag.size() > 2);
+  Hal_http_header("If-None-Match", tag.c_str());        /*the browser has this version*/
+  CHECK(get("/jquery.min.js", &response) == 304);
+  CHECK(response.body.empty() == true);
+  Hal_http_header("If-None-Match", "\"0000000000000000\"");   /*an older version*/
+  CHECK(get("/jquery.min.js", &response) == 200);
+
+  Hal_http_header("If-None-Match", tag.c_str());        /*no allocations on the request path*/
+  CHECK(allocations("/jquery.min.js", NULL) == 0);
+  CHECK(allocations("/jquery.min.js", NULL) == 0);
+  CHECK(allocations("/index.htm", NULL) == 0);
+  CHECK(allocations("/style.css", "download=1") == 0);
+  CHECK(allocations("/config.json", NULL) == 0);
+  CHECK(allocations("/status_message.txt", NULL) == 0);
+  CHECK(allocations("/metrics", NULL) == 0);
+  CHECK(allocations("/no_such_file.htm", "name=value") == 0);
+
+  Hal_spiffs_write("/journal.bin", "journal");           /*the files of the firmware itself are never sent*/
+  Hal_spiffs_write("/journal.tmp", "journal");
+  Hal_spiffs_write("/wifi.bin", "network");
+  Hal_spiffs_write("/ntp_drift.txt", "1000");
+  CHECK(get("/journal.tmp", &response) == 404);
+  CHECK(get("/wifi.bin", &response) == 404);
+  CHECK(get("/ntp_drift.txt", &response) == 404);
+  CHECK(get("/journal.bin", &response) == 404);
+  CHECK(get("/config.json", &response) == 200);         /*made from the settings, not the file*/
+  CHECK(response.body.find("\"ssid\":\"linear\"") != std::string::npos);
+  CHECK(response.body.find("\"key\"") == std::string::npos);   /*the secrets are never sent*/
+  CHECK(response.body.find("beacon_key") == std::string::npos);
+
+  Hal_http("/index.htm", "ssid=linear&key=&beacon_key=", &response);   /*the form leaves the secrets empty*/
+  CHECK(strcmp(cfg.key, "clock") == 0);
+  Hal_http("/index.htm", "ssid=linear&key=other&beacon_key=", &response);
+  CHECK(strcmp(cfg.key, "other") == 0);
+
+  uri = "/" + std::string(35, 'x');                   /*the longest name the webserver accepts*/
+  Hal_spiffs_write(uri.c_str(), "short");
+  CHECK(get(uri.c_str(), &response) == 200);
+  uri = uri + ".txt";                                   /*a longer name must not be shortened to the one that exists*/
+  CHECK(get(uri.c_str(), &response) == 404);
+  uri = "/" + std::string(30, 'x') + "/";               /*no room for index.htm*/
+  CHECK(get(uri.c_str(), &response) == 404);
+  return(CHECK_RESULT());
+}
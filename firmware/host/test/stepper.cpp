@@ -0,0 +1,205 @@
+/* The step timing of the stepper engine: the gentle speed, the acceleration profile (with the default cruise speed
+ * and with a faster one), stopping while accelerated, the full-step mode and the cruise setting. The coils are
+ * watched, so these are the moments the motor really gets its steps. */
+
+#include <Arduino.h>
+#include <math.h>
+#include "Stepper.h"
+#include "Steps.h"
+#include "Check.h"
+
+/*--------------------------------------------*/
+#define START       0x10000000UL
+#define FAST        350     /*a cruise interval (in us) that is faster than the default, to see the whole profile*/
+#define RAMP_STEPS  255     /*the ramp table has this many steps of speed*/
+
+void Stepper_ramp_init(unsigned int cruise_interval);
+
+/*------------------------------------------------------------------------------------------*/
+
+static void move(unsigned long target, unsigned int interval)
+{
+  Steps_record();
+  Stepper_moveto(target, interval);
+  while(Stepper_busy() == true)
+  {
+    Hal_advance(1000);
+  }
+}
+
+static long moved(void)
+{
+  long sum = 0;
+
+  for(auto &step : steps_recorded)
+  {
+    sum = sum + step.halfsteps;
+  }
+  return(sum);
+}
+
+static double speed(size_t i)
+{
+  return((abs(steps_recorded[i].halfsteps) * 1000000.0) / Steps_interval(i));
+}
+
+/*the speed never changes faster than the acceleration allows (a step of the ramp table is the resolution)*/
+static bool accelerates_smoothly(double cruise_us)
+{
+  double v0 = 1000000.0 / STEPPER_INTERVAL_SLOW;
+  double vc = 1000000.0 / cruise_us;
+  double resolution = 2.0 * (((vc * vc) - (v0 * v0)) / 2.0) / RAMP_STEPS;
+  size_t n = steps_recorded.size();
+  size_t i;
+
+  for(i=1; i<n; i++)
+  {
+    if((((speed(i) * speed(i)) - (v0 * v0)) / 2.0) > ((STEPPER_ACCELERATION * (double)i) + resolution))
+    {
+      printf("step %zu: %.0f half-steps/s is too fast after accelerating %zu steps\n", i, speed(i), i);
+      return(false);
+    }
+    if((((speed(n - 1 - i) * speed(n - 1 - i)) - (v0 * v0)) / 2.0) > ((STEPPER_DECELERATION * (double)(i + 1)) + resolution))
+    {
+      printf("step %zu: %.0f half-steps/s is too fast to stop in %zu steps\n", n - 1 - i, speed(n - 1 - i), i + 1);
+      return(false);
+    }
+  }
+  return(true);
+}
+
+/*first the intervals get shorter (or stay the same), then longer, never the other way around*/
+static bool trapezoid(void)
+{
+  bool slowing = false;
+  size_t i;
+
+  for(i=2; i<steps_recorded.size(); i++)
+  {
+    if(Steps_interval(i) > (Steps_interval(i - 1) + 0.01))
+    {
+      slowing = true;
+    }
+    else if((slowing == true) && (Steps_interval(i) < (Steps_interval(i - 1) - 0.01)))
+    {
+      printf("step %zu: accelerates again while decelerating\n", i);
+      return(false);
+    }
+  }
+  return(true);
+}
+
+static double shortest(void)
+{
+  double t = 1e9;
+  size_t i;
+
+  for(i=1; i<steps_recorded.size(); i++)
+  {
+    t = (Steps_interval(i) / abs(steps_recorded[i].halfsteps) < t) ? (Steps_interval(i) / abs(steps_recorded[i].halfsteps)) : t;
+  }
+  return(t);
+}
+
+int main(void)
+{
+  size_t i;
+  unsigned long stop_position;
+
+  Stepper_init();
+  Stepper_mode("half");
+  Stepper_setposition(START - 1);
+  move(START, STEPPER_INTERVAL_SLOW);   /*the coils were off, the first step only tells the rotor where it is*/
+
+  /*the minute tick: every half-step exactly STEPPER_INTERVAL_SLOW apart*/
+  move(START + 1000, STEPPER_INTERVAL_SLOW);
+  CHECK(moved() == 1000);
+  CHECK(current_position == (START + 1000));
+  for(i=1; i<steps_recorded.size(); i++)
+  {
+    CHECK(steps_recorded[i].halfsteps == 1);
+    CHECK(fabs(Steps_interval(i) - STEPPER_INTERVAL_SLOW) < 0.01);
+  }
+
+  /*a long move with the default cruise speed is never faster than the gentle speed*/
+  move(START + 1000 + 40000, STEPPER_PROFILE);
+  CHECK(moved() == 40000);
+  CHECK(shortest() > (STEPPER_INTERVAL_SLOW - 0.5));
+  move(START, STEPPER_PROFILE);
+  CHECK(moved() == -41000);
+  CHECK(current_position == START);
+
+  /*a faster cruise speed: it is reached, never exceeded, the acceleration and deceleration are within bounds*/
+  Stepper_ramp_init(FAST);
+  move(START + 40000, STEPPER_PROFILE);
+  CHECK(moved() == 40000);
+  CHECK(shortest() > (FAST - 0.5));
+  CHECK(shortest() < (FAST + 0.5));
+  CHECK(Steps_interval(1) > (STEPPER_INTERVAL_SLOW * 0.9));
+  CHECK(Steps_interval(steps_recorded.size() - 1) > (STEPPER_INTERVAL_SLOW * 0.9));
+  CHECK(accelerates_smoothly(FAST));
+  CHECK(trapezoid());
+
+  move(START, STEPPER_PROFILE);     /*the same, down*/
+  CHECK(moved() == -40000);
+  CHECK(current_position == START);
+  CHECK(accelerates_smoothly(FAST));
+  CHECK(trapezoid());
+
+  /*stopping at full speed: the motor decelerates, it doesn't stop dead*/
+  Steps_record();
+  Stepper_moveto(START + 100000, STEPPER_PROFILE);
+  Hal_advance(5000000);
+  Stepper_stop();
+  stop_position = current_position;
+  while(Stepper_busy() == true)
+  {
+    Hal_advance(1000);
+  }
+  CHECK(current_position > stop_position);
+  CHECK(current_position < (START + 100000));
+  CHECK(accelerates_smoothly(FAST));
+  CHECK(trapezoid());
+  move(START, STEPPER_PROFILE);
+
+  /*full-step mode: two half-steps per tick, the speed (in half-steps per second) is the same*/
+  Stepper_mode("full");
+  move(START + 1001, STEPPER_INTERVAL_SLOW);
+  CHECK(moved() == 1001);
+  CHECK(current_position == (START + 1001));
+  for(i=2; i<(steps_recorded.size() - 1); i++)
+  {
+    CHECK(steps_recorded[i].halfsteps == 2);
+    CHECK(fabs(Steps_interval(i) - (2 * STEPPER_INTERVAL_SLOW)) < 0.01);
+  }
+  move(START + 1001 + 40000, STEPPER_PROFILE);   /*this mode cruises faster, within the limits of the ramp*/
+  CHECK(moved() == 40000);
+  CHECK(shortest() > (STEPPER_CRUISE_FULL - 0.5));
+  CHECK(shortest() < (STEPPER_CRUISE_FULL + 0.5));
+  Stepper_mode("wave");
+  move(START + 1001, STEPPER_PROFILE);
+  CHECK(moved() == -40000);
+  CHECK(shortest() > (STEPPER_INTERVAL_SLOW - 0.5));
+  Stepper_mode("full");
+  Stepper_ramp_init(FAST);
+  move(START, STEPPER_PROFILE);
+  CHECK(moved() == -1001);
+  CHECK(shortest() > (FAST - 0.5));
+
+  /*the cruise setting overrides the default of the mode, within its limits, 0 gives the default back*/
+  Stepper_cruise(700);
+  Stepper_mode("full");
+  move(START + 40000, STEPPER_PROFILE);
+  CHECK(shortest() > (700 - 0.5));
+  CHECK(shortest() < (700 + 0.5));
+  Stepper_cruise(100);
+  Stepper_mode("full");
+  move(START, STEPPER_PROFILE);
+  CHECK(shortest() > (STEPPER_CRUISE_MIN - 0.5));
+  Stepper_cruise(0);
+  Stepper_mode("full");
+  move(START + 40000, STEPPER_PROFILE);
+  CHECK(shortest() > (STEPPER_CRUISE_FULL - 0.5));
+  CHECK(shortest() < (STEPPER_CRUISE_FULL + 0.5));
+  return(CHECK_RESULT());
+}
@@ -0,0 +1,58 @@
+/* The step timing of a move, to see what the settings in Stepper.h do before trying them on the clock.
+ * Usage: stepper_profile <half-steps> [half|full|wave] [cruise interval in us]
+ * Prints a line for every tick of the motor: the moment (us), the half-steps made, the interval (us) and the speed
+ * (half-steps per second). The total time is printed at the end. */
+
+#include <Arduino.h>
+#include "Stepper.h"
+#include "Steps.h"
+
+/*--------------------------------------------*/
+#define START   0x10000000UL
+
+void Stepper_ramp_init(unsigned int cruise_interval);
+
+/*------------------------------------------------------------------------------------------*/
+
+int main(int argc, char *argv[])
+{
+  unsigned long distance;
+  size_t i;
+
+  if(argc < 2)
+  {
+    printf("usage: %s <half-steps> [half|full|wave] [cruise interval in us]\n", argv[0]);
+    return(1);
+  }
+  distance = strtoul(argv[1], NULL, 10);
+
+  Stepper_init();
+  Stepper_mode((argc > 2) ? argv[2] : "half");
+  if(argc > 3)
+  {
+    Stepper_ramp_init(strtoul(argv[3], NULL, 10));
+  }
+  Stepper_setposition(START - 1);
+  Steps_record();
+  Stepper_moveto(START, STEPPER_INTERVAL_SLOW);   /*the coils were off, the first step only tells the rotor where it is*/
+  while(Stepper_busy() == true)
+  {
+    Hal_advance(1000);
+  }
+
+  Steps_record();
+  Stepper_moveto(START + distance, (distance > 1) ? STEPPER_PROFILE : STEPPER_INTERVAL_SLOW);
+  while(Stepper_busy() == true)
+  {
+    Hal_advance(1000);
+  }
+
+  printf("time_us,halfsteps,interval_us,speed\n");
+  for(i=0; i<steps_recorded.size(); i++)
+  {
+    printf("%.1f,%d,%.1f,%.0f\n", (steps_recorded[i].cycles - steps_start) / (double)HAL_CYCLES_PER_US, steps_recorded[i].halfsteps,
+           Steps_interval(i), (steps_recorded[i].halfsteps * 1000000.0) / Steps_interval(i));
+  }
+  fprintf(stderr, "%lu half-steps in %.3f s\n", distance, (steps_recorded.back().cycles - steps_start) / (1000000.0 * HAL_CYCLES_PER_US));
+  return(0);
+}
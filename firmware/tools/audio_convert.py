@@ -0,0 +1,166 @@
+#!/usr/bin/env python3
+"""
+Audio asset conversion for the linear clock
+===========================================
+The samples are played through AudioOutputI2SNoDAC, a 1-bit sigma-delta output that can not reproduce
+44.1kHz/16-bit fidelity anyway. Storing the samples in that format only wastes SPIFFS space, upload time
+and read bandwidth. This script converts every WAV in the source folder to one rate and bit depth:
+
+ - mixed down to mono
+ - resampled (windowed-sinc, so no aliasing when going down from 44.1kHz)
+ - trailing silence removed
+ - normalised to just below full scale
+ - written as plain PCM (8 bit samples are dithered)
+
+and writes a manifest (audio.json) with the duration and format of every sample, so the firmware knows
+what it is going to play without opening the files.
+
+Usage (from the firmware folder):
+    python3 tools/audio_convert.py Lin_clock/audio Lin_clock/data
+
+Only the standard library is used, so no numpy etc. is required.
+"""
+
+import argparse
+import json
+import math
+import os
+import random
+import struct
+import sys
+import wave
+
+TARGET_RATE = 8000      # Hz, the NoDAC output doesn't benefit from anything higher
+TARGET_BITS = 8         # 8 or 16
+PEAK = 0.89             # normalise to -1dBFS
+SILENCE = 0.01          # samples below 1% of the peak at the end of the file are considered silence
+FADE_MS = 20            # short fade out after trimming, to avoid a click
+TAPS = 16               # half the length of the resampling filter (in samples of the slowest rate)
+
+
+def read_wav(path):
+    """read a PCM wav file, returns the rate and a list of mono samples (floats between -1 and 1)"""
+    w = wave.open(path, 'rb')
+    channels = w.getnchannels()
+    width = w.getsampwidth()
+    rate = w.getframerate()
+    data = w.readframes(w.getnframes())
+    w.close()
+
+    if width == 1:
+        raw = [(b - 128) / 128.0 for b in data]
+    elif width == 2:
+        raw = [s / 32768.0 for s in struct.unpack('<%dh' % (len(data) // 2), data)]
+    else:
+        raise ValueError('%s: %d bit samples are not supported' % (path, width * 8))
+
+    if channels > 1:  # mix down to mono
+        raw = [sum(raw[i:i + channels]) / channels for i in range(0, len(raw), channels)]
+    return rate, raw
+
+
+def resample(samples, rate_in, rate_out):
+    """windowed-sinc resampler, the cut-off is placed at the lowest of both nyquist frequencies"""
+    if rate_in == rate_out:
+        return list(samples)
+
+    ratio = rate_out / float(rate_in)
+    cutoff = min(1.0, ratio)  # relative to the input nyquist frequency
+    half = int(math.ceil(TAPS / cutoff))
+    count = int(len(samples) * ratio)
+    out = []
+
+    for n in range(count):
+        centre = n / ratio
+        first = int(math.floor(centre)) - half + 1
+        acc = 0.0
+        for i in range(first, first + 2 * half):
+            if i < 0 or i >= len(samples):
+                continue
+            x = (i - centre) * cutoff
+            sinc = 1.0 if x == 0 else math.sin(math.pi * x) / (math.pi * x)
+            window = 0.5 + 0.5 * math.cos(math.pi * (i - centre) / half)  # hann
+            acc += samples[i] * sinc * window
+        out.append(acc * cutoff)
+    return out
+
+
+def trim(samples, rate):
+    """remove the trailing silence and fade out the last few ms"""
+    peak = max(abs(s) for s in samples) if samples else 0
+    end = len(samples)
+    while end > 0 and abs(samples[end - 1]) <= peak * SILENCE:
+        end -= 1
+    samples = samples[:end]
+
+    fade = min(len(samples), rate * FADE_MS // 1000)
+    for i in range(fade):
+        samples[len(samples) - fade + i] *= 1.0 - (i + 1) / float(fade)
+    return samples
+
+
+def normalise(samples):
+    peak = max(abs(s) for s in samples) if samples else 0
+    if peak == 0:
+        return samples
+    gain = PEAK / peak
+    return [s * gain for s in samples]
+
+
+def write_wav(path, samples, rate, bits):
+    if bits == 8:
+        rnd = random.Random(0)  # the same input always results in the same file
+        data = bytearray()
+        for s in samples:
+            v = s * 127.0 + (rnd.random() - rnd.random())  # TPDF dither
+            data.append(max(0, min(255, int(round(v)) + 128)))
+    else:
+        data = struct.pack('<%dh' % len(samples), *[max(-32768, min(32767, int(round(s * 32767.0)))) for s in samples])
+
+    w = wave.open(path, 'wb')
+    w.setnchannels(1)
+    w.setsampwidth(bits // 8)
+    w.setframerate(rate)
+    w.writeframes(bytes(data))
+    w.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='convert the chime samples to one format and write the manifest')
+    parser.add_argument('source', help='folder with the original wav files')
+    parser.add_argument('data', help='the data folder of the sketch (this is what is uploaded to the SPIFFS)')
+    parser.add_argument('--rate', type=int, default=TARGET_RATE)
+    parser.add_argument('--bits', type=int, default=TARGET_BITS, choices=[8, 16])
+    args = parser.parse_args()
+
+    manifest = {'rate': args.rate, 'bits': args.bits, 'samples': {}}
+    total_in = 0
+    total_out = 0
+
+    for name in sorted(os.listdir(args.source)):
+        if not name.lower().endswith('.wav'):
+            continue
+        src = os.path.join(args.source, name)
+        dst = os.path.join(args.data, name)
+
+        rate, samples = read_wav(src)
+        samples = normalise(trim(resample(samples, rate, args.rate), args.rate))
+        write_wav(dst, samples, args.rate, args.bits)
+
+        size_in = os.path.getsize(src)
+        size_out = os.path.getsize(dst)
+        total_in += size_in
+        total_out += size_out
+        manifest['samples']['/' + name] = {'ms': len(samples) * 1000 // args.rate, 'bytes': size_out}
+        print('%-28s %6dHz -> %5dHz/%2dbit %7d -> %6d bytes %5d ms' % (name, rate, args.rate, args.bits, size_in, size_out, len(samples) * 1000 // args.rate))
+
+    with open(os.path.join(args.data, 'audio.json'), 'w') as f:
+        json.dump(manifest, f, separators=(',', ':'), sort_keys=True)
+        f.write('\n')
+
+    print('total %d -> %d bytes' % (total_in, total_out))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""
+Event log of the linear clock
+=============================
+The clock keeps its last events (state changes, moves, time syncs, page requests, errors) in a small binary ring in
+RAM, see Lin_clock/Eventlog.cpp. This script reads the /events page (or a file that was saved from it) and prints
+the events as text, with the time relative to the moment of the dump.
+
+The dump looks like this (numbers are little endian):
+    "LCEV" (4), version (1), record size (1), number of records (2), number of events since boot (4), millis() (4)
+followed by the records, oldest first:
+    millis() (4), code (2), a (2), b (4, signed)
+
+Usage (from the firmware folder):
+    python3 tools/event_log.py http://linear-clock/events
+    python3 tools/event_log.py events.bin
+    python3 tools/event_log.py http://linear-clock/events --save events.bin
+
+Only the standard library is used.
+"""
+
+import argparse
+import socket
+import struct
+import sys
+import urllib.request
+
+HEADER = struct.Struct('<4sBBHLL')
+RECORD = struct.Struct('<LHHl')
+VERSION = 1
+
+# the lists below must be kept in line with the firmware
+EVENTS = ['NONE', 'BOOT', 'STATE', 'MOVE', 'ARRIVED', 'NTP_REQUEST', 'NTP_REPLY', 'NTP_SYNC', 'NTP_TIMEOUT',
+          'NTP_INVALID', 'NTP_DNS_FAIL', 'HTTP', 'SETTING', 'NETWORK', 'CORRECTION', 'ERROR',
+          'AGENDA']                                                                               # Eventlog.h
+STATES = ['IDLE', 'RESUME', 'RESUME_CHECK', 'HOMING_SETUP', 'HOMING', 'OPERATE', 'OPERATE_2', 'OPERATE_3',
+          'OPERATE_4', 'SMOOTH', 'ALARM_SETUP', 'ALARM', 'CALIBRATE_SETUP', 'CALIBRATE', 'NTP_ERROR',
+          'ERROR']                                                                                # Lin_clock.ino
+SETTINGS = ['ssid', 'key', 'ntp', 'offset', 'dst', 'tz', 'alarm', 'chime', 'steps', 'power', 'beacon',
+            'beacon_key', 'stepmode', 'smooth', 'agenda']                                         # WebConfig.cpp
+RESETS = ['power-on', 'watchdog', 'exception', 'soft watchdog', 'restart', 'deep sleep', 'reset pin']
+
+
+def name(table, i):
+    return table[i] if i < len(table) else str(i)
+
+
+def ip(b):
+    b &= 0xFFFFFFFF
+    return '%d.%d.%d.%d' % (b & 0xFF, (b >> 8) & 0xFF, (b >> 16) & 0xFF, b >> 24)   # as lwIP stores it
+
+
+def uri(b):
+    return '/' + (b & 0xFFFFFFFF).to_bytes(4, 'little').rstrip(b'\0').decode('latin-1')
+
+
+def describe(code, a, b):
+    """the arguments of an event as text"""
+    event = name(EVENTS, code)
+    if event == 'BOOT':
+        return 'reset reason: %s' % name(RESETS, a)
+    if event == 'STATE':
+        return '%s -> %s' % (name(STATES, b), name(STATES, a))
+    if event == 'MOVE':
+        return 'to %d:%02d, %+d steps' % (a // 60, a % 60, b)
+    if event == 'ARRIVED':
+        return 'after %d ms, at position %d' % (a, b)
+    if event == 'NTP_REQUEST':
+        return '%d server(s) asked' % a
+    if event == 'NTP_REPLY':
+        return 'server %d, delay %d ms' % (a, b)
+    if event == 'NTP_SYNC':
+        return 'offset %d ms, delay %d ms' % (b, a)
+    if event == 'NTP_TIMEOUT':
+        return '%d retries left' % a
+    if event == 'NTP_INVALID':
+        return 'not a valid reply' if a == 0 else 'not a reply to our request'
+    if event == 'NTP_DNS_FAIL':
+        return 'server %d' % a
+    if event == 'HTTP':
+        return '%d %s' % (a, uri(b))
+    if event == 'SETTING':
+        return '%s changed%s' % (name(SETTINGS, a), '' if b else ', NOT stored in the journal')
+    if event == 'NETWORK':
+        return 'connected, %s' % ip(b) if a else 'lost'
+    if event == 'CORRECTION':
+        return 'GPIO%d, %+d steps' % (a, b)
+    if event == 'ERROR':
+        return 'error #%d' % a
+    if event == 'AGENDA':
+        return 'rule %d%s' % (a + 1, '' if b else ', skipped (quiet or too late)')
+    return 'a=%d b=%d' % (a, b)
+
+
+def decode(data):
+    """returns (total, now_ms, [(ms, code, a, b), ...]), raises ValueError when the dump is not valid"""
+    if len(data) < HEADER.size:
+        raise ValueError('too short')
+    magic, version, size, count, total, now_ms = HEADER.unpack_from(data)
+    if magic != b'LCEV' or version != VERSION or size != RECORD.size:
+        raise ValueError('not an event log (or another version)')
+    if len(data) < HEADER.size + count * size:
+        raise ValueError('incomplete, %d of %d records' % ((len(data) - HEADER.size) // size, count))
+    records = [RECORD.unpack_from(data, HEADER.size + i * size) for i in range(count)]
+    return total, now_ms, records
+
+
+def main():
+    parser = argparse.ArgumentParser(description='print the event log of the linear clock')
+    parser.add_argument('source', help='the URL of the /events page, or a file')
+    parser.add_argument('--save', default=None, help='also store the binary dump in this file')
+    args = parser.parse_args()
+
+    try:
+        if '://' in args.source:
+            with urllib.request.urlopen(args.source, timeout=10) as response:
+                data = response.read()
+        else:
+            with open(args.source, 'rb') as f:
+                data = f.read()
+        total, now_ms, records = decode(data)
+    except (OSError, socket.timeout, ValueError) as e:
+        print('%s: %s' % (args.source, e))
+        return 1
+
+    if args.save:
+        with open(args.save, 'wb') as f:
+            f.write(data)
+
+    print('%d events since boot, the last %d are shown, uptime %.1f s' % (total, len(records), now_ms / 1000.0))
+    for ms, code, a, b in records:
+        age = ((now_ms - ms) & 0xFFFFFFFF) / 1000.0     # millis() wraps after 49 days
+        print('%10.3f  -%9.1f s  %-12s %s' % (ms / 1000.0, age, name(EVENTS, code), describe(code, a, b)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,266 @@
+#!/usr/bin/env python3
+"""
+Time beacons for a fleet of linear clocks
+=========================================
+One master sends the time to a multicast group on the LAN, the clocks that are set to "follower" lock to it
+(see Lin_clock/Beacon.cpp for the firmware side). This script can:
+
+ - master     send beacons using the time of this computer (which should be synced by NTP itself)
+ - follow     listen to the beacons and show how far they differ from the time of this computer
+ - simulate   run a master and several simulated clocks (each with its own offset and drifting crystal) on the
+              loopback interface, and check that they all end up at the same time. A beacon with a wrong key
+              is sent as well, it must be rejected by every clock. The clocks are a Python model, the firmware itself
+              is tested against a master in host/test/sim_beacon.cpp
+
+A beacon is 28 bytes (numbers are big endian):
+    "LCB", version (1), flags (1), reserved (3), sequence number (4), UTC time in us since 1970 (8),
+    SipHash-2-4 of the previous 20 bytes (8, little endian), the key is the shared secret padded to 16 bytes
+
+Usage (from the firmware folder):
+    python3 tools/time_beacon.py master --key secret
+    python3 tools/time_beacon.py simulate --clocks 8 --seconds 30
+
+Only the standard library is used.
+"""
+
+import argparse
+import random
+import socket
+import struct
+import sys
+import threading
+import time
+
+GROUP = '239.255.42.99'
+PORT = 4242
+VERSION = 1
+FLAG_SYNCED = 0x01
+SIZE = 28
+SIGNED = 20
+
+STEP_LIMIT = 1.0    # offsets larger than this (in s) are stepped instead of slewed, like NTP.cpp
+MASK = 0xFFFFFFFFFFFFFFFF
+
+
+def siphash24(key, data):
+    """SipHash-2-4 of data (bytes) with a 16 byte key, returns an integer"""
+    def rotl(x, b):
+        return ((x << b) | (x >> (64 - b))) & MASK
+
+    def rounds(v, n):
+        v0, v1, v2, v3 = v
+        for _ in range(n):
+            v0 = (v0 + v1) & MASK; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32)
+            v2 = (v2 + v3) & MASK; v3 = rotl(v3, 16); v3 ^= v2
+            v0 = (v0 + v3) & MASK; v3 = rotl(v3, 21); v3 ^= v0
+            v2 = (v2 + v1) & MASK; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32)
+        return [v0, v1, v2, v3]
+
+    k0, k1 = struct.unpack('<QQ', key)
+    v = [k0 ^ 0x736f6d6570736575, k1 ^ 0x646f72616e646f6d, k0 ^ 0x6c7967656e657261, k1 ^ 0x7465646279746573]
+    tail = len(data) - (len(data) % 8)
+    for i in range(0, tail, 8):
+        m = struct.unpack_from('<Q', data, i)[0]
+        v[3] ^= m
+        v = rounds(v, 2)
+        v[0] ^= m
+    b = (len(data) << 56) & MASK
+    for i, c in enumerate(data[tail:]):
+        b |= c << (8 * i)
+    v[3] ^= b
+    v = rounds(v, 2)
+    v[0] ^= b
+    v[2] ^= 0xff
+    v = rounds(v, 4)
+    return v[0] ^ v[1] ^ v[2] ^ v[3]
+
+
+def make_key(secret):
+    """the firmware uses the (at most 16) characters of the secret, padded with zeros"""
+    return secret.encode()[:16].ljust(16, b'\0')
+
+
+def make_beacon(key, sequence, time_us, flags=FLAG_SYNCED):
+    packet = b'LCB' + struct.pack('>BB3xLQ', VERSION, flags, sequence, time_us)
+    return packet + struct.pack('<Q', siphash24(key, packet))
+
+
+def parse_beacon(key, packet):
+    """returns (sequence, time_us) or None when the beacon is not valid"""
+    if len(packet) != SIZE or packet[:3] != b'LCB':
+        return None
+    version, flags, sequence, time_us = struct.unpack_from('>BB3xLQ', packet, 3)
+    tag = struct.unpack_from('<Q', packet, SIGNED)[0]
+    if version != VERSION or not (flags & FLAG_SYNCED) or tag != siphash24(key, packet[:SIGNED]):
+        return None
+    return sequence, time_us
+
+
+def sender(interface):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 1)     # stay on the LAN
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_LOOP, 1)
+    if interface:
+        sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_IF, socket.inet_aton(interface))
+    return sock
+
+
+def receiver(interface):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    if hasattr(socket, 'SO_REUSEPORT'):
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, 1)     # several simulated clocks on one computer
+    sock.bind(('', PORT))
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, socket.inet_aton(GROUP) + socket.inet_aton(interface or '0.0.0.0'))
+    return sock
+
+
+def master(key, interval, interface, stop=None, clock=time.time):
+    sock = sender(interface)
+    sequence = 0
+    while stop is None or not stop.is_set():
+        sequence = (sequence + 1) & 0xFFFFFFFF
+        sock.sendto(make_beacon(key, sequence, int(clock() * 1e6)), (GROUP, PORT))
+        if stop is None:
+            time.sleep(interval)
+        else:
+            stop.wait(interval)
+
+
+class SimClock:
+    """a clock with a crystal that drifts, disciplined by the beacons the same way as NTP.cpp does it"""
+
+    def __init__(self, name, offset, drift_ppm, poll):
+        self.name = name
+        self.start = time.time()
+        self.offset = offset            # the error of the clock at power-on, in s
+        self.drift = drift_ppm * 1e-6   # the error of the crystal
+        self.poll = poll                # a beacon is used once per poll interval, so the drift can be measured
+        self.adjust = 0.0               # the corrections that have been applied
+        self.drift_estimate = 0.0
+        self.base = 0.0                 # the moment (on the raw clock) of the last correction
+        self.synced = False
+        self.last_time = 0
+        self.accepted = 0
+        self.rejected = 0
+
+    def raw(self, now):
+        return now + self.offset + self.drift * (now - self.start)
+
+    def now(self, now=None):
+        now = time.time() if now is None else now
+        raw = self.raw(now)
+        return raw + self.adjust - (self.drift_estimate * (raw - self.base))
+
+    def beacon(self, time_us, arrival):
+        if time_us <= self.last_time:       # an old (copied) beacon
+            self.rejected += 1
+            return
+        self.last_time = time_us
+        self.accepted += 1
+        raw = self.raw(arrival)
+        target = time_us / 1e6
+        error = target - self.now(arrival)
+        if self.synced and abs(error) < STEP_LIMIT:
+            if raw - self.base < self.poll:
+                return
+            self.drift_estimate -= error / (raw - self.base)    # the error that built up since the last correction
+        self.adjust = target - raw          # the firmware slews small errors in, here they are simply stepped
+        self.base = raw
+        self.synced = True
+
+    def run(self, key, interface, stop):
+        sock = receiver(interface)
+        sock.settimeout(0.2)
+        while not stop.is_set():
+            try:
+                packet = sock.recv(64)
+            except socket.timeout:
+                continue
+            arrival = time.time()
+            result = parse_beacon(key, packet)
+            if result is None:
+                self.rejected += 1
+            else:
+                self.beacon(result[1], arrival)
+        sock.close()
+
+
+def simulate(args, key):
+    stop = threading.Event()
+    rng = random.Random(args.seed)
+    clocks = [SimClock('clock%d' % i, rng.uniform(-30, 30), rng.uniform(-200, 200), args.poll) for i in range(args.clocks)]
+    threads = [threading.Thread(target=c.run, args=(key, args.interface, stop), daemon=True) for c in clocks]
+    for t in threads:
+        t.start()
+    time.sleep(0.5)     # the receivers must have joined the group
+
+    threads.append(threading.Thread(target=master, args=(key, args.interval, args.interface, stop), daemon=True))
+    threads[-1].start()
+    forged = sender(args.interface)
+    deadline = time.time() + args.seconds
+    while time.time() < deadline:
+        forged.sendto(make_beacon(make_key('wrong key'), 1, int((time.time() + 3600) * 1e6)), (GROUP, PORT))
+        time.sleep(1.0)
+    stop.set()
+    for t in threads:
+        t.join(1.0)
+
+    now = time.time()
+    errors = []
+    print('%-8s %10s %10s %9s %9s %11s' % ('clock', 'start_s', 'drift_ppm', 'accepted', 'rejected', 'error_ms'))
+    for c in clocks:
+        error = (c.now(now) - now) * 1000.0
+        errors.append(error)
+        print('%-8s %10.3f %10.1f %9d %9d %11.3f' % (c.name, c.offset, c.drift * 1e6, c.accepted, c.rejected, error))
+    spread = max(errors) - min(errors)
+    print('spread %.3f ms' % spread)
+
+    if any(not c.synced for c in clocks):
+        print('FAIL: not every clock received a beacon (is multicast allowed on %s?)' % (args.interface or 'the default interface'))
+        return 1
+    if any(c.rejected == 0 for c in clocks):
+        print('FAIL: the forged beacons were not rejected')
+        return 1
+    if spread > args.tolerance:
+        print('FAIL: the clocks are more than %.1f ms apart' % args.tolerance)
+        return 1
+    print('OK')
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description='send, watch or simulate the time beacons of the linear clocks')
+    parser.add_argument('mode', choices=['master', 'follow', 'simulate'])
+    parser.add_argument('--key', default='', help='the shared secret (the beacon key in the settings of the clocks)')
+    parser.add_argument('--interface', default=None, help='the address of the interface to use (simulate uses 127.0.0.1)')
+    parser.add_argument('--interval', type=float, default=None, help='time between beacons in s (8 for master, 0.2 for simulate)')
+    parser.add_argument('--clocks', type=int, default=8, help='simulate: the number of clocks')
+    parser.add_argument('--seconds', type=float, default=20, help='simulate: how long to run')
+    parser.add_argument('--poll', type=float, default=4, help='simulate: a beacon is used once per ... s (NTP_POLL_MIN in the firmware)')
+    parser.add_argument('--tolerance', type=float, default=20, help='simulate: the largest allowed difference between the clocks in ms')
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+    key = make_key(args.key)
+
+    if args.mode == 'master':
+        master(key, args.interval or 8.0, args.interface)
+    elif args.mode == 'follow':
+        sock = receiver(args.interface)
+        while True:
+            packet = sock.recv(64)
+            arrival = time.time()
+            result = parse_beacon(key, packet)
+            if result is None:
+                print('invalid beacon (wrong key?)')
+            else:
+                print('beacon %d, difference %.3f ms' % (result[0], (result[1] / 1e6 - arrival) * 1000.0))
+    else:
+        args.interface = args.interface or '127.0.0.1'
+        args.interval = args.interval or 0.2
+        return simulate(args, key)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
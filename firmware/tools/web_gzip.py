@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""
+Web asset packing for the linear clock
+======================================
+The pages of the webserver are served from the SPIFFS over the (slow) WiFi of the ESP8266. This script takes
+the files of the web folder of the sketch and places them in the data folder (which is uploaded to the SPIFFS):
+
+ - text based files (htm, css, js, ico, ...) are stored gzipped, the browser unpacks them
+ - files that don't get any smaller (jpg, ...) are copied as they are
+ - a manifest (web.json) lists every file with a hash of its contents
+
+At boot the firmware reads the manifest into a table, so it knows which files exist (without searching the
+SPIFFS) and can answer a browser that already has the file with "304 Not Modified" without reading the flash.
+
+Usage (from the firmware folder):
+    python3 tools/web_gzip.py Lin_clock/web Lin_clock/data
+
+Only the standard library is used. The output is reproducible, the same input always results in the same files.
+"""
+
+import argparse
+import gzip
+import hashlib
+import json
+import os
+import sys
+
+COMPRESS = ('.htm', '.html', '.css', '.js', '.ico', '.txt', '.svg', '.xml', '.json')
+NAME_MAX = 31   # SPIFFS object names are limited to 31 characters (including the leading /)
+SKIP = ('index - werkt.htm',)   # an old copy of the main page, kept for reference, the webserver doesn't use it
+
+
+def main():
+    parser = argparse.ArgumentParser(description='gzip the web assets and write the manifest')
+    parser.add_argument('source', help='folder with the original web files')
+    parser.add_argument('data', help='the data folder of the sketch (this is what is uploaded to the SPIFFS)')
+    args = parser.parse_args()
+
+    manifest = []
+    total_in = 0
+    total_out = 0
+
+    for name in sorted(os.listdir(args.source)):
+        src = os.path.join(args.source, name)
+        if not os.path.isfile(src) or name in SKIP:
+            continue
+
+        with open(src, 'rb') as f:
+            data = f.read()
+
+        out_name = name
+        if name.lower().endswith(COMPRESS):
+            packed = gzip.compress(data, compresslevel=9, mtime=0)
+            if len(packed) < len(data):
+                data = packed
+                out_name = name + '.gz'
+
+        if len('/' + out_name) > NAME_MAX:
+            print('%s: name is too long for the SPIFFS' % out_name)
+            return 1
+
+        # remove the other variant, otherwise both end up in the SPIFFS
+        stale = os.path.join(args.data, name + '.gz' if out_name == name else name)
+        if os.path.exists(stale):
+            os.remove(stale)
+
+        with open(os.path.join(args.data, out_name), 'wb') as f:
+            f.write(data)
+
+        total_in += os.path.getsize(src)
+        total_out += len(data)
+        manifest.append({'path': '/' + name,
+                         'gz': out_name != name,
+                         'etag': hashlib.sha256(data).hexdigest()[:16]})
+        print('%-24s %7d -> %7d bytes' % (out_name, os.path.getsize(src), len(data)))
+
+    with open(os.path.join(args.data, 'web.json'), 'w') as f:
+        json.dump(manifest, f, separators=(',', ':'), sort_keys=True)
+        f.write('\n')
+
+    print('total %d -> %d bytes' % (total_in, total_out))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())